@@ -10,18 +10,26 @@ uniform float aspect_ratio = 720.0f/1280.0f;
 uniform mat4 view;
 uniform mat4 perspective;
 uniform vec3 transform[256];
+uniform vec4 rotation[256];	/* body frame -> world frame, (x, y, z, w) quaternion */
 uniform int collision[256];
 
 out vec3 FragPos;
 out vec4 color;
 out vec3 normal;
 
+/* q v q^-1 for unit q */
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
 	int i = index % 256;
+	vec3 world_position = rotate(rotation[i], position) + transform[i].xyz;
 	vec4 collision_color = vec4(1.0f, 0.0f, 0.0f, a_color.w);
 	color = collision[i] * collision_color + (1 - collision[i]) * a_color;
- 	gl_Position = perspective * view * vec4(position + transform[i].xyz, 1.0f);
-	normal = a_normal;
-	FragPos = position + transform[i].xyz;
+ 	gl_Position = perspective * view * vec4(world_position, 1.0f);
+	normal = rotate(rotation[i], a_normal);
+	FragPos = world_position;
 }
@@ -65,6 +65,118 @@ struct dbvt dbvt_alloc(struct arena *mem, const i32 len)
 	return tree;
 }
 
+/* partially sort perm[lo, hi) so that perm[mid] holds the box with the median centroid along axis */
+static void dbvt_internal_select(i32 *perm, const struct AABB *box, i32 lo, i32 hi, const i32 mid, const u32 axis)
+{
+	hi -= 1;
+	while (lo < hi)
+	{
+		const f32 pivot = box[perm[lo + (hi - lo) / 2]].center[axis];
+		i32 i = lo;
+		i32 j = hi;
+		while (i <= j)
+		{
+			while (box[perm[i]].center[axis] < pivot) { i += 1; }
+			while (box[perm[j]].center[axis] > pivot) { j -= 1; }
+			if (i <= j)
+			{
+				const i32 tmp = perm[i];
+				perm[i] = perm[j];
+				perm[j] = tmp;
+				i += 1;
+				j -= 1;
+			}
+		}
+
+		if (mid <= j)
+		{
+			hi = j;
+		}
+		else if (mid >= i)
+		{
+			lo = i;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+static i32 dbvt_internal_build(struct dbvt *tree, const struct AABB *box, i32 *perm, const i32 lo, const i32 hi, const i32 parent)
+{
+	const i32 node = tree->len++;
+	tree->nodes[node].parent = parent;
+
+	if (hi - lo == 1)
+	{
+		tree->nodes[node].box = box[perm[lo]];
+		tree->nodes[node].id = perm[lo];
+		tree->nodes[node].left = DBVT_NO_NODE;
+		tree->nodes[node].right = DBVT_NO_NODE;
+		return node;
+	}
+
+	vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (i32 i = lo; i < hi; ++i)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			min[k] = fminf(min[k], box[perm[i]].center[k]);
+			max[k] = fmaxf(max[k], box[perm[i]].center[k]);
+		}
+	}
+
+	u32 axis = 0;
+	for (u32 k = 1; k < 3; ++k)
+	{
+		if (max[k] - min[k] > max[axis] - min[axis])
+		{
+			axis = k;
+		}
+	}
+
+	const i32 mid = lo + (hi - lo) / 2;
+	dbvt_internal_select(perm, box, lo, hi, mid, axis);
+
+	tree->nodes[node].id = DBVT_NO_NODE;
+	tree->nodes[node].left = dbvt_internal_build(tree, box, perm, lo, mid, node);
+	tree->nodes[node].right = dbvt_internal_build(tree, box, perm, mid, hi, node);
+	AABB_union(&tree->nodes[node].box, &tree->nodes[tree->nodes[node].left].box, &tree->nodes[tree->nodes[node].right].box);
+
+	return node;
+}
+
+struct dbvt dbvt_build(struct arena *mem, const struct AABB *box, const i32 count)
+{
+	struct dbvt tree =
+	{
+		.cost_queue = NULL,
+		.nodes = NULL,
+		.proxy_count = count,
+		.root = DBVT_NO_NODE,
+		.next = DBVT_NO_NODE,
+		.len = 0,
+	};
+
+	if (count == 0) { return tree; }
+
+	tree.nodes = arena_push(mem, NULL, (2*count - 1) * sizeof(struct dbvt_node));
+
+	struct arena record = *mem;
+	i32 *perm = arena_push(mem, NULL, count * sizeof(i32));
+	for (i32 i = 0; i < count; ++i)
+	{
+		perm[i] = i;
+	}
+	tree.root = dbvt_internal_build(&tree, box, perm, 0, count, DBVT_NO_NODE);
+	assert(tree.len == 2*count - 1);
+	*mem = record;
+
+	return tree;
+}
+
 static f32 cost_SVT(const struct AABB *box)
 {
 	return box->hw[0]*box->hw[1]*box->hw[2];
@@ -408,6 +520,118 @@ i32 dbvt_internal_push_subtree_overlap_pairs(struct arena *mem, const struct dbv
 	return overlap_count;
 }
 
+i32 dbvt_push_box_overlaps(struct arena *mem, const struct dbvt *tree, const struct AABB *box)
+{
+	if (tree->proxy_count == 0) { return 0; }
+
+	i32 overlap_count = 0;
+	i32 node = tree->root;
+	i32 q = -1;
+	i32 stack[2*COST_QUEUE_MAX];
+
+	while (1)
+	{
+		if (AABB_test(&tree->nodes[node].box, box))
+		{
+			if (tree->nodes[node].left == DBVT_NO_NODE)
+			{
+				overlap_count += 1;
+				arena_push_packed(mem, &tree->nodes[node].id, sizeof(i32));
+			}
+			else
+			{
+				stack[++q] = tree->nodes[node].right;
+				assert(q < 2*COST_QUEUE_MAX);
+				node = tree->nodes[node].left;
+				continue;
+			}
+		}
+
+		if (q != -1)
+		{
+			node = stack[q--];
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return overlap_count;
+}
+
+/* dst = rot*src + pos, grown by margin */
+static void dbvt_internal_transform_box(struct AABB *dst, const struct AABB *src, mat3 rot, const vec3 pos, const f32 margin)
+{
+	mat3_vec_mul(dst->center, rot, src->center);
+	vec3_translate(dst->center, pos);
+	for (u32 k = 0; k < 3; ++k)
+	{
+		dst->hw[k] = fabsf(rot[0][k])*src->hw[0] + fabsf(rot[1][k])*src->hw[1] + fabsf(rot[2][k])*src->hw[2] + margin;
+	}
+}
+
+i32 dbvt_push_transformed_overlap_pairs(struct arena *mem, const struct dbvt *a, const struct dbvt *b, mat3 rot, const vec3 pos, const f32 margin)
+{
+	if (a->proxy_count == 0 || b->proxy_count == 0) { return 0; }
+
+	i32 overlap_count = 0;
+	i32 overlap[2];
+	i32 subA = a->root;
+	i32 subB = b->root;
+	i32 q = -1;
+	i32 stack[2*COST_QUEUE_MAX];
+	struct AABB box_b;
+
+	while (1)
+	{
+		dbvt_internal_transform_box(&box_b, &b->nodes[subB].box, rot, pos, margin);
+		if (AABB_test(&a->nodes[subA].box, &box_b))
+		{
+			const i32 leaf_a = (a->nodes[subA].left == DBVT_NO_NODE);
+			const i32 leaf_b = (b->nodes[subB].left == DBVT_NO_NODE);
+			if (leaf_a && leaf_b)
+			{
+				overlap_count += 1;
+				overlap[0] = a->nodes[subA].id;
+				overlap[1] = b->nodes[subB].id;
+				arena_push_packed(mem, overlap, sizeof(overlap));
+			}
+			else
+			{
+				/* descend into the larger volume first */
+				if (leaf_b || (!leaf_a && cost_SAT(&box_b) < cost_SAT(&a->nodes[subA].box)))
+				{
+					stack[++q] = a->nodes[subA].left;
+					stack[++q] = subB;
+					subA = a->nodes[subA].right;
+				}
+				else
+				{
+					stack[++q] = subA;
+					stack[++q] = b->nodes[subB].left;
+					subB = b->nodes[subB].right;
+				}
+
+				assert(q < 2*COST_QUEUE_MAX);
+				continue;
+			}
+		}
+
+		if (q != -1)
+		{
+			subB = stack[q--];
+			subA = stack[q--];
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return overlap_count;
+}
+
 i32 dbvt_push_overlap_pairs(struct arena *mem, struct dbvt *tree)
 {
 	if (tree->proxy_count < 2) { return 0; }
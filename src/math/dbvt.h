@@ -67,12 +67,25 @@ struct dbvt
 
 /* If mem == NULL, standard malloc is used */
 struct 	dbvt dbvt_alloc(struct arena *mem, const i32 len);
+/**
+ * Bulk build a static tree over count boxes, leaf i getting id i. Nodes are split top-down at the centroid median
+ * of their largest centroid axis and laid out in depth first order (left child directly after its parent). The
+ * tree is full and has no cost queue, so it must not be inserted into.
+ */
+struct	dbvt dbvt_build(struct arena *mem, const struct AABB *box, const i32 count);
 /* id is an integer identifier from the outside, return index of added value */
 i32 	dbvt_insert(struct dbvt *tree, const i32 id, const struct AABB *box);
 /* remove leaf corresponding to index from tree */
 void 	dbvt_remove(struct dbvt *tree, const i32 index);
 /* push overlap indices onto mem->stack_ptr; returns number of collisions. -1 == out of memory */
 i32 	dbvt_push_overlap_pairs(struct arena *mem, struct dbvt *tree);
+/* push ids of leaves overlapping box onto mem->stack_ptr; returns number of overlaps */
+i32 	dbvt_push_box_overlaps(struct arena *mem, const struct dbvt *tree, const struct AABB *box);
+/**
+ * push overlapping leaf id pairs (id_a, id_b) of two trees in different frames onto mem->stack_ptr; boxes of b are
+ * taken into the frame of a by x -> rot*x + pos and grown by margin. Returns number of pairs.
+ */
+i32	dbvt_push_transformed_overlap_pairs(struct arena *mem, const struct dbvt *a, const struct dbvt *b, mat3 rot, const vec3 pos, const f32 margin);
 /* validate tree construction */
 void	dbvt_validate(struct dbvt *tree);
 /* push heirarchy node box lines into draw buffer */
@@ -6,6 +6,7 @@
 #include "relation_list.h"
 #include "array_list.h"
 #include "queue.h"
+#include "thread.h"
 
 /**************************************************************/
 
@@ -118,32 +119,33 @@ i32 tetrahedron_indices(i32 indices[4], const vec3ptr v, const i32 v_count, cons
 		}
 	}	
 
-	/* Find non-collinear point */
+	/* 
+	 * Find non-collinear point, the distance to the line is |a x b| since sqrt(|b|^2 - (a.b)^2) cancels to 
+	 * rounding noise for far away points on the line, such as the points of a lattice row
+	 */
 	for (i32 i = indices[1] + 1; i <= v_count; ++i)
 	{
 		/* all points are collinear */
 		if (i == v_count) { return 0; }
 
 		vec3_sub(b, v[i], v[0]);
-		const f32 dot = vec3_dot(a, b);
-		
-		if (sqrtf(vec3_length(b)*vec3_length(b) - dot*dot) > tol)
+		vec3_cross(c, a, b);
+		if (vec3_length(c) > tol)
 		{
 			indices[2] = i;
 			break;
 		}
 	}
 
+	/* plane normal */
+	vec3_mul_constant(c, 1.0f / vec3_length(c));
+
 	/* Find non-coplanar point */
 	for (i32 i = indices[2] + 1; i <= v_count; ++i)
 	{
 		/* all points are coplanar */
 		if (i == v_count) { return 0; }
 
-		/* plane normal */
-		vec3_cross(c, a, b);
-		vec3_mul_constant(c, 1.0f / vec3_length(c));
-
 		vec3_sub(d, v[i], v[0]);
 		if (fabs(vec3_dot(d, c)) > tol)
 		{
@@ -604,38 +606,26 @@ void convex_hull_cs_step_draw_internal_push_data(const struct DCEL *dcel, struct
 	d_buf->next_index = m_i;
 }
 
-struct tri_mesh tri_mesh_empty(void)
-{
-	struct tri_mesh mesh =
-	{
-		.v = NULL,
-		.v_count = 0,
-		.tri = NULL,
-		.tri_count = 0,
-	};
-
-	return mesh;
-}
-
-struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, struct arena *mem_5, const vec3ptr v, const u32 v_count, const f32 EPSILON)
+i32 convex_hull_cs_step_draw(struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, struct arena *mem_5, const f32 *vs, const i32 num_vs, const f32 EPSILON, const i32 num_steps, const u32 seed, struct drawbuffer *d_buf, const vec4 color, const i32 polygon_mode)
 {
-	if (v_count < 4) { return tri_mesh_empty(); }	
+	mersenne_twister_init(seed);
+	if (num_vs < 4) { return 0; }	
 
 	/* (1) Get inital points for tetrahedron */
 	i32 init_i[4] = { 0 };
-	if (tetrahedron_indices(init_i, v, v_count, EPSILON) == 0) { return tri_mesh_empty(); }
+	if (tetrahedron_indices(init_i, (vec3ptr) vs, num_vs, EPSILON) == 0) { return 0; }
 
 	/* (2) permutation - Random permutation of remaining points */
-	const u64 permutation_size = sizeof(i32) * v_count;
+	const u64 permutation_size = sizeof(i32) * num_vs;
 	i32 *permutation = (i32 *) arena_push(table_mem, NULL, permutation_size);
-	convex_hull_internal_random_permutation(permutation, init_i, v_count);
+	convex_hull_internal_random_permutation(permutation, init_i, num_vs);
 	
 	/* (3) initiate DCEL from points */
-	struct DCEL dcel = convex_hull_internal_setup_tetrahedron_DCEL(table_mem, face_mem, init_i, v);
+	struct DCEL dcel = convex_hull_internal_setup_tetrahedron_DCEL(table_mem, face_mem, init_i, (vec3ptr) vs);
 
 
 	/* (4) setup conflict graph */
-	struct relation_list conflict_graph = convex_hull_internal_tetrahedron_conflicts(&dcel, conflict_mem, permutation, table_mem, v, v_count, EPSILON);
+	struct relation_list conflict_graph = convex_hull_internal_tetrahedron_conflicts(&dcel, conflict_mem, permutation, table_mem, (vec3ptr) vs, num_vs, EPSILON);
 
 	/**
 	 * vertex -> edge map. We iterate over all conflicting faces for a point, and for each edge
@@ -643,10 +633,10 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 	 * In the end, we will only have the horizon edges left. For degenerate coplanar faces for newly
 	 * created faces in the point's iteration, we can check the horizon edges' twins.
 	 */
-	struct hash_index *horizon_map = hash_new(mem_4, power_of_two_ceil(v_count), 1024);
+	struct hash_index *horizon_map = hash_new(mem_4, power_of_two_ceil(num_vs), 1024);
 
 	/* iteratetively solve and add conflicts until no vertices left */
-	const i32 n = v_count;
+	const i32 n = (4 + num_steps < num_vs) ?  4 + num_steps : num_vs;
 
 	for (i32 i = 4; i < n; ++i)
 	{
@@ -712,12 +702,12 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 
 			i32 b_i = dcel.he_table[dcel.he_table[dcel.he_table[dcel.he_table[horizon_edges[j]].twin].next].next].origin;
 			vec3 b, c, normal, origin, new;
-			vec3_copy(origin, v[dcel.he_table[horizon_edges[j]].origin]);
-			vec3_sub(b, v[b_i], origin);
-			vec3_sub(c, v[dcel.he_table[horizon_edges[(j+1) % num_edges]].origin], origin);
+			vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
+			vec3_sub(b, vs + 3*b_i, origin);
+			vec3_sub(c, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
 			vec3_cross(normal, b, c);
 			vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-			vec3_sub(new, v[permutation[i]], origin);
+			vec3_sub(new, vs + 3*permutation[i], origin);
 			/*coplanar if neighbor is on fat plane of new face */
 			if (fabs(vec3_dot(new, normal)) < EPSILON)
 			{
@@ -798,12 +788,12 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 						prev_edge);
 					if (tmp != -1) { dcel.he_table[tmp].twin = last_edge_in_polygon; }
 					
-					vec3_copy(origin, v[dcel.he_table[horizon_edges[j]].origin]);
-					vec3_sub(b, v[dcel.he_table[horizon_edges[(j+1) % num_edges]].origin], origin);
-					vec3_sub(c, v[permutation[i]], origin);
+					vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
+					vec3_sub(b, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
+					vec3_sub(c, vs + 3*permutation[i], origin);
 					vec3_cross(normal, b, c);
 					vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-					convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, v, EPSILON);
+					convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, (vec3ptr) vs, EPSILON);
 				
 					dcel.he_table[horizon_edges[j]].prev = last_edge_in_polygon;
 					dcel.he_table[horizon_edges[j]].next = prev_edge;
@@ -820,12 +810,12 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 				for (k += 1; k < upper+1 && dcel.he_table[dcel.he_table[horizon_edges[k]].twin].face_ccw == dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw; k += 1);
 
 				b_i = dcel.he_table[dcel.he_table[dcel.he_table[dcel.he_table[horizon_edges[j]].twin].next].next].origin;
-				vec3_copy(origin, v[dcel.he_table[horizon_edges[j]].origin]);
-				vec3_sub(b, v[b_i], origin);
-				vec3_sub(c, v[dcel.he_table[horizon_edges[(j+1) % num_edges]].origin], origin);
+				vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
+				vec3_sub(b, vs + 3*b_i, origin);
+				vec3_sub(c, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
 				vec3_cross(normal, b, c);
 				vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-				vec3_sub(new, v[permutation[i]], origin);
+				vec3_sub(new, vs + 3*permutation[i], origin);
 				/*coplanar if neighbor is on fat plane of new face */
 				if (fabs(vec3_dot(new, normal)) < EPSILON)
 				{
@@ -909,12 +899,12 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 							prev_edge);
 						dcel.he_table[tmp].twin = last_edge_in_polygon;
 
-						vec3_copy(origin, v[dcel.he_table[horizon_edges[j]].origin]);
-						vec3_sub(b, v[dcel.he_table[horizon_edges[(j+1) % num_edges]].origin], origin);
-						vec3_sub(c, v[permutation[i]], origin);
+						vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
+						vec3_sub(b, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
+						vec3_sub(c, vs + 3*permutation[i], origin);
 						vec3_cross(normal, b, c);
 						vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-						convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, v, EPSILON);
+						convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, (vec3ptr) vs, EPSILON);
 
 						dcel.he_table[horizon_edges[j]].prev = last_edge_in_polygon;
 						dcel.he_table[horizon_edges[j]].next = prev_edge;
@@ -964,415 +954,1626 @@ struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem
 		relation_list_remove_relation_unit(&conflict_graph, i);
 	}
 
+	convex_hull_cs_step_draw_internal_push_data(&dcel, d_buf, vs, color, polygon_mode);
+
+	/* Cleanup */
+	hash_free(horizon_map);
+	relation_list_free(&conflict_graph);
+	arena_pop_packed(table_mem, dcel.num_he * sizeof(struct DCEL_half_edge));
+	arena_pop_packed(face_mem, dcel.num_faces * sizeof(struct DCEL_face));
+	arena_pop(table_mem, permutation_size);
+
+	return 1;
+}
+
+#endif
+
+struct tri_mesh tri_mesh_empty(void)
+{
 	struct tri_mesh mesh =
 	{
-		.v = arena_push(mem, v, v_count * sizeof(vec3)),
-		.v_count = v_count,
+		.v = NULL,
+		.v_count = 0,
+		.tri = NULL,
 		.tri_count = 0,
 	};
 
-	mesh.tri = (vec3u32ptr) mem->stack_ptr;
-	for (i32 i = 0; i < dcel.num_faces; ++i)
+	return mesh;
+}
+
+f32 tri_mesh_volume(const struct tri_mesh *mesh)
+{
+	f32 volume = 0.0f;
+	vec3 cross;
+	for (u32 t = 0; t < mesh->tri_count; ++t)
 	{
-		const struct DCEL_face *f = &dcel.faces[i];
-		/* It is a face on the convex mesh */
-		if (f->relation_unit != -1)
+		vec3_cross(cross, mesh->v[mesh->tri[t][1]], mesh->v[mesh->tri[t][2]]);
+		volume += vec3_dot(mesh->v[mesh->tri[t][0]], cross) / 6.0f;
+	}
+	return volume;
+}
+
+void tri_mesh_push(struct drawbuffer *buf, const struct tri_mesh *mesh, const vec4 color, const i32 index)
+{
+	vec3 normal, ab, ac;
+	vec3i32 indices;
+	i32 m_i = buf->next_index;
+	for (u32 i = 0; i < mesh->tri_count; ++i)
+	{
+		const u32 *t = mesh->tri[i];
+		vec3_sub(ab, mesh->v[t[1]], mesh->v[t[0]]);
+		vec3_sub(ac, mesh->v[t[2]], mesh->v[t[0]]);
+		vec3_cross(normal, ab, ac);
+		vec3_mul_constant(normal, 1.0f / vec3_length(normal));
+
+		/* flat shading, every triangle gets its own vertices */
+		for (u32 j = 0; j < 3; ++j)
 		{
-			struct DCEL_half_edge *he = &dcel.he_table[f->he_index];
+			arena_push_packed(&buf->v_buf, mesh->v[t[j]], sizeof(vec3));
+			arena_push_packed(&buf->v_buf, color, sizeof(vec4));
+			arena_push_packed(&buf->v_buf, normal, sizeof(vec3));
+			arena_push_packed(&buf->v_buf, &index, sizeof(i32));
+		}
+		vec3i32_set(indices, m_i + 0, m_i + 1, m_i + 2);
+		arena_push_packed(&buf->i_buf, indices, sizeof(vec3i32));
+		m_i += 3;
+	}
 
-			vec3u32 tri;
-			tri[0] = he->origin;
-			he = &dcel.he_table[he->next];
-			tri[1] = he->origin;
-			he = &dcel.he_table[he->next];
-			tri[2] = he->origin;
+	buf->next_index = m_i;
+}
 
-			arena_push_packed(mem, tri, sizeof(vec3u32));
-			mesh.tri_count += 1;
+/**
+ * Convex hull construction shared by the randomized incremental and the Quickhull path. Both keep a triangulated
+ * hull with face adjacencies, and every point not yet in the hull keeps a single conflicting face, which is the 
+ * linear-space variant of [Clarkson-Shor, Applications of Random Sampling in Computational Geometry II, page 23]. 
+ * Faces keep a linked list of their conflicting points, with the farthest point first. On insertion, the visible 
+ * region is found by walking face adjacencies from the point's conflict face, the visible faces are replaced by 
+ * a cone of new faces over the horizon, and the points of removed faces are handed over to the new faces or 
+ * discarded as interior points.
+ *
+ * All working memory is taken from a single scratch arena of size convex_hull_scratch_size(v_count):
+ *
+ * 	points		- u32[n]	insertion order (incremental) or classification batch (Quickhull)
+ * 	conflict	- i32[n]	conflicting face of point (-1 == inserted or interior)
+ * 	point_next	- i32[n]	next point in face's conflict list
+ * 	vertex_map	- i32[n]	vertex -> horizon edge, then new face on the horizon, later vertex -> output vertex
+ * 	faces		- hull_face[2n]	a triangulated hull on n vertices has at most 2n - 4 faces
+ * 	stack		- i32[2n]	visible face traversal, later the new faces of an insertion
+ * 	horizon		- i32[2*2n]	(face, edge) pairs on the horizon
+ */
+struct hull_face
+{
+	u32 v[3];	/* CCW vertices seen from the outside */
+	i32 adj[3];	/* adj[k] is the face sharing edge v[k] -> v[k+1] */
+	vec3 normal;
+	f32 d;		/* plane: dot(normal, x) == d */
+	i32 conflict;	/* farthest conflicting point, or -1 */
+	i32 visit;	/* insertion step the face was last visited at */
+	i32 next;	/* next free face, or CONVEX_HULL_FACE_ALIVE */
+};
 
-			/* 0->2->3, 0->3->4, ... */
-			while (he->next != f->he_index)
-			{
-				he = &dcel.he_table[he->next];
-				tri[1] = tri[2];
-				tri[2] = he->origin;
-				arena_push_packed(mem, tri, sizeof(vec3u32));
-				mesh.tri_count += 1;
-			}
-		}
-	}	
-	
-	/* Cleanup */
-	hash_free(horizon_map);
-	relation_list_free(&conflict_graph);
-	arena_pop_packed(table_mem, dcel.num_he * sizeof(struct DCEL_half_edge));
-	arena_pop_packed(face_mem, dcel.num_faces * sizeof(struct DCEL_face));
-	arena_pop(table_mem, permutation_size);
+#define CONVEX_HULL_FACE_ALIVE -2
 
-	return mesh;
+struct hull
+{
+	struct hull_face *faces;
+	u32 *points;
+	i32 *conflict;
+	i32 *point_next;
+	i32 *vertex_map;
+	i32 *stack;
+	i32 *horizon;
+	vec3ptr v;
+	vec3 interior;		/* centroid of the initial tetrahedron, inside every later hull */
+	f32 EPSILON;
+	i32 v_count;
+	i32 max_faces;
+	i32 face_count;
+	i32 free_face;
+	i32 step;
+};
+
+u64 convex_hull_scratch_size(const u32 v_count)
+{
+	const u64 n = v_count;
+	const u64 pad = MEMORY_ALIGNMENT;
+	return 4*(n*sizeof(i32) + pad)
+		+ 2*n*sizeof(struct hull_face) + pad 
+		+ 2*n*sizeof(i32) + pad 
+		+ 4*n*sizeof(i32) + pad;
 }
 
-i32 convex_hull_cs_step_draw(struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, struct arena *mem_5, const f32 *vs, const i32 num_vs, const f32 EPSILON, const i32 num_steps, const u32 seed, struct drawbuffer *d_buf, const vec4 color, const i32 polygon_mode)
+static void convex_hull_internal_setup(struct hull *h, struct arena *scratch, const vec3ptr v, const u32 v_count, const f32 EPSILON)
 {
-	mersenne_twister_init(seed);
-	if (num_vs < 4) { return 0; }	
+	h->v = v;
+	h->EPSILON = EPSILON;
+	h->v_count = (i32) v_count;
+	h->max_faces = 2 * (i32) v_count;
+	h->face_count = 0;
+	h->free_face = -1;
+	h->step = 0;
+
+	h->points = arena_push(scratch, NULL, v_count * sizeof(u32));
+	h->conflict = arena_push(scratch, NULL, v_count * sizeof(i32));
+	h->point_next = arena_push(scratch, NULL, v_count * sizeof(i32));
+	h->vertex_map = arena_push(scratch, NULL, v_count * sizeof(i32));
+	h->faces = arena_push(scratch, NULL, h->max_faces * sizeof(struct hull_face));
+	h->stack = arena_push(scratch, NULL, h->max_faces * sizeof(i32));
+	h->horizon = arena_push(scratch, NULL, 2 * h->max_faces * sizeof(i32));
 
-	/* (1) Get inital points for tetrahedron */
-	i32 init_i[4] = { 0 };
-	if (tetrahedron_indices(init_i, (vec3ptr) vs, num_vs, EPSILON) == 0) { return 0; }
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		h->points[i] = i;
+		h->conflict[i] = -1;
+		h->vertex_map[i] = -1;
+	}
+}
 
-	/* (2) permutation - Random permutation of remaining points */
-	const u64 permutation_size = sizeof(i32) * num_vs;
-	i32 *permutation = (i32 *) arena_push(table_mem, NULL, permutation_size);
-	convex_hull_internal_random_permutation(permutation, init_i, num_vs);
-	
-	/* (3) initiate DCEL from points */
-	struct DCEL dcel = convex_hull_internal_setup_tetrahedron_DCEL(table_mem, face_mem, init_i, (vec3ptr) vs);
+static void convex_hull_internal_face_plane(struct hull_face *f, const vec3ptr v)
+{
+	vec3 a, b;
+	vec3_sub(a, v[f->v[1]], v[f->v[0]]);
+	vec3_sub(b, v[f->v[2]], v[f->v[0]]);
+	vec3_cross(f->normal, a, b);
+	const f32 len = vec3_length(f->normal);
+	if (len > 0.0f)
+	{
+		vec3_mul_constant(f->normal, 1.0f / len);
+	}
+	f->d = vec3_dot(f->normal, v[f->v[0]]);
+}
 
+static i32 convex_hull_internal_face_alloc(struct hull *h, const u32 a, const u32 b, const u32 c)
+{
+	i32 f = h->free_face;
+	if (f != -1)
+	{
+		h->free_face = h->faces[f].next;
+	}
+	else
+	{
+		f = h->face_count;
+		h->face_count += 1;
+		assert(h->face_count <= h->max_faces);
+	}
 
-	/* (4) setup conflict graph */
-	struct relation_list conflict_graph = convex_hull_internal_tetrahedron_conflicts(&dcel, conflict_mem, permutation, table_mem, (vec3ptr) vs, num_vs, EPSILON);
+	struct hull_face *face = h->faces + f;
+	face->v[0] = a;
+	face->v[1] = b;
+	face->v[2] = c;
+	face->adj[0] = -1;
+	face->adj[1] = -1;
+	face->adj[2] = -1;
+	face->conflict = -1;
+	face->visit = -1;
+	face->next = CONVEX_HULL_FACE_ALIVE;
+	convex_hull_internal_face_plane(face, h->v);
+
+	return f;
+}
 
-	/**
-	 * vertex -> edge map. We iterate over all conflicting faces for a point, and for each edge
-	 * in a face, add it to the map if it is not currentl in the map. If it is in the map, remove it.
-	 * In the end, we will only have the horizon edges left. For degenerate coplanar faces for newly
-	 * created faces in the point's iteration, we can check the horizon edges' twins.
-	 */
-	struct hash_index *horizon_map = hash_new(mem_4, power_of_two_ceil(num_vs), 1024);
+static f32 convex_hull_internal_distance(const struct hull *h, const i32 f, const u32 p)
+{
+	return vec3_dot(h->faces[f].normal, h->v[p]) - h->faces[f].d;
+}
 
-	/* iteratetively solve and add conflicts until no vertices left */
-	const i32 n = (4 + num_steps < num_vs) ?  4 + num_steps : num_vs;
+/* add p at distance dist above face f to the face's conflict list, keeping the farthest point first */
+static void convex_hull_internal_push_conflict(struct hull *h, const i32 f, const u32 p, const f32 dist)
+{
+	const i32 head = h->faces[f].conflict;
+	if (head == -1 || dist > convex_hull_internal_distance(h, f, head))
+	{
+		h->point_next[p] = head;
+		h->faces[f].conflict = p;
+	}
+	else
+	{
+		h->point_next[p] = h->point_next[head];
+		h->point_next[head] = p;
+	}
+	h->conflict[p] = f;
+}
 
-	for (i32 i = 4; i < n; ++i)
+/* remove p from the conflict list of its face */
+static void convex_hull_internal_drop_conflict(struct hull *h, const u32 p)
+{
+	struct hull_face *f = h->faces + h->conflict[p];
+	if (f->conflict == (i32) p)
 	{
-		/* Some face is conflicting with point */
-		if (conflict_graph.r[i].next != -1)
+		f->conflict = h->point_next[p];
+	}
+	else
+	{
+		i32 q = f->conflict;
+		for (; h->point_next[q] != (i32) p; q = h->point_next[q]);
+		h->point_next[q] = h->point_next[p];
+	}
+	h->conflict[p] = -1;
+}
+
+/* assign p to the first face in list that it lies strictly above; returns 1 if assigned */
+static u32 convex_hull_internal_assign_conflict(struct hull *h, const i32 *list, const i32 count, const u32 p)
+{
+	for (i32 i = 0; i < count; ++i)
+	{
+		const f32 dist = convex_hull_internal_distance(h, list[i], p);
+		if (dist > h->EPSILON)
 		{
-			/* (5) Get horizon edges (unsorted) and push all conflicting faces to pointer, delete all DCEL edges not on the horizon  */
-			i32 *conflict_faces = (i32 *) mem_5->stack_ptr;
-			i32 *edges_to_remove = (i32 *) mem_4->stack_ptr;
-			i32 num_conflict_faces = convex_hull_internal_push_conflict_faces(&dcel, &conflict_graph, horizon_map, mem_5, mem_4, i);
-			
-			/* (6) sort the edges (push to mem_4) */
-			i32 start;
-			for (i32 k = 0; (start = hash_first(horizon_map, k)) == -1; ++k);
-			const i32 *horizon_edges = (i32 *) mem_4->stack_ptr;
-			arena_push_packed(mem_4, &start, sizeof(i32));
-			i32 edge = start;
-		        i32 num_edges = 1;
-			while (1)
-			{
-				const i32 next = dcel.he_table[edge].next;
-				const i32 key = hash_generate_key_int(dcel.he_table[next].origin);
-				/* all keys should have 0 or 1 values at this point */
-				edge = hash_first(horizon_map, key);
-				if (edge == start) { break; }
-				arena_push_packed(mem_4, &edge, sizeof(i32));
-				num_edges += 1;	
-			}
-			hash_clear(horizon_map);
+			convex_hull_internal_push_conflict(h, list[i], p, dist);
+			return 1;
+		}
+	}
 
-			/**
-			 * (7) Remove all conflicts with face and face itself from conflict graph but record any
-			 * old vertex conflicts at boundary edge first. New faces will only conflict with points
-			 * in the given unions. 
-			 */
-			i32 *union_lens = (i32 *) mem_4->stack_ptr;
-			arena_push_packed(mem_4, NULL, num_edges * sizeof(i32));
-			for (i32 z = 0; z < num_edges; ++z)
-			{
-				const i32 f1 = dcel.he_table[horizon_edges[z]].face_ccw;
-				const i32 f2 = dcel.he_table[dcel.he_table[horizon_edges[z]].twin].face_ccw;
-				union_lens[z] = relation_list_push_union(mem_4, &conflict_graph, dcel.faces[f1].relation_unit, dcel.faces[f2].relation_unit);
-			}
-		
-			
-			/* (8) Add new faces */
-			/* (9) Fix coplanar degeneracies */ 
-			/* (10) find conflicts to i<j<n points and add to graph  */
-			i32 j = 0, k = 1, upper = num_edges - 1; 
-			for (; 0 < upper && dcel.he_table[dcel.he_table[horizon_edges[upper]].twin].face_ccw == dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw; --upper);
-			for (; k <= upper && dcel.he_table[dcel.he_table[horizon_edges[k]].twin].face_ccw == dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw; ++k);
-			j = (upper + 1) % num_edges;
+	h->conflict[p] = -1;
+	return 0;
+}
 
-			i32 len_offset = 0;
-			for (i32 t = 0; t < j; ++t)
-			{
-				len_offset += union_lens[t]; 
-			}
+/**
+ * assign every point in points[0..count-1] to the face in list that it lies farthest above, or mark it as
+ * interior. Points are classified four at a time against each face plane.
+ */
+static void convex_hull_internal_classify(struct hull *h, const u32 *points, const u32 count, const i32 *list, const i32 list_count)
+{
+	for (u32 i = 0; i < count; i += 4)
+	{
+		const u32 lanes = (count - i < 4) ? count - i : 4;
+		u32 p[4];
+		for (u32 k = 0; k < 4; ++k)
+		{
+			p[k] = points[i + ((k < lanes) ? k : lanes - 1)];
+		}
 
-			i32 horizon_edges_to_remove = 0;
-			
-			i32 unit, face, prev_edge = -1, last_edge = -1;
+		const __m128 x = _mm_set_ps(h->v[p[3]][0], h->v[p[2]][0], h->v[p[1]][0], h->v[p[0]][0]);
+		const __m128 y = _mm_set_ps(h->v[p[3]][1], h->v[p[2]][1], h->v[p[1]][1], h->v[p[0]][1]);
+		const __m128 z = _mm_set_ps(h->v[p[3]][2], h->v[p[2]][2], h->v[p[1]][2], h->v[p[0]][2]);
 
-			i32 b_i = dcel.he_table[dcel.he_table[dcel.he_table[dcel.he_table[horizon_edges[j]].twin].next].next].origin;
-			vec3 b, c, normal, origin, new;
-			vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
-			vec3_sub(b, vs + 3*b_i, origin);
-			vec3_sub(c, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
-			vec3_cross(normal, b, c);
-			vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-			vec3_sub(new, vs + 3*permutation[i], origin);
-			/*coplanar if neighbor is on fat plane of new face */
-			if (fabs(vec3_dot(new, normal)) < EPSILON)
+		__m128 max = _mm_set1_ps(h->EPSILON);
+		__m128i max_f = _mm_set1_epi32(-1);
+		for (i32 j = 0; j < list_count; ++j)
+		{
+			const struct hull_face *f = h->faces + list[j];
+			const __m128 dist = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(x, _mm_set1_ps(f->normal[0])),
+					_mm_mul_ps(y, _mm_set1_ps(f->normal[1]))),
+					_mm_mul_ps(z, _mm_set1_ps(f->normal[2]))),
+					_mm_set1_ps(f->d));
+			const __m128i greater = _mm_castps_si128(_mm_cmpgt_ps(dist, max));
+			max = _mm_max_ps(dist, max);
+			max_f = _mm_or_si128(_mm_and_si128(greater, _mm_set1_epi32(list[j])), _mm_andnot_si128(greater, max_f));
+		}
+
+		f32 dist[4];
+		i32 face[4];
+		_mm_storeu_ps(dist, max);
+		_mm_storeu_si128((__m128i *) face, max_f);
+		for (u32 k = 0; k < lanes; ++k)
+		{
+			if (face[k] != -1)
 			{
-				//unit = relation_list_add_relation_unit_empty(&conflict_graph, -1);
-				//face = DCEL_face_add(&dcel, face_mem, horizon_edges[j], unit);
-				//conflict_graph.r[unit].related_to = face;
-				face = dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw;
-				unit = dcel.faces[face].relation_unit;
+				convex_hull_internal_push_conflict(h, face[k], p[k], dist[k]);
+			}
+			else
+			{
+				h->conflict[p[k]] = -1;
+			}
+		}
+	}
+}
 
-				last_edge = DCEL_half_edge_reserve(&dcel, table_mem);
-				prev_edge = DCEL_half_edge_reserve(&dcel, table_mem);
+/* setup outward oriented tetrahedron faces from 4 non-coplanar points */
+static void convex_hull_internal_tetrahedron(struct hull *h, i32 tetrahedron[4], const u32 init_i[4])
+{
+	vec3 a, b, c, normal;
+	vec3_sub(a, h->v[init_i[1]], h->v[init_i[0]]);
+	vec3_sub(b, h->v[init_i[2]], h->v[init_i[0]]);
+	vec3_sub(c, h->v[init_i[3]], h->v[init_i[0]]);
+	vec3_cross(normal, a, b);
+
+	/* (0,1,2) has the apex 3 below it, the remaining faces are (0,3,1), (1,3,2), (2,3,0) */
+	const u32 t0 = init_i[0], t3 = init_i[3];
+	const u32 t1 = (vec3_dot(normal, c) > 0.0f) ? init_i[2] : init_i[1];
+	const u32 t2 = (vec3_dot(normal, c) > 0.0f) ? init_i[1] : init_i[2];
+	const i32 f0 = convex_hull_internal_face_alloc(h, t0, t1, t2);
+	const i32 f1 = convex_hull_internal_face_alloc(h, t0, t3, t1);
+	const i32 f2 = convex_hull_internal_face_alloc(h, t1, t3, t2);
+	const i32 f3 = convex_hull_internal_face_alloc(h, t2, t3, t0);
+
+	vec3_set(h->interior, 0.0f, 0.0f, 0.0f);
+	for (u32 k = 0; k < 4; ++k)
+	{
+		vec3_translate(h->interior, h->v[init_i[k]]);
+	}
+	vec3_mul_constant(h->interior, 0.25f);
+
+	struct hull_face *faces = h->faces;
+	faces[f0].adj[0] = f1; faces[f0].adj[1] = f2; faces[f0].adj[2] = f3;
+	faces[f1].adj[0] = f3; faces[f1].adj[1] = f2; faces[f1].adj[2] = f0;
+	faces[f2].adj[0] = f1; faces[f2].adj[1] = f3; faces[f2].adj[2] = f0;
+	faces[f3].adj[0] = f2; faces[f3].adj[1] = f1; faces[f3].adj[2] = f0;
+
+	tetrahedron[0] = f0;
+	tetrahedron[1] = f1;
+	tetrahedron[2] = f2;
+	tetrahedron[3] = f3;
+}
 
-				DCEL_half_edge_set(&dcel, prev_edge,
-					dcel.he_table[horizon_edges[k % num_edges]].origin,
-					-1,
-					face,
-					last_edge,
-					-1);
+/**
+ * Collect the horizon of the visible faces stack[max_faces - visible_count, max_faces) as (face, edge) pairs on
+ * the non-visible side. Returns the horizon edge count if the edges form one simple cycle, or -1 otherwise.
+ */
+static i32 convex_hull_internal_horizon(struct hull *h, const i32 step, const i32 visible_count)
+{
+	const struct hull_face *faces = h->faces;
+	i32 *horizon = h->horizon;
+	i32 horizon_count = 0;
+	for (i32 j = 0; j < visible_count; ++j)
+	{
+		const i32 f = h->stack[h->max_faces - 1 - j];
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const i32 g = faces[f].adj[k];
+			if (faces[g].visit == step) { continue; }
+
+			u32 k_g = 0;
+			for (; faces[g].adj[k_g] != f; ++k_g);
+			horizon[2*horizon_count + 0] = g;
+			horizon[2*horizon_count + 1] = k_g;
+			horizon_count += 1;
+		}
+	}
 
-				DCEL_half_edge_set(&dcel, last_edge,
-					permutation[i],
-					-1,
-					face,
-					-1,
-					prev_edge);
+	/* vertex_map[a] = horizon edge starting at a; stale entries from earlier insertions fail the start check */
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		const u32 a = faces[horizon[2*j]].v[(horizon[2*j + 1] + 1) % 3];
+		const i32 e = h->vertex_map[a];
+		if (0 <= e && e < j && faces[horizon[2*e]].v[(horizon[2*e + 1] + 1) % 3] == a) { return -1; }
+		h->vertex_map[a] = j;
+	}
 
-				dcel.faces[face].he_index = last_edge;
+	if (horizon_count < 3) { return -1; }
 
-				convex_hull_internal_DCEL_add_coplanar(&dcel, horizon_edges[j], horizon_edges[k-1], last_edge, prev_edge);
-			
-				i32 edge = dcel.he_table[horizon_edges[j]].twin;
-				while (edge != dcel.he_table[horizon_edges[k-1]].twin) 
+	/* the edge a -> b is followed by the edge starting at b */
+	i32 e = 0;
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		const u32 b = faces[horizon[2*e]].v[horizon[2*e + 1]];
+		e = h->vertex_map[b];
+		if (e < 0 || horizon_count <= e || faces[horizon[2*e]].v[(horizon[2*e + 1] + 1) % 3] != b) { return -1; }
+		if (e == 0 && j + 1 < horizon_count) { return -1; }
+	}
+
+	return (e == 0) ? horizon_count : -1;
+}
+
+/**
+ * Returns a horizon face whose new face (a, b, p) over the shared edge a -> b would be degenerate (p within
+ * EPSILON of the edge line) or face the hull interior, or a horizon face p is within EPSILON of whose third vertex
+ * would be above the new face, folding it back over the face. Returns -1 if there is none.
+ */
+static i32 convex_hull_internal_fold(const struct hull *h, const u32 p, const i32 horizon_count)
+{
+	const struct hull_face *faces = h->faces;
+	vec3 n, r;
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		const i32 g = h->horizon[2*j + 0];
+		const u32 k_g = h->horizon[2*j + 1];
+		const u32 a = faces[g].v[(k_g + 1) % 3];
+		const u32 b = faces[g].v[k_g];
+		const u32 c = faces[g].v[(k_g + 2) % 3];
+		vec3_recenter_cross(n, h->v[a], h->v[b], h->v[p]);
+		const f32 len = vec3_length(n);
+		vec3_sub(r, h->interior, h->v[a]);
+		if (len <= h->EPSILON * vec3_distance(h->v[a], h->v[b]) || vec3_dot(n, r) >= 0.0f)
+		{
+			return g;
+		}
+
+		vec3_sub(r, h->v[c], h->v[a]);
+		if (convex_hull_internal_distance(h, g, p) >= -h->EPSILON && vec3_dot(n, r) > h->EPSILON * len)
+		{
+			return g;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Insert p, which must have a conflicting face, into the hull. The conflicting points of the removed faces
+ * (except p) and the vertices leaving the hull are chained through point_next and returned in chain. If
+ * volume != NULL, the volume added to the hull is accumulated into it. Returns the number of new faces, stored in h->stack, 0 if p already is a hull
+ * vertex, or -1 if the horizon cannot be made a simple cycle.
+ */
+static i32 convex_hull_internal_insert(struct hull *h, const u32 p, i32 *chain, f32 *volume)
+{
+	struct hull_face *faces = h->faces;
+	i32 *stack = h->stack;
+	i32 *horizon = h->horizon;
+	const i32 step = h->step++;
+	const i32 max_faces = h->max_faces;
+
+	/* 
+	 * (1) walk the visible region from the conflict face; every face is classified once, as visible (visit == step)
+	 *     if p is more than EPSILON above it and as non-visible (visit == -(step+2)) otherwise. The traversal stack 
+	 *     grows from the front, the visible list from the back. Faces p is within EPSILON of can still leave the 
+	 *     region pinched or holed, so until its horizon is a simple cycle the non-visible neighbour p is nearest 
+	 *     to (or furthest above) joins the region. A simple horizon is then grown by any face whose new face would
+	 *     be degenerate, face inwards or fold back over it.
+	 */
+	i32 visible_count = 0;
+	i32 horizon_count = -1;
+	i32 stack_count = 1;
+	stack[0] = h->conflict[p];
+	faces[h->conflict[p]].visit = step;
+	while (1)
+	{
+		while (stack_count)
+		{
+			const i32 f = stack[--stack_count];
+			stack[max_faces - 1 - visible_count] = f;
+			visible_count += 1;
+			if (volume)
+			{
+				/* tetrahedron (face, p) */
+				vec3 a, b, n;
+				vec3_sub(a, h->v[faces[f].v[1]], h->v[faces[f].v[0]]);
+				vec3_sub(b, h->v[faces[f].v[2]], h->v[faces[f].v[0]]);
+				vec3_cross(n, a, b);
+				*volume += vec3_length(n) * convex_hull_internal_distance(h, f, p) / 6.0f;
+			}
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const i32 g = faces[f].adj[k];
+				if (faces[g].visit == step || faces[g].visit == -(step+2)) { continue; }
+
+				if (convex_hull_internal_distance(h, g, p) > h->EPSILON)
 				{
-					horizon_edges_to_remove += 2;
-					const i32 tmp = dcel.he_table[edge].prev;
-					arena_push_packed(mem_5, &dcel.he_table[edge].twin, sizeof(i32));
-					arena_push_packed(mem_5, &edge, sizeof(i32));
-					edge = tmp;
+					faces[g].visit = step;
+					stack[stack_count++] = g;
 				}
-				horizon_edges_to_remove += 2;
-				arena_push_packed(mem_5, &dcel.he_table[edge].twin, sizeof(i32));
-				arena_push_packed(mem_5, &edge, sizeof(i32));
+				else
+				{
+					faces[g].visit = -(step+2);
+				}
+			}
+		}
 
-				len_offset = 0;
-				for (j = 0; j < k; ++j) 
-				{ 
-					len_offset += union_lens[j]; 
+		horizon_count = convex_hull_internal_horizon(h, step, visible_count);
+		if (horizon_count != -1)
+		{
+			const i32 fold = convex_hull_internal_fold(h, p, horizon_count);
+			if (fold == -1) { break; }
+
+			faces[fold].visit = step;
+			stack[stack_count++] = fold;
+			continue;
+		}
+
+		i32 nearest = -1;
+		f32 max_dist = -FLT_MAX;
+		for (i32 j = 0; j < visible_count; ++j)
+		{
+			const i32 f = stack[max_faces - 1 - j];
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const i32 g = faces[f].adj[k];
+				if (faces[g].visit == step) { continue; }
+				const f32 dist = convex_hull_internal_distance(h, g, p);
+				if (dist >= max_dist)
+				{
+					max_dist = dist;
+					nearest = g;
 				}
 			}
-			else
+		}
+
+		if (nearest == -1) { return -1; }
+		faces[nearest].visit = step;
+		stack[stack_count++] = nearest;
+	}
+
+	/* a hull vertex rounding puts above a neighbouring face is already on the hull, it is dropped */
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		if (faces[horizon[2*j]].v[horizon[2*j + 1]] == p)
+		{
+			convex_hull_internal_drop_conflict(h, p);
+			*chain = -1;
+			return 0;
+		}
+	}
+
+	/* 
+	 * (2) gather conflicting points of visible faces into one chain and free the faces. Vertices of visible faces
+	 *     off the horizon leave the hull; a region grown past faces p is within EPSILON of may leave one of them 
+	 *     outside the new faces, so they are chained as well and reclassified. Chained points are marked with
+	 *     vertex_map == -(step+2), since rounding may leave a hull vertex in a conflict list too.
+	 */
+	*chain = -1;
+	for (i32 j = 0; j < visible_count; ++j)
+	{
+		const i32 f = stack[max_faces - 1 - j];
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 w = faces[f].v[k];
+			const i32 e = h->vertex_map[w];
+			const u32 on_horizon = (0 <= e && e < horizon_count && faces[horizon[2*e]].v[(horizon[2*e + 1] + 1) % 3] == w);
+			if (!on_horizon && e != -(step+2))
 			{
-				for (; j != k; ) 
-				{ 
-					unit = relation_list_add_relation_unit_empty(&conflict_graph, -1);
-					face = DCEL_face_add(&dcel, face_mem, horizon_edges[j], unit);
-					conflict_graph.r[unit].related_to = face;
+				h->vertex_map[w] = -(step+2);
+				h->point_next[w] = *chain;
+				*chain = w;
+			}
+		}
 
-					const i32 tmp = prev_edge;
-					const i32 last_edge_in_polygon = DCEL_half_edge_reserve(&dcel, table_mem);
-					if (j == ((upper + 1) % num_edges))
-					{
-						last_edge = last_edge_in_polygon;
-					}
-					prev_edge = DCEL_half_edge_reserve(&dcel, table_mem);
+		for (i32 q = faces[f].conflict; q != -1; )
+		{
+			const i32 next = h->point_next[q];
+			if ((u32) q != p && h->vertex_map[q] != -(step+2))
+			{
+				h->vertex_map[q] = -(step+2);
+				h->point_next[q] = *chain;
+				*chain = q;
+			}
+			q = next;
+		}
+		faces[f].next = h->free_face;
+		h->free_face = f;
+	}
+	h->conflict[p] = -1;
 
-					DCEL_half_edge_set(&dcel, prev_edge,
-						dcel.he_table[horizon_edges[(j+1) % num_edges]].origin,
-						-1,
-						face,
-						last_edge_in_polygon,
-						horizon_edges[j]);
+	/* (3) cone of new faces (a, b, p) over every horizon edge a -> b, linked around the cycle */
+	i32 *new_faces = stack;
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		const i32 g = horizon[2*j + 0];
+		const u32 k_g = horizon[2*j + 1];
+		const u32 a = faces[g].v[(k_g + 1) % 3];
+		const u32 b = faces[g].v[k_g];
+		const i32 f = convex_hull_internal_face_alloc(h, a, b, p);
+		faces[f].adj[0] = g;
+		faces[g].adj[k_g] = f;
+		h->vertex_map[a] = f;
+		new_faces[j] = f;
+	}
 
-					DCEL_half_edge_set(&dcel, last_edge_in_polygon,
-						permutation[i],
-						tmp,
-						face,
-						horizon_edges[j],
-						prev_edge);
-					if (tmp != -1) { dcel.he_table[tmp].twin = last_edge_in_polygon; }
-					
-					vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
-					vec3_sub(b, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
-					vec3_sub(c, vs + 3*permutation[i], origin);
-					vec3_cross(normal, b, c);
-					vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-					convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, (vec3ptr) vs, EPSILON);
-				
-					dcel.he_table[horizon_edges[j]].prev = last_edge_in_polygon;
-					dcel.he_table[horizon_edges[j]].next = prev_edge;
-					dcel.he_table[horizon_edges[j]].face_ccw = face;
+	for (i32 j = 0; j < horizon_count; ++j)
+	{
+		const i32 f = new_faces[j];
+		const i32 f_b = h->vertex_map[faces[f].v[1]];
+		faces[f].adj[1] = f_b;
+		faces[f_b].adj[2] = f;
+	}
 
-					len_offset += union_lens[j]; 
-					j = (j+1) % num_edges;
-					if (j == 0) { len_offset = 0; }
-				}
+	return horizon_count;
+}
+
+/* push hull onto mem, compacted to hull vertices only */
+static struct tri_mesh convex_hull_internal_output(struct arena *mem, struct hull *h)
+{
+	u32 hull_v_count = 0;
+	u32 tri_count = 0;
+	for (i32 i = 0; i < h->v_count; ++i)
+	{
+		h->vertex_map[i] = -1;
+	}
+
+	for (i32 f = 0; f < h->face_count; ++f)
+	{
+		if (h->faces[f].next != CONVEX_HULL_FACE_ALIVE) { continue; }
+		tri_count += 1;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			if (h->vertex_map[h->faces[f].v[k]] == -1)
+			{
+				h->vertex_map[h->faces[f].v[k]] = hull_v_count++;
 			}
+		}
+	}
 
-			for (; k < upper+1;)
+	struct tri_mesh mesh =
+	{
+		.v = arena_push(mem, NULL, hull_v_count * sizeof(vec3)),
+		.v_count = hull_v_count,
+		.tri_count = tri_count,
+	};
+	mesh.tri = arena_push_packed(mem, NULL, tri_count * sizeof(vec3u32));
+
+	for (i32 i = 0; i < h->v_count; ++i)
+	{
+		if (h->vertex_map[i] != -1)
+		{
+			vec3_copy(mesh.v[h->vertex_map[i]], h->v[i]);
+		}
+	}
+
+	u32 t = 0;
+	for (i32 f = 0; f < h->face_count; ++f)
+	{
+		if (h->faces[f].next != CONVEX_HULL_FACE_ALIVE) { continue; }
+		mesh.tri[t][0] = h->vertex_map[h->faces[f].v[0]];
+		mesh.tri[t][1] = h->vertex_map[h->faces[f].v[1]];
+		mesh.tri[t][2] = h->vertex_map[h->faces[f].v[2]];
+		t += 1;
+	}
+
+	return mesh;
+}
+
+/* local xorshift generator; keeps hull construction deterministic and free of global state */
+static u32 convex_hull_internal_xorshift(u32 *state)
+{
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/* indices of the extreme points of v along the axes and the cube diagonals, without duplicates; returns count */
+static u32 convex_hull_internal_extreme_points(u32 extreme[14], const vec3ptr v, const u32 v_count)
+{
+	const vec3 dir[7] = 
+	{
+		{ 1.0f,  0.0f,  0.0f },
+		{ 0.0f,  1.0f,  0.0f },
+		{ 0.0f,  0.0f,  1.0f },
+		{ 1.0f,  1.0f,  1.0f },
+		{ 1.0f,  1.0f, -1.0f },
+		{ 1.0f, -1.0f,  1.0f },
+		{-1.0f,  1.0f,  1.0f },
+	};
+
+	f32 extreme_dot[14];
+	for (u32 j = 0; j < 7; ++j)
+	{
+		extreme[2*j + 0] = 0;
+		extreme[2*j + 1] = 0;
+		extreme_dot[2*j + 0] = -FLT_MAX;
+		extreme_dot[2*j + 1] = FLT_MAX;
+	}
+
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		for (u32 j = 0; j < 7; ++j)
+		{
+			const f32 dot = vec3_dot(dir[j], v[i]);
+			if (dot > extreme_dot[2*j + 0]) { extreme_dot[2*j + 0] = dot; extreme[2*j + 0] = i; }
+			if (dot < extreme_dot[2*j + 1]) { extreme_dot[2*j + 1] = dot; extreme[2*j + 1] = i; }
+		}
+	}
+
+	u32 extreme_count = 0;
+	for (u32 j = 0; j < 14; ++j)
+	{
+		u32 k = 0;
+		for (; k < extreme_count && extreme[k] != extreme[j]; ++k);
+		if (k == extreme_count)
+		{
+			extreme[extreme_count++] = extreme[j];
+		}
+	}
+
+	return extreme_count;
+}
+
+/*
+ * large initial tetrahedron: the farthest pair of extreme points, the point farthest from their line and the point
+ * farthest from their plane. A tetrahedron only just thicker than EPSILON, as the first such points of a lattice
+ * give, has faces whose outside cannot be told apart from rounding, and every later visibility test inherits that.
+ * Returns 0 if v is degenerate (all within EPSILON of a point, line or plane).
+ */
+static u32 convex_hull_internal_initial_tetrahedron(u32 tetrahedron_v[4], const u32 *extreme, const u32 extreme_count, const vec3ptr v, const u32 v_count, const f32 EPSILON)
+{
+	f32 max = 0.0f;
+	for (u32 i = 0; i < extreme_count; ++i)
+	{
+		for (u32 j = i + 1; j < extreme_count; ++j)
+		{
+			const f32 dist_sq = vec3_distance_squared(v[extreme[i]], v[extreme[j]]);
+			if (dist_sq > max)
 			{
-				for (k += 1; k < upper+1 && dcel.he_table[dcel.he_table[horizon_edges[k]].twin].face_ccw == dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw; k += 1);
+				max = dist_sq;
+				tetrahedron_v[0] = extreme[i];
+				tetrahedron_v[1] = extreme[j];
+			}
+		}
+	}
+	if (max <= EPSILON * EPSILON) { return 0; }
 
-				b_i = dcel.he_table[dcel.he_table[dcel.he_table[dcel.he_table[horizon_edges[j]].twin].next].next].origin;
-				vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
-				vec3_sub(b, vs + 3*b_i, origin);
-				vec3_sub(c, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
-				vec3_cross(normal, b, c);
-				vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-				vec3_sub(new, vs + 3*permutation[i], origin);
-				/*coplanar if neighbor is on fat plane of new face */
-				if (fabs(vec3_dot(new, normal)) < EPSILON)
+	vec3 a, b, n;
+	vec3_sub(a, v[tetrahedron_v[1]], v[tetrahedron_v[0]]);
+	vec3_mul_constant(a, 1.0f / vec3_length(a));
+	max = 0.0f;
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		vec3_sub(b, v[i], v[tetrahedron_v[0]]);
+		vec3_cross(n, a, b);
+		const f32 dist = vec3_length(n);
+		if (dist > max)
+		{
+			max = dist;
+			tetrahedron_v[2] = i;
+		}
+	}
+	if (max <= EPSILON) { return 0; }
+
+	vec3_sub(b, v[tetrahedron_v[2]], v[tetrahedron_v[0]]);
+	vec3_cross(n, a, b);
+	vec3_mul_constant(n, 1.0f / vec3_length(n));
+	max = 0.0f;
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		vec3_sub(b, v[i], v[tetrahedron_v[0]]);
+		const f32 dist = fabsf(vec3_dot(n, b));
+		if (dist > max)
+		{
+			max = dist;
+			tetrahedron_v[3] = i;
+		}
+	}
+
+	return (max > EPSILON);
+}
+
+struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *scratch, const vec3ptr v, const u32 v_count, const f32 EPSILON)
+{
+	if (v_count < 4) { return tri_mesh_empty(); }	
+	if (scratch->mem_left < convex_hull_scratch_size(v_count)) { return tri_mesh_empty(); }
+
+	/* (1) initial tetrahedron */
+	u32 extreme[14];
+	u32 tetrahedron_v[4];
+	const u32 extreme_count = convex_hull_internal_extreme_points(extreme, v, v_count);
+	if (!convex_hull_internal_initial_tetrahedron(tetrahedron_v, extreme, extreme_count, v, v_count, EPSILON))
+	{
+		return tri_mesh_empty();
+	}
+
+	struct arena record = *scratch;
+	struct hull h;
+	convex_hull_internal_setup(&h, scratch, v, v_count, EPSILON);
+
+	/* (2) Random insertion order */
+	u32 state = 0x9e3779b9u ^ v_count;
+	for (u32 i = v_count-1; i > 0; --i)
+	{
+		const u32 j = convex_hull_internal_xorshift(&state) % (i + 1);
+		const u32 tmp = h.points[i];
+		h.points[i] = h.points[j];
+		h.points[j] = tmp;
+	}
+
+	/* (3) Outward oriented tetrahedron and initial conflicts */
+	i32 tetrahedron[4];
+	convex_hull_internal_tetrahedron(&h, tetrahedron, tetrahedron_v);
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		const u32 p = h.points[i];
+		if (p != tetrahedron_v[0] && p != tetrahedron_v[1] && p != tetrahedron_v[2] && p != tetrahedron_v[3])
+		{
+			convex_hull_internal_assign_conflict(&h, tetrahedron, 4, p);
+		}
+	}
+
+	/* (4) Insert points in random order; a point without conflict is (or became) interior */
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		const u32 p = h.points[i];
+		if (h.conflict[p] == -1) { continue; }
+
+		i32 chain;
+		const i32 new_count = convex_hull_internal_insert(&h, p, &chain, NULL);
+		if (new_count == -1)
+		{
+			/* the visible region swallowed every face; only possible for degenerate input */
+			*scratch = record;
+			return tri_mesh_empty();
+		}
+
+		/* hand over conflicts of removed faces to new faces, points seeing none of them are interior */
+		for (i32 q = chain; q != -1; )
+		{
+			const i32 next = h.point_next[q];
+			convex_hull_internal_assign_conflict(&h, h.stack, new_count, q);
+			q = next;
+		}
+	}
+
+	struct tri_mesh mesh = convex_hull_internal_output(mem, &h);
+	*scratch = record;
+	return mesh;
+}
+
+struct tri_mesh convex_hull_quickhull(struct arena *mem, struct arena *scratch, const vec3ptr v, const u32 v_count, const f32 EPSILON)
+{
+	if (v_count < 4) { return tri_mesh_empty(); }	
+	if (scratch->mem_left < convex_hull_scratch_size(v_count)) { return tri_mesh_empty(); }
+
+	/* (1) initial tetrahedron, preferably spanned by extreme points along the axes and cube diagonals */
+	u32 extreme[14];
+	u32 tetrahedron_v[4];
+	const u32 extreme_count = convex_hull_internal_extreme_points(extreme, v, v_count);
+	if (!convex_hull_internal_initial_tetrahedron(tetrahedron_v, extreme, extreme_count, v, v_count, EPSILON))
+	{
+		return tri_mesh_empty();
+	}
+
+	struct arena record = *scratch;
+	struct hull h;
+	convex_hull_internal_setup(&h, scratch, v, v_count, EPSILON);
+
+	i32 tetrahedron[4];
+	convex_hull_internal_tetrahedron(&h, tetrahedron, tetrahedron_v);
+
+	/* (2) hull of the extreme points */
+	for (u32 j = 0; j < extreme_count; ++j)
+	{
+		const u32 p = extreme[j];
+		for (i32 f = 0; f < h.face_count; ++f)
+		{
+			if (h.faces[f].next == CONVEX_HULL_FACE_ALIVE && convex_hull_internal_distance(&h, f, p) > EPSILON)
+			{
+				i32 chain;
+				convex_hull_internal_push_conflict(&h, f, p, convex_hull_internal_distance(&h, f, p));
+				if (convex_hull_internal_insert(&h, p, &chain, NULL) == -1)
 				{
-					//unit = relation_list_add_relation_unit_empty(&conflict_graph, -1);
-					//face = DCEL_face_add(&dcel, face_mem, horizon_edges[j], unit);
-					//conflict_graph.r[unit].related_to = face;
+					*scratch = record;
+					return tri_mesh_empty();
+				}
+				break;
+			}
+		}
+	}
 
-					face = dcel.he_table[dcel.he_table[horizon_edges[j]].twin].face_ccw;
-					unit = dcel.faces[face].relation_unit;
+	/**
+	 * (3) throwaway: classify all points against the extreme point hull. Points below every face are 
+	 * interior and never looked at again, the rest are assigned to the face they are farthest above.
+	 */
+	i32 face_count = 0;
+	for (i32 f = 0; f < h.face_count; ++f)
+	{
+		if (h.faces[f].next == CONVEX_HULL_FACE_ALIVE)
+		{
+			h.stack[face_count++] = f;
+		}
+	}
+	convex_hull_internal_classify(&h, h.points, v_count, h.stack, face_count);
 
-					const i32 tmp = prev_edge;
-					const i32 last_edge_in_polygon = DCEL_half_edge_reserve(&dcel, table_mem);
-					if (j == ((upper + 1) % num_edges))
-					{
-						last_edge = last_edge_in_polygon;
-					}
+	/* (4) repeatedly insert the farthest point of a face with conflicts */
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		while (h.conflict[i] != -1)
+		{
+			const u32 p = h.faces[h.conflict[i]].conflict;
 
-					prev_edge = DCEL_half_edge_reserve(&dcel, table_mem);
+			i32 chain;
+			const i32 new_count = convex_hull_internal_insert(&h, p, &chain, NULL);
+			if (new_count == -1) 
+			{
+				*scratch = record;
+				return tri_mesh_empty();
+			}
 
-					DCEL_half_edge_set(&dcel, prev_edge,
-						dcel.he_table[horizon_edges[k % num_edges]].origin,
-						-1,
-						face,
-						last_edge_in_polygon,
-						-1);
+			u32 count = 0;
+			for (i32 q = chain; q != -1; q = h.point_next[q])
+			{
+				h.points[count++] = q;
+			}
+			convex_hull_internal_classify(&h, h.points, count, h.stack, new_count);
+		}
+	}
 
-					DCEL_half_edge_set(&dcel, last_edge_in_polygon,
-						permutation[i],
-						tmp,
-						face,
-						-1,
-						prev_edge);
-					dcel.he_table[tmp].twin = last_edge_in_polygon;
+	struct tri_mesh mesh = convex_hull_internal_output(mem, &h);
+	*scratch = record;
+	return mesh;
+}
 
-					dcel.faces[face].he_index = last_edge_in_polygon;
+/* arena over the next size bytes of mem, for output that has to outlive a scratch record taken on mem */
+static struct arena convex_hull_internal_sub_arena(struct arena *mem, const u64 size)
+{
+	struct arena sub = { .stack_ptr = arena_push(mem, NULL, size), .mem_size = size, .mem_left = size };
+	return sub;
+}
 
-					convex_hull_internal_DCEL_add_coplanar(&dcel, horizon_edges[j], horizon_edges[k-1], last_edge_in_polygon, prev_edge);
+/*
+ * Outer approximation of the partial hull h of hull: every face plane of h is pushed out to the parallel support
+ * plane of hull, planes within CONVEX_HULL_MERGE_COS of an earlier plane are merged away, and the vertices of the
+ * intersection of the remaining half spaces are found as the faces of the dual hull about the interior point c
+ * (plane n.(x - c) <= e is the dual point n / e, dual face u.y = 1 the vertex c + u). On success the at most 
+ * max_v_count vertices are written to out, their hull volume to volume and their count returned; 0 is returned if
+ * the planes do not bound a volume, scratch is too small or there are more than max_v_count vertices.
+ */
+static u32 convex_hull_internal_outer(vec3ptr out, f32 *volume, const u32 max_v_count, struct arena *scratch, const struct hull *h, const struct tri_mesh *hull, const f32 EPSILON)
+{
+	const u64 n = (u64) h->face_count;
+	const u64 pad = MEMORY_ALIGNMENT;
+	/* the dual hull has at most n vertices and 2n faces, so at most 2n corners and 4n outer faces */
+	const u64 dual_size = n*sizeof(vec3) + 2*n*sizeof(vec3u32) + 2*pad;
+	const u64 outer_size = 2*n*sizeof(vec3) + 4*n*sizeof(vec3u32) + 2*pad;
+	if (scratch->mem_left < 2*(n*sizeof(vec3) + pad) + dual_size + pad + 2*n*sizeof(vec3) + pad + outer_size + pad + convex_hull_scratch_size(2*(u32) n))
+	{
+		return 0;
+	}
 
-					i32 edge = dcel.he_table[horizon_edges[j]].twin;
-					while (edge != dcel.he_table[horizon_edges[k-1]].twin) 
-					{
-						horizon_edges_to_remove += 2;
-						const i32 tmp = dcel.he_table[edge].prev;
-						arena_push_packed(mem_5, &dcel.he_table[edge].twin, sizeof(i32));
-						arena_push_packed(mem_5, &edge, sizeof(i32));
-						edge = tmp;
-					}
-					horizon_edges_to_remove += 2;
-					arena_push_packed(mem_5, &dcel.he_table[edge].twin, sizeof(i32));
-					arena_push_packed(mem_5, &edge, sizeof(i32));
+	struct arena record = *scratch;
+	vec3ptr normal = arena_push(scratch, NULL, n*sizeof(vec3));
+	vec3ptr dual = arena_push(scratch, NULL, n*sizeof(vec3));
 
-					for (; j < k; ++j) 
-					{ 
-						len_offset += union_lens[j]; 
-					}
+	vec3 c = { 0.0f, 0.0f, 0.0f };
+	u32 corner_count = 0;
+	for (i32 f = 0; f < h->face_count; ++f)
+	{
+		if (h->faces[f].next != CONVEX_HULL_FACE_ALIVE) { continue; }
+		for (u32 k = 0; k < 3; ++k)
+		{
+			vec3_translate(c, h->v[h->faces[f].v[k]]);
+		}
+		corner_count += 3;
+	}
+	vec3_scale(c, c, 1.0f / (f32) corner_count);
+
+	u32 plane_count = 0;
+	for (i32 f = 0; f < h->face_count; ++f)
+	{
+		if (h->faces[f].next != CONVEX_HULL_FACE_ALIVE) { continue; }
+
+		u32 merged = 0;
+		for (u32 k = 0; k < plane_count && !merged; ++k)
+		{
+			merged = (vec3_dot(normal[k], h->faces[f].normal) >= CONVEX_HULL_MERGE_COS);
+		}
+		if (merged) { continue; }
+
+		f32 support = -FLT_MAX;
+		for (u32 i = 0; i < hull->v_count; ++i)
+		{
+			support = fmaxf(support, vec3_dot(h->faces[f].normal, hull->v[i]));
+		}
+
+		const f32 e = support - vec3_dot(h->faces[f].normal, c);
+		if (e <= EPSILON)
+		{
+			*scratch = record;
+			return 0;
+		}
+		vec3_copy(normal[plane_count], h->faces[f].normal);
+		vec3_scale(dual[plane_count], h->faces[f].normal, 1.0f / e);
+		plane_count += 1;
+	}
+
+	struct arena dual_mem = convex_hull_internal_sub_arena(scratch, dual_size);
+	const struct tri_mesh dual_hull = convex_hull_construct(&dual_mem, scratch, dual, plane_count, EPSILON);
+	if (dual_hull.tri_count == 0)
+	{
+		*scratch = record;
+		return 0;
+	}
+
+	/* the origin is inside the dual hull iff the planes bound a volume */
+	vec3ptr corner = arena_push(scratch, NULL, dual_hull.tri_count * sizeof(vec3));
+	vec3 m;
+	for (u32 t = 0; t < dual_hull.tri_count; ++t)
+	{
+		vec3_recenter_cross(m, dual_hull.v[dual_hull.tri[t][0]], dual_hull.v[dual_hull.tri[t][1]], dual_hull.v[dual_hull.tri[t][2]]);
+		const f32 dot = vec3_dot(m, dual_hull.v[dual_hull.tri[t][0]]);
+		if (dot <= EPSILON * vec3_length(m))
+		{
+			*scratch = record;
+			return 0;
+		}
+		vec3_scale(corner[t], m, 1.0f / dot);
+		vec3_translate(corner[t], c);
+	}
+
+	/* corners of planes meeting in more than three faces coincide, and are merged by the hull */
+	struct arena outer_mem = convex_hull_internal_sub_arena(scratch, outer_size);
+	const struct tri_mesh outer = convex_hull_construct(&outer_mem, scratch, corner, dual_hull.tri_count, EPSILON);
+	if (outer.tri_count == 0 || outer.v_count > max_v_count)
+	{
+		*scratch = record;
+		return 0;
+	}
+
+	memcpy(out, outer.v, outer.v_count * sizeof(vec3));
+	*volume = tri_mesh_volume(&outer);
+	*scratch = record;
+	return outer.v_count;
+}
+
+struct tri_mesh convex_hull_simplify(struct arena *mem, struct arena *scratch, const struct tri_mesh *hull, const u32 max_v_count, const f32 volume_tolerance, const f32 EPSILON)
+{
+	const u32 v_count = hull->v_count;
+	if (v_count < 4 || max_v_count < 4) { return tri_mesh_empty(); }	
+	if (scratch->mem_left < convex_hull_scratch_size(v_count) + max_v_count*sizeof(vec3) + MEMORY_ALIGNMENT) { return tri_mesh_empty(); }
+
+	/* (1) initial tetrahedron */
+	u32 extreme[14];
+	u32 tetrahedron_v[4];
+	const u32 extreme_count = convex_hull_internal_extreme_points(extreme, hull->v, v_count);
+	if (!convex_hull_internal_initial_tetrahedron(tetrahedron_v, extreme, extreme_count, hull->v, v_count, EPSILON))
+	{
+		return tri_mesh_empty();
+	}
+
+	const f32 volume = tri_mesh_volume(hull);
+
+	struct arena record = *scratch;
+	vec3ptr best = arena_push(scratch, NULL, max_v_count * sizeof(vec3));
+	u32 best_count = 0;
+
+	struct arena hull_record = *scratch;
+	struct hull h;
+	convex_hull_internal_setup(&h, scratch, hull->v, v_count, EPSILON);
+
+	i32 tetrahedron[4];
+	convex_hull_internal_tetrahedron(&h, tetrahedron, tetrahedron_v);
+	convex_hull_internal_classify(&h, h.points, v_count, tetrahedron, 4);
+
+	/* 
+	 * (2) greedily insert the vertex farthest outside the inner hull, keeping the last outer approximation within
+	 * the vertex budget, until it is within volume_tolerance or no vertex is more than EPSILON outside
+	 */
+	while (1)
+	{
+		f32 outer_volume;
+		const u32 outer_count = convex_hull_internal_outer(best, &outer_volume, max_v_count, scratch, &h, hull, EPSILON);
+		if (outer_count == 0) { break; }
+
+		best_count = outer_count;
+		if (outer_volume - volume <= volume_tolerance * volume) { break; }
+
+		i32 farthest = -1;
+		f32 max_dist = EPSILON;
+		for (i32 f = 0; f < h.face_count; ++f)
+		{
+			if (h.faces[f].next == CONVEX_HULL_FACE_ALIVE && h.faces[f].conflict != -1)
+			{
+				const f32 dist = convex_hull_internal_distance(&h, f, h.faces[f].conflict);
+				if (dist > max_dist)
+				{
+					max_dist = dist;
+					farthest = f;
 				}
-				else
+			}
+		}
+
+		if (farthest == -1) { break; }
+
+		i32 chain;
+		const i32 new_count = convex_hull_internal_insert(&h, h.faces[farthest].conflict, &chain, NULL);
+		if (new_count == -1) { break; }
+
+		u32 chain_count = 0;
+		for (i32 q = chain; q != -1; q = h.point_next[q])
+		{
+			h.points[chain_count++] = q;
+		}
+		convex_hull_internal_classify(&h, h.points, chain_count, h.stack, new_count);
+	}
+	*scratch = hull_record;
+
+	/* (3) hull of the kept outer vertices */
+	const struct tri_mesh mesh = (best_count) 
+		? convex_hull_construct(mem, scratch, best, best_count, EPSILON) 
+		: tri_mesh_empty();
+	*scratch = record;
+	return mesh;
+}
+
+struct convex_hull_batch
+{
+	struct arena *mem;
+	struct tri_mesh *meshes;
+	const vec3ptr *v;
+	const u32 *v_count;
+	u32 count;
+	u32 next;		/* next unclaimed point set */
+	u64 scratch_size;
+	u64 out_size;
+	f32 EPSILON;
+	struct tri_mesh (*construct)(struct arena *, struct arena *, const vec3ptr, const u32, const f32);
+	mutex lock;		/* guards next and mem */
+};
+
+static void *convex_hull_internal_batch_worker(void *args)
+{
+	struct convex_hull_batch *batch = args;
+	struct arena scratch = arena_alloc(batch->scratch_size);
+	struct arena out = arena_alloc(batch->out_size);
+
+	/* without its memory a worker still claims point sets, giving them empty hulls */
+	const u32 allocated = (scratch.stack_ptr != NULL && out.stack_ptr != NULL);
+	while (1)
+	{
+		mutex_lock(&batch->lock);
+		const u32 i = batch->next;
+		batch->next += (i < batch->count) ? 1 : 0;
+		mutex_unlock(&batch->lock);
+		if (i >= batch->count) { break; }
+
+		struct arena record = out;
+		const struct tri_mesh mesh = (allocated) 
+			? batch->construct(&out, &scratch, batch->v[i], batch->v_count[i], batch->EPSILON)
+			: tri_mesh_empty();
+
+		/* gather into the shared arena */
+		struct tri_mesh *dst = batch->meshes + i;
+		*dst = mesh;
+		if (mesh.tri_count)
+		{
+			mutex_lock(&batch->lock);
+			dst->v = arena_push(batch->mem, mesh.v, mesh.v_count * sizeof(vec3));
+			dst->tri = arena_push_packed(batch->mem, mesh.tri, mesh.tri_count * sizeof(vec3u32));
+			mutex_unlock(&batch->lock);
+		}
+		out = record;
+	}
+
+	arena_free(&out);
+	arena_free(&scratch);
+	return NULL;
+}
+
+static void convex_hull_internal_batch(struct arena *mem, struct tri_mesh *meshes, const vec3ptr *v, const u32 *v_count, const u32 count, const f32 EPSILON, const u32 thread_count, struct tri_mesh (*construct)(struct arena *, struct arena *, const vec3ptr, const u32, const f32))
+{
+	if (count == 0) { return; }
+
+	u32 max_v_count = 4;
+	for (u32 i = 0; i < count; ++i)
+	{
+		max_v_count = (v_count[i] > max_v_count) ? v_count[i] : max_v_count;
+	}
+
+	struct convex_hull_batch batch =
+	{
+		.mem = mem,
+		.meshes = meshes,
+		.v = v,
+		.v_count = v_count,
+		.count = count,
+		.next = 0,
+		.scratch_size = convex_hull_scratch_size(max_v_count),
+		.out_size = max_v_count * sizeof(vec3) + 2 * max_v_count * sizeof(vec3u32) + 2 * MEMORY_ALIGNMENT,
+		.EPSILON = EPSILON,
+		.construct = construct,
+		.lock = mutex_default(),
+	};
+
+	/* the calling thread works on the batch as well */
+	u32 worker_count = (thread_count < count) ? thread_count : count;
+	worker_count = (worker_count > CONVEX_HULL_MAX_THREADS) ? CONVEX_HULL_MAX_THREADS : worker_count;
+	thread workers[CONVEX_HULL_MAX_THREADS];
+	for (u32 i = 1; i < worker_count; ++i)
+	{
+		workers[i] = thread_default(convex_hull_internal_batch_worker, &batch);
+	}
+
+	convex_hull_internal_batch_worker(&batch);
+
+	for (u32 i = 1; i < worker_count; ++i)
+	{
+		thread_join(workers + i, NULL);
+	}
+
+	mutex_destroy(&batch.lock);
+}
+
+void convex_hull_construct_batch(struct arena *mem, struct tri_mesh *meshes, const vec3ptr *v, const u32 *v_count, const u32 count, const f32 EPSILON, const u32 thread_count)
+{
+	convex_hull_internal_batch(mem, meshes, v, v_count, count, EPSILON, thread_count, convex_hull_construct);
+}
+
+void convex_hull_quickhull_batch(struct arena *mem, struct tri_mesh *meshes, const vec3ptr *v, const u32 *v_count, const u32 count, const f32 EPSILON, const u32 thread_count)
+{
+	convex_hull_internal_batch(mem, meshes, v, v_count, count, EPSILON, thread_count, convex_hull_quickhull);
+}
+
+/*
+ * Convex decomposition state. The voxel grid is padded by one empty voxel on every side, so the exterior is connected
+ * and every part voxel has six neighbours. Voxel (x,y,z) covers min + ([x-1,x], [y-1,y], [z-1,z]) * h, and corner
+ * (X,Y,Z) of the lattice sits at min + (X-1, Y-1, Z-1) * h.
+ */
+struct convex_decomposition
+{
+	struct arena work;
+	i32 *label;		/* part of voxel, -1 outside */
+	u32 *stamp;		/* lattice corner stamps, deduplicates hull points */
+	vec3ptr sample;		/* surface samples */
+	u32 *sample_voxel;	/* voxel of sample */
+	u32 sample_count;
+	u32 stamp_next;
+	u32 dim[3];
+	vec3 min;
+	f32 h;
+	f32 total_volume;	/* voxel volume of the whole mesh */
+	u32 thread_count;
+};
+
+#define CONVEX_DECOMPOSITION_VOXEL_EMPTY	-2
+#define CONVEX_DECOMPOSITION_VOXEL_OUTSIDE	-1
+
+static u32 convex_decomposition_internal_index(const struct convex_decomposition *d, const u32 x, const u32 y, const u32 z)
+{
+	return (z * d->dim[1] + y) * d->dim[0] + x;
+}
+
+/* surface samples of triangle t are a grid at most h/3 apart */
+static u32 convex_decomposition_internal_sample_resolution(const struct convex_decomposition *d, const struct tri_mesh *mesh, const u32 t)
+{
+	const f32 *a = mesh->v[mesh->tri[t][0]];
+	const f32 *b = mesh->v[mesh->tri[t][1]];
+	const f32 *c = mesh->v[mesh->tri[t][2]];
+	const f32 len = fmaxf(fmaxf(vec3_distance(a, b), vec3_distance(a, c)), vec3_distance(b, c));
+	return 1 + (u32) (3.0f * len / d->h);
+}
+
+/* mark voxels hit by surface samples, flood the exterior from the padding and fill the rest */
+static u32 convex_decomposition_internal_voxelize(struct convex_decomposition *d, const struct tri_mesh *mesh)
+{
+	const u32 count = d->dim[0] * d->dim[1] * d->dim[2];
+	for (u32 i = 0; i < count; ++i)
+	{
+		d->label[i] = CONVEX_DECOMPOSITION_VOXEL_EMPTY;
+	}
+
+	vec3 e1, e2;
+	d->sample_count = 0;
+	for (u32 t = 0; t < mesh->tri_count; ++t)
+	{
+		const f32 *a = mesh->v[mesh->tri[t][0]];
+		vec3_sub(e1, mesh->v[mesh->tri[t][1]], a);
+		vec3_sub(e2, mesh->v[mesh->tri[t][2]], a);
+		const u32 n = convex_decomposition_internal_sample_resolution(d, mesh, t);
+		for (u32 i = 0; i <= n; ++i)
+		{
+			for (u32 j = 0; j <= n - i; ++j)
+			{
+				f32 *p = d->sample[d->sample_count];
+				vec3_copy(p, a);
+				vec3_translate_scaled(p, e1, (f32) i / n);
+				vec3_translate_scaled(p, e2, (f32) j / n);
+				u32 voxel[3];
+				for (u32 k = 0; k < 3; ++k)
 				{
-					for (; j < k; ++j) 
-					{ 
-						unit = relation_list_add_relation_unit_empty(&conflict_graph, -1);
-						face = DCEL_face_add(&dcel, face_mem, horizon_edges[j], unit);
-						conflict_graph.r[unit].related_to = face;
+					const f32 x = fmaxf(1.0f + (p[k] - d->min[k]) / d->h, 1.0f);
+					voxel[k] = ((u32) x < d->dim[k] - 2) ? (u32) x : d->dim[k] - 2;
+				}
+				d->sample_voxel[d->sample_count] = convex_decomposition_internal_index(d, voxel[0], voxel[1], voxel[2]);
+				d->label[d->sample_voxel[d->sample_count]] = 0;
+				d->sample_count += 1;
+			}
+		}
+	}
+
+	struct arena record = d->work;
+	u32 *stack = arena_push(&d->work, NULL, count * sizeof(u32));
+	u32 stack_count = 1;
+	stack[0] = 0;
+	d->label[0] = CONVEX_DECOMPOSITION_VOXEL_OUTSIDE;
+	const i32 step[3] = { 1, (i32) d->dim[0], (i32) (d->dim[0] * d->dim[1]) };
+	while (stack_count)
+	{
+		const u32 i = stack[--stack_count];
+		const u32 coord[3] = { i % d->dim[0], (i / d->dim[0]) % d->dim[1], i / (d->dim[0] * d->dim[1]) };
+		for (u32 k = 0; k < 3; ++k)
+		{
+			if (coord[k] > 0 && d->label[i - step[k]] == CONVEX_DECOMPOSITION_VOXEL_EMPTY)
+			{
+				d->label[i - step[k]] = CONVEX_DECOMPOSITION_VOXEL_OUTSIDE;
+				stack[stack_count++] = i - step[k];
+			}
+			if (coord[k] + 1 < d->dim[k] && d->label[i + step[k]] == CONVEX_DECOMPOSITION_VOXEL_EMPTY)
+			{
+				d->label[i + step[k]] = CONVEX_DECOMPOSITION_VOXEL_OUTSIDE;
+				stack[stack_count++] = i + step[k];
+			}
+		}
+	}
+	d->work = record;
+
+	u32 inside = 0;
+	for (u32 i = 0; i < count; ++i)
+	{
+		if (d->label[i] == CONVEX_DECOMPOSITION_VOXEL_EMPTY)
+		{
+			d->label[i] = 0;
+		}
+		inside += (d->label[i] == 0) ? 1 : 0;
+	}
+
+	return inside;
+}
+
+/* voxel of part on the given side of the plane coord[axis] = plane (side -1: whole part, 0: below, 1: at or above) */
+static u32 convex_decomposition_internal_in(const struct convex_decomposition *d, const u32 i, const u32 coord, const i32 part, const u32 plane, const i32 side)
+{
+	return d->label[i] == part && (side == -1 || (coord >= plane) == (u32) side);
+}
+
+/*
+ * Push the distinct lattice corners of the surface voxels of (part, side) onto work, returns the point count and 
+ * the number of voxels in (part, side).
+ */
+static u32 convex_decomposition_internal_points(struct convex_decomposition *d, vec3ptr *points, u32 *voxel_count, const i32 part, const u32 axis, const u32 plane, const i32 side)
+{
+	*points = (vec3ptr) d->work.stack_ptr;
+	u32 count = 0;
+	*voxel_count = 0;
+
+	d->stamp_next += 1;
+	const u32 step[3] = { 1, d->dim[0], d->dim[0] * d->dim[1] };
+	const u32 lattice[3] = { d->dim[0] + 1, d->dim[1] + 1, d->dim[2] + 1 };
+	for (u32 z = 1; z + 1 < d->dim[2]; ++z)
+	for (u32 y = 1; y + 1 < d->dim[1]; ++y)
+	for (u32 x = 1; x + 1 < d->dim[0]; ++x)
+	{
+		const u32 coord[3] = { x, y, z };
+		const u32 i = convex_decomposition_internal_index(d, x, y, z);
+		if (!convex_decomposition_internal_in(d, i, coord[axis], part, plane, side))
+		{
+			continue;
+		}
+
+		*voxel_count += 1;
+		u32 surface = 0;
+		for (u32 k = 0; k < 3 && !surface; ++k)
+		{
+			const u32 below = (k == axis) ? coord[axis] - 1 : coord[axis];
+			const u32 above = (k == axis) ? coord[axis] + 1 : coord[axis];
+			surface = !convex_decomposition_internal_in(d, i - step[k], below, part, plane, side)
+				|| !convex_decomposition_internal_in(d, i + step[k], above, part, plane, side);
+		}
+
+		if (!surface)
+		{
+			continue;
+		}
+
+		for (u32 c = 0; c < 8; ++c)
+		{
+			const u32 X = x + (c & 1);
+			const u32 Y = y + ((c >> 1) & 1);
+			const u32 Z = z + ((c >> 2) & 1);
+			const u32 corner = (Z * lattice[1] + Y) * lattice[0] + X;
+			if (d->stamp[corner] != d->stamp_next)
+			{
+				d->stamp[corner] = d->stamp_next;
+				vec3 *p = arena_push_packed(&d->work, NULL, sizeof(vec3));
+				vec3_set(*p, d->min[0] + (X - 1.0f) * d->h, d->min[1] + (Y - 1.0f) * d->h, d->min[2] + (Z - 1.0f) * d->h);
+				count += 1;
+			}
+		}
+	}
 
-						const i32 tmp = prev_edge;
-						const i32 last_edge_in_polygon = DCEL_half_edge_reserve(&dcel, table_mem);
-						prev_edge = DCEL_half_edge_reserve(&dcel, table_mem);
+	return count;
+}
 
-						DCEL_half_edge_set(&dcel, prev_edge,
-							dcel.he_table[horizon_edges[(j+1) % num_edges]].origin,
-							-1,
-							face,
-							last_edge_in_polygon,
-							horizon_edges[j]);
+/* concavity of a voxel set: hull volume not covered by voxels, relative to the volume of the whole mesh */
+static f32 convex_decomposition_internal_concavity(const struct convex_decomposition *d, const struct tri_mesh *hull, const u32 voxel_count)
+{
+	/* a failed hull covers nothing, keep such sets from looking convex */
+	if (hull->tri_count == 0) { return 1.0f; }
 
-						DCEL_half_edge_set(&dcel, last_edge_in_polygon,
-							permutation[i],
-							tmp,
-							face,
-							horizon_edges[j],
-							prev_edge);
-						dcel.he_table[tmp].twin = last_edge_in_polygon;
+	const f32 excess = tri_mesh_volume(hull) - voxel_count * d->h * d->h * d->h;
+	return fmaxf(excess, 0.0f) / d->total_volume;
+}
 
-						vec3_copy(origin, vs + 3*dcel.he_table[horizon_edges[j]].origin);
-						vec3_sub(b, vs + 3*dcel.he_table[horizon_edges[(j+1) % num_edges]].origin, origin);
-						vec3_sub(c, vs + 3*permutation[i], origin);
-						vec3_cross(normal, b, c);
-						vec3_mul_constant(normal, 1.0f / vec3_length(normal));
-						convex_hull_internal_add_possible_conflicts(permutation, &conflict_graph, hash_index_hash_ptr(horizon_map), mem_5, unit, union_lens[j], union_lens + num_edges + len_offset, origin, normal, (vec3ptr) vs, EPSILON);
+u32 convex_decomposition(struct arena *mem, struct tri_mesh *parts, const u32 max_parts, const struct tri_mesh *mesh, const u32 resolution, const f32 max_concavity, const u32 thread_count)
+{
+	if (max_parts == 0 || mesh->tri_count == 0 || resolution == 0) { return 0; }
 
-						dcel.he_table[horizon_edges[j]].prev = last_edge_in_polygon;
-						dcel.he_table[horizon_edges[j]].next = prev_edge;
-						dcel.he_table[horizon_edges[j]].face_ccw = face;
+	struct convex_decomposition d = { .stamp_next = 0, .thread_count = thread_count };
 
-						len_offset += union_lens[j]; 
-					}
-				}
+	vec3 max;
+	vec3_copy(d.min, mesh->v[mesh->tri[0][0]]);
+	vec3_copy(max, d.min);
+	for (u32 t = 0; t < mesh->tri_count; ++t)
+	{
+		for (u32 j = 0; j < 3; ++j)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				d.min[k] = fminf(d.min[k], mesh->v[mesh->tri[t][j]][k]);
+				max[k] = fmaxf(max[k], mesh->v[mesh->tri[t][j]][k]);
 			}
+		}
+	}
 
-			assert(last_edge != -1);
-			dcel.he_table[last_edge].twin = prev_edge;
-			dcel.he_table[prev_edge].twin = last_edge;
-			
-			arena_pop_packed(mem_5, horizon_edges_to_remove * sizeof(i32));
-			i32 *ptr = (i32 *) mem_5->stack_ptr;
-			for (i32 z = 0; z < horizon_edges_to_remove; ++z)
+	d.h = fmaxf(fmaxf(max[0] - d.min[0], max[1] - d.min[1]), max[2] - d.min[2]) / resolution;
+	if (d.h <= 0.0f) { return 0; }
+	for (u32 k = 0; k < 3; ++k)
+	{
+		d.dim[k] = 3 + (u32) ((max[k] - d.min[k]) / d.h);
+	}
+
+	/* a candidate batch holds at most 2*CONVEX_DECOMPOSITION_PLANES point sets of distinct lattice corners and their hulls, the final batch at most 8 corners per voxel */
+	const u64 grid_count = (u64) d.dim[0] * d.dim[1] * d.dim[2];
+	const u64 lattice_count = (u64) (d.dim[0] + 1) * (d.dim[1] + 1) * (d.dim[2] + 1);
+	const u64 candidate_points = 2 * CONVEX_DECOMPOSITION_PLANES * lattice_count;
+	const u64 point_budget = (candidate_points > 8 * grid_count) ? candidate_points : 8 * grid_count;
+	const u64 batch_set_count = (2 * CONVEX_DECOMPOSITION_PLANES > max_parts) ? 2 * CONVEX_DECOMPOSITION_PLANES : max_parts;
+	u64 sample_count = 0;
+	for (u32 t = 0; t < mesh->tri_count; ++t)
+	{
+		const u64 n = convex_decomposition_internal_sample_resolution(&d, mesh, t);
+		sample_count += (n + 1) * (n + 2) / 2;
+	}
+	d.work = arena_alloc(grid_count * 2 * sizeof(u32) + lattice_count * sizeof(u32) 
+			+ sample_count * (2 * sizeof(vec3) + sizeof(u32))
+			+ point_budget * (sizeof(vec3) + sizeof(vec3) + 2 * sizeof(vec3u32))
+			+ batch_set_count * (sizeof(vec3ptr) + 2 * sizeof(u32) + sizeof(struct tri_mesh) + 4 * MEMORY_ALIGNMENT)
+			+ max_parts * sizeof(f32) + 16 * MEMORY_ALIGNMENT);
+	if (d.work.stack_ptr == NULL) { return 0; }
+
+	d.label = arena_push(&d.work, NULL, grid_count * sizeof(i32));
+	d.stamp = arena_push(&d.work, NULL, lattice_count * sizeof(u32));
+	d.sample = arena_push(&d.work, NULL, sample_count * sizeof(vec3));
+	d.sample_voxel = arena_push(&d.work, NULL, sample_count * sizeof(u32));
+	memset(d.stamp, 0, lattice_count * sizeof(u32));
+	f32 *concavity = arena_push(&d.work, NULL, max_parts * sizeof(f32));
+
+	const u32 inside = convex_decomposition_internal_voxelize(&d, mesh);
+	if (inside == 0)
+	{
+		arena_free(&d.work);
+		return 0;
+	}
+	d.total_volume = inside * d.h * d.h * d.h;
+
+	/* samples and voxel corners are lattices full of coplanar points, the hull tolerance follows the voxel size */
+	const f32 EPSILON = 0.001f * d.h;
+	struct arena record = d.work;
+	vec3ptr *v = arena_push(&d.work, NULL, 2 * CONVEX_DECOMPOSITION_PLANES * sizeof(vec3ptr));
+	u32 *v_count = arena_push(&d.work, NULL, 2 * CONVEX_DECOMPOSITION_PLANES * sizeof(u32));
+	u32 *voxel_count = arena_push(&d.work, NULL, 2 * CONVEX_DECOMPOSITION_PLANES * sizeof(u32));
+	u32 *plane = arena_push(&d.work, NULL, CONVEX_DECOMPOSITION_PLANES * sizeof(u32));
+	struct tri_mesh *hulls = arena_push(&d.work, NULL, 2 * CONVEX_DECOMPOSITION_PLANES * sizeof(struct tri_mesh));
+	struct arena candidate_record = d.work;
+
+	v_count[0] = convex_decomposition_internal_points(&d, v, voxel_count, 0, 0, 0, -1);
+	convex_hull_quickhull_batch(&d.work, hulls, v, v_count, 1, EPSILON, 1);
+	concavity[0] = convex_decomposition_internal_concavity(&d, hulls, voxel_count[0]);
+	d.work = candidate_record;
+
+	u32 part_count = 1;
+	while (part_count < max_parts)
+	{
+		i32 worst = 0;
+		for (u32 i = 1; i < part_count; ++i)
+		{
+			worst = (concavity[i] > concavity[worst]) ? (i32) i : worst;
+		}
+
+		if (concavity[worst] <= max_concavity)
+		{
+			break;
+		}
+
+		u32 lo[3] = { d.dim[0], d.dim[1], d.dim[2] };
+		u32 hi[3] = { 0, 0, 0 };
+		for (u32 z = 1; z + 1 < d.dim[2]; ++z)
+		for (u32 y = 1; y + 1 < d.dim[1]; ++y)
+		for (u32 x = 1; x + 1 < d.dim[0]; ++x)
+		{
+			if (d.label[convex_decomposition_internal_index(&d, x, y, z)] == worst)
 			{
-				DCEL_half_edge_remove(&dcel, ptr[z]);
+				lo[0] = (x < lo[0]) ? x : lo[0];
+				lo[1] = (y < lo[1]) ? y : lo[1];
+				lo[2] = (z < lo[2]) ? z : lo[2];
+				hi[0] = (x > hi[0]) ? x : hi[0];
+				hi[1] = (y > hi[1]) ? y : hi[1];
+				hi[2] = (z > hi[2]) ? z : hi[2];
+			}
+		}
+
+		/* cost of a cut: concavity of both halves plus a small imbalance penalty, which settles ties between cuts into convex halves */
+		f32 best_cost = FLT_MAX;
+		f32 best_concavity[2] = { 0.0f, 0.0f };
+		u32 best_axis = 0;
+		u32 best_plane = 0;
+		for (u32 axis = 0; axis < 3; ++axis)
+		{
+			const u32 range = hi[axis] - lo[axis];
+			if (range == 0) { continue; }
+
+			const u32 plane_count = (range < CONVEX_DECOMPOSITION_PLANES) ? range : CONVEX_DECOMPOSITION_PLANES;
+			for (u32 i = 0; i < plane_count; ++i)
+			{
+				plane[i] = lo[axis] + 1 + (i * range) / plane_count;
+				v_count[2*i + 0] = convex_decomposition_internal_points(&d, v + 2*i + 0, voxel_count + 2*i + 0, worst, axis, plane[i], 0);
+				v_count[2*i + 1] = convex_decomposition_internal_points(&d, v + 2*i + 1, voxel_count + 2*i + 1, worst, axis, plane[i], 1);
 			}
 
-			/* cleanup mem_5 */
-			for (i32 z = 0; z < num_conflict_faces; z++)
+			convex_hull_quickhull_batch(&d.work, hulls, v, v_count, 2 * plane_count, EPSILON, d.thread_count);
+			for (u32 i = 0; i < plane_count; ++i)
 			{
-				/* only free once if repeated */
-				if (dcel.faces[conflict_faces[z]].relation_unit != -1)
+				const f32 c_0 = convex_decomposition_internal_concavity(&d, hulls + 2*i + 0, voxel_count[2*i + 0]);
+				const f32 c_1 = convex_decomposition_internal_concavity(&d, hulls + 2*i + 1, voxel_count[2*i + 1]);
+				const f32 imbalance = fabsf((f32) voxel_count[2*i + 0] - (f32) voxel_count[2*i + 1]) / inside;
+				const f32 cost = c_0 + c_1 + CONVEX_DECOMPOSITION_BALANCE * imbalance;
+				if (cost < best_cost)
 				{
-					relation_list_remove_relation_unit(&conflict_graph, dcel.faces[conflict_faces[z]].relation_unit);
-					DCEL_face_remove(&dcel, conflict_faces[z]);
+					best_cost = cost;
+					best_concavity[0] = c_0;
+					best_concavity[1] = c_1;
+					best_axis = axis;
+					best_plane = plane[i];
 				}
 			}
-			arena_pop_packed(mem_5, num_conflict_faces * sizeof(i32));
+			d.work = candidate_record;
+		}
 
-			/* cleanup mem_4 */
-			for (i32 z = 0; z < num_edges; ++z)
-			{
-				arena_pop_packed(mem_4, union_lens[z] * sizeof(i32));
-			}
-			for (i32 z = 0; z < edges_to_remove[0]; ++z)
+		/* a single voxel can not be split further */
+		if (best_cost == FLT_MAX)
+		{
+			concavity[worst] = 0.0f;
+			continue;
+		}
+
+		for (u32 z = 1; z + 1 < d.dim[2]; ++z)
+		for (u32 y = 1; y + 1 < d.dim[1]; ++y)
+		for (u32 x = 1; x + 1 < d.dim[0]; ++x)
+		{
+			const u32 coord[3] = { x, y, z };
+			const u32 i = convex_decomposition_internal_index(&d, x, y, z);
+			if (convex_decomposition_internal_in(&d, i, coord[best_axis], worst, best_plane, 1))
 			{
-				DCEL_half_edge_remove(&dcel, edges_to_remove[z+1]);
+				d.label[i] = (i32) part_count;
 			}
-			arena_pop_packed(mem_4, (edges_to_remove[0]+1) * sizeof(i32));
-			arena_pop_packed(mem_4, num_edges * sizeof(i32));
-			arena_pop_packed(mem_4, num_edges * sizeof(i32));
 		}
-		relation_list_remove_relation_unit(&conflict_graph, i);
+		concavity[worst] = best_concavity[0];
+		concavity[part_count] = best_concavity[1];
+		part_count += 1;
 	}
+	d.work = record;
 
-	convex_hull_cs_step_draw_internal_push_data(&dcel, d_buf, vs, color, polygon_mode);
+	/* 
+	 * Part hulls are built from the surface samples in their voxels, which unlike the voxel corners do not 
+	 * overshoot the surface. Parts whose samples do not span a volume fall back to their voxel corners.
+	 */
+	vec3ptr *part_v = arena_push(&d.work, NULL, part_count * sizeof(vec3ptr));
+	u32 *part_v_count = arena_push(&d.work, NULL, part_count * sizeof(u32));
+	vec3ptr bucket = arena_push(&d.work, NULL, d.sample_count * sizeof(vec3));
+	for (u32 i = 0; i < part_count; ++i)
+	{
+		part_v_count[i] = 0;
+	}
+	for (u32 i = 0; i < d.sample_count; ++i)
+	{
+		part_v_count[d.label[d.sample_voxel[i]]] += 1;
+	}
+	u32 offset = 0;
+	for (u32 i = 0; i < part_count; ++i)
+	{
+		part_v[i] = bucket + offset;
+		offset += part_v_count[i];
+		part_v_count[i] = 0;
+	}
+	for (u32 i = 0; i < d.sample_count; ++i)
+	{
+		const i32 part = d.label[d.sample_voxel[i]];
+		vec3_copy(part_v[part][part_v_count[part]++], d.sample[i]);
+	}
 
-	/* Cleanup */
-	hash_free(horizon_map);
-	relation_list_free(&conflict_graph);
-	arena_pop_packed(table_mem, dcel.num_he * sizeof(struct DCEL_half_edge));
-	arena_pop_packed(face_mem, dcel.num_faces * sizeof(struct DCEL_face));
-	arena_pop(table_mem, permutation_size);
+	convex_hull_quickhull_batch(mem, parts, part_v, part_v_count, part_count, EPSILON, d.thread_count);
 
-	return 1;
-}
+	u32 part_voxel_count;
+	for (u32 i = 0; i < part_count; ++i)
+	{
+		if (parts[i].tri_count == 0)
+		{
+			part_v_count[i] = convex_decomposition_internal_points(&d, part_v + i, &part_voxel_count, (i32) i, 0, 0, -1);
+			convex_hull_quickhull_batch(mem, parts + i, part_v + i, part_v_count + i, 1, EPSILON, 1);
+		}
+	}
 
-#endif
+	arena_free(&d.work);
+	return part_count;
+}
 
 void convex_centroid(vec3 centroid, vec3ptr vs, const u32 n)
 {
@@ -1403,34 +2604,9 @@ u32 convex_support(vec3 support, const vec3 dir, vec3ptr vs, const u32 n)
 	return max_index;
 }
 
-f32 GJK_internal_tolerance(vec3ptr vs_1, const u32 n_1, vec3ptr vs_2, const u32 n_2, const f32 tol)
+f32 GJK_tolerance(const struct sphere *s_1, const struct sphere *s_2, const f32 tol)
 {
-	vec3 c_1, c_2;
-	convex_centroid(c_1, vs_1, n_1);
-	convex_centroid(c_2, vs_2, n_2);
-
-	/* Get max distance from centroids to convex surfaces */
-	f32 l_sq_1 = 0.0f;
-	for (u32 i = 0; i < n_1; ++i)
-	{
-		const f32 l_sq = vec3_distance_squared(c_1, vs_1[i]);
-		if (l_sq_1 < l_sq)
-		{
-			l_sq_1 = l_sq;
-		}
-	}
-
-	f32 l_sq_2 = 0.0f;
-	for (u32 i = 0; i < n_2; ++i)
-	{
-		const f32 l_sq = vec3_distance_squared(c_2, vs_2[i]);
-		if (l_sq_2 < l_sq)
-		{
-			l_sq_2 = l_sq;
-		}
-	}
-
-	const f32 D = sqrtf(l_sq_1) + sqrtf(l_sq_2) + vec3_distance(c_1, c_2);
+	const f32 D = s_1->radius + s_2->radius + vec3_distance(s_1->center, s_2->center);
 	return tol * D*D;
 }
 
@@ -1445,13 +2621,21 @@ u64 convex_minkowski_difference_support(vec3 support, const vec3 dir, vec3ptr A,
 	return (u64) i_1 << 32 | (u64) i_2;
 }
 
-u64 convex_minkowski_difference_world_support(vec3 support, const vec3 dir, const vec3 pos_A, vec3ptr A, const u32 n_A, const vec3 pos_B, vec3ptr B, const u32 n_B)
+/* 
+ * The search direction is rotated into each body frame (d' = R^T d) and the local support point is rotated back, 
+ * so a rotated body costs two mat3 multiplies per support call instead of transforming all its vertices.
+ */
+u64 convex_minkowski_difference_world_support(vec3 support, const vec3 dir, const vec3 pos_A, mat3 rot_A, vec3ptr A, const u32 n_A, const vec3 pos_B, mat3 rot_B, vec3ptr B, const u32 n_B)
 {
-	vec3 v_1, v_2, support_dir;
-	const u32 i_1 = convex_support(v_1, dir, A, n_A);
+	vec3 v_1, v_2, local, local_dir, support_dir;
+	vec3_mat_mul(local_dir, dir, rot_A);
+	const u32 i_1 = convex_support(local, local_dir, A, n_A);
+	mat3_vec_mul(v_1, rot_A, local);
 	vec3_translate(v_1, pos_A);
 	vec3_scale(support_dir, dir, -1.0f);
-	const u32 i_2 = convex_support(v_2, support_dir, B, n_B);
+	vec3_mat_mul(local_dir, support_dir, rot_B);
+	const u32 i_2 = convex_support(local, local_dir, B, n_B);
+	mat3_vec_mul(v_2, rot_B, local);
 	vec3_translate(v_2, pos_B);
 	vec3_sub(support, v_1, v_2);
 
@@ -2033,7 +3217,7 @@ static u32 GJK_internal_johnsons_algorithm(struct gjk_simplex *simplex, vec3 c_v
 	return 0;
 }
 
-u32 GJK_test(const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 abs_tol, const f32 tol)
+u32 GJK_test(const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 abs_tol, const f32 tol)
 {
 	struct gjk_simplex simplex = GJK_internal_simplex_init();
 	/* c_v - closest point in each iteration, dir = -c_v */
@@ -2049,7 +3233,7 @@ u32 GJK_test(const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, ve
 	{
 		simplex.type += 1;
 		vec3_scale(dir, c_v, -1.0f);
-		support_id = convex_minkowski_difference_world_support(simplex.p[simplex.type], dir, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+		support_id = convex_minkowski_difference_world_support(simplex.p[simplex.type], dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 		if (vec3_dot(simplex.p[simplex.type], dir) < 0.0f)
 		{
 			return 0;
@@ -2068,59 +3252,385 @@ u32 GJK_test(const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, ve
 		 */
 		if (GJK_internal_johnsons_algorithm(&simplex, c_v, lambda))
 		{
-			return 0;
+			return 0;
+		}
+
+		simplex.id[simplex.type] = support_id;
+		simplex.dot[simplex.type] = vec3_dot(simplex.p[simplex.type], simplex.p[simplex.type]);
+
+		/* 
+		 * If the simplex is of type 3, or a tetrahedron, we have encapsulated 0, or, if v is sufficiently
+		 * close to the origin, within a margin of error, return an intersection.
+		 */
+		if (simplex.type == 3)
+		{
+			return 1;
+		}
+		else
+		{
+			ma = simplex.dot[0];
+			ma = fmax(ma, simplex.dot[1]);
+			ma = fmax(ma, simplex.dot[2]);
+			ma = fmax(ma, simplex.dot[3]);
+
+			/* For error bound discussion, see sections 4.3.5, 4.3.6 */
+			if (vec3_dot(c_v, c_v) <= tol * ma || vec3_dot(c_v, c_v) <= abs_tol)
+			{
+				return 1;
+			}
+		}
+	} while (1);
+}
+
+/******************************** Batched GJK ********************************/
+
+/* SoA simplex for GJK_BATCH_WIDTH pairs, lane l of every register belongs to pair l of the batch */
+struct gjk_batch_simplex
+{
+	__m128 x[4];
+	__m128 y[4];
+	__m128 z[4];
+	__m128 dot[4];
+	__m128i id_1[4];
+	__m128i id_2[4];
+	__m128i type;	/* -1 == empty simplex */
+};
+
+static inline __m128 GJK_batch_internal_select(const __m128 mask, const __m128 a, const __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i GJK_batch_internal_select_i(const __m128 mask, const __m128i a, const __m128i b)
+{
+	const __m128i m = _mm_castps_si128(mask);
+	return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+/* out = R^T v (transpose == 0) or R v (transpose != 0) per lane, r[c][k] = column c, component k */
+static inline void GJK_batch_internal_rotate(__m128 out[3], const __m128 r[3][3], const __m128 v[3], const u32 transpose)
+{
+	if (transpose)
+	{
+		for (u32 c = 0; c < 3; ++c)
+		{
+			out[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[c][0], v[0]), _mm_mul_ps(r[c][1], v[1])), _mm_mul_ps(r[c][2], v[2]));
+		}
+	}
+	else
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			out[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0][k], v[0]), _mm_mul_ps(r[1][k], v[1])), _mm_mul_ps(r[2][k], v[2]));
+		}
+	}
+}
+
+/* Support of each lane's vertex set in direction (d_x, d_y, d_z), returns support indices. Lanes with fewer vertices 
+ * revisit their last vertex, which never wins the strict comparison, so the chosen index matches convex_support. */
+static __m128i GJK_batch_internal_support(__m128 *s_x, __m128 *s_y, __m128 *s_z, vec3ptr vs[GJK_BATCH_WIDTH], const u32 n[GJK_BATCH_WIDTH], const __m128 d_x, const __m128 d_y, const __m128 d_z)
+{
+	u32 n_max = n[0];
+	n_max = (n_max < n[1]) ? n[1] : n_max;
+	n_max = (n_max < n[2]) ? n[2] : n_max;
+	n_max = (n_max < n[3]) ? n[3] : n_max;
+
+	__m128 max = _mm_set1_ps(-FLT_MAX);
+	__m128i max_i = _mm_setzero_si128();
+	for (u32 i = 0; i < n_max; ++i)
+	{
+		const u32 i_0 = (i < n[0]) ? i : n[0] - 1;
+		const u32 i_1 = (i < n[1]) ? i : n[1] - 1;
+		const u32 i_2 = (i < n[2]) ? i : n[2] - 1;
+		const u32 i_3 = (i < n[3]) ? i : n[3] - 1;
+		const __m128 x = _mm_set_ps(vs[3][i_3][0], vs[2][i_2][0], vs[1][i_1][0], vs[0][i_0][0]);
+		const __m128 y = _mm_set_ps(vs[3][i_3][1], vs[2][i_2][1], vs[1][i_1][1], vs[0][i_0][1]);
+		const __m128 z = _mm_set_ps(vs[3][i_3][2], vs[2][i_2][2], vs[1][i_1][2], vs[0][i_0][2]);
+		const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, d_x), _mm_mul_ps(y, d_y)), _mm_mul_ps(z, d_z));
+		const __m128 greater = _mm_cmplt_ps(max, dot);
+		max = GJK_batch_internal_select(greater, dot, max);
+		max_i = GJK_batch_internal_select_i(greater, _mm_set1_epi32((i32) i), max_i);
+	}
+
+	u32 index[GJK_BATCH_WIDTH];
+	_mm_storeu_si128((__m128i *) index, max_i);
+	*s_x = _mm_set_ps(vs[3][index[3]][0], vs[2][index[2]][0], vs[1][index[1]][0], vs[0][index[0]][0]);
+	*s_y = _mm_set_ps(vs[3][index[3]][1], vs[2][index[2]][1], vs[1][index[1]][1], vs[0][index[0]][1]);
+	*s_z = _mm_set_ps(vs[3][index[3]][2], vs[2][index[2]][2], vs[1][index[1]][2], vs[0][index[0]][2]);
+
+	return max_i;
+}
+
+/*
+ * Branch-free Johnson's algorithm over all lanes. Instead of walking the sub-simplex decision tree, the determinants
+ * of every subset X of {0,1,2,3} are computed using the recursion
+ *
+ * 	delta_j(X + {j}) = sum_{i in X} delta_i(X) * ((y_k - y_j) * y_i),	k = min(X),
+ *
+ * and the subset containing the newest point (max(X) == type) that fulfills the Johnson conditions is selected per lane
+ * using masks. Points of the selected subset are compacted to the front, keeping the newest point last. Returns the
+ * mask of active lanes for which no valid subset was found (numerical failure, see GJK_internal_johnsons_algorithm).
+ */
+static __m128 GJK_batch_internal_johnsons_algorithm(struct gjk_batch_simplex *simplex, __m128 *c_x, __m128 *c_y, __m128 *c_z, const __m128 active)
+{
+	const __m128 zero = _mm_setzero_ps();
+	__m128 dp[4][4];
+	__m128 delta[16][4];
+
+	for (u32 a = 0; a < 4; ++a)
+	{
+		for (u32 b = a; b < 4; ++b)
+		{
+			dp[a][b] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(simplex->x[a], simplex->x[b]), 
+					_mm_mul_ps(simplex->y[a], simplex->y[b])),
+					_mm_mul_ps(simplex->z[a], simplex->z[b]));
+			dp[b][a] = dp[a][b];
+		}
+	}
+
+	for (u32 set = 1; set < 16; ++set)
+	{
+		for (u32 j = 0; j < 4; ++j)
+		{
+			if (!(set & (1 << j))) { continue; }
+
+			const u32 sub = set & ~(1 << j);
+			if (sub == 0)
+			{
+				delta[set][j] = _mm_set1_ps(1.0f);
+				continue;
+			}
+
+			const u32 k = __builtin_ctz(sub);
+			__m128 sum = zero;
+			for (u32 i = 0; i < 4; ++i)
+			{
+				if (sub & (1 << i))
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(delta[sub][i], _mm_sub_ps(dp[k][i], dp[j][i])));
+				}
+			}
+			delta[set][j] = sum;
+		}
+	}
+
+	struct gjk_batch_simplex reduced = *simplex;
+	/* lanes that are inactive count as already found, so they are left untouched */
+	__m128 found = _mm_andnot_ps(active, _mm_castsi128_ps(_mm_set1_epi32(-1)));
+	for (u32 set = 1; set < 16; ++set)
+	{
+		const u32 newest = 31 - __builtin_clz(set);
+		__m128 valid = _mm_castsi128_ps(_mm_cmpeq_epi32(simplex->type, _mm_set1_epi32((i32) newest)));
+		valid = _mm_andnot_ps(found, valid);
+		__m128 sum = zero;
+		for (u32 i = 0; i <= newest; ++i)
+		{
+			if (set & (1 << i))
+			{
+				valid = _mm_and_ps(valid, _mm_cmpgt_ps(delta[set][i], zero));
+				sum = _mm_add_ps(sum, delta[set][i]);
+			}
+			else
+			{
+				valid = _mm_and_ps(valid, _mm_cmple_ps(delta[set | (1 << i)][i], zero));
+			}
+		}
+
+		if (_mm_movemask_ps(valid) == 0) { continue; }
+		found = _mm_or_ps(found, valid);
+
+		const __m128 inv_sum = _mm_div_ps(_mm_set1_ps(1.0f), GJK_batch_internal_select(valid, sum, _mm_set1_ps(1.0f)));
+		__m128 x = zero;
+		__m128 y = zero;
+		__m128 z = zero;
+		u32 m = 0;
+		for (u32 i = 0; i <= newest; ++i)
+		{
+			if (set & (1 << i))
+			{
+				const __m128 lambda = _mm_mul_ps(delta[set][i], inv_sum);
+				x = _mm_add_ps(x, _mm_mul_ps(lambda, simplex->x[i]));
+				y = _mm_add_ps(y, _mm_mul_ps(lambda, simplex->y[i]));
+				z = _mm_add_ps(z, _mm_mul_ps(lambda, simplex->z[i]));
+				reduced.x[m] = GJK_batch_internal_select(valid, simplex->x[i], reduced.x[m]);
+				reduced.y[m] = GJK_batch_internal_select(valid, simplex->y[i], reduced.y[m]);
+				reduced.z[m] = GJK_batch_internal_select(valid, simplex->z[i], reduced.z[m]);
+				reduced.dot[m] = GJK_batch_internal_select(valid, simplex->dot[i], reduced.dot[m]);
+				reduced.id_1[m] = GJK_batch_internal_select_i(valid, simplex->id_1[i], reduced.id_1[m]);
+				reduced.id_2[m] = GJK_batch_internal_select_i(valid, simplex->id_2[i], reduced.id_2[m]);
+				m += 1;
+			}
+		}
+
+		reduced.type = GJK_batch_internal_select_i(valid, _mm_set1_epi32((i32) m - 1), reduced.type);
+		*c_x = GJK_batch_internal_select(valid, x, *c_x);
+		*c_y = GJK_batch_internal_select(valid, y, *c_y);
+		*c_z = GJK_batch_internal_select(valid, z, *c_z);
+	}
+
+	*simplex = reduced;
+	return _mm_andnot_ps(found, active);
+}
+
+static void GJK_test_batch_internal(u32 result[GJK_BATCH_WIDTH], const struct gjk_pair *pair[GJK_BATCH_WIDTH])
+{
+	vec3ptr vs_1[GJK_BATCH_WIDTH] = { pair[0]->vs_1, pair[1]->vs_1, pair[2]->vs_1, pair[3]->vs_1 };
+	vec3ptr vs_2[GJK_BATCH_WIDTH] = { pair[0]->vs_2, pair[1]->vs_2, pair[2]->vs_2, pair[3]->vs_2 };
+	const u32 n_1[GJK_BATCH_WIDTH] = { pair[0]->n_1, pair[1]->n_1, pair[2]->n_1, pair[3]->n_1 };
+	const u32 n_2[GJK_BATCH_WIDTH] = { pair[0]->n_2, pair[1]->n_2, pair[2]->n_2, pair[3]->n_2 };
+	__m128 rot_1[3][3], rot_2[3][3];
+	for (u32 c = 0; c < 3; ++c)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			rot_1[c][k] = _mm_set_ps(pair[3]->rot_1[c][k], pair[2]->rot_1[c][k], pair[1]->rot_1[c][k], pair[0]->rot_1[c][k]);
+			rot_2[c][k] = _mm_set_ps(pair[3]->rot_2[c][k], pair[2]->rot_2[c][k], pair[1]->rot_2[c][k], pair[0]->rot_2[c][k]);
+		}
+	}
+	const __m128 pos_x = _mm_set_ps(pair[3]->pos_1[0] - pair[3]->pos_2[0], pair[2]->pos_1[0] - pair[2]->pos_2[0], pair[1]->pos_1[0] - pair[1]->pos_2[0], pair[0]->pos_1[0] - pair[0]->pos_2[0]);
+	const __m128 pos_y = _mm_set_ps(pair[3]->pos_1[1] - pair[3]->pos_2[1], pair[2]->pos_1[1] - pair[2]->pos_2[1], pair[1]->pos_1[1] - pair[1]->pos_2[1], pair[0]->pos_1[1] - pair[0]->pos_2[1]);
+	const __m128 pos_z = _mm_set_ps(pair[3]->pos_1[2] - pair[3]->pos_2[2], pair[2]->pos_1[2] - pair[2]->pos_2[2], pair[1]->pos_1[2] - pair[1]->pos_2[2], pair[0]->pos_1[2] - pair[0]->pos_2[2]);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 v_tol = _mm_set_ps(pair[3]->abs_tol, pair[2]->abs_tol, pair[1]->abs_tol, pair[0]->abs_tol);
+	__m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 intersection = zero;
+
+	struct gjk_batch_simplex simplex;
+	for (u32 s = 0; s < 4; ++s)
+	{
+		simplex.x[s] = zero;
+		simplex.y[s] = zero;
+		simplex.z[s] = zero;
+		simplex.dot[s] = zero;
+		simplex.id_1[s] = _mm_set1_epi32(-1);
+		simplex.id_2[s] = _mm_set1_epi32(-1);
+	}
+	simplex.type = _mm_set1_epi32(-1);
+
+	/* c_v - closest point in each iteration, dir = -c_v; arbitrary starting search direction */
+	__m128 c_x = _mm_set1_ps(1.0f);
+	__m128 c_y = zero;
+	__m128 c_z = zero;
+
+	while (_mm_movemask_ps(active))
+	{
+		simplex.type = _mm_sub_epi32(simplex.type, _mm_castps_si128(active));
+
+		/* directions into body frames, d' = R^T d, and the local supports back into world frame */
+		__m128 dir[3], local[3], support[3], s_1[3], s_2[3];
+		const __m128 d_x = _mm_sub_ps(zero, c_x);
+		const __m128 d_y = _mm_sub_ps(zero, c_y);
+		const __m128 d_z = _mm_sub_ps(zero, c_z);
+		dir[0] = d_x; dir[1] = d_y; dir[2] = d_z;
+		GJK_batch_internal_rotate(local, rot_1, dir, 1);
+		const __m128i i_1 = GJK_batch_internal_support(&support[0], &support[1], &support[2], vs_1, n_1, local[0], local[1], local[2]);
+		GJK_batch_internal_rotate(s_1, rot_1, support, 0);
+		dir[0] = c_x; dir[1] = c_y; dir[2] = c_z;
+		GJK_batch_internal_rotate(local, rot_2, dir, 1);
+		const __m128i i_2 = GJK_batch_internal_support(&support[0], &support[1], &support[2], vs_2, n_2, local[0], local[1], local[2]);
+		GJK_batch_internal_rotate(s_2, rot_2, support, 0);
+		const __m128 w_x = _mm_add_ps(_mm_sub_ps(s_1[0], s_2[0]), pos_x);
+		const __m128 w_y = _mm_add_ps(_mm_sub_ps(s_1[1], s_2[1]), pos_y);
+		const __m128 w_z = _mm_add_ps(_mm_sub_ps(s_1[2], s_2[2]), pos_z);
+
+		/* separating axis found */
+		const __m128 w_dot_dir = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w_x, d_x), _mm_mul_ps(w_y, d_y)), _mm_mul_ps(w_z, d_z));
+		active = _mm_andnot_ps(_mm_cmplt_ps(w_dot_dir, zero), active);
+
+		/* Degenerate Case: new support point is already in simplex */
+		__m128i duplicate = _mm_setzero_si128();
+		for (u32 s = 0; s < 3; ++s)
+		{
+			const __m128i in_simplex = _mm_cmplt_epi32(_mm_set1_epi32((i32) s), simplex.type);
+			const __m128i same = _mm_and_si128(_mm_cmpeq_epi32(simplex.id_1[s], i_1), _mm_cmpeq_epi32(simplex.id_2[s], i_2));
+			duplicate = _mm_or_si128(duplicate, _mm_and_si128(in_simplex, same));
+		}
+		active = _mm_andnot_ps(_mm_castsi128_ps(duplicate), active);
+
+		const __m128 w_dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w_x, w_x), _mm_mul_ps(w_y, w_y)), _mm_mul_ps(w_z, w_z));
+		for (u32 s = 0; s < 4; ++s)
+		{
+			const __m128 slot = _mm_and_ps(active, _mm_castsi128_ps(_mm_cmpeq_epi32(simplex.type, _mm_set1_epi32((i32) s))));
+			simplex.x[s] = GJK_batch_internal_select(slot, w_x, simplex.x[s]);
+			simplex.y[s] = GJK_batch_internal_select(slot, w_y, simplex.y[s]);
+			simplex.z[s] = GJK_batch_internal_select(slot, w_z, simplex.z[s]);
+			simplex.dot[s] = GJK_batch_internal_select(slot, w_dot, simplex.dot[s]);
+			simplex.id_1[s] = GJK_batch_internal_select_i(slot, i_1, simplex.id_1[s]);
+			simplex.id_2[s] = GJK_batch_internal_select_i(slot, i_2, simplex.id_2[s]);
+		}
+
+		const __m128 failure = GJK_batch_internal_johnsons_algorithm(&simplex, &c_x, &c_y, &c_z, active);
+		active = _mm_andnot_ps(failure, active);
+
+		/* tetrahedron encapsulating the origin, or v within the pair's tolerance of the origin (sections 4.3.5, 4.3.6) */
+		const __m128 c_dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c_x, c_x), _mm_mul_ps(c_y, c_y)), _mm_mul_ps(c_z, c_z));
+		const __m128 hit = _mm_and_ps(active, _mm_or_ps(
+				_mm_castsi128_ps(_mm_cmpeq_epi32(simplex.type, _mm_set1_epi32(3))),
+				_mm_cmple_ps(c_dot, v_tol)));
+		intersection = _mm_or_ps(intersection, hit);
+		active = _mm_andnot_ps(hit, active);
+	}
+
+	const i32 mask = _mm_movemask_ps(intersection);
+	for (u32 l = 0; l < GJK_BATCH_WIDTH; ++l)
+	{
+		result[l] = (mask >> l) & 0x1;
+	}
+}
+
+void GJK_test_batch(u32 *result, const struct gjk_pair *pairs, const u32 count)
+{
+	u32 lane_result[GJK_BATCH_WIDTH];
+	const struct gjk_pair *lane_pair[GJK_BATCH_WIDTH];
+	for (u32 i = 0; i < count; i += GJK_BATCH_WIDTH)
+	{
+		/* pad the last batch by repeating its final pair */
+		for (u32 l = 0; l < GJK_BATCH_WIDTH; ++l)
+		{
+			lane_pair[l] = pairs + ((i + l < count) ? i + l : count - 1);
 		}
 
-		simplex.id[simplex.type] = support_id;
-		simplex.dot[simplex.type] = vec3_dot(simplex.p[simplex.type], simplex.p[simplex.type]);
+		GJK_test_batch_internal(lane_result, lane_pair);
 
-		/* 
-		 * If the simplex is of type 3, or a tetrahedron, we have encapsulated 0, or, if v is sufficiently
-		 * close to the origin, within a margin of error, return an intersection.
-		 */
-		if (simplex.type == 3)
-		{
-			return 1;
-		}
-		else
+		for (u32 l = 0; l < GJK_BATCH_WIDTH && i + l < count; ++l)
 		{
-			ma = simplex.dot[0];
-			ma = fmax(ma, simplex.dot[1]);
-			ma = fmax(ma, simplex.dot[2]);
-			ma = fmax(ma, simplex.dot[3]);
-
-			/* For error bound discussion, see sections 4.3.5, 4.3.6 */
-			if (vec3_dot(c_v, c_v) <= tol * ma)
-			{
-				return 1;
-			}
+			result[i + l] = lane_result[l];
 		}
-	} while (1);
+	}
 }
 
-static void GJK_internal_closest_points_on_bodies(vec3 c_1, vec3 c_2, vec3ptr vs_1, const vec3 pos_1, vec3ptr vs_2, const vec3 pos_2, const u64 simplex_id[4], const vec4 lambda, const u32 simplex_type)
+static void GJK_internal_closest_points_on_bodies(vec3 c_1, vec3 c_2, vec3ptr vs_1, const vec3 pos_1, mat3 rot_1, vec3ptr vs_2, const vec3 pos_2, mat3 rot_2, const u64 simplex_id[4], const vec4 lambda, const u32 simplex_type)
 {
-	vec3_copy(c_1, pos_1);
-	vec3_copy(c_2, pos_2);
+	vec3 l_1, l_2;
 	if (simplex_type == 0)
 	{
-		vec3_translate(c_1, vs_1[simplex_id[0] >> 32]);
-		vec3_translate(c_2, vs_2[simplex_id[0] & 0xffffffff]);
+		vec3_copy(l_1, vs_1[simplex_id[0] >> 32]);
+		vec3_copy(l_2, vs_2[simplex_id[0] & 0xffffffff]);
 	}
 	else
 	{
 		vec3 v_1, v_2;
+		vec3_set(l_1, 0.0f, 0.0f, 0.0f);
+		vec3_set(l_2, 0.0f, 0.0f, 0.0f);
 		for (u32 i = 0; i <= simplex_type; ++i)
 		{
 			vec3_scale(v_1, vs_1[simplex_id[i] >> 32], lambda[i]);
 			vec3_scale(v_2, vs_2[simplex_id[i] & 0xffffffff], lambda[i]);
-			vec3_translate(c_1, v_1);
-			vec3_translate(c_2, v_2);
+			vec3_translate(l_1, v_1);
+			vec3_translate(l_2, v_2);
 		}	
 	}
+
+	/* body frame -> world frame */
+	mat3_vec_mul(c_1, rot_1, l_1);
+	mat3_vec_mul(c_2, rot_2, l_2);
+	vec3_translate(c_1, pos_1);
+	vec3_translate(c_2, pos_2);
 }
 
-static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
+static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
 { 
 	*simplex = GJK_internal_simplex_init();
 	/* c_v - closest point in each iteration, dir = -c_v */
@@ -2140,7 +3650,7 @@ static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2
 	{
 		simplex->type += 1;
 		vec3_scale(dir, c_v, -1.0f);
-		support_id = convex_minkowski_difference_world_support(simplex->p[simplex->type], dir, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+		support_id = convex_minkowski_difference_world_support(simplex->p[simplex->type], dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 		if (c_v_distance_sq - vec3_dot(simplex->p[simplex->type], c_v) <= rel * c_v_distance_sq + abs_tol
 				|| simplex->id[0] == support_id || simplex->id[1] == support_id 
 				|| simplex->id[2] == support_id || simplex->id[3] == support_id)
@@ -2148,7 +3658,7 @@ static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2
 			assert(simplex->id != 0);
 			assert(c_v_distance_sq != FLT_MAX);
 			simplex->type -= 1;
-			GJK_internal_closest_points_on_bodies(c_1, c_2, vs_1, pos_1, vs_2, pos_2, simplex->id, lambda, simplex->type);
+			GJK_internal_closest_points_on_bodies(c_1, c_2, vs_1, pos_1, rot_1, vs_2, pos_2, rot_2, simplex->id, lambda, simplex->type);
 			return sqrtf(c_v_distance_sq);
 		}
 
@@ -2161,7 +3671,7 @@ static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2
 		{
 			assert(c_v_distance_sq != FLT_MAX);
 			simplex->type -= 1;
-			GJK_internal_closest_points_on_bodies(c_1, c_2, vs_1, pos_1, vs_2, pos_2, simplex->id, lambda, simplex->type);
+			GJK_internal_closest_points_on_bodies(c_1, c_2, vs_1, pos_1, rot_1, vs_2, pos_2, rot_2, simplex->id, lambda, simplex->type);
 			return sqrtf(c_v_distance_sq);
 		}
 
@@ -2195,10 +3705,499 @@ static f32 GJK_distance_internal(struct gjk_simplex *simplex, vec3 c_1, vec3 c_2
 	return 0.0f;
 }
 
-f32 GJK_distance(vec3 c_1, vec3 c_2, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
+f32 GJK_distance(vec3 c_1, vec3 c_2, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
 {
 	struct gjk_simplex simplex;
-	return GJK_distance_internal(&simplex, c_1, c_2, pos_1, vs_1, n_1, pos_2, vs_2, n_2, rel_tol, abs_tol);
+	return GJK_distance_internal(&simplex, c_1, c_2, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2, rel_tol, abs_tol);
+}
+
+u32 GJK_distance_within(const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 max_dist, const f32 rel_tol, const f32 abs_tol)
+{
+	struct gjk_simplex simplex = GJK_internal_simplex_init();
+	/* c_v - closest point in each iteration, dir = -c_v */
+	vec3 dir, c_v;
+	vec4 lambda;
+	u64 support_id;
+	f32 ma; /* max dot product of current simplex */
+	f32 c_v_distance_sq = FLT_MAX; /* closest point on simplex distance to origin */
+	const f32 rel = rel_tol * rel_tol;
+	const f32 max_dist_sq = max_dist * max_dist;
+
+	/* arbitrary starting search direction */
+	vec3_set(c_v, 1.0f, 0.0f, 0.0f);
+
+	do
+	{
+		simplex.type += 1;
+		vec3_scale(dir, c_v, -1.0f);
+		support_id = convex_minkowski_difference_world_support(simplex.p[simplex.type], dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
+
+		/* 
+		 * Separating plane: every point x of the minkowski difference satisfies x*c_v >= w*c_v, so the
+		 * distance is at least w*c_v / |c_v|. Exit as soon as that lower bound exceeds max_dist.
+		 */
+		const f32 c_v_w = vec3_dot(c_v, simplex.p[simplex.type]);
+		if (c_v_w > 0.0f && c_v_w * c_v_w > max_dist_sq * vec3_dot(c_v, c_v))
+		{
+			return 0;
+		}
+
+		/* converged (or degenerate), c_v is the closest point up to tolerance */
+		if (c_v_distance_sq - c_v_w <= rel * c_v_distance_sq + abs_tol
+				|| simplex.id[0] == support_id || simplex.id[1] == support_id 
+				|| simplex.id[2] == support_id || simplex.id[3] == support_id)
+		{
+			return c_v_distance_sq <= max_dist_sq;
+		}
+
+		if (GJK_internal_johnsons_algorithm(&simplex, c_v, lambda))
+		{
+			return c_v_distance_sq <= max_dist_sq;
+		}
+
+		simplex.id[simplex.type] = support_id;
+		simplex.dot[simplex.type] = vec3_dot(simplex.p[simplex.type], simplex.p[simplex.type]);
+
+		if (simplex.type == 3)
+		{
+			return 1;
+		}
+
+		ma = simplex.dot[0];
+		ma = fmax(ma, simplex.dot[1]);
+		ma = fmax(ma, simplex.dot[2]);
+		ma = fmax(ma, simplex.dot[3]);
+
+		/* witness: c_v lies in the minkowski difference, so the distance is at most |c_v| */
+		c_v_distance_sq = vec3_dot(c_v, c_v);
+		if (c_v_distance_sq <= max_dist_sq || c_v_distance_sq <= abs_tol * ma)
+		{
+			return 1;
+		}
+	} while (1);
+}
+
+f32 GJK_time_of_impact(const vec3 pos_1, mat3 rot_1, const vec3 vel_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, const vec3 vel_2, vec3ptr vs_2, const u32 n_2, const f32 t_max, const f32 tol)
+{
+	assert(tol > 0.0f);
+
+	vec3 p_1, p_2, c_1, c_2, n, v_rel;
+	vec3_sub(v_rel, vel_1, vel_2);
+
+	f32 t = 0.0f;
+	for (u32 i = 0; i < TOI_MAX_ITERATIONS; ++i)
+	{
+		vec3_copy(p_1, pos_1);
+		vec3_copy(p_2, pos_2);
+		vec3_translate_scaled(p_1, vel_1, t);
+		vec3_translate_scaled(p_2, vel_2, t);
+
+		/* bodies overlapping at the start are in contact, and the contact solver separates them */
+		const f32 dist = GJK_distance(c_1, c_2, p_1, rot_1, vs_1, n_1, p_2, rot_2, vs_2, n_2, 0.001f, 100.0f*FLT_EPSILON);
+		if (dist <= 0.0f)
+		{
+			return (t > 0.0f) ? t : FLT_MAX;
+		}
+
+		/* 
+		 * closing speed of body 1 towards body 2 along the closest point direction; separating bodies, and bodies
+		 * sliding along each other too slowly to close the gap within t_max, never impact
+		 */
+		vec3_sub(n, c_2, c_1);
+		const f32 closing_speed = vec3_dot(v_rel, n) / vec3_length(n);
+		if (closing_speed * (t_max - t) <= dist - 0.5f*tol)
+		{
+			return FLT_MAX;
+		}
+
+		/* touching at the start is contact as well, not an impact */
+		if (dist <= tol)
+		{
+			return (t > 0.0f) ? t : FLT_MAX;
+		}
+
+		/* stop half a tolerance short of contact, so the advanced bodies never overlap */
+		t += (dist - 0.5f*tol) / closing_speed;
+		if (t > t_max)
+		{
+			return FLT_MAX;
+		}
+	}
+
+	return t;
+}
+
+/* world frame planes n.x <= d of the hull triangles; degenerate triangles get a plane that never separates */
+static void convex_internal_world_planes(vec4ptr plane, const vec3 pos, mat3 rot, const struct tri_mesh *h)
+{
+	vec3 local, n;
+	for (u32 t = 0; t < h->tri_count; ++t)
+	{
+		vec3_recenter_cross(local, h->v[h->tri[t][0]], h->v[h->tri[t][1]], h->v[h->tri[t][2]]);
+		const f32 len = vec3_length(local);
+		if (len <= 100.0f*FLT_EPSILON)
+		{
+			vec4_set(plane[t], 0.0f, 0.0f, 0.0f, FLT_MAX);
+			continue;
+		}
+
+		vec3_scale(local, local, 1.0f / len);
+		mat3_vec_mul(n, rot, local);
+		vec4_set(plane[t], n[0], n[1], n[2], vec3_dot(local, h->v[h->tri[t][0]]) + vec3_dot(n, pos));
+	}
+}
+
+/* min over the hull vertices of n.(R*v + pos) */
+static f32 convex_internal_world_min(u32 *index, const vec3 n, const vec3 pos, mat3 rot, const struct tri_mesh *h)
+{
+	vec3 local;
+	vec3_mat_mul(local, n, rot);
+
+	u32 min_index = 0;
+	f32 min = FLT_MAX;
+	for (u32 i = 0; i < h->v_count; ++i)
+	{
+		const f32 d = vec3_dot(local, h->v[i]);
+		if (d < min)
+		{
+			min = d;
+			min_index = i;
+		}
+	}
+
+	*index = min_index;
+	return min + vec3_dot(n, pos);
+}
+
+static u32 convex_internal_inside(const vec3 p, const vec4ptr plane, const u32 plane_count, const f32 margin)
+{
+	for (u32 t = 0; t < plane_count; ++t)
+	{
+		if (vec3_dot(plane[t], p) > plane[t][3] + margin)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* keep the candidate furthest along each of the directions dir[k] */
+static void convex_internal_reduce(struct contact_patch *patch, f32 extent[CONTACT_PATCH_MAX_POINTS], vec3 dir[CONTACT_PATCH_MAX_POINTS], const vec3 p, const f32 depth, const u32 feature)
+{
+	for (u32 k = 0; k < CONTACT_PATCH_MAX_POINTS; ++k)
+	{
+		const f32 e = vec3_dot(dir[k], p);
+		if (e > extent[k])
+		{
+			extent[k] = e;
+			vec3_copy(patch->point[k], p);
+			patch->depth[k] = depth;
+			patch->feature[k] = feature;
+		}
+	}
+}
+
+/* 
+ * hull edges as vertex pairs edge[2e], edge[2e+1] with their triangles face[2e], face[2e+1]; diagonals between 
+ * coplanar triangles and edges of degenerate triangles can not separate and are left out
+ */
+static u32 convex_internal_edges(struct arena *mem, u32 **edge, u32 **face, const struct tri_mesh *h, const vec4ptr plane)
+{
+	const u32 half_count = 3*h->tri_count;
+	struct hash_index *twin = hash_new(mem, power_of_two_ceil(half_count), half_count);
+	for (u32 t = 0; t < h->tri_count; ++t)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 a = h->tri[t][k];
+			const u32 b = h->tri[t][(k+1) % 3];
+			hash_add(twin, (i32) ((a < b) ? a * 0x9e3779b1u + b : b * 0x9e3779b1u + a), (i32) (3*t + k));
+		}
+	}
+
+	*edge = arena_push(mem, NULL, half_count * sizeof(u32));
+	*face = arena_push(mem, NULL, half_count * sizeof(u32));
+	u32 count = 0;
+	for (u32 t = 0; t < h->tri_count; ++t)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 a = h->tri[t][k];
+			const u32 b = h->tri[t][(k+1) % 3];
+			if (a > b)
+			{
+				continue;
+			}
+
+			for (i32 j = hash_first(twin, (i32) (a * 0x9e3779b1u + b)); j != -1; j = hash_next(twin, j))
+			{
+				const u32 t_2 = (u32) j / 3;
+				if (h->tri[t_2][j % 3] == b && h->tri[t_2][(j+1) % 3] == a)
+				{
+					if (plane[t][3] != FLT_MAX && plane[t_2][3] != FLT_MAX && vec3_dot(plane[t], plane[t_2]) < 1.0f - 100.0f*FLT_EPSILON)
+					{
+						(*edge)[2*count + 0] = a;
+						(*edge)[2*count + 1] = b;
+						(*face)[2*count + 0] = t;
+						(*face)[2*count + 1] = t_2;
+						count += 1;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+/* 
+ * edges with adjacent face normals a, b and c, d build a face of the Minkowski difference iff their arcs on the
+ * Gauss map intersect; c and d are the negated normals of the second hull
+ */
+static u32 convex_internal_minkowski_face(const vec3 a, const vec3 b, const vec3 c, const vec3 d)
+{
+	vec3 b_x_a, d_x_c;
+	vec3_cross(b_x_a, b, a);
+	vec3_cross(d_x_c, d, c);
+	const f32 cba = vec3_dot(c, b_x_a);
+	const f32 dba = vec3_dot(d, b_x_a);
+	const f32 adc = vec3_dot(a, d_x_c);
+	const f32 bdc = vec3_dot(b, d_x_c);
+	return cba * dba < 0.0f && adc * bdc < 0.0f && cba * bdc > 0.0f;
+}
+
+/* closest points c_1, c_2 of the segments p_1 q_1 and p_2 q_2 */
+static void convex_internal_segment_closest(vec3 c_1, vec3 c_2, const vec3 p_1, const vec3 q_1, const vec3 p_2, const vec3 q_2)
+{
+	vec3 d_1, d_2, r;
+	vec3_sub(d_1, q_1, p_1);
+	vec3_sub(d_2, q_2, p_2);
+	vec3_sub(r, p_1, p_2);
+	const f32 a = vec3_dot(d_1, d_1);
+	const f32 e = vec3_dot(d_2, d_2);
+	const f32 b = vec3_dot(d_1, d_2);
+	const f32 c = vec3_dot(d_1, r);
+	const f32 f = vec3_dot(d_2, r);
+	const f32 denom = a*e - b*b;
+
+	f32 s = (denom > FLT_EPSILON * a * e) ? fminf(fmaxf((b*f - c*e) / denom, 0.0f), 1.0f) : 0.0f;
+	f32 t = (b*s + f) / e;
+	if (t < 0.0f)
+	{
+		t = 0.0f;
+		s = fminf(fmaxf(-c / a, 0.0f), 1.0f);
+	}
+	else if (t > 1.0f)
+	{
+		t = 1.0f;
+		s = fminf(fmaxf((b - c) / a, 0.0f), 1.0f);
+	}
+
+	vec3_copy(c_1, p_1);
+	vec3_translate_scaled(c_1, d_1, s);
+	vec3_copy(c_2, p_2);
+	vec3_translate_scaled(c_2, d_2, t);
+}
+
+u32 convex_hull_contact(struct arena *mem, struct contact_patch *patch, const vec3 pos_1, mat3 rot_1, const struct tri_mesh *h_1, const vec3 pos_2, mat3 rot_2, const struct tri_mesh *h_2, const f32 margin)
+{
+	struct arena record = *mem;
+	vec4ptr plane_1 = arena_push(mem, NULL, h_1->tri_count * sizeof(vec4));
+	vec4ptr plane_2 = arena_push(mem, NULL, h_2->tri_count * sizeof(vec4));
+	convex_internal_world_planes(plane_1, pos_1, rot_1, h_1);
+	convex_internal_world_planes(plane_2, pos_2, rot_2, h_2);
+
+	/* SAT over the face normals of both hulls, keep the axis of least penetration */
+	u32 index;
+	f32 penetration = FLT_MAX;
+	vec3 n;
+	patch->count = 0;
+	for (u32 t = 0; t < h_1->tri_count; ++t)
+	{
+		const f32 p = plane_1[t][3] - convex_internal_world_min(&index, plane_1[t], pos_2, rot_2, h_2);
+		if (p < -margin)
+		{
+			*mem = record;
+			return 0;
+		}
+		else if (p < penetration)
+		{
+			penetration = p;
+			vec3_copy(patch->normal, plane_1[t]);
+		}
+	}
+
+	for (u32 t = 0; t < h_2->tri_count; ++t)
+	{
+		const f32 p = plane_2[t][3] - convex_internal_world_min(&index, plane_2[t], pos_1, rot_1, h_1);
+		if (p < -margin)
+		{
+			*mem = record;
+			return 0;
+		}
+		else if (p < penetration)
+		{
+			penetration = p;
+			vec3_copy(patch->normal, plane_2[t]);
+			vec3_negative(patch->normal);
+		}
+	}
+
+	/* SAT over the cross products of the edge pairs that build faces of the Minkowski difference */
+	vec3ptr w_1 = arena_push(mem, NULL, h_1->v_count * sizeof(vec3));
+	vec3ptr w_2 = arena_push(mem, NULL, h_2->v_count * sizeof(vec3));
+	for (u32 i = 0; i < h_1->v_count; ++i)
+	{
+		mat3_vec_mul(w_1[i], rot_1, h_1->v[i]);
+		vec3_translate(w_1[i], pos_1);
+	}
+	for (u32 i = 0; i < h_2->v_count; ++i)
+	{
+		mat3_vec_mul(w_2[i], rot_2, h_2->v[i]);
+		vec3_translate(w_2[i], pos_2);
+	}
+
+	u32 *edge_1, *edge_2, *face_1, *face_2;
+	const u32 edge_count_1 = convex_internal_edges(mem, &edge_1, &face_1, h_1, plane_1);
+	const u32 edge_count_2 = convex_internal_edges(mem, &edge_2, &face_2, h_2, plane_2);
+
+	vec3 c, d, e_1, e_2, axis;
+	f32 edge_penetration = FLT_MAX;
+	u32 edge_pair[2] = { 0 };
+	for (u32 i = 0; i < edge_count_1; ++i)
+	{
+		const f32 *a = plane_1[face_1[2*i]];
+		const f32 *b = plane_1[face_1[2*i+1]];
+		vec3_sub(e_1, w_1[edge_1[2*i+1]], w_1[edge_1[2*i]]);
+		for (u32 j = 0; j < edge_count_2; ++j)
+		{
+			vec3_scale(c, plane_2[face_2[2*j]], -1.0f);
+			vec3_scale(d, plane_2[face_2[2*j+1]], -1.0f);
+			if (!convex_internal_minkowski_face(a, b, c, d))
+			{
+				continue;
+			}
+
+			/* parallel edges are covered by the face normals */
+			vec3_sub(e_2, w_2[edge_2[2*j+1]], w_2[edge_2[2*j]]);
+			vec3_cross(axis, e_1, e_2);
+			const f32 len = vec3_length(axis);
+			if (len <= 1e-4f * vec3_length(e_1) * vec3_length(e_2))
+			{
+				continue;
+			}
+
+			/* the axis points out of hull 1 at its edge */
+			vec3_scale(axis, axis, 1.0f / len);
+			vec3_sub(d, w_1[edge_1[2*i]], pos_1);
+			if (vec3_dot(axis, d) < 0.0f)
+			{
+				vec3_negative(axis);
+			}
+
+			vec3_sub(d, w_2[edge_2[2*j]], w_1[edge_1[2*i]]);
+			const f32 p = -vec3_dot(axis, d);
+			if (p < -margin)
+			{
+				*mem = record;
+				return 0;
+			}
+			else if (p < edge_penetration)
+			{
+				edge_penetration = p;
+				vec3_copy(n, axis);
+				edge_pair[0] = i;
+				edge_pair[1] = j;
+			}
+		}
+	}
+
+	/* 
+	 * an edge pair separates better than every face: one point halfway between the closest points of the edges.
+	 * Faces win ties, so resting face contacts keep their patches.
+	 */
+	if (edge_penetration + CONTACT_PATCH_EDGE_TOLERANCE < penetration)
+	{
+		vec3 c_1, c_2;
+		const u32 i = edge_pair[0];
+		const u32 j = edge_pair[1];
+		convex_internal_segment_closest(c_1, c_2, w_1[edge_1[2*i]], w_1[edge_1[2*i+1]], w_2[edge_2[2*j]], w_2[edge_2[2*j+1]]);
+		vec3_copy(patch->normal, n);
+		vec3_interpolate(patch->point[0], c_1, c_2, 0.5f);
+		patch->depth[0] = edge_penetration;
+		patch->feature[0] = CONTACT_PATCH_EDGE_FEATURE | (i << 15) | j;
+		patch->count = 1;
+		*mem = record;
+		return 1;
+	}
+
+	/* extent of hull 2 towards hull 1, and of hull 1 towards hull 2, along the normal */
+	vec3_copy(n, patch->normal);
+	const f32 min_2 = convex_internal_world_min(&index, n, pos_2, rot_2, h_2);
+	vec3_negative(n);
+	const f32 max_1 = -convex_internal_world_min(&index, n, pos_1, rot_1, h_1);
+
+	/* diagonal directions of the contact plane, so the four corners of a face aligned with the basis are kept */
+	vec3 t_1, t_2, dir[CONTACT_PATCH_MAX_POINTS];
+	f32 extent[CONTACT_PATCH_MAX_POINTS] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	vec3_create_basis(t_1, t_2, patch->normal);
+	vec3_add(dir[0], t_1, t_2);
+	vec3_sub(dir[1], t_1, t_2);
+	vec3_scale(dir[2], dir[0], -1.0f);
+	vec3_scale(dir[3], dir[1], -1.0f);
+
+	vec3 p;
+	for (u32 i = 0; i < h_1->v_count; ++i)
+	{
+		mat3_vec_mul(p, rot_1, h_1->v[i]);
+		vec3_translate(p, pos_1);
+		if (convex_internal_inside(p, plane_2, h_2->tri_count, margin))
+		{
+			const f32 depth = vec3_dot(patch->normal, p) - min_2;
+			vec3_translate_scaled(p, patch->normal, -0.5f*depth);
+			convex_internal_reduce(patch, extent, dir, p, depth, i);
+		}
+	}
+
+	for (u32 i = 0; i < h_2->v_count; ++i)
+	{
+		mat3_vec_mul(p, rot_2, h_2->v[i]);
+		vec3_translate(p, pos_2);
+		if (convex_internal_inside(p, plane_1, h_1->tri_count, margin))
+		{
+			const f32 depth = max_1 - vec3_dot(patch->normal, p);
+			vec3_translate_scaled(p, patch->normal, 0.5f*depth);
+			convex_internal_reduce(patch, extent, dir, p, depth, i | 0x80000000);
+		}
+	}
+
+	/* compact the kept points, a vertex may be extreme in several directions */
+	for (u32 k = 0; k < CONTACT_PATCH_MAX_POINTS; ++k)
+	{
+		if (extent[k] == -FLT_MAX)
+		{
+			continue;
+		}
+
+		u32 unique = 1;
+		for (u32 j = 0; j < patch->count; ++j)
+		{
+			unique &= (patch->feature[j] != patch->feature[k]);
+		}
+
+		if (unique)
+		{
+			vec3_copy(patch->point[patch->count], patch->point[k]);
+			patch->depth[patch->count] = patch->depth[k];
+			patch->feature[patch->count] = patch->feature[k];
+			patch->count += 1;
+		}
+	}
+
+	*mem = record;
+	return patch->count;
 }
 
 static u32 EPA_internal_check_unique_identifiers(const u64 id[4])
@@ -2217,7 +4216,7 @@ static u32 EPA_internal_check_unique_identifiers(const u64 id[4])
 	return 1;
 }
 
-static u32 EPA_internal_tetrahedron_from_line(struct gjk_simplex *simplex, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2)
+static u32 EPA_internal_tetrahedron_from_line(struct gjk_simplex *simplex, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2)
 {
 	vec3 tmp, p_1, support_dir;
 	vec3_copy(p_1, simplex->p[1]);	
@@ -2237,15 +4236,15 @@ static u32 EPA_internal_tetrahedron_from_line(struct gjk_simplex *simplex, const
 	vec3_set(simplex->p[1], 0.0f, 0.0f, 0.0f);
 	simplex->p[1][min_axis] = 1.0f;
 	vec3_cross(support_dir, tmp, simplex->p[1]);
-	simplex->id[1] = convex_minkowski_difference_world_support(simplex->p[1], support_dir, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+	simplex->id[1] = convex_minkowski_difference_world_support(simplex->p[1], support_dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 
 	vec3_copy(tmp, support_dir);
 	mat3_vec_mul(support_dir, rotation, tmp);
-	simplex->id[2] = convex_minkowski_difference_world_support(simplex->p[2], support_dir, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+	simplex->id[2] = convex_minkowski_difference_world_support(simplex->p[2], support_dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 
 	vec3_copy(tmp, support_dir);
 	mat3_vec_mul(support_dir, rotation, tmp);
-	simplex->id[3] = convex_minkowski_difference_world_support(simplex->p[3], support_dir, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+	simplex->id[3] = convex_minkowski_difference_world_support(simplex->p[3], support_dir, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 	
 	vec3_set(tmp, 0.0f, 0.0f, 0.0f);
 	u32 valid = 0;
@@ -2266,7 +4265,7 @@ static u32 EPA_internal_tetrahedron_from_line(struct gjk_simplex *simplex, const
 	return valid;
 }
 
-static u32 EPA_internal_tetrahedron_from_triangle(struct gjk_simplex *simplex, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2)
+static u32 EPA_internal_tetrahedron_from_triangle(struct gjk_simplex *simplex, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2)
 {
 	vec3 n, AB, AC;
 	vec3 origin = VEC3_ZERO;
@@ -2278,7 +4277,7 @@ static u32 EPA_internal_tetrahedron_from_triangle(struct gjk_simplex *simplex, c
 	for (u32 i = 0; i < 2; ++i)
 	{
 		vec3_negative(n);
-		simplex->id[3] = convex_minkowski_difference_world_support(simplex->p[3], n, pos_1, vs_1, n_1, pos_2, vs_2, n_2);		
+		simplex->id[3] = convex_minkowski_difference_world_support(simplex->p[3], n, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);		
 		if (EPA_internal_check_unique_identifiers(simplex->id) && tetrahedron_point_test(simplex->p, origin)) 
 		{  
 			valid = 1;
@@ -2289,7 +4288,7 @@ static u32 EPA_internal_tetrahedron_from_triangle(struct gjk_simplex *simplex, c
 	return valid;
 }
 
-static u32 EPA_internal_setup_tetrahedron(struct gjk_simplex *simplex, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2)
+static u32 EPA_internal_setup_tetrahedron(struct gjk_simplex *simplex, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2)
 {
 	u32 valid = 0;
 	switch (simplex->type)
@@ -2298,12 +4297,12 @@ static u32 EPA_internal_setup_tetrahedron(struct gjk_simplex *simplex, const vec
 
 		case 1: 
 		{
-			valid = EPA_internal_tetrahedron_from_line(simplex, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+			valid = EPA_internal_tetrahedron_from_line(simplex, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 		} break;
 
 		case 2: 
 		{
-			valid = EPA_internal_tetrahedron_from_triangle(simplex, pos_1, vs_1, n_1, pos_2, vs_2, n_2); 
+			valid = EPA_internal_tetrahedron_from_triangle(simplex, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2); 
 		} break;
 
 		case 3: 
@@ -2506,18 +4505,18 @@ static struct horizon EPA_internal_horizon(struct arena *mem, struct gen_array_l
 	return horizon;
 }
 
-u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
+u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol)
 {
 	struct arena record = *mem;
 	struct gjk_simplex simplex;
 	vec3 c_1, c_2;
 	u32 collision;
 
-	if (GJK_distance_internal(&simplex, c_1, c_2, pos_1, vs_1, n_1, pos_2, vs_2, n_2, rel_tol, abs_tol) == 0.0f)
+	if (GJK_distance_internal(&simplex, c_1, c_2, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2, rel_tol, abs_tol) == 0.0f)
 	{
 		collision = 1;
 		struct gen_array_list *entries = gen_array_list_new(mem, (4 + EPA_MAX_ITERATIONS * 2), sizeof(struct EPA_entry));
-		if (EPA_internal_setup_tetrahedron(&simplex, pos_1, vs_1, n_1, pos_2, vs_2, n_2) && EPA_internal_initiate_entries_from_tetrahedron(entries, &simplex, abs_tol)) 
+		if (EPA_internal_setup_tetrahedron(&simplex, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2) && EPA_internal_initiate_entries_from_tetrahedron(entries, &simplex, abs_tol)) 
 		{ 
 			struct min_heap *heap = min_heap_new(mem, 4 + EPA_MAX_ITERATIONS * 2);
 
@@ -2550,7 +4549,7 @@ u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, v
 				printf("---- SMALLEST VALID ----\n");
 				EPA_entry_print(entry);
 
-				const u64 support_id = convex_minkowski_difference_world_support(support, entry->closest_point, pos_1, vs_1, n_1, pos_2, vs_2, n_2);
+				const u64 support_id = convex_minkowski_difference_world_support(support, entry->closest_point, pos_1, rot_1, vs_1, n_1, pos_2, rot_2, vs_2, n_2);
 				const f32 dot = vec3_dot(support, entry->closest_point);
 				pen_depth_sq_upper_bound = fmin(pen_depth_sq_upper_bound, dot*dot / entry->distance_sq);
 			
@@ -2632,16 +4631,20 @@ u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, v
 			printf("---FINAL--\n");
 			EPA_entry_print(entry);
 			c_m->penetration_depth = sqrtf(entry->distance_sq);
-			vec3_copy(c_m->p_1, pos_1);
-			vec3_copy(c_m->p_2, pos_2);
-			vec3 v_1, v_2;
+			vec3 v_1, v_2, l_1, l_2;
+			vec3_set(l_1, 0.0f, 0.0f, 0.0f);
+			vec3_set(l_2, 0.0f, 0.0f, 0.0f);
 			for (u32 i = 0; i < 3; ++i)
 			{
 				vec3_scale(v_1, vs_1[entry->id[i] >> 32], entry->lambda[i]);
 				vec3_scale(v_2, vs_2[entry->id[i] & 0xffffffff], entry->lambda[i]);
-				vec3_translate(c_m->p_1, v_1);
-				vec3_translate(c_m->p_2, v_2);
+				vec3_translate(l_1, v_1);
+				vec3_translate(l_2, v_2);
 			}	
+			mat3_vec_mul(c_m->p_1, rot_1, l_1);
+			mat3_vec_mul(c_m->p_2, rot_2, l_2);
+			vec3_translate(c_m->p_1, pos_1);
+			vec3_translate(c_m->p_2, pos_2);
 		}
 		else
 		{
@@ -3002,10 +5005,12 @@ u32 GJKC_world_test(const vec3 pos_1, const f32 *vs_1, const u32 n_1, const vec3
 	vec3 dir, simplex[4];
 	u32 simplex_type = SIMPLEX_0;
 	const f32 error_bound = 0.001f;
+	mat3 identity;
+	mat3_identity(identity);
 
 	/* Get initial point */
 	vec3_set(dir, 1.0f, 0.0f, 0.0f);
-	convex_minkowski_difference_world_support(simplex[0], dir, pos_1, (vec3ptr) vs_1, n_1, pos_2, (vec3ptr) vs_2, n_2);
+	convex_minkowski_difference_world_support(simplex[0], dir, pos_1, identity, (vec3ptr) vs_1, n_1, pos_2, identity, (vec3ptr) vs_2, n_2);
 	vec3_scale(dir, simplex[0], -1.0f);
 	
 	const u32 max_iter = 100;
@@ -3014,7 +5019,7 @@ u32 GJKC_world_test(const vec3 pos_1, const f32 *vs_1, const u32 n_1, const vec3
 	{
 		simplex_type += 1;
 		/* (1) Add support */
-		convex_minkowski_difference_world_support(simplex[simplex_type], dir, pos_1, (vec3ptr) vs_1, n_1, pos_2, (vec3ptr) vs_2, n_2);
+		convex_minkowski_difference_world_support(simplex[simplex_type], dir, pos_1, identity, (vec3ptr) vs_1, n_1, pos_2, identity, (vec3ptr) vs_2, n_2);
 		//for (u32 i = 0; i < simplex_type+1;++i)
 		//{
 		//	printf("[%i]", i);
@@ -3367,6 +5372,19 @@ void AABB_union(struct AABB *box_union, const struct AABB *a, const struct AABB
 	vec3_add(box_union->center, box_union->hw, min);
 }
 
+/* center = R*c + t, hw = |R|*hw (Arvo) */
+void AABB_transform(struct AABB *dst, const struct AABB *src, mat3 rot, const vec3 translation)
+{
+	vec3 center, hw;
+	mat3_vec_mul(center, rot, src->center);
+	for (u32 i = 0; i < 3; ++i)
+	{
+		hw[i] = fabsf(rot[0][i]) * src->hw[0] + fabsf(rot[1][i]) * src->hw[1] + fabsf(rot[2][i]) * src->hw[2];
+	}
+	vec3_add(dst->center, center, translation);
+	vec3_copy(dst->hw, hw);
+}
+
 
 void AABB_push_lines(struct drawbuffer *buf, const struct AABB *box, const vec4 color)
 {
@@ -4123,16 +6141,18 @@ i32 cylinder_test(const struct cylinder *a, const struct cylinder *b)
 //	return 0;
 //}
 
-//f32 sphere_distance(const struct sphere *a, const struct sphere *b)
-//{
-//	return 0.0f;
-//}
-//
-//i32 sphere_test(const struct sphere *a, const struct sphere *b)
-//{
-//	return 0;
-//}
-//
+f32 sphere_distance(const struct sphere *a, const struct sphere *b)
+{
+	const f32 dist = vec3_distance(a->center, b->center) - a->radius - b->radius;
+	return (dist > 0.0f) ? dist : 0.0f;
+}
+
+i32 sphere_test(const struct sphere *a, const struct sphere *b)
+{
+	const f32 r = a->radius + b->radius;
+	return vec3_distance_squared(a->center, b->center) <= r*r;
+}
+
 //i32 sphere_intersection(struct tmp *dst, const struct sphere *a, const struct sphere *b)
 //{
 //	return 0;
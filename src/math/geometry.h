@@ -14,6 +14,8 @@
 #define SIMPLEX_2	2
 #define SIMPLEX_3	3
 
+struct sphere;
+
 /**************************************************************/
 
 struct tri_mesh 
@@ -92,17 +94,79 @@ void DCEL_half_edge_remove(struct DCEL *dcel, const i32 he);
 i32 DCEL_face_add(struct DCEL *dcel, struct arena *face_mem, const i32 edge, const i32 unit);
 void DCEL_face_remove(struct DCEL *dcel, const i32 face);
 
-/* Clarkson-Shor randomized convex hull (Computational Geometry Algorithms and Applications, Section 11) 
- * TODO: A space usage improvement found in the he original paper [Applications of Random Sampling in Computational Geometry, II, Page 23 (A linear-space variant] reduces the memory usage from O(nlogn) to O(n).
- * */
+/* Clarkson-Shor randomized convex hull (Computational Geometry Algorithms and Applications, Section 11) */
 i32 convex_hull_cs(struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, const f32 *vs, const i32 num_vs, const f32 EPSILON);
 
 #ifdef MGL_DEBUG
 i32 convex_hull_cs_step_draw(struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, struct arena *mem_5, const f32 *vs, const i32 num_vs, const f32 EPSILON, const i32 num_steps, const u32 seed, struct drawbuffer *d_buf, const vec4 color, const i32 polygon_mode);
 #endif
 
-struct tri_mesh convex_hull_empty(void);
-struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *table_mem, struct arena *face_mem, struct arena *conflict_mem, struct arena *mem_4, struct arena *mem_5, const vec3ptr v, const u32 v_count, const f32 EPSILON);
+struct tri_mesh tri_mesh_empty(void);
+/* push flat shaded triangles (pos | color | normal | index) of the mesh in local space, transforms are applied per index in the shader */
+void tri_mesh_push(struct drawbuffer *buf, const struct tri_mesh *mesh, const vec4 color, const i32 index);
+/* signed volume of a closed CCW mesh */
+f32 tri_mesh_volume(const struct tri_mesh *mesh);
+/* scratch memory required by convex_hull_construct for v_count points, O(v_count) */
+u64 convex_hull_scratch_size(const u32 v_count);
+/**
+ * Linear-space randomized incremental hull [Applications of Random Sampling in Computational Geometry, II, 
+ * Page 23 (A linear-space variant)]. The hull is pushed onto mem and only contains hull vertices. All working 
+ * memory is taken from scratch and released on return. Visible regions are grown over faces within EPSILON of
+ * the inserted point until their horizon is a simple cycle that the new faces can close without folding, and
+ * points already on the hull are not inserted again. Returns an empty mesh if the points are degenerate 
+ * (coplanar as a whole), if scratch has less than convex_hull_scratch_size(v_count) bytes left, or if a visible
+ * region grows over the whole hull, which only happens for nearly degenerate input.
+ */
+struct tri_mesh convex_hull_construct(struct arena *mem, struct arena *scratch, const vec3ptr v, const u32 v_count, const f32 EPSILON);
+/**
+ * Quickhull [Barber, Dobkin, Huhdanpaa, The Quickhull Algorithm for Convex Hulls] on the same face graph and 
+ * scratch layout as convex_hull_construct. Points are first classified against the hull of the extreme points
+ * along 7 directions, discarding interior points in one vectorised O(n) pass, after which the farthest point 
+ * of a face is inserted until no face has conflicts. Prefer it for point clouds where most points are interior.
+ * Returns an empty mesh under the same conditions as convex_hull_construct.
+ */
+struct tri_mesh convex_hull_quickhull(struct arena *mem, struct arena *scratch, const vec3ptr v, const u32 v_count, const f32 EPSILON);
+
+/**
+ * Simplify a hull into a collision proxy of at most max_v_count vertices that contains it. Starting from a 
+ * tetrahedron, the hull vertex farthest outside an inner hull is inserted, and after every insertion the faces of
+ * the inner hull give an outer approximation: each face plane is pushed out to the support plane of the original
+ * with the same normal (by the largest distance of a vertex left out), and face planes within CONVEX_HULL_MERGE_COS 
+ * of each other are merged into one, so nearly coplanar faces become one face. The last outer approximation with
+ * at most max_v_count vertices is kept, stopping once its volume is within volume_tolerance (relative) of the
+ * original or no vertex is more than EPSILON outside the inner hull. Since every plane supports the original, the
+ * proxy is outside the original by at most the distance of a vertex from the inner hull. Uses scratch as 
+ * convex_hull_construct, and returns an empty mesh if even the tetrahedron is over budget or scratch is too small.
+ */
+#define CONVEX_HULL_MERGE_COS 0.9995f	/* faces with normals less than about 1.8 degrees apart are merged */
+struct tri_mesh convex_hull_simplify(struct arena *mem, struct arena *scratch, const struct tri_mesh *hull, const u32 max_v_count, const f32 volume_tolerance, const f32 EPSILON);
+
+#define CONVEX_HULL_MAX_THREADS 64
+/**
+ * Construct hulls of count independent point sets on thread_count threads, the calling thread included. Each 
+ * thread owns scratch arenas sized for the largest point set, and finished hulls are gathered into mem under a 
+ * lock: meshes[i] is the hull of v[i] regardless of scheduling, but the order of the meshes in mem is not fixed.
+ * Point sets claimed by a thread whose scratch arenas could not be allocated get empty meshes.
+ */
+void convex_hull_construct_batch(struct arena *mem, struct tri_mesh *meshes, const vec3ptr *v, const u32 *v_count, const u32 count, const f32 EPSILON, const u32 thread_count);
+/* convex_hull_construct_batch with convex_hull_quickhull as the constructor */
+void convex_hull_quickhull_batch(struct arena *mem, struct tri_mesh *meshes, const vec3ptr *v, const u32 *v_count, const u32 count, const f32 EPSILON, const u32 thread_count);
+
+#define CONVEX_DECOMPOSITION_PLANES	8	/* candidate cutting planes per axis and split */
+#define CONVEX_DECOMPOSITION_BALANCE	0.01f	/* weight of the voxel count imbalance of a cut */
+/**
+ * Approximate convex decomposition in the spirit of V-HACD [Mamou, Volumetric Hierarchical Approximate Convex 
+ * Decomposition]. The triangle soup is voxelized at resolution voxels along its longest axis: voxels touched by 
+ * the surface are marked, the exterior is flooded from outside and the rest is filled in, so the soup only has to 
+ * enclose a volume, not be consistently oriented or manifold. The part with the largest concavity (hull volume 
+ * not covered by its voxels, relative to the mesh volume) is then cut by the best of CONVEX_DECOMPOSITION_PLANES 
+ * axis aligned planes per axis until every part is within max_concavity or max_parts is reached. Candidate hulls 
+ * (of voxel corners) and the final part hulls (of the surface samples in each part) are built on thread_count 
+ * threads with convex_hull_quickhull_batch, which discards the many interior points of both sets in one pass. Part hulls 
+ * are pushed onto mem into parts[0, count), the working memory is allocated internally. Returns count, 0 if 
+ * nothing is enclosed or the working memory cannot be allocated.
+ */
+u32 convex_decomposition(struct arena *mem, struct tri_mesh *parts, const u32 max_parts, const struct tri_mesh *mesh, const u32 resolution, const f32 max_concavity, const u32 thread_count);
 
 /****************************************************************************/
 
@@ -128,9 +192,74 @@ struct contact_manifold
 	f32 penetration_depth;
 };
 
-u32 GJK_test(const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 abs_tol, const f32 tol); /* [Page 146] -1 on error (To few points, or no initial tetrahedron). 0 == no collision, 1 == collision. */
-f32 GJK_distance(vec3 c_1, vec3 c_2, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol); /* Retrieve shortest distance between objects and the convex objects' closest points, or 0.0f if collision. */
-u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol); /* Returns 0 if no collision and contact manifold penetration depth 0.0f, otherwise != 0 and a valid contact manifold */
+u32 GJK_test(const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 abs_tol, const f32 tol); /* [Page 146] -1 on error (To few points, or no initial tetrahedron). 0 == no collision, 1 == collision, reported once |v|^2 <= max(tol * max|w|^2, abs_tol). */
+f32 GJK_distance(vec3 c_1, vec3 c_2, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol); /* Retrieve shortest distance between objects and the convex objects' closest points, or 0.0f if collision. */
+/* Absolute GJK tolerance tol * D^2, D = upper bound of the objects' extent from their world bounding spheres, O(1) */
+f32 GJK_tolerance(const struct sphere *s_1, const struct sphere *s_2, const f32 tol);
+/* Returns 1 if the distance between the objects is at most max_dist, 0 otherwise. Exits as soon as a separating plane proves the distance exceeds max_dist, or a witness point closer than max_dist is found */
+u32 GJK_distance_within(const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 max_dist, const f32 rel_tol, const f32 abs_tol);
+u32 GJK_EPA(struct arena *mem, struct contact_manifold *c_m, const vec3 pos_1, mat3 rot_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, vec3ptr vs_2, const u32 n_2, const f32 rel_tol, const f32 abs_tol); /* Returns 0 if no collision and contact manifold penetration depth 0.0f, otherwise != 0 and a valid contact manifold */
+
+/*
+ * Time of impact using conservative advancement: the bodies translate with constant velocities vel_1, vel_2 over
+ * [0, t_max], keeping their orientations rot_1, rot_2. Each step advances time by the distance left over the closing speed along the closest point direction,
+ * which for translational motion can never step past the first contact. Returns the time at which the approaching
+ * bodies come within tol of each other, or FLT_MAX if they do not come that close within t_max. Bodies separating,
+ * sliding along each other, or already within tol (overlapping included) at t = 0 return FLT_MAX: they are in
+ * contact, and keeping them apart is left to the contact solver.
+ */
+#define TOI_MAX_ITERATIONS 32
+f32 GJK_time_of_impact(const vec3 pos_1, mat3 rot_1, const vec3 vel_1, vec3ptr vs_1, const u32 n_1, const vec3 pos_2, mat3 rot_2, const vec3 vel_2, vec3ptr vs_2, const u32 n_2, const f32 t_max, const f32 tol);
+
+/*
+ * Contact patch between two convex hulls from a SAT test over the face normals of both hulls and the cross products
+ * of the edge pairs building faces of their Minkowski difference. The normal points from hull 1 towards hull 2 and
+ * is the axis of least penetration. For a face axis the points are hull vertices lying inside the other hull grown
+ * by margin, reduced to at most CONTACT_PATCH_MAX_POINTS extremes in the contact plane, and moved halfway to the
+ * other hull; an edge axis, taken only when it beats every face by CONTACT_PATCH_EDGE_TOLERANCE, gives one point
+ * halfway between the closest points of the two edges. depth[i] is the penetration at point[i] along the normal,
+ * negative for points within margin that do not yet touch. feature[i] identifies the generating vertex (bit 31 set
+ * for vertices of hull 2) or edge pair (bit 30 set) so contacts can be matched between frames.
+ */
+#define CONTACT_PATCH_MAX_POINTS 4
+#define CONTACT_PATCH_NO_FEATURE 0xffffffff
+#define CONTACT_PATCH_EDGE_FEATURE 0x40000000
+#define CONTACT_PATCH_EDGE_TOLERANCE 0.005f
+
+struct contact_patch
+{
+	vec3 normal;
+	vec3 point[CONTACT_PATCH_MAX_POINTS];
+	f32 depth[CONTACT_PATCH_MAX_POINTS];
+	u32 feature[CONTACT_PATCH_MAX_POINTS];
+	u32 count;
+};
+
+/* returns the number of contact points, 0 if the hulls are separated by more than margin; hull planes are pushed onto mem temporarily */
+u32 convex_hull_contact(struct arena *mem, struct contact_patch *patch, const vec3 pos_1, mat3 rot_1, const struct tri_mesh *h_1, const vec3 pos_2, mat3 rot_2, const struct tri_mesh *h_2, const f32 margin);
+
+/**
+ * Batched GJK intersection test. GJK_BATCH_WIDTH pairs run in lockstep, one pair per SSE lane; the support mapping,
+ * simplex and Johnson's algorithm are kept in SoA form and the sub-simplex selection is done with masks instead of 
+ * branches. Lanes that terminate are masked out until the whole batch is done, so pairs should be grouped by vertex
+ * count to keep the lanes busy.
+ */
+#define GJK_BATCH_WIDTH 4
+
+struct gjk_pair
+{
+	const f32 *pos_1;
+	const f32 *pos_2;
+	vec3ptr rot_1;		/* mat3 */
+	vec3ptr rot_2;		/* mat3 */
+	vec3ptr vs_1;
+	vec3ptr vs_2;
+	u32 n_1;
+	u32 n_2;
+	f32 abs_tol;		/* intersection once |v|^2 <= abs_tol, see GJK_tolerance */
+};
+
+void GJK_test_batch(u32 *result, const struct gjk_pair *pairs, const u32 count); /* result[i] = GJK_test(pairs[i], abs_tol = pairs[i].abs_tol, tol = 0) */
 
 u32 GJKC_test(const f32 *vs_1, const u32 n_1, const f32 *vs_2, const u32 n_2, const f32 tol);
 u32 GJKC_world_test(const vec3 pos_1, const f32 *vs_1, const u32 n_1, const vec3 pos_2, const f32 *vs_2, const u32 n_2, const f32 tol);
@@ -139,6 +268,8 @@ void convex_centroid(vec3 centroid, vec3ptr vs, const u32 n);
 u32 convex_support(vec3 support, const vec3 dir, vec3ptr vs, const u32 n);
 /* support of A-B, A,B convex */
 u64 convex_minkowski_difference_support(vec3 support, const vec3 dir, vec3ptr A, const u32 n_A, vec3ptr B, const u32 n_B);
+/* support of (R_A*A + pos_A) - (R_B*B + pos_B), A,B convex in their body frames */
+u64 convex_minkowski_difference_world_support(vec3 support, const vec3 dir, const vec3 pos_A, mat3 rot_A, vec3ptr A, const u32 n_A, const vec3 pos_B, mat3 rot_B, vec3ptr B, const u32 n_B);
 
 /* Get indices for initial tetrahedron using given tolerance. return 0 on no initial tetrahedron, 1 otherwise. */
 i32 tetrahedron_indices(i32 indices[4], const vec3ptr v, const i32 v_count, const f32 tol);
@@ -200,6 +331,8 @@ void spawn_cylinder_intersection(struct drawbuffer *d_buf, const struct cylinder
 /* Bounding volume calculation */
 void AABB_bounding_volume(struct AABB *dst, const vec3ptr v, const u32 v_count, const f32 tol);
 void AABB_union(struct AABB *box_union, const struct AABB *a, const struct AABB *b);
+/* smallest AABB bounding the box src rotated by rot and then translated, dst may alias src */
+void AABB_transform(struct AABB *dst, const struct AABB *src, mat3 rot, const vec3 translation);
 void AABB_push_lines(struct drawbuffer *buf, const struct AABB *box, const vec4 color);
 i32 AABB_contains(const struct AABB *a, const struct AABB *b); /* 0 if b is not contained in a, 1 otherwise */
 
@@ -294,3 +294,37 @@ void mat4_add(mat4 dst, mat4 a, mat4 b)
         dst[3][2] = a[3][2] + b[3][2];
         dst[3][3] = a[3][3] + b[3][3];
 }
+
+void mat3_transpose(mat3 dst, mat3 m)
+{
+	for (u32 i = 0; i < 3; ++i)
+	{
+		dst[i][0] = m[0][i];
+		dst[i][1] = m[1][i];
+		dst[i][2] = m[2][i];
+	}
+}
+
+/* the rows of m^-1 are the cross products of the columns of m, scaled by 1/det(m) */
+matrix_type mat3_inverse(mat3 dst, mat3 m)
+{
+	vec3 r[3];
+	vec3_cross(r[0], m[1], m[2]);
+	vec3_cross(r[1], m[2], m[0]);
+	vec3_cross(r[2], m[0], m[1]);
+	const matrix_type det = vec3_dot(m[0], r[0]);
+	if (det == 0.0f)
+	{
+		return det;
+	}
+
+	const matrix_type inv_det = 1.0f / det;
+	for (u32 i = 0; i < 3; ++i)
+	{
+		dst[i][0] = r[0][i] * inv_det;
+		dst[i][1] = r[1][i] * inv_det;
+		dst[i][2] = r[2][i] * inv_det;
+	}
+
+	return det;
+}
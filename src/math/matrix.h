@@ -61,4 +61,9 @@ void mat2_mult(mat2 dst, mat2 a, mat2 b);
 void mat3_mult(mat3 dst, mat3 a, mat3 b);
 void mat4_mult(mat4 dst, mat4 a, mat4 b);
 
+/* dst = m^T, dst may not alias m */
+void mat3_transpose(mat3 dst, mat3 m);
+/* dst = m^-1 by the adjugate, dst may not alias m; returns det(m), dst is untouched if m is singular */
+matrix_type mat3_inverse(mat3 dst, mat3 m);
+
 #endif
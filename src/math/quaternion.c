@@ -88,6 +88,21 @@ void quat_normalize(quat q)
 	quat_scale(q, norm_2_inv);
 }
 
+void quat_interpolate(quat dst, const quat p, const quat q, const vec_type alpha)
+{
+	const vec_type dot = p[0]*q[0] + p[1]*q[1] + p[2]*q[2] + p[3]*q[3];
+#ifdef VEC_TYPE_DOUBLE 
+	const vec_type beta = (dot < 0.0) ? alpha - 1.0 : 1.0 - alpha;
+#else
+	const vec_type beta = (dot < 0.0f) ? alpha - 1.0f : 1.0f - alpha;
+#endif
+	dst[0] = p[0] * alpha + q[0] * beta;
+	dst[1] = p[1] * alpha + q[1] * beta;
+	dst[2] = p[2] * alpha + q[2] * beta;
+	dst[3] = p[3] * alpha + q[3] * beta;
+	quat_normalize(dst);
+}
+
 /**
  * CCW rot?
  */
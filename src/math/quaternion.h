@@ -49,6 +49,8 @@ void quat_conj(quat conj, const quat q);
 void quat_inv(quat inv, const quat q);
 vec_type quat_norm(const quat q);
 void quat_normalize(quat q);
+/* normalized dst = p * alpha + q * (1 - alpha), q negated if needed so the blend follows the shorter arc */
+void quat_interpolate(quat dst, const quat p, const quat q, const vec_type alpha);
 
 /**
  * Quaternion Rotation operation matrix Q in: qvq* = Qv
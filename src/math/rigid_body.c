@@ -1,4 +1,5 @@
 #include <float.h>
+#include <string.h>
 
 #include "rigid_body.h"
 
@@ -6,15 +7,15 @@ void rigid_body_update_local_box(struct rigid_body *body)
 {
 	vec3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
 	vec3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
-	for (u32 i = 0; i < body->mesh.v_count; ++i)
+	for (u32 i = 0; i < body->collision.v_count; ++i)
 	{
-		min[0] = fminf(min[0], body->mesh.v[i][0]); 
-		min[1] = fminf(min[1], body->mesh.v[i][1]);			
-		min[2] = fminf(min[2], body->mesh.v[i][2]);			
+		min[0] = fminf(min[0], body->collision.v[i][0]); 
+		min[1] = fminf(min[1], body->collision.v[i][1]);			
+		min[2] = fminf(min[2], body->collision.v[i][2]);			
 
-		max[0] = fmaxf(max[0], body->mesh.v[i][0]);			
-		max[1] = fmaxf(max[1], body->mesh.v[i][1]);			
-		max[2] = fmaxf(max[2], body->mesh.v[i][2]);			
+		max[0] = fmaxf(max[0], body->collision.v[i][0]);			
+		max[1] = fmaxf(max[1], body->collision.v[i][1]);			
+		max[2] = fmaxf(max[2], body->collision.v[i][2]);			
 	}
 
 	vec3_sub(body->local_box.hw, max, min);
@@ -24,11 +25,35 @@ void rigid_body_update_local_box(struct rigid_body *body)
 
 void rigid_body_proxy(struct AABB *proxy, struct rigid_body *body)
 {
+	mat3 rot;
 	rigid_body_update_local_box(body);
-	vec3_add(proxy->center, body->local_box.center, body->position);
-	vec3_set(proxy->hw, body->local_box.hw[0] + body->margin,
-			body->local_box.hw[1] + body->margin,
-			body->local_box.hw[2] + body->margin);
+	quat_to_mat3(rot, body->rotation);
+	AABB_transform(proxy, &body->local_box, rot, body->position);
+	proxy->hw[0] += body->margin;
+	proxy->hw[1] += body->margin;
+	proxy->hw[2] += body->margin;
+}
+
+void rigid_body_world_sphere(struct sphere *sphere, const struct rigid_body *body, const vec3 position, mat3 rot)
+{
+	mat3_vec_mul(sphere->center, rot, body->bounding_sphere.center);
+	vec3_translate(sphere->center, position);
+	sphere->radius = body->bounding_sphere.radius;
+}
+
+void rigid_body_push_meshes(struct drawbuffer *buf, const struct rigid_body *body, const vec4 color, const i32 index)
+{
+	if (body->compound)
+	{
+		for (u32 c = 0; c < body->compound->child_count; ++c)
+		{
+			tri_mesh_push(buf, body->compound->child + c, color, index);
+		}
+	}
+	else
+	{
+		tri_mesh_push(buf, &body->mesh, color, index);
+	}
 }
 
 #define VOL	0 
@@ -42,218 +67,292 @@ void rigid_body_proxy(struct AABB *proxy, struct rigid_body *body)
 #define T_YZ	8
 #define T_ZX	9
 	    
-//TODO: REPLACE using table
-static u32 comb(const u32 o, const u32 u)
+void statics_print(FILE *file, struct rigid_body *body)
 {
-	assert(u <= o);
+	mat3_print("intertia tensor", body->inertia_tensor);
+	fprintf(stderr, "mass: %f\n", body->mass);
+}
 
-	u32 v1 = 1;
-	u32 v2 = 1;
-	u32 rep = (u <= o-u) ? u : o-u;
+/*
+ * Closed form subexpressions of the projected triangle integrals for one coordinate axis, w = (w0, w1, w2) being
+ * the axis coordinates of the triangle vertices. f1, f2, f3 are the integrals of w, w^2, w^3 and g_i the partial
+ * derivatives needed for the product terms (Eberly, Polyhedral Mass Properties; reduction of Mirtich's recurrences).
+ * Two triangles are handled per call, one in each double lane.
+ */
+static void statics_internal_subexpressions(__m128d *f1, __m128d *f2, __m128d *f3, __m128d g[3], const __m128d w0, const __m128d w1, const __m128d w2)
+{
+	const __m128d tmp0 = _mm_add_pd(w0, w1);
+	const __m128d tmp1 = _mm_mul_pd(w0, w0);
+	const __m128d tmp2 = _mm_add_pd(tmp1, _mm_mul_pd(w1, tmp0));
+	*f1 = _mm_add_pd(tmp0, w2);
+	*f2 = _mm_add_pd(tmp2, _mm_mul_pd(w2, *f1));
+	*f3 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(w0, tmp1), _mm_mul_pd(w1, tmp2)), _mm_mul_pd(w2, *f2));
+	g[0] = _mm_add_pd(*f2, _mm_mul_pd(w0, _mm_add_pd(*f1, w0)));
+	g[1] = _mm_add_pd(*f2, _mm_mul_pd(w1, _mm_add_pd(*f1, w1)));
+	g[2] = _mm_add_pd(*f2, _mm_mul_pd(w2, _mm_add_pd(*f1, w2)));
+}
 
-	for (u32 i = 0; i < rep; ++i)
+/*
+ *  accumulate unscaled volume integrals of two CCW triangles, p[k][j] = vertex k of triangle j. Degenerate (zero)
+ *  triangles contribute nothing, so odd counts pad the second lane with zeroes.
+ */
+static void statics_internal_calculate_integrals(__m128d integrals[10], vec3 p[3][2])
+{
+	__m128d x[3], y[3], z[3];
+	for (u32 k = 0; k < 3; ++k)
 	{
-		v1 *= (o-i);
-		v2 *= (i+1);
+		x[k] = _mm_set_pd(p[k][1][0], p[k][0][0]);
+		y[k] = _mm_set_pd(p[k][1][1], p[k][0][1]);
+		z[k] = _mm_set_pd(p[k][1][2], p[k][0][2]);
 	}
 
-	assert(v1 % v2 == 0);
-
-	return v1 / v2;
+	const __m128d a1 = _mm_sub_pd(x[1], x[0]);
+	const __m128d b1 = _mm_sub_pd(y[1], y[0]);
+	const __m128d c1 = _mm_sub_pd(z[1], z[0]);
+	const __m128d a2 = _mm_sub_pd(x[2], x[0]);
+	const __m128d b2 = _mm_sub_pd(y[2], y[0]);
+	const __m128d c2 = _mm_sub_pd(z[2], z[0]);
+
+	/* area weighted normal */
+	const __m128d d0 = _mm_sub_pd(_mm_mul_pd(b1, c2), _mm_mul_pd(b2, c1));
+	const __m128d d1 = _mm_sub_pd(_mm_mul_pd(a2, c1), _mm_mul_pd(a1, c2));
+	const __m128d d2 = _mm_sub_pd(_mm_mul_pd(a1, b2), _mm_mul_pd(a2, b1));
+
+	__m128d f1x, f2x, f3x, gx[3];
+	__m128d f1y, f2y, f3y, gy[3];
+	__m128d f1z, f2z, f3z, gz[3];
+	statics_internal_subexpressions(&f1x, &f2x, &f3x, gx, x[0], x[1], x[2]);
+	statics_internal_subexpressions(&f1y, &f2y, &f3y, gy, y[0], y[1], y[2]);
+	statics_internal_subexpressions(&f1z, &f2z, &f3z, gz, z[0], z[1], z[2]);
+
+	const __m128d xy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(y[0], gx[0]), _mm_mul_pd(y[1], gx[1])), _mm_mul_pd(y[2], gx[2]));
+	const __m128d yz = _mm_add_pd(_mm_add_pd(_mm_mul_pd(z[0], gy[0]), _mm_mul_pd(z[1], gy[1])), _mm_mul_pd(z[2], gy[2]));
+	const __m128d zx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x[0], gz[0]), _mm_mul_pd(x[1], gz[1])), _mm_mul_pd(x[2], gz[2]));
+
+	integrals[VOL]  = _mm_add_pd(integrals[VOL],  _mm_mul_pd(d0, f1x));
+	integrals[T_X]  = _mm_add_pd(integrals[T_X],  _mm_mul_pd(d0, f2x));
+	integrals[T_Y]  = _mm_add_pd(integrals[T_Y],  _mm_mul_pd(d1, f2y));
+	integrals[T_Z]  = _mm_add_pd(integrals[T_Z],  _mm_mul_pd(d2, f2z));
+	integrals[T_XX] = _mm_add_pd(integrals[T_XX], _mm_mul_pd(d0, f3x));
+	integrals[T_YY] = _mm_add_pd(integrals[T_YY], _mm_mul_pd(d1, f3y));
+	integrals[T_ZZ] = _mm_add_pd(integrals[T_ZZ], _mm_mul_pd(d2, f3z));
+	integrals[T_XY] = _mm_add_pd(integrals[T_XY], _mm_mul_pd(d0, xy));
+	integrals[T_YZ] = _mm_add_pd(integrals[T_YZ], _mm_mul_pd(d1, yz));
+	integrals[T_ZX] = _mm_add_pd(integrals[T_ZX], _mm_mul_pd(d2, zx));
 }
 
-void statics_print(FILE *file, struct rigid_body *body)
+/* accumulate the unscaled volume integrals of all triangles of mesh */
+static void statics_internal_accumulate(__m128d acc[10], const struct tri_mesh *mesh)
 {
-	mat3_print("intertia tensor", body->inertia_tensor);
-	fprintf(stderr, "mass: %f\n", body->mass);
-}
+	const vec3ptr v = mesh->v;
+	const vec3u32ptr tri = mesh->tri;
 
-static f32 statics_internal_line_integrals(const vec2 v0, const vec2 v1, const vec2 v2, const u32 p, const u32 q, const vec3 int_scalars)
-{
-	assert(p <= 4 && q <= 4);
-	
-	f32 sum = 0.0f;
-	for (u32 i = 0; i <= p; ++i)
+	vec3 p[3][2];
+	u32 i = 0;
+	for (; i + 1 < mesh->tri_count; i += 2)
 	{
-		for (u32 j = 0; j <= q; ++j)
+		for (u32 k = 0; k < 3; ++k)
 		{
-			sum += int_scalars[0] * comb(p, i) * comb(q, j) * powf(v1[0],i) * powf(v0[0],p-i) * powf(v1[1],j) * powf(v0[1],q-j) / comb(p+q, i+j);
-			sum += int_scalars[1] * comb(p, i) * comb(q, j) * powf(v2[0],i) * powf(v1[0],p-i) * powf(v2[1],j) * powf(v1[1],q-j) / comb(p+q, i+j);
-			sum += int_scalars[2] * comb(p, i) * comb(q, j) * powf(v0[0],i) * powf(v2[0],p-i) * powf(v0[1],j) * powf(v2[1],q-j) / comb(p+q, i+j);
+			vec3_copy(p[k][0], v[tri[i+0][k]]);
+			vec3_copy(p[k][1], v[tri[i+1][k]]);
 		}
+		statics_internal_calculate_integrals(acc, p);
 	}
 
-	return sum / (p+q+1);
+	if (i < mesh->tri_count)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			vec3_copy(p[k][0], v[tri[i][k]]);
+			vec3_set(p[k][1], 0.0f, 0.0f, 0.0f);
+		}
+		statics_internal_calculate_integrals(acc, p);
+	}
 }
-	
-/*
- *  alpha beta gamma CCW
- */ 
-static void statics_internal_calculate_integrals(f32 integrals[10], const vec3 p0, const vec3 p1, const vec3 p2)
-{
-	vec3 n, a, b;
-	vec2 v0, v1, v2;
-	vec3_sub(a, p1, p0);
-	vec3_sub(b, p2, p0);
-	vec3_cross(n, a, b);
-	vec3_mul_constant(n, 1.0f / vec3_length(n));
-	const f32 d = -vec3_dot(n, p0);
 
-	u32 max_index = 0;
-	if (n[max_index]*n[max_index] < n[1]*n[1]) { max_index = 1; }
-	if (n[max_index]*n[max_index] < n[2]*n[2]) { max_index = 2; }
+/* mass and inertia tensor about the center of mass com from the accumulated integrals */
+static void statics_internal_mass_properties(struct rigid_body *body, vec3 com, __m128d acc[10], const f32 density)
+{
+	const f64 scale[10] = { 1.0/6.0, 1.0/24.0, 1.0/24.0, 1.0/24.0, 1.0/60.0, 1.0/60.0, 1.0/60.0, 1.0/120.0, 1.0/120.0, 1.0/120.0 };
+	f64 integrals[10];
+	for (u32 j = 0; j < 10; ++j)
+	{
+		f64 lane[2];
+		_mm_storeu_pd(lane, acc[j]);
+		integrals[j] = (lane[0] + lane[1]) * scale[j];
+	}
 
-	/* maxized normal direction determines projected surface integral axes (we maximse the projected surface area) */
+	const f64 mass = integrals[VOL] * density;
+	body->mass = (f32) mass;
+	body->volume = (f32) integrals[VOL];
+	assert(body->mass >= 0.0f);
 
-	
-	const u32 a_i = (1+max_index) % 3;
-	const u32 b_i = (2+max_index) % 3;
-	const u32 y_i = max_index % 3;
+	/* center of mass */
+	const f64 com_d[3] = 
+	{ 
+		integrals[T_X] * density / mass,
+	       	integrals[T_Y] * density / mass,
+	       	integrals[T_Z] * density / mass,
+	};
+	vec3_set(com, (f32) com_d[0], (f32) com_d[1], (f32) com_d[2]);
 
-	//vec3_set(n, n[a_i], n[b_i], n[y_i]);
+	fprintf(stderr, "Center of Mass: { %f, %f, %f }\n", com[0], com[1], com[2]);
 
-	/* TODO: REPLACE */
-	union { f32 f; u32 bits; } val = { .f = n[y_i] };
-	const f32 n_sign = (val.bits >> 31) ? -1.0f : 1.0f;
+	const f32 I_xx = (f32) (density * (integrals[T_YY] + integrals[T_ZZ]) - mass * (com_d[1]*com_d[1] + com_d[2]*com_d[2]));
+	const f32 I_yy = (f32) (density * (integrals[T_XX] + integrals[T_ZZ]) - mass * (com_d[0]*com_d[0] + com_d[2]*com_d[2]));
+	const f32 I_zz = (f32) (density * (integrals[T_XX] + integrals[T_YY]) - mass * (com_d[0]*com_d[0] + com_d[1]*com_d[1]));
+	const f32 I_xy = (f32) (density * integrals[T_XY] - mass * com_d[0] * com_d[1]);
+	const f32 I_xz = (f32) (density * integrals[T_ZX] - mass * com_d[0] * com_d[2]);
+	const f32 I_yz = (f32) (density * integrals[T_YZ] - mass * com_d[1] * com_d[2]);
 
-	vec2_set(v0, p0[a_i], p0[b_i]);
-	vec2_set(v1, p1[a_i], p1[b_i]);
-	vec2_set(v2, p2[a_i], p2[b_i]);
-	
-	const vec3 delta_a =
-	{
-		v1[0] - v0[0],
-		v2[0] - v1[0],
-		v0[0] - v2[0],
-	};
-	
-	const vec3 delta_b = 
-	{
-		v1[1] - v0[1],
-		v2[1] - v1[1],
-		v0[1] - v2[1],
-	};
+	mat3_set(body->inertia_tensor, I_xx, -I_xy, -I_xz,
+		       		 	 -I_xy,  I_yy, -I_yz,
+					 -I_xz, -I_yz, I_zz);
+}
 
-	/* simplify cross product of v1-v0, v2-v0 to get this */
-	const f32 P_1 	=  n_sign * ((v0[0] + v1[0])*delta_b[0] + (v1[0] + v2[0])*delta_b[1] + (v0[0] + v2[0])*delta_b[2]) / 2.0f;
-	const f32 P_a 	=  (n_sign / 2.0f) * statics_internal_line_integrals(v0, v1, v2, 2, 0, delta_b);
-	const f32 P_aa 	=  (n_sign / 3.0f) * statics_internal_line_integrals(v0, v1, v2, 3, 0, delta_b);
-	const f32 P_aaa =  (n_sign / 4.0f) * statics_internal_line_integrals(v0, v1, v2, 4, 0, delta_b);
-	const f32 P_b 	= -(n_sign / 2.0f) * statics_internal_line_integrals(v0, v1, v2, 0, 2, delta_a);
-	const f32 P_bb 	= -(n_sign / 3.0f) * statics_internal_line_integrals(v0, v1, v2, 0, 3, delta_a);
-	const f32 P_bbb = -(n_sign / 4.0f) * statics_internal_line_integrals(v0, v1, v2, 0, 4, delta_a);
-	const f32 P_ab 	=  (n_sign / 2.0f) * statics_internal_line_integrals(v0, v1, v2, 2, 1, delta_b);
-	const f32 P_aab =  (n_sign / 3.0f) * statics_internal_line_integrals(v0, v1, v2, 3, 1, delta_b);
-	const f32 P_abb =  (n_sign / 3.0f) * statics_internal_line_integrals(v0, v1, v2, 1, 3, delta_b);
-
-	const f32 a_y_div = n_sign / n[y_i];
-	const f32 n_y_div = 1.0f / n[y_i];
-
-	/* surface integrals */
-	const f32 S_a 	= a_y_div * P_a;
-	const f32 S_aa 	= a_y_div * P_aa;
-	const f32 S_aaa = a_y_div * P_aaa;
-	const f32 S_aab = a_y_div * P_aab;
-	const f32 S_b 	= a_y_div * P_b;
-	const f32 S_bb 	= a_y_div * P_bb;
-	const f32 S_bbb = a_y_div * P_bbb;
-	const f32 S_bby = -a_y_div * n_y_div * (n[a_i]*P_abb + n[b_i]*P_bbb + d*P_bb);
-	const f32 S_y 	= -a_y_div * n_y_div * (n[a_i]*P_a + n[b_i]*P_b + d*P_1);
-	const f32 S_yy 	= a_y_div * n_y_div * n_y_div * (n[a_i]*n[a_i]*P_aa + 2.0f*n[a_i]*n[b_i]*P_ab + n[b_i]*n[b_i]*P_bb 
-			+ 2.0f*d*n[a_i]*P_a + 2.0f*d*n[b_i]*P_b + d*d*P_1);	
-	const f32 S_yyy = -a_y_div * n_y_div * n_y_div * n_y_div * (n[a_i]*n[a_i]*n[a_i]*P_aaa + 3.0f*n[a_i]*n[a_i]*n[b_i]*P_aab
-			+ 3.0f*n[a_i]*n[b_i]*n[b_i]*P_abb + n[b_i]*n[b_i]*n[b_i]*P_bbb + 3.0f*d*n[a_i]*n[a_i]*P_aa 
-			+ 6.0f*d*n[a_i]*n[b_i]*P_ab + 3.0f*d*n[b_i]*n[b_i]*P_bb + 3.0f*d*d*n[a_i]*P_a
-		       	+ 3.0f*d*d*n[b_i]*P_b + d*d*d*P_1);
-	const f32 S_yya = a_y_div * n_y_div * n_y_div * (n[a_i]*n[a_i]*P_aaa + 2.0f*n[a_i]*n[b_i]*P_aab + n[b_i]*n[b_i]*P_abb 
-			+ 2.0f*d*n[a_i]*P_aa + 2.0f*d*n[b_i]*P_ab + d*d*P_a);	
-
-	if (max_index == 2)
-	{
-		integrals[VOL] += S_a * n[0];
-	}
-	else if (max_index == 1)
+/* bounding sphere of the collision hull, so narrowphase tolerances and rejects need no vertex scans */
+static void statics_internal_bounding_sphere(struct rigid_body *body)
+{
+	const vec3ptr v = body->collision.v;
+	convex_centroid(body->bounding_sphere.center, v, body->collision.v_count);
+	f32 r_sq = 0.0f;
+	for (u32 i = 0; i < body->collision.v_count; ++i)
 	{
-		integrals[VOL] += S_b * n[0];
+		r_sq = fmaxf(r_sq, vec3_distance_squared(body->bounding_sphere.center, v[i]));
 	}
-	else
+	body->bounding_sphere.radius = sqrtf(r_sq);
+}
+
+static void statics_internal_zero(__m128d acc[10])
+{
+	for (u32 i = 0; i < 10; ++i)
 	{
-		integrals[VOL] += S_y * n[0];
+		acc[i] = _mm_setzero_pd();
 	}
-
-	integrals[T_X + a_i] += S_aa * n[a_i] / 2.0f;
-	integrals[T_X + b_i] += S_bb * n[b_i] / 2.0f;
-	integrals[T_X + y_i] += S_yy * n[y_i] / 2.0f;
-
-	integrals[T_XX + a_i] += S_aaa * n[a_i] / 3.0f;
-	integrals[T_XX + b_i] += S_bbb * n[b_i] / 3.0f;
-	integrals[T_XX + y_i] += S_yyy * n[y_i] / 3.0f;
-
-	integrals[T_XY + a_i] += S_aab * n[a_i] / 2.0f;
-	integrals[T_XY + b_i] += S_bby * n[b_i] / 2.0f;
-	integrals[T_XY + y_i] += S_yya * n[y_i] / 2.0f;
 }
 
 /*
- * Mirtich's Algorithm (Dynamic Solutions to Multibody Systems, Appendix D)
+ * Mirtich's Algorithm (Dynamic Solutions to Multibody Systems, Appendix D), with the projection integrals replaced by
+ * their closed form subexpressions and accumulated in double precision.
  */
 void statics_setup(struct rigid_body *body, struct arena *stack, struct tri_mesh *mesh, const f32 density)
 {
 	struct arena record = *stack;
 	
+	body->shape = -1;
+	body->compound = NULL;
 	body->mesh = *mesh;
-	const vec3ptr v = mesh->v;
-	const vec3u32ptr tri = mesh->tri;
-	f32 integrals[10] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; 
+	__m128d acc[10];
+	statics_internal_zero(acc);
+	statics_internal_accumulate(acc, mesh);
+
+	vec3 com;
+	statics_internal_mass_properties(body, com, acc, density);
 
-	for (u32 i = 0; i < mesh->tri_count; ++i)
+	/* set local frame coordinates */
+	body->friction = RIGID_BODY_FRICTION_DEFAULT;
+	body->restitution = RIGID_BODY_RESTITUTION_DEFAULT;
+	vec3_copy(body->position, com);
+	quat_set(body->rotation, 0.0f, 0.0f, 0.0f, 1.0f);
+	vec3_set(body->angular_momentum, 0.0f, 0.0f, 0.0f);
+	vec3_negative(com);
+	for (u32 i = 0; i < mesh->v_count; ++i)
 	{
-		statics_internal_calculate_integrals(integrals, v[tri[i][0]], v[tri[i][1]], v[tri[i][2]]); 
+		vec3_translate(mesh->v[i], com);
 	}
+	body->collision = body->mesh;
+	statics_internal_bounding_sphere(body);
+	
+	*stack = record;
+}
 
-	//fprintf(stderr, "Volume integrals: %f, %f, %f, %f, %f, %f, %f, %f, %f, %f\n\n",
-	//		 integrals[VOL ],
-	//		 integrals[T_X ],
-	//		 integrals[T_Y ],
-	//		 integrals[T_Z ],
-	//		 integrals[T_XX],
-	//		 integrals[T_YY],
-	//		 integrals[T_ZZ],
-        //                 integrals[T_XY],
-        //                 integrals[T_YZ],
-        //                 integrals[T_ZX]);
-
-	body->mass = integrals[VOL] * density;
-	assert(body->mass >= 0.0f);
-
-	/* center of mass */
-	vec3 com = 
-	{ 
-		integrals[T_X] * density / body->mass,
-	       	integrals[T_Y] * density / body->mass,
-	       	integrals[T_Z] * density / body->mass,
-	};
-
-	fprintf(stderr, "Center of Mass: { %f, %f, %f }\n", com[0], com[1], com[2]);
+void statics_setup_compound(struct rigid_body *body, struct arena *mem, struct arena *scratch, struct tri_mesh *child, const u32 child_count, const f32 density)
+{
+	assert(child_count > 0);
 
-	const f32 I_xx = density * (integrals[T_YY] + integrals[T_ZZ]) - body->mass * (com[1]*com[1] + com[2]*com[2]);
-	const f32 I_yy = density * (integrals[T_XX] + integrals[T_ZZ]) - body->mass * (com[0]*com[0] + com[2]*com[2]);
-	const f32 I_zz = density * (integrals[T_XX] + integrals[T_YY]) - body->mass * (com[0]*com[0] + com[1]*com[1]);
-	const f32 I_xy = density * integrals[T_XY] - body->mass * com[0] * com[1];
-	const f32 I_xz = density * integrals[T_ZX] - body->mass * com[0] * com[2];
-	const f32 I_yz = density * integrals[T_YZ] - body->mass * com[1] * com[2];
+	body->shape = -1;
+	__m128d acc[10];
+	statics_internal_zero(acc);
+	for (u32 c = 0; c < child_count; ++c)
+	{
+		statics_internal_accumulate(acc, child + c);
+	}
 
-	mat3_set(body->inertia_tensor, I_xx, -I_xy, -I_xz,
-		       		 	 -I_xy,  I_yy, -I_yz,
-					 -I_xz, -I_yz, I_zz);
+	vec3 com;
+	statics_internal_mass_properties(body, com, acc, density);
 
 	/* set local frame coordinates */
+	body->friction = RIGID_BODY_FRICTION_DEFAULT;
+	body->restitution = RIGID_BODY_RESTITUTION_DEFAULT;
 	vec3_copy(body->position, com);
+	quat_set(body->rotation, 0.0f, 0.0f, 0.0f, 1.0f);
+	vec3_set(body->angular_momentum, 0.0f, 0.0f, 0.0f);
 	vec3_negative(com);
-	for (u32 i = 0; i < mesh->v_count; ++i)
+	u32 v_count = 0;
+	for (u32 c = 0; c < child_count; ++c)
+	{
+		for (u32 i = 0; i < child[c].v_count; ++i)
+		{
+			vec3_translate(child[c].v[i], com);
+		}
+		v_count += child[c].v_count;
+	}
+
+	struct arena record = *scratch;
+
+	vec3ptr v = arena_push(scratch, NULL, v_count * sizeof(vec3));
+	struct AABB *box = arena_push(scratch, NULL, child_count * sizeof(struct AABB));
+	v_count = 0;
+	for (u32 c = 0; c < child_count; ++c)
 	{
-		vec3_translate(v[i], com);
+		memcpy(v + v_count, child[c].v, child[c].v_count * sizeof(vec3));
+		v_count += child[c].v_count;
+		AABB_bounding_volume(box + c, child[c].v, child[c].v_count, 0.0f);
+	}
+
+	body->mesh = convex_hull_quickhull(mem, scratch, v, v_count, 100.0f * FLT_EPSILON);
+	body->collision = body->mesh;
+	statics_internal_bounding_sphere(body);
+
+	body->compound = arena_push(mem, NULL, sizeof(struct compound));
+	body->compound->child = child;
+	body->compound->child_count = child_count;
+	body->compound->tree = dbvt_build(mem, box, (i32) child_count);
+
+	*scratch = record;
+}
+
+void rigid_body_set_shape(struct rigid_body *body, const struct shape_registry *reg, const i32 shape, const f32 density)
+{
+	const struct shape *s = reg->shapes + shape;
+	body->shape = shape;
+	body->compound = NULL;
+	body->mesh = s->mesh;
+	body->collision = s->collision;
+	body->local_box = s->local_box;
+	body->bounding_sphere = s->bounding_sphere;
+	body->mass = density * s->volume;
+	body->volume = s->volume;
+	body->friction = RIGID_BODY_FRICTION_DEFAULT;
+	body->restitution = RIGID_BODY_RESTITUTION_DEFAULT;
+	for (u32 i = 0; i < 3; ++i)
+	{
+		vec3_scale(body->inertia_tensor[i], s->inertia_tensor[i], density);
+	}
+
+	/* local frame coordinates */
+	vec3_copy(body->position, s->center_of_mass);
+	quat_set(body->rotation, 0.0f, 0.0f, 0.0f, 1.0f);
+	vec3_set(body->angular_momentum, 0.0f, 0.0f, 0.0f);
+}
+
+void rigid_body_simplify_collision(struct rigid_body *body, struct arena *mem, struct arena *scratch, const u32 max_v_count, const f32 volume_tolerance)
+{
+	const struct tri_mesh collision = convex_hull_simplify(mem, scratch, &body->mesh, max_v_count, volume_tolerance, 100.0f * FLT_EPSILON);
+	if (collision.v_count)
+	{
+		body->collision = collision;
+		statics_internal_bounding_sphere(body);
+		rigid_body_update_local_box(body);
 	}
-	
-	*stack = record;
 }
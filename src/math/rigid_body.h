@@ -4,36 +4,73 @@
 #include "mg_common.h"
 #include "mg_mempool.h"
 #include "geometry.h"
+#include "shape.h"
+#include "dbvt.h"
 #include "mmath.h"
 
+/*
+ * Compound - convex children sharing one body frame. A static tree over the child boxes lets the narrowphase cull
+ * children against the other body before any child pair reaches GJK.
+ */
+struct compound
+{
+	struct tri_mesh *child;	/* child hulls in body frame */
+	struct dbvt tree;	/* leaf id = child index */
+	u32 child_count;
+};
+
+/* contact material set up by statics_setup, statics_setup_compound and rigid_body_set_shape */
+#define RIGID_BODY_FRICTION_DEFAULT	0.5f
+#define RIGID_BODY_RESTITUTION_DEFAULT	0.0f
+
 struct rigid_body
 {
 	vec3 velocity;
-	struct AABB local_box;	/* bounding AABB */
+	struct AABB local_box;	/* bounding AABB of the collision hull */
 
-	i32 proxy;
 	f32 margin;
-	u32 active : 1;
-	u32 dynamic: 1;
+	u32 fast : 1;	/* swept against other bodies (CCD) when moving further than its smallest half-width in a step */
 
 
 	/* static state */
-	struct tri_mesh mesh; 		/* hull */
+	i32 shape;			/* shape registry id, -1 if the body owns its hull */
+	struct compound *compound;	/* convex children, NULL if the body is a single hull */
+	struct tri_mesh mesh; 		/* hull, the hull of all children for compound bodies */
+	struct tri_mesh collision;	/* narrowphase hull, mesh unless simplified */
 	struct AABB bounding_box;	/* bounding AABB */
+	struct sphere bounding_sphere;	/* body frame bounding sphere of the collision hull (vertex centroid, max radius) */
 	mat3 inertia_tensor;		/* intertia tensor of body frame */
 	f32 mass;			/* total body mass */
+	f32 volume;			/* hull volume, displaced by the body in buoyancy fields */
+	f32 friction;			/* coulomb friction coefficient, combined as sqrt(f_1*f_2) */
+	f32 restitution;		/* combined as max(e_1, e_2) */
 
-	/* dynamic state */
-	quat rotation;		/* TODO: */
-	quat angular_momentum;	/* TODO: */
+	/* dynamic state, the initial state once the body is added to a pipeline (see struct rbp) */
+	quat rotation;		/* body frame -> world frame, identity after statics_setup */
+	vec3 angular_momentum;	/* world frame, L = Iw */
 	vec3 position;	/* center of mass world frame position */
 	vec3 linear_momentum;   /* L = mv */
 };
 
 void rigid_body_update_local_box(struct rigid_body *body);
 void rigid_body_proxy(struct AABB *proxy, struct rigid_body *body);
+/* bounding sphere in world frame, position and rot = body position and rotation matrix */
+void rigid_body_world_sphere(struct sphere *sphere, const struct rigid_body *body, const vec3 position, mat3 rot);
+/* push the body frame hull tagged with index, see tri_mesh_push; compound bodies push each child instead */
+void rigid_body_push_meshes(struct drawbuffer *buf, const struct rigid_body *body, const vec4 color, const i32 index);
 
 void statics_print(FILE *file, struct rigid_body *body);
 void statics_setup(struct rigid_body *body, struct arena *stack, struct tri_mesh *hull, const f32 density);
+/**
+ * set up the static state of a compound body from child_count convex children, all in the same frame. Mass
+ * properties are summed over the children and the children are moved into the center of mass frame. The compound,
+ * its child tree and the hull of all children (mesh and collision hull, bounding the proxy) are pushed onto mem;
+ * the children themselves are referenced, not copied.
+ */
+void statics_setup_compound(struct rigid_body *body, struct arena *mem, struct arena *scratch, struct tri_mesh *child, const u32 child_count, const f32 density);
+/* set up the static state from a registry shape: hull views are shared, mass properties are scaled by density */
+void rigid_body_set_shape(struct rigid_body *body, const struct shape_registry *reg, const i32 shape, const f32 density);
+/* replace the collision hull with a simplification of the body frame hull, see convex_hull_simplify */
+void rigid_body_simplify_collision(struct rigid_body *body, struct arena *mem, struct arena *scratch, const u32 max_v_count, const f32 volume_tolerance);
 
 #endif
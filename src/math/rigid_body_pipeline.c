@@ -1,292 +1,2527 @@
 #include <stdlib.h>
 #include <string.h>
 #include "rigid_body_pipeline.h"
+#include "sort.h"
+#include "thread.h"
 
 #define UNIFORM_SIZE 256
 #define GRAVITY_CONSTANT_DEFAULT 9.80665f
 
-struct rbp rbp_new(struct arena *mem, const i32 size)
+/* zeroed array, if mem == NULL standard malloc is used */
+static void *rbp_internal_alloc(struct arena *mem, const u64 size)
+{
+	void *array = (mem) ? arena_push(mem, NULL, size) : malloc(size);
+	memset(array, 0, size);
+	return array;
+}
+
+/* 
+ * island - dynamic bodies connected through contacts and joints, together with their contacts and joints. Its solver
+ * bodies are [body_first, body_first + body_count], the last one standing in for every static body the island
+ * touches and for the world.
+ */
+struct rbp_island
+{
+	u32 contact_first;
+	u32 contact_count;
+	u32 joint_first;
+	u32 joint_count;
+	u32 body_first;
+	u32 body_count;
+};
+
+struct rbp_island_jobs
+{
+	const struct rbp_island *island;
+	const u64 *order;		/* island index in the low bits, largest islands first */
+	u32 count;
+	u32 next;			/* next unclaimed island */
+	struct solver_bodies bodies;
+	struct solver_contact *contact;
+	struct solver_joint *joint;
+	u64 scratch_size;
+	f32 delta;
+	mutex *lock;			/* guards next and the barrier */
+	/* large island solved color by color by every thread, the threads claim their index through next */
+	struct solver_colored *colored;
+	u32 thread_count;
+	u32 arrived;			/* threads waiting at the barrier */
+	u32 generation;			/* bumped whenever the barrier opens */
+	mutex_condition *barrier;
+};
+
+/* solver bodies of island i */
+static struct solver_bodies rbp_internal_island_bodies(const struct rbp_island_jobs *jobs, const u32 i)
+{
+	const struct rbp_island *island = jobs->island + i;
+	struct solver_bodies bodies =
+	{
+		.linear_velocity = jobs->bodies.linear_velocity + island->body_first,
+		.angular_velocity = jobs->bodies.angular_velocity + island->body_first,
+		.inv_mass = jobs->bodies.inv_mass + island->body_first,
+		.inv_inertia = jobs->bodies.inv_inertia + island->body_first,
+		.count = island->body_count + 1,
+	};
+	return bodies;
+}
+
+static void rbp_internal_solve_island(struct arena *mem, const struct rbp_island_jobs *jobs, const u32 i)
+{
+	const struct rbp_island *island = jobs->island + i;
+	struct solver_bodies bodies = rbp_internal_island_bodies(jobs, i);
+	solver_solve(mem, &bodies, jobs->contact + island->contact_first, island->contact_count, jobs->joint + island->joint_first, island->joint_count, jobs->delta, RBP_SOLVER_ITERATIONS);
+}
+
+/* wait until every thread on the colored island has arrived */
+static void rbp_internal_barrier(struct rbp_island_jobs *jobs)
+{
+	if (jobs->thread_count == 1) { return; }
+
+	mutex_lock(jobs->lock);
+	const u32 generation = jobs->generation;
+	jobs->arrived += 1;
+	if (jobs->arrived == jobs->thread_count)
+	{
+		jobs->arrived = 0;
+		jobs->generation += 1;
+		mutex_condition_broadcast(jobs->barrier);
+	}
+	else
+	{
+		while (jobs->generation == generation)
+		{
+			mutex_condition_wait(jobs->lock, jobs->barrier);
+		}
+	}
+	mutex_unlock(jobs->lock);
+}
+
+/* sweep the colored island as thread t, see struct solver_colored */
+static void rbp_internal_color_work(struct rbp_island_jobs *jobs, const u32 t)
+{
+	struct solver_colored *colored = jobs->colored;
+	for (u32 it = 0; it < RBP_SOLVER_ITERATIONS; ++it)
+	{
+		if (colored->joint_count)
+		{
+			if (t == 0)
+			{
+				solver_color_sweep_joints(colored);
+			}
+			rbp_internal_barrier(jobs);
+		}
+
+		for (u32 k = 0; k < colored->color_count; ++k)
+		{
+			solver_color_sweep(colored, k, t, jobs->thread_count);
+			rbp_internal_barrier(jobs);
+		}
+	}
+}
+
+/* solve unclaimed islands of jobs until none are left, or take a thread index on the colored island */
+static void rbp_internal_island_work(struct arena *scratch, struct rbp_island_jobs *jobs)
+{
+	if (jobs->colored)
+	{
+		mutex_lock(jobs->lock);
+		const u32 t = jobs->next++;
+		mutex_unlock(jobs->lock);
+		rbp_internal_color_work(jobs, t);
+		return;
+	}
+
+	while (1)
+	{
+		mutex_lock(jobs->lock);
+		const u32 i = jobs->next;
+		jobs->next += (i < jobs->count) ? 1 : 0;
+		mutex_unlock(jobs->lock);
+		if (i >= jobs->count) { break; }
+
+		rbp_internal_solve_island(scratch, jobs, (u32) jobs->order[i]);
+	}
+}
+
+/*
+ * island workers - the thread_count - 1 threads started by rbp_new, sleeping until a step hands them its island jobs.
+ * The calling thread works on the jobs as well and waits until every worker is done. A worker keeps its scratch arena
+ * between steps and only reallocates it when a step needs more. Large islands are handed over one at a time, with
+ * every thread sweeping its share of each color and meeting the others at a barrier.
+ */
+struct rbp_workers
+{
+	thread thread[RBP_MAX_THREADS];
+	u32 count;
+	mutex lock;			/* guards the fields below and the next island of the jobs */
+	mutex_condition work;		/* batch bumped or quit set */
+	mutex_condition done;		/* busy reached 0 */
+	mutex_condition barrier;	/* see rbp_internal_barrier */
+	struct rbp_island_jobs *jobs;
+	u32 batch;			/* bumped on every dispatch */
+	u32 busy;			/* workers still on the current batch */
+	u32 quit;
+};
+
+static void *rbp_internal_island_worker(void *args)
+{
+	struct rbp_workers *workers = args;
+	struct arena scratch = { 0 };
+	u32 batch = 0;
+
+	mutex_lock(&workers->lock);
+	while (1)
+	{
+		while (!workers->quit && workers->batch == batch)
+		{
+			mutex_condition_wait(&workers->lock, &workers->work);
+		}
+		if (workers->quit) { break; }
+
+		batch = workers->batch;
+		struct rbp_island_jobs *jobs = workers->jobs;
+		mutex_unlock(&workers->lock);
+
+		if (scratch.mem_size < jobs->scratch_size)
+		{
+			if (scratch.mem_size) { arena_free(&scratch); }
+			scratch = arena_alloc(jobs->scratch_size);
+		}
+		rbp_internal_island_work(&scratch, jobs);
+
+		mutex_lock(&workers->lock);
+		workers->busy -= 1;
+		if (workers->busy == 0)
+		{
+			mutex_condition_signal(&workers->done);
+		}
+	}
+	mutex_unlock(&workers->lock);
+
+	if (scratch.mem_size) { arena_free(&scratch); }
+	return NULL;
+}
+
+/* hand jobs to the workers, work on them on the calling thread as well and wait until every worker is done */
+static void rbp_internal_dispatch(struct rbp_workers *workers, struct rbp_island_jobs *jobs, struct arena *scratch)
+{
+	mutex_lock(&workers->lock);
+	workers->jobs = jobs;
+	workers->batch += 1;
+	workers->busy = workers->count;
+	mutex_condition_broadcast(&workers->work);
+	mutex_unlock(&workers->lock);
+
+	rbp_internal_island_work(scratch, jobs);
+
+	mutex_lock(&workers->lock);
+	while (workers->busy)
+	{
+		mutex_condition_wait(&workers->lock, &workers->done);
+	}
+	workers->jobs = NULL;
+	mutex_unlock(&workers->lock);
+}
+
+struct rbp rbp_new(struct arena *mem, const i32 size, const u32 thread_count)
 {
 	struct rbp pipeline =
 	{
 		.size = size,
 		.count = 0,
+		.generation = 0,
+		.thread_count = (thread_count == 0) ? 1 : (thread_count > RBP_MAX_THREADS) ? RBP_MAX_THREADS : thread_count,
+		.integrator = RBP_INTEGRATOR_EULER,
+		.awake_count = 0,
+		.wake_count = 0,
 		.gravity = { 0.0f, -GRAVITY_CONSTANT_DEFAULT, 0.0f },
 	};
 
-	if (mem)
+	pipeline.position = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.linear_momentum = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.angular_momentum = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.force = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.torque = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.velocity = rbp_internal_alloc(mem, size * sizeof(vec3));
+	pipeline.rotation = rbp_internal_alloc(mem, size * sizeof(quat));
+	pipeline.inv_mass = rbp_internal_alloc(mem, size * sizeof(f32));
+	pipeline.inv_inertia_body = rbp_internal_alloc(mem, size * sizeof(mat3));
+	pipeline.inv_inertia = rbp_internal_alloc(mem, size * sizeof(mat3));
+	pipeline.margin = rbp_internal_alloc(mem, size * sizeof(f32));
+	pipeline.local_box = rbp_internal_alloc(mem, size * sizeof(struct AABB));
+	pipeline.proxy = rbp_internal_alloc(mem, size * sizeof(i32));
+	pipeline.flags = rbp_internal_alloc(mem, size * sizeof(u32));
+	pipeline.active = rbp_internal_alloc(mem, size * sizeof(i32));
+	pipeline.active_index = rbp_internal_alloc(mem, size * sizeof(i32));
+	pipeline.slot_generation = rbp_internal_alloc(mem, size * sizeof(u32));
+	pipeline.awake = rbp_internal_alloc(mem, size * sizeof(i32));
+	pipeline.awake_index = rbp_internal_alloc(mem, size * sizeof(i32));
+	pipeline.rest_frames = rbp_internal_alloc(mem, size * sizeof(u32));
+	pipeline.bodies = rbp_internal_alloc(mem, size * sizeof(struct rigid_body));
+	pipeline.dynamic_tree = dbvt_alloc(mem, 2*size);
+	pipeline.shapes = shape_registry_new(mem, size, RBP_COLLISION_MAX_V_COUNT, RBP_COLLISION_VOLUME_TOLERANCE);
+	pipeline.contact_size = RBP_CONTACT_CACHE_PER_BODY * size;
+	pipeline.contact_count = 0;
+	pipeline.contact_hash = hash_new(mem, power_of_two_ceil(pipeline.contact_size), pipeline.contact_size);
+	pipeline.contact_cache = rbp_internal_alloc(mem, pipeline.contact_size * sizeof(struct rbp_contact_point));
+	pipeline.field_size = RBP_FIELD_PER_BODY * size;
+	pipeline.field_count = 0;
+	pipeline.field = rbp_internal_alloc(mem, pipeline.field_size * sizeof(struct rbp_field));
+	pipeline.field_slot = rbp_internal_alloc(mem, pipeline.field_size * sizeof(i32));
+	pipeline.field_index = rbp_internal_alloc(mem, pipeline.field_size * sizeof(i32));
+	pipeline.field_generation = rbp_internal_alloc(mem, pipeline.field_size * sizeof(u32));
+	pipeline.joint_size = RBP_JOINT_PER_BODY * size;
+	pipeline.joint_count = 0;
+	pipeline.joint = rbp_internal_alloc(mem, pipeline.joint_size * sizeof(struct rbp_joint));
+	pipeline.joint_slot = rbp_internal_alloc(mem, pipeline.joint_size * sizeof(i32));
+	pipeline.joint_index = rbp_internal_alloc(mem, pipeline.joint_size * sizeof(i32));
+	pipeline.joint_generation = rbp_internal_alloc(mem, pipeline.joint_size * sizeof(u32));
+
+	for (i32 i = 0; i < size; ++i)
+	{
+		pipeline.active_index[i] = -1;
+		pipeline.awake_index[i] = -1;
+	}
+
+	for (u32 i = 0; i < pipeline.field_size; ++i)
+	{
+		pipeline.field_slot[i] = (i32) i;
+		pipeline.field_index[i] = -1;
+	}
+
+	for (u32 i = 0; i < pipeline.joint_size; ++i)
+	{
+		pipeline.joint_slot[i] = (i32) i;
+		pipeline.joint_index[i] = -1;
+	}
+
+	pipeline.workers = rbp_internal_alloc(mem, sizeof(struct rbp_workers));
+	pipeline.workers->count = pipeline.thread_count - 1;
+	if (pipeline.workers->count)
+	{
+		pipeline.workers->lock = mutex_default();
+		pipeline.workers->work = mutex_condition_default();
+		pipeline.workers->done = mutex_condition_default();
+		pipeline.workers->barrier = mutex_condition_default();
+		for (u32 i = 0; i < pipeline.workers->count; ++i)
+		{
+			pipeline.workers->thread[i] = thread_default(rbp_internal_island_worker, pipeline.workers);
+		}
+	}
+
+	return pipeline;
+}
+
+void rbp_free(struct rbp *pipeline)
+{
+	struct rbp_workers *workers = pipeline->workers;
+	if (workers->count)
+	{
+		mutex_lock(&workers->lock);
+		workers->quit = 1;
+		mutex_condition_broadcast(&workers->work);
+		mutex_unlock(&workers->lock);
+		for (u32 i = 0; i < workers->count; ++i)
+		{
+			thread_join(workers->thread + i, NULL);
+		}
+		mutex_condition_destroy(&workers->barrier);
+		mutex_condition_destroy(&workers->done);
+		mutex_condition_destroy(&workers->work);
+		mutex_destroy(&workers->lock);
+		workers->count = 0;
+	}
+}
+
+/*
+ * slots of a packed record array (fields, joints) handed out as struct rbp_handle: slot[0, count) are the slots of
+ * the packed records, slot[count, size) the free ones and index[slot] the position of a slot in the array, -1 if free
+ */
+static struct rbp_handle rbp_internal_slot_take(i32 *slot, i32 *index, const u32 *generation, const u32 count)
+{
+	const i32 s = slot[count];
+	index[s] = (i32) count;
+	const struct rbp_handle handle = { .index = s, .generation = generation[s] };
+	return handle;
+}
+
+/* free the slot of record i out of count, the last record being moved into its place */
+static void rbp_internal_slot_release(i32 *slot, i32 *index, u32 *generation, const u32 i, const u32 count)
+{
+	const i32 s = slot[i];
+	const i32 last = slot[count - 1];
+	slot[i] = last;
+	index[last] = (i32) i;
+	slot[count - 1] = s;
+	index[s] = -1;
+	generation[s] += 1;
+}
+
+static i32 rbp_internal_slot_resolve(const i32 *index, const u32 *generation, const u32 size, const struct rbp_handle handle)
+{
+	assert(handle.index >= 0 && (u32) handle.index < size);
+	return (index[handle.index] != -1 && generation[handle.index] == handle.generation) ? index[handle.index] : -1;
+}
+
+/* dst = R T R^T, the body frame tensor T in world frame */
+static void rbp_internal_world_tensor(mat3 dst, mat3 rot, mat3 tensor)
+{
+	mat3 tmp, rot_t;
+	mat3_mult(tmp, rot, tensor);
+	mat3_transpose(rot_t, rot);
+	mat3_mult(dst, tmp, rot_t);
+}
+
+/* swap remove from the awake list */
+static void rbp_internal_awake_remove(struct rbp *pipeline, const i32 index)
+{
+	const i32 last = pipeline->awake[pipeline->awake_count - 1];
+	pipeline->awake[pipeline->awake_index[index]] = last;
+	pipeline->awake_index[last] = pipeline->awake_index[index];
+	pipeline->awake_index[index] = -1;
+	pipeline->awake_count -= 1;
+}
+
+static void rbp_internal_sleep(struct rbp *pipeline, const i32 index)
+{
+	rbp_internal_awake_remove(pipeline, index);
+	pipeline->flags[index] |= RBP_BODY_SLEEPING;
+	vec3_set(pipeline->linear_momentum[index], 0.0f, 0.0f, 0.0f);
+	vec3_set(pipeline->angular_momentum[index], 0.0f, 0.0f, 0.0f);
+}
+
+struct rbp_handle rbp_add(struct rbp *pipeline, const i32 index, struct rigid_body *body, u32 dynamic)
+{
+	assert(index >= 0 && index < pipeline->size);
+	assert(!(pipeline->flags[index] & RBP_BODY_ACTIVE));
+	assert(!dynamic || body->mass > 0.0f);
+
+	struct AABB proxy;
+	rigid_body_proxy(&proxy, body);
+	memcpy(pipeline->bodies + index, body, sizeof(struct rigid_body));
+
+	vec3_copy(pipeline->position[index], body->position);
+	mat3 rot;
+	quat_copy(pipeline->rotation[index], body->rotation);
+	quat_normalize(pipeline->rotation[index]);
+	quat_to_mat3(rot, pipeline->rotation[index]);
+	if (dynamic)
+	{
+		vec3_copy(pipeline->linear_momentum[index], body->linear_momentum);
+		vec3_copy(pipeline->angular_momentum[index], body->angular_momentum);
+		mat3_inverse(pipeline->inv_inertia_body[index], body->inertia_tensor);
+		rbp_internal_world_tensor(pipeline->inv_inertia[index], rot, pipeline->inv_inertia_body[index]);
+	}
+	else
+	{
+		vec3_set(pipeline->linear_momentum[index], 0.0f, 0.0f, 0.0f);
+		vec3_set(pipeline->angular_momentum[index], 0.0f, 0.0f, 0.0f);
+		memset(pipeline->inv_inertia_body[index], 0, sizeof(mat3));
+		memset(pipeline->inv_inertia[index], 0, sizeof(mat3));
+	}
+	vec3_set(pipeline->force[index], 0.0f, 0.0f, 0.0f);
+	vec3_set(pipeline->torque[index], 0.0f, 0.0f, 0.0f);
+	vec3_copy(pipeline->velocity[index], body->velocity);
+	pipeline->inv_mass[index] = (dynamic) ? 1.0f / body->mass : 0.0f;
+	pipeline->margin[index] = body->margin;
+	pipeline->local_box[index] = body->local_box;
+	pipeline->flags[index] = RBP_BODY_ACTIVE 
+		| ((dynamic) ? RBP_BODY_DYNAMIC : 0) 
+		| ((body->fast) ? RBP_BODY_FAST : 0);
+	pipeline->proxy[index] = dbvt_insert(&pipeline->dynamic_tree, index, &proxy);
+
+	pipeline->active[pipeline->count] = index;
+	pipeline->active_index[index] = pipeline->count;
+	pipeline->count += 1;
+	pipeline->rest_frames[index] = 0;
+	if (dynamic)
+	{
+		pipeline->awake[pipeline->awake_count] = index;
+		pipeline->awake_index[index] = pipeline->awake_count;
+		pipeline->awake_count += 1;
+	}
+	pipeline->generation += 1;
+
+	const struct rbp_handle handle = { .index = index, .generation = pipeline->slot_generation[index] };
+	return handle;
+}
+
+/* wake the sleeping bodies overlapping box at the start of the next step, every sleeping body if box is NULL */
+static void rbp_internal_queue_wake(struct rbp *pipeline, const struct AABB *box)
+{
+	if (box && pipeline->wake_count < RBP_WAKE_BOX_MAX)
+	{
+		pipeline->wake_box[pipeline->wake_count] = *box;
+		pipeline->wake_count += 1;
+	}
+	else
+	{
+		pipeline->wake_count = RBP_WAKE_BOX_MAX + 1;
+	}
+}
+
+/* wake whatever the field reaches, so a change of fields is felt by sleeping bodies */
+static void rbp_internal_field_wake(struct rbp *pipeline, const struct rbp_field *field)
+{
+	if (field->type == RBP_FIELD_SPRING)
+	{
+		const i32 body[2] = { field->value.spring.body_1, field->value.spring.body_2 };
+		for (u32 j = 0; j < 2; ++j)
+		{
+			if (body[j] != -1 && (pipeline->flags[body[j]] & RBP_BODY_SLEEPING))
+			{
+				rbp_wake(pipeline, body[j]);
+			}
+		}
+	}
+	else
+	{
+		rbp_internal_queue_wake(pipeline, (field->bounded || field->type == RBP_FIELD_BUOYANCY) ? &field->box : NULL);
+	}
+}
+
+/* remove the field at position index of the packed field array */
+static void rbp_internal_field_remove(struct rbp *pipeline, const u32 index)
+{
+	rbp_internal_field_wake(pipeline, pipeline->field + index);
+	rbp_internal_slot_release(pipeline->field_slot, pipeline->field_index, pipeline->field_generation, index, pipeline->field_count);
+	pipeline->field_count -= 1;
+	pipeline->field[index] = pipeline->field[pipeline->field_count];
+}
+
+/* remove the joint at position index of the packed joint array, waking its bodies */
+static void rbp_internal_joint_remove(struct rbp *pipeline, const u32 index)
+{
+	const struct rbp_joint *joint = pipeline->joint + index;
+	const i32 body[2] = { joint->body_1, joint->body_2 };
+	for (u32 j = 0; j < 2; ++j)
+	{
+		if (body[j] != -1 && (pipeline->flags[body[j]] & RBP_BODY_SLEEPING))
+		{
+			rbp_wake(pipeline, body[j]);
+		}
+	}
+	rbp_internal_slot_release(pipeline->joint_slot, pipeline->joint_index, pipeline->joint_generation, index, pipeline->joint_count);
+	pipeline->joint_count -= 1;
+	pipeline->joint[index] = pipeline->joint[pipeline->joint_count];
+}
+
+static i32 rbp_internal_contact_key(const struct rbp_contact_point *p)
+{
+	const u32 word[5] = { (u32) p->body_1, (u32) p->body_2, (u32) p->child_1, (u32) p->child_2, p->feature };
+	u32 key = 2166136261u;
+	for (u32 i = 0; i < 5; ++i)
+	{
+		key = (key ^ word[i]) * 16777619u;
+	}
+
+	return (i32) key;
+}
+
+/* 
+ * drop the cached contact points of body slot index, moving the last point into each hole, so a reused slot never
+ * inherits impulses while the points of other pairs keep warm starting
+ */
+static void rbp_internal_evict_contacts(struct rbp *pipeline, const i32 index)
+{
+	struct rbp_contact_point *cache = pipeline->contact_cache;
+	for (u32 i = 0; i < pipeline->contact_count; )
+	{
+		if (cache[i].body_1 != index && cache[i].body_2 != index)
+		{
+			i += 1;
+			continue;
+		}
+
+		const u32 last = pipeline->contact_count - 1;
+		hash_remove(pipeline->contact_hash, rbp_internal_contact_key(cache + i), (i32) i);
+		if (i != last)
+		{
+			hash_remove(pipeline->contact_hash, rbp_internal_contact_key(cache + last), (i32) last);
+			cache[i] = cache[last];
+			hash_add(pipeline->contact_hash, rbp_internal_contact_key(cache + i), (i32) i);
+		}
+		pipeline->contact_count = last;
+	}
+}
+
+void rbp_remove(struct rbp *pipeline, const i32 index)
+{
+	assert(index >= 0 && index < pipeline->size);
+	assert(pipeline->flags[index] & RBP_BODY_ACTIVE);
+
+	/* springs attached to the body go with it */
+	for (i32 f = (i32) pipeline->field_count - 1; f >= 0; --f)
+	{
+		const struct rbp_field *field = pipeline->field + f;
+		if (field->type == RBP_FIELD_SPRING && (field->value.spring.body_1 == index || field->value.spring.body_2 == index))
+		{
+			rbp_internal_field_remove(pipeline, (u32) f);
+		}
+	}
+
+	/* and so do its joints */
+	for (i32 j = (i32) pipeline->joint_count - 1; j >= 0; --j)
+	{
+		if (pipeline->joint[j].body_1 == index || pipeline->joint[j].body_2 == index)
+		{
+			rbp_internal_joint_remove(pipeline, (u32) j);
+		}
+	}
+
+	/* bodies resting on the removed one must not stay asleep */
+	rbp_internal_queue_wake(pipeline, &pipeline->dynamic_tree.nodes[pipeline->proxy[index]].box);
+	if (pipeline->awake_index[index] != -1)
+	{
+		rbp_internal_awake_remove(pipeline, index);
+	}
+
+	dbvt_remove(&pipeline->dynamic_tree, pipeline->proxy[index]);
+	vec3_set(pipeline->linear_momentum[index], 0.0f, 0.0f, 0.0f);
+	vec3_set(pipeline->angular_momentum[index], 0.0f, 0.0f, 0.0f);
+	vec3_set(pipeline->velocity[index], 0.0f, 0.0f, 0.0f);
+	pipeline->inv_mass[index] = 0.0f;
+	memset(pipeline->inv_inertia_body[index], 0, sizeof(mat3));
+	memset(pipeline->inv_inertia[index], 0, sizeof(mat3));
+	pipeline->flags[index] = 0;
+
+	const i32 last = pipeline->active[pipeline->count - 1];
+	pipeline->active[pipeline->active_index[index]] = last;
+	pipeline->active_index[last] = pipeline->active_index[index];
+	pipeline->active_index[index] = -1;
+	pipeline->slot_generation[index] += 1;
+	pipeline->count -= 1;
+	pipeline->generation += 1;
+	rbp_internal_evict_contacts(pipeline, index);
+	if (pipeline->bodies[index].shape != -1)
+	{
+		shape_registry_release(&pipeline->shapes, pipeline->bodies[index].shape);
+	}
+}
+
+void rbp_wake(struct rbp *pipeline, const i32 index)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_ACTIVE));
+	if (pipeline->flags[index] & RBP_BODY_SLEEPING)
+	{
+		pipeline->flags[index] &= ~RBP_BODY_SLEEPING;
+		pipeline->rest_frames[index] = 0;
+		pipeline->awake[pipeline->awake_count] = index;
+		pipeline->awake_index[index] = pipeline->awake_count;
+		pipeline->awake_count += 1;
+	}
+}
+
+void rbp_apply_linear_impulse(struct rbp *pipeline, const i32 index, const vec3 impulse)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_DYNAMIC));
+	rbp_wake(pipeline, index);
+	vec3_translate(pipeline->linear_momentum[index], impulse);
+}
+
+void rbp_apply_angular_impulse(struct rbp *pipeline, const i32 index, const vec3 impulse)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_DYNAMIC));
+	rbp_wake(pipeline, index);
+	vec3_translate(pipeline->angular_momentum[index], impulse);
+}
+
+void rbp_apply_force(struct rbp *pipeline, const i32 index, const vec3 force)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_DYNAMIC));
+	rbp_wake(pipeline, index);
+	vec3_translate(pipeline->force[index], force);
+}
+
+void rbp_apply_force_at(struct rbp *pipeline, const i32 index, const vec3 force, const vec3 point)
+{
+	vec3 r, torque;
+	rbp_apply_force(pipeline, index, force);
+	vec3_sub(r, point, pipeline->position[index]);
+	vec3_cross(torque, r, force);
+	vec3_translate(pipeline->torque[index], torque);
+}
+
+void rbp_apply_torque(struct rbp *pipeline, const i32 index, const vec3 torque)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_DYNAMIC));
+	rbp_wake(pipeline, index);
+	vec3_translate(pipeline->torque[index], torque);
+}
+
+struct rbp_handle rbp_field_add(struct rbp *pipeline, const struct rbp_field *field)
+{
+	assert(field->type < RBP_FIELD_COUNT);
+	assert(field->type != RBP_FIELD_SPRING || (pipeline->flags[field->value.spring.body_1] & RBP_BODY_DYNAMIC));
+	if (pipeline->field_count == pipeline->field_size)
 	{
-		pipeline.bodies = arena_push(mem, NULL, size * sizeof(struct rigid_body));	
-		pipeline.dynamic_tree = dbvt_alloc(mem, 2*size);
+		const struct rbp_handle none = { .index = -1, .generation = 0 };
+		return none;
+	}
+
+	pipeline->field[pipeline->field_count] = *field;
+	rbp_internal_field_wake(pipeline, field);
+	const struct rbp_handle handle = rbp_internal_slot_take(pipeline->field_slot, pipeline->field_index, pipeline->field_generation, pipeline->field_count);
+	pipeline->field_count += 1;
+	return handle;
+}
+
+void rbp_field_remove(struct rbp *pipeline, const struct rbp_handle handle)
+{
+	const i32 index = rbp_field_index(pipeline, handle);
+	if (index != -1)
+	{
+		rbp_internal_field_remove(pipeline, (u32) index);
+	}
+}
+
+i32 rbp_field_index(const struct rbp *pipeline, const struct rbp_handle handle)
+{
+	return rbp_internal_slot_resolve(pipeline->field_index, pipeline->field_generation, pipeline->field_size, handle);
+}
+
+/* position and rotation of a joint body, the world frame for -1 */
+static void rbp_internal_joint_frame(vec3 position, quat rotation, const struct rbp *pipeline, const i32 index)
+{
+	if (index == -1)
+	{
+		vec3_set(position, 0.0f, 0.0f, 0.0f);
+		quat_set(rotation, 0.0f, 0.0f, 0.0f, 1.0f);
 	}
 	else
 	{
-		pipeline.bodies = malloc(size * sizeof(struct rigid_body));	
-		pipeline.dynamic_tree = dbvt_alloc(mem, 2*size);
+		vec3_copy(position, pipeline->position[index]);
+		quat_copy(rotation, pipeline->rotation[index]);
+	}
+}
+
+/* v_body = R^T (v_world - t) for points, R^T v_world for directions (t = NULL) */
+static void rbp_internal_to_body_frame(vec3 dst, const quat rotation, const vec3 v, const vec3 translation)
+{
+	mat3 rot;
+	vec3 tmp;
+	quat_to_mat3(rot, rotation);
+	vec3_copy(tmp, v);
+	if (translation)
+	{
+		vec3_sub(tmp, v, translation);
+	}
+	vec3_mat_mul(dst, tmp, rot);
+}
+
+struct rbp_handle rbp_joint_add(struct rbp *pipeline, const enum rbp_joint_type type, const i32 body_1, const i32 body_2, const vec3 anchor_1, const vec3 anchor_2, const vec3 axis)
+{
+	assert(type < RBP_JOINT_COUNT);
+	assert(body_1 >= 0 && body_1 < pipeline->size && (pipeline->flags[body_1] & RBP_BODY_DYNAMIC));
+	assert(body_2 == -1 || (body_2 >= 0 && body_2 < pipeline->size && (pipeline->flags[body_2] & RBP_BODY_ACTIVE)));
+	assert(body_1 != body_2);
+	if (pipeline->joint_count == pipeline->joint_size)
+	{
+		const struct rbp_handle none = { .index = -1, .generation = 0 };
+		return none;
+	}
+
+	vec3 p_1, p_2, a;
+	quat q_1, q_2, q_1_inv;
+	rbp_internal_joint_frame(p_1, q_1, pipeline, body_1);
+	rbp_internal_joint_frame(p_2, q_2, pipeline, body_2);
+	vec3_copy(a, axis);
+	vec3_normalize(a, a);
+
+	struct rbp_joint *joint = pipeline->joint + pipeline->joint_count;
+	memset(joint, 0, sizeof(struct rbp_joint));
+	joint->type = type;
+	joint->body_1 = body_1;
+	joint->body_2 = body_2;
+	rbp_internal_to_body_frame(joint->anchor_1, q_1, anchor_1, p_1);
+	rbp_internal_to_body_frame(joint->anchor_2, q_2, anchor_2, p_2);
+	rbp_internal_to_body_frame(joint->axis_1, q_1, a, NULL);
+	rbp_internal_to_body_frame(joint->axis_2, q_2, a, NULL);
+	quat_conj(q_1_inv, q_1);
+	quat_mult(joint->relative, q_1_inv, q_2);
+	joint->length = vec3_distance(anchor_1, anchor_2);
+
+	rbp_wake(pipeline, body_1);
+	if (body_2 != -1 && (pipeline->flags[body_2] & RBP_BODY_SLEEPING))
+	{
+		rbp_wake(pipeline, body_2);
+	}
+	const struct rbp_handle handle = rbp_internal_slot_take(pipeline->joint_slot, pipeline->joint_index, pipeline->joint_generation, pipeline->joint_count);
+	pipeline->joint_count += 1;
+	return handle;
+}
+
+void rbp_joint_remove(struct rbp *pipeline, const struct rbp_handle handle)
+{
+	const i32 index = rbp_joint_index(pipeline, handle);
+	if (index != -1)
+	{
+		rbp_internal_joint_remove(pipeline, (u32) index);
+	}
+}
+
+i32 rbp_joint_index(const struct rbp *pipeline, const struct rbp_handle handle)
+{
+	return rbp_internal_slot_resolve(pipeline->joint_index, pipeline->joint_generation, pipeline->joint_size, handle);
+}
+
+i32 rbp_handle_index(const struct rbp *pipeline, const struct rbp_handle handle)
+{
+	assert(handle.index >= 0 && handle.index < pipeline->size);
+	return (pipeline->active_index[handle.index] != -1 && pipeline->slot_generation[handle.index] == handle.generation) 
+		? handle.index 
+		: -1;
+}
+
+void rbp_push_dbvt(struct drawbuffer *buf, struct rbp *pipeline, const vec4 color)
+{
+	dbvt_push_lines(buf, &pipeline->dynamic_tree, color);
+}
+
+void rbp_push_proxies(struct drawbuffer *buf, const struct rbp *pipeline, const vec4 color)
+{
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		AABB_push_lines(buf, &pipeline->dynamic_tree.nodes[pipeline->proxy[pipeline->active[k]]].box, color);
+	}
+}
+
+void rbp_push_convex_hulls(const struct rbp *pipeline, struct drawbuffer *buf, const vec4 color, i32 i_count[], i32 i_offset[])
+{
+	const i32 len = (pipeline->size % UNIFORM_SIZE) ? pipeline->size / UNIFORM_SIZE + 1 : pipeline->size / UNIFORM_SIZE;
+	for (i32 i = 0; i < len; ++i)
+	{
+		i_count[i] = 0;
+		i_offset[i] = 0;
+	}
+
+	const void *first = buf->i_buf.stack_ptr;
+
+	for (i32 i = 0; i < pipeline->size; ++i)
+	{
+		const void *before = buf->i_buf.stack_ptr;
+		if (pipeline->flags[i] & RBP_BODY_ACTIVE)
+		{
+			rigid_body_push_meshes(buf, pipeline->bodies + i, color, i);
+		}
+		const void *after = buf->i_buf.stack_ptr;
+		i_count[i / UNIFORM_SIZE] += ((u64) after - (u64) before) / sizeof(i32);
+		if (i % UNIFORM_SIZE == 0)
+		{
+			i_offset[i / UNIFORM_SIZE] = ((u64) before - (u64) first);
+		}
+	}
+}
+
+void rbp_push_positions(void *buf, const struct rbp *pipeline)
+{
+
+}
+
+/* reinsert the proxies of the listed bodies whose world box is no longer contained in their proxy */
+static void rbp_internal_update_proxies(struct rbp *pipeline, const i32 *list, const i32 count)
+{
+	struct AABB world_AABB;
+	mat3 rot;
+	for (i32 k = 0; k < count; ++k)
+	{
+		const i32 i = list[k];
+		quat_to_mat3(rot, pipeline->rotation[i]);
+		AABB_transform(&world_AABB, pipeline->local_box + i, rot, pipeline->position[i]);
+		const struct AABB *proxy = &pipeline->dynamic_tree.nodes[pipeline->proxy[i]].box;
+		if (!AABB_contains(proxy, &world_AABB))
+		{
+			world_AABB.hw[0] += pipeline->margin[i];
+			world_AABB.hw[1] += pipeline->margin[i];
+			world_AABB.hw[2] += pipeline->margin[i];
+			dbvt_remove(&pipeline->dynamic_tree, pipeline->proxy[i]);
+			pipeline->proxy[i] = dbvt_insert(&pipeline->dynamic_tree, i, &world_AABB);
+		}
+	}
+}
+
+static void internal_update_bodies(struct rbp *pipeline, const f32 delta)
+{
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		const i32 i = pipeline->active[k];
+		vec3_translate_scaled(pipeline->position[i], pipeline->velocity[i], delta);
+	}
+
+	rbp_internal_update_proxies(pipeline, pipeline->active, pipeline->count);
+}
+
+static i32 internal_push_proxy_overlaps(struct arena *mem_frame, struct rbp *pipeline)
+{
+	return dbvt_push_overlap_pairs(mem_frame, &pipeline->dynamic_tree);
+}
+
+/* body frame -> world frame rotation matrices for the narrowphase, computed once per stage instead of per pair */
+static mat3 *internal_push_rotations(struct arena *mem_frame, const struct rbp *pipeline)
+{
+	mat3 *rot = arena_push(mem_frame, NULL, sizeof(mat3)*pipeline->size);
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		const i32 i = pipeline->active[k];
+		quat_to_mat3(rot[i], pipeline->rotation[i]);
+	}
+
+	return rot;
+}
+
+/* sort key: total vertex count in high bits, overlap index in low bits */
+static i32 internal_pair_cost_compare(const void *a, const void *b)
+{
+	const u64 k_1 = *((const u64 *) a);
+	const u64 k_2 = *((const u64 *) b);
+	return (k_1 < k_2) ? -1 : 1;
+}
+
+/* collision hull of a child, child == -1 being the collision hull of the body itself */
+static const struct tri_mesh *rbp_internal_child_hull(const struct rigid_body *b, const i32 child)
+{
+	return (child == -1) ? &b->collision : b->compound->child + child;
+}
+
+/*
+ * Push the child pairs (c_1, c_2) of two bodies whose child boxes overlap when grown by margin, single hull bodies
+ * taking part as child -1. Culling runs in the body frame of b1: the child tree of b2 (or its local box) is taken
+ * into it, so neither tree is rebuilt as the bodies move. Returns number of pairs.
+ */
+static i32 rbp_internal_push_child_pairs(struct arena *mem, const struct rbp *pipeline, const i32 i_1, mat3 rot_1, const i32 i_2, mat3 rot_2, const f32 margin)
+{
+	const struct rigid_body *b1 = pipeline->bodies + i_1;
+	const struct rigid_body *b2 = pipeline->bodies + i_2;
+	if (!b1->compound && !b2->compound)
+	{
+		const i32 pair[2] = { -1, -1 };
+		arena_push_packed(mem, pair, sizeof(pair));
+		return 1;
+	}
+
+	const struct rigid_body *b[2] = { b1, b2 };
+	const i32 index[2] = { i_1, i_2 };
+	struct dbvt_node leaf[2];
+	struct dbvt single[2];
+	const struct dbvt *tree[2];
+	for (u32 k = 0; k < 2; ++k)
+	{
+		if (b[k]->compound)
+		{
+			tree[k] = &b[k]->compound->tree;
+		}
+		else
+		{
+			leaf[k].box = pipeline->local_box[index[k]];
+			leaf[k].id = -1;
+			leaf[k].parent = DBVT_NO_NODE;
+			leaf[k].left = DBVT_NO_NODE;
+			leaf[k].right = DBVT_NO_NODE;
+			single[k].nodes = leaf + k;
+			single[k].root = 0;
+			single[k].proxy_count = 1;
+			tree[k] = single + k;
+		}
+	}
+
+	/* body 2 frame -> body 1 frame */
+	mat3 rot;
+	vec3 pos, diff;
+	for (u32 j = 0; j < 3; ++j)
+	{
+		vec3_mat_mul(rot[j], rot_2[j], rot_1);
+	}
+	vec3_sub(diff, pipeline->position[i_2], pipeline->position[i_1]);
+	vec3_mat_mul(pos, diff, rot_1);
+
+	return dbvt_push_transformed_overlap_pairs(mem, tree[0], tree[1], rot, pos, margin);
+}
+
+/* neither body can move, and at least one of them is sleeping */
+static u32 rbp_internal_pair_at_rest(const struct rbp *pipeline, const i32 i_1, const i32 i_2)
+{
+	return pipeline->awake_index[i_1] == -1 && pipeline->awake_index[i_2] == -1 
+		&& ((pipeline->flags[i_1] | pipeline->flags[i_2]) & RBP_BODY_SLEEPING);
+}
+
+static i32 *internal_push_collisions(struct arena *mem_frame, struct rbp *pipeline, i32 *overlaps, const i32 overlap_count)
+{
+	i32 *collisions = arena_push_packed(mem_frame, NULL, sizeof(i32)*pipeline->size);
+	for (i32 i = 0; i < pipeline->size; ++i) { collisions[i] = 0; }
+	if (overlap_count == 0) { return collisions; }
+
+	struct arena record = *mem_frame;
+	mat3 *rot = internal_push_rotations(mem_frame, pipeline);
+
+	/*
+	 * pairs at rest are skipped, then a bounding sphere pre-reject; the remaining body pairs are expanded into child pairs, so that only the 
+	 * children of compound bodies with overlapping boxes go through GJK. first[o] is the first child pair of 
+	 * overlap o.
+	 */
+	u32 *first = arena_push(mem_frame, NULL, sizeof(u32)*(overlap_count + 1));
+	const i32 *child = (i32 *) mem_frame->stack_ptr;
+	const struct rigid_body *b1, *b2;
+	struct sphere s_1, s_2;
+	i32 pair_count = 0;
+	for (i32 i = 0; i < overlap_count; ++i)
+	{
+		first[i] = pair_count;
+		const i32 i_1 = overlaps[2*i];
+		const i32 i_2 = overlaps[2*i+1];
+		if (rbp_internal_pair_at_rest(pipeline, i_1, i_2))
+		{
+			continue;
+		}
+
+		rigid_body_world_sphere(&s_1, pipeline->bodies + i_1, pipeline->position[i_1], rot[i_1]);
+		rigid_body_world_sphere(&s_2, pipeline->bodies + i_2, pipeline->position[i_2], rot[i_2]);
+		if (sphere_test(&s_1, &s_2))
+		{
+			pair_count += rbp_internal_push_child_pairs(mem_frame, pipeline, i_1, rot[i_1], i_2, rot[i_2], 0.0f);
+		}
+	}
+	first[overlap_count] = pair_count;
+
+	if (pair_count == 0)
+	{
+		*mem_frame = record;
+		return collisions;
+	}
+
+	/* 
+	 * Group the child pairs by vertex count before running the batched GJK test, so that pairs
+	 * sharing a batch do about the same amount of support mapping work and few lanes sit masked out.
+	 */
+	u64 *keys = arena_push(mem_frame, NULL, sizeof(u64)*pair_count);
+	u32 *owner = arena_push(mem_frame, NULL, sizeof(u32)*pair_count);
+	struct gjk_pair *pairs = arena_push(mem_frame, NULL, sizeof(struct gjk_pair)*pair_count);
+	u32 *result = arena_push(mem_frame, NULL, sizeof(u32)*pair_count);
+
+	for (i32 o = 0; o < overlap_count; ++o)
+	{
+		b1 = pipeline->bodies + overlaps[2*o];
+		b2 = pipeline->bodies + overlaps[2*o+1];
+		for (u32 i = first[o]; i < first[o+1]; ++i)
+		{
+			owner[i] = o;
+			const u32 cost = rbp_internal_child_hull(b1, child[2*i])->v_count + rbp_internal_child_hull(b2, child[2*i+1])->v_count;
+			keys[i] = ((u64) cost << 32) | (u64) i;
+		}
+	}
+	mergesort(mem_frame, keys, pair_count, sizeof(u64), &internal_pair_cost_compare);
+
+	for (i32 i = 0; i < pair_count; ++i)
+	{
+		const u32 k = (u32) keys[i];
+		const u32 o = owner[k];
+		b1 = pipeline->bodies + overlaps[2*o];
+		b2 = pipeline->bodies + overlaps[2*o+1];
+		const struct tri_mesh *h1 = rbp_internal_child_hull(b1, child[2*k]);
+		const struct tri_mesh *h2 = rbp_internal_child_hull(b2, child[2*k+1]);
+		pairs[i].pos_1 = pipeline->position[overlaps[2*o]];
+		pairs[i].pos_2 = pipeline->position[overlaps[2*o+1]];
+		pairs[i].rot_1 = rot[overlaps[2*o]];
+		pairs[i].rot_2 = rot[overlaps[2*o+1]];
+		pairs[i].vs_1 = h1->v;
+		pairs[i].vs_2 = h2->v;
+		pairs[i].n_1 = h1->v_count;
+		pairs[i].n_2 = h2->v_count;
+
+		/* the body spheres bound every child, so they bound the extent of the child pair as well */
+		rigid_body_world_sphere(&s_1, b1, pipeline->position[overlaps[2*o]], rot[overlaps[2*o]]);
+		rigid_body_world_sphere(&s_2, b2, pipeline->position[overlaps[2*o+1]], rot[overlaps[2*o+1]]);
+		pairs[i].abs_tol = GJK_tolerance(&s_1, &s_2, 100.0f*FLT_EPSILON);
+	}
+
+	GJK_test_batch(result, pairs, pair_count);
+
+	for (i32 i = 0; i < pair_count; ++i)
+	{
+		if (result[i])
+		{
+			const u32 o = owner[(u32) keys[i]];
+			collisions[overlaps[2*o]] = 1;
+			collisions[overlaps[2*o+1]] = 1;
+		}
+	}
+
+	*mem_frame = record;
+	return collisions;
+}
+
+vec3ptr rbp_push_closest_points_between_bodies(struct arena *mem_frame, struct rbp *pipeline, u32 *pair_count)
+{
+	*pair_count = 0;
+	struct rigid_body *b1, *b2;
+	vec3ptr point_pairs = arena_push(mem_frame, NULL, 2*sizeof(vec3)*pipeline->size*(pipeline->size-1)/2);
+	mat3 *rot = internal_push_rotations(mem_frame, pipeline);
+
+	for (i32 i = 0; i < pipeline->size; ++i)
+	{
+		b1 = pipeline->bodies + i;
+		for (i32 j = i+1; j < pipeline->size; ++j)
+		{
+			b2 = pipeline->bodies + j;
+			if (!(pipeline->flags[i] & pipeline->flags[j] & RBP_BODY_ACTIVE))
+			{
+				continue;
+			}
+
+			struct sphere s_1, s_2;
+			rigid_body_world_sphere(&s_1, b1, pipeline->position[i], rot[i]);
+			rigid_body_world_sphere(&s_2, b2, pipeline->position[j], rot[j]);
+			if (!sphere_test(&s_1, &s_2))
+			{
+				continue;
+			}
+
+			struct contact_manifold c_m;
+			const f32 abs_tol = GJK_tolerance(&s_1, &s_2, 100.0f*FLT_EPSILON);
+			if (GJK_EPA(mem_frame, &c_m, pipeline->position[i], rot[i], b1->collision.v, b1->collision.v_count, pipeline->position[j], rot[j], b2->collision.v, b2->collision.v_count, 0.001f, abs_tol))
+			//if (GJK_distance(point_pairs[2*(*pair_count)], point_pairs[2*(*pair_count) + 1],
+			//			b1->position, b1->v, b1->v_count, b2->position, b2->v, b2->v_count, 0.001f, 100.0f*FLT_EPSILON) > 0.0f)
+			{
+				printf("PENETRATION_DEPTH: %f\n", c_m.penetration_depth);
+				vec3 pen_dir;
+				vec3_sub(pen_dir, c_m.p_1, c_m.p_2);
+				vec3_translate(pipeline->position[j], pen_dir);
+				vec3_copy(point_pairs[2*(*pair_count)], c_m.p_1);
+				vec3_copy(point_pairs[2*(*pair_count) + 1], c_m.p_2);
+				*pair_count += 1;
+			}
+		}
+	}
+
+	return point_pairs;
+}
+
+i32 rbp_push_bodies_within(struct arena *mem, struct rbp *pipeline, const i32 index, const f32 max_dist)
+{
+	assert(index >= 0 && index < pipeline->size && (pipeline->flags[index] & RBP_BODY_ACTIVE));
+
+	const struct rigid_body *b = pipeline->bodies + index;
+	struct AABB box = pipeline->dynamic_tree.nodes[pipeline->proxy[index]].box;
+	box.hw[0] += max_dist;
+	box.hw[1] += max_dist;
+	box.hw[2] += max_dist;
+
+	/* candidates are overwritten in place by the bodies passing the narrowphase query */
+	i32 *candidates = (i32 *) mem->stack_ptr;
+	const i32 candidate_count = dbvt_push_box_overlaps(mem, &pipeline->dynamic_tree, &box);
+
+	mat3 rot, rot_other;
+	struct sphere s, s_other;
+	quat_to_mat3(rot, pipeline->rotation[index]);
+	rigid_body_world_sphere(&s, b, pipeline->position[index], rot);
+	i32 count = 0;
+	for (i32 i = 0; i < candidate_count; ++i)
+	{
+		const i32 j = candidates[i];
+		const struct rigid_body *other = pipeline->bodies + j;
+		if (j == index || !(pipeline->flags[j] & RBP_BODY_ACTIVE))
+		{
+			continue;
+		}
+
+		quat_to_mat3(rot_other, pipeline->rotation[j]);
+		rigid_body_world_sphere(&s_other, other, pipeline->position[j], rot_other);
+		if (sphere_distance(&s, &s_other) > max_dist)
+		{
+			continue;
+		}
+
+		const f32 abs_tol = GJK_tolerance(&s, &s_other, 100.0f*FLT_EPSILON);
+		struct arena record = *mem;
+		const i32 *child = (i32 *) mem->stack_ptr;
+		const i32 pair_count = rbp_internal_push_child_pairs(mem, pipeline, index, rot, j, rot_other, max_dist);
+		for (i32 k = 0; k < pair_count; ++k)
+		{
+			const struct tri_mesh *h = rbp_internal_child_hull(b, child[2*k]);
+			const struct tri_mesh *h_other = rbp_internal_child_hull(other, child[2*k+1]);
+			if (GJK_distance_within(pipeline->position[index], rot, h->v, h->v_count, pipeline->position[j], rot_other, h_other->v, h_other->v_count, max_dist, 0.001f, abs_tol))
+			{
+				candidates[count++] = j;
+				break;
+			}
+		}
+		*mem = record;
+	}
+
+	arena_pop_packed(mem, (candidate_count - count) * sizeof(i32));
+	return count;
+}
+
+i32 *rbp_simulate(struct arena *mem_frame, struct rbp *pipeline, const f32 delta)
+{
+	internal_update_bodies(pipeline, delta);
+
+	i32 *overlaps = (i32 *) mem_frame->stack_ptr;
+	i32 overlap_pairs_count = internal_push_proxy_overlaps(mem_frame, pipeline);
+	i32 *collisions = internal_push_collisions(mem_frame, pipeline, overlaps, overlap_pairs_count);
+
+	return collisions;
+}
+
+static void rbp_internal_random_points(vec3ptr v, const u32 v_count, const f32 radius, const vec3 pos)
+{
+	for (u32 j = 0; j < v_count; ++j)
+	{
+		const f32 u1 = gen_continuous_uniform_f(0.0f, 1.0f);
+		const f32 u2 = gen_continuous_uniform_f(0.0f, 1.0f);
+		const f32 phi = acosf(2*u1 - 1.0f) - MM_PI_F / 2.0f;
+		const f32 lambda = 2*MM_PI_F*u2;
+		vec3_set(v[j]
+				,pos[0] + radius*cosf(phi)*cosf(lambda)
+				,pos[1] + radius*cosf(phi)*sinf(lambda)
+				,pos[2] + radius*sinf(phi));
+	}
+}
+
+static void rbp_internal_random_body_add(struct arena *mem, struct arena *scratch, struct rbp *pipeline, const u64 index, struct tri_mesh *mesh)
+{
+	struct rigid_body body;
+	vec3_set(body.velocity, 0.0f, 0.0f, 0.0f);
+	vec3_set(body.linear_momentum, 0.0f, 0.0f, 0.0f);
+	body.fast = 1;
+	//vec3_set(body.velocity, 
+	//	gen_continuous_uniform_f(-1.0f, 1.0f),
+	//	gen_continuous_uniform_f(-1.0f, 1.0f),
+	//	gen_continuous_uniform_f(-1.0f, 1.0f));
+	//vec3_mul_constant(body.velocity, 1.0f / vec3_length(body.velocity));
+	vec3_set(body.position, 0.0f, 0.0f, 0.0f);
+
+	/* TODO:
+	 * (O) generate hull
+	 * (O) generate statics
+	 * () generate dynamics 
+	 */
+	const f32 density = 1.0;
+	const i32 shape = shape_registry_add(&pipeline->shapes, mem, scratch, mesh);
+	assert(shape != -1);
+	rigid_body_set_shape(&body, &pipeline->shapes, shape, density);
+
+	body.margin = 1.00f;
+	rbp_add(pipeline, index, &body, 1);
+}
+
+void rbp_construct_random(struct arena *mem, struct rbp *pipeline, const u64 index, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena_collection *mem_tmp, const vec3 pos)
+{
+	assert(mem_tmp->arena_count >= 5);
+
+	const f32 radius = gen_continuous_uniform_f(min_radius, max_radius);
+	const f32 t1 = gen_rand_f();
+	const f32 t2 = gen_rand_f();
+
+	struct arena record = mem_tmp->arenas[4];
+	u32 v_count = (u32) gen_continuous_uniform_f(min_v_count, (f32) max_v_count + 0.99f); 
+	vec3ptr v = arena_push_packed(&mem_tmp->arenas[4], NULL, v_count * sizeof(vec3));
+	rbp_internal_random_points(v, v_count, radius, pos);
+
+	/* the registry keeps its own copy of the hull */
+	struct tri_mesh mesh = convex_hull_construct(&mem_tmp->arenas[4], mem_tmp->arenas + 0, v, v_count, 100.0f * FLT_EPSILON);
+	rbp_internal_random_body_add(mem, mem_tmp->arenas + 0, pipeline, index, &mesh);
+
+	mem_tmp->arenas[4] = record;
+}
+
+void rbp_construct_random_batch(struct arena *mem, struct rbp *pipeline, const u64 *index, const vec3ptr pos, const u32 count, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena *mem_tmp, const u32 thread_count)
+{
+	struct arena record = *mem_tmp;
+	vec3ptr *v = arena_push(mem_tmp, NULL, count * sizeof(vec3ptr));
+	u32 *v_count = arena_push(mem_tmp, NULL, count * sizeof(u32));
+	struct tri_mesh *meshes = arena_push(mem_tmp, NULL, count * sizeof(struct tri_mesh));
+
+	/* random draws in the same order as repeated rbp_construct_random calls */
+	for (u32 i = 0; i < count; ++i)
+	{
+		const f32 radius = gen_continuous_uniform_f(min_radius, max_radius);
+		const f32 t1 = gen_rand_f();
+		const f32 t2 = gen_rand_f();
+
+		v_count[i] = (u32) gen_continuous_uniform_f(min_v_count, (f32) max_v_count + 0.99f); 
+		v[i] = arena_push_packed(mem_tmp, NULL, v_count[i] * sizeof(vec3));
+		rbp_internal_random_points(v[i], v_count[i], radius, pos[i]);
+	}
+
+	convex_hull_construct_batch(mem_tmp, meshes, v, v_count, count, 100.0f * FLT_EPSILON, thread_count);
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		rbp_internal_random_body_add(mem, mem_tmp, pipeline, index[i], meshes + i);
+	}
+
+	*mem_tmp = record;
+}
+
+/* v = L / m, zero for static bodies */
+static void rbp_internal_body_velocity(vec3 velocity, const struct rbp *pipeline, const i32 index)
+{
+	vec3_scale(velocity, pipeline->linear_momentum[index], pipeline->inv_mass[index]);
+}
+
+/*
+ * Continuous collision step: every fast body moving further than its smallest half-width during the step is swept
+ * against the proxies overlapping its swept bounding box, and its step is cut short at the earliest time of impact.
+ * Returns the time each active body is allowed to move this step.
+ */
+static f32 *rbp_internal_continuous_collision(struct arena *mem_frame, struct rbp *pipeline, const f32 delta)
+{
+	f32 *step = arena_push_packed(mem_frame, NULL, sizeof(f32)*pipeline->size);
+	mat3 *rot = internal_push_rotations(mem_frame, pipeline);
+	vec3 velocity, velocity_other, relative, displacement;
+	struct AABB box_start, box_end, swept;
+	const u32 swept_flags = RBP_BODY_ACTIVE | RBP_BODY_DYNAMIC | RBP_BODY_FAST;
+
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		const i32 i = pipeline->active[k];
+		step[i] = delta;
+		if ((pipeline->flags[i] & swept_flags) != swept_flags)
+		{
+			continue;
+		}
+
+		const struct rigid_body *b = pipeline->bodies + i;
+		const struct AABB *local_box = pipeline->local_box + i;
+		rbp_internal_body_velocity(velocity, pipeline, i);
+		vec3_scale(displacement, velocity, delta);
+		const f32 min_hw = fminf(local_box->hw[0], fminf(local_box->hw[1], local_box->hw[2]));
+		if (vec3_length(displacement) <= min_hw)
+		{
+			continue;
+		}
+
+		AABB_transform(&box_start, local_box, rot[i], pipeline->position[i]);
+		vec3_add(box_end.center, box_start.center, displacement);
+		vec3_copy(box_end.hw, box_start.hw);
+		AABB_union(&swept, &box_start, &box_end);
+
+		struct arena record = *mem_frame;
+		const i32 *candidates = (i32 *) mem_frame->stack_ptr;
+		const i32 candidate_count = dbvt_push_box_overlaps(mem_frame, &pipeline->dynamic_tree, &swept);
+		for (i32 j = 0; j < candidate_count; ++j)
+		{
+			const i32 o = candidates[j];
+			const struct rigid_body *other = pipeline->bodies + o;
+			if (o == i || !(pipeline->flags[o] & RBP_BODY_ACTIVE))
+			{
+				continue;
+			}
+
+			/* children can only meet if their boxes are within the relative displacement of the step */
+			rbp_internal_body_velocity(velocity_other, pipeline, o);
+			vec3_sub(relative, velocity, velocity_other);
+			const f32 sweep = vec3_length(relative) * step[i];
+
+			struct arena pair_record = *mem_frame;
+			const i32 *child = (i32 *) mem_frame->stack_ptr;
+			const i32 pair_count = rbp_internal_push_child_pairs(mem_frame, pipeline, i, rot[i], o, rot[o], sweep);
+			for (i32 k = 0; k < pair_count; ++k)
+			{
+				const struct tri_mesh *h = rbp_internal_child_hull(b, child[2*k]);
+				const struct tri_mesh *h_other = rbp_internal_child_hull(other, child[2*k+1]);
+				const f32 toi = GJK_time_of_impact(pipeline->position[i], rot[i], velocity, h->v, h->v_count, pipeline->position[o], rot[o], velocity_other, h_other->v, h_other->v_count, step[i], 0.01f*min_hw);
+				if (toi < step[i])
+				{
+					step[i] = toi;
+				}
+			}
+			*mem_frame = pair_record;
+		}
+		*mem_frame = record;
+	}
+
+	return step;
+}
+
+/* 
+ * the packed awake bodies a force field acts on this step, see struct rbp_linear_state; the body lists of bounded
+ * fields come from the dynamic tree, so a field only costs for the bodies inside it
+ */
+struct rbp_field_batch
+{
+	const struct rbp_field *field;
+	i32 *body;		/* packed body indices, NULL if the field acts on every packed body; springs: both ends, -1 if fixed */
+	i32 count;
+	f32 *volume;		/* buoyancy: body volume */
+	f32 *offset;		/* buoyancy: height of the world box center above the center of mass */
+	f32 *extent;		/* buoyancy: world box half height */
+	vec3 anchor;		/* spring: the fixed end if body[1] is -1 */
+};
+
+/* linear state of the awake bodies packed in awake list order, body k at [3k, 3k + 3) */
+struct rbp_linear_state
+{
+	f32 *x;
+	f32 *p;			/* L = mv */
+	f32 *inv_mass;
+	f32 *h;			/* time body k moves this step, see rbp_internal_continuous_collision */
+	f32 *force;		/* accumulated force, constant over the step */
+	struct rbp_field_batch *batch;
+	u32 batch_count;
+	i32 count;
+};
+
+/* wake the sleeping end of pair i_1, i_2 if the other end is awake, -1 is the world */
+static void rbp_internal_wake_pair(struct rbp *pipeline, const i32 i_1, const i32 i_2)
+{
+	if (i_1 == -1 || i_2 == -1)
+	{
+		return;
+	}
+
+	if (pipeline->awake_index[i_1] != -1 && (pipeline->flags[i_2] & RBP_BODY_SLEEPING))
+	{
+		rbp_wake(pipeline, i_2);
+	}
+	else if (pipeline->awake_index[i_2] != -1 && (pipeline->flags[i_1] & RBP_BODY_SLEEPING))
+	{
+		rbp_wake(pipeline, i_1);
+	}
+}
+
+/* 
+ * wake the sleeping end of springs and joints with an awake end, so neither pulls on a body the integrator skips;
+ * woken bodies may wake further joints, so the pass repeats until nothing changes
+ */
+static void rbp_internal_wake_connected(struct rbp *pipeline)
+{
+	for (u32 f = 0; f < pipeline->field_count; ++f)
+	{
+		const struct rbp_field *field = pipeline->field + f;
+		if (field->type == RBP_FIELD_SPRING)
+		{
+			rbp_internal_wake_pair(pipeline, field->value.spring.body_1, field->value.spring.body_2);
+		}
+	}
+
+	i32 awake_count = -1;
+	while (awake_count != pipeline->awake_count)
+	{
+		awake_count = pipeline->awake_count;
+		for (u32 j = 0; j < pipeline->joint_count; ++j)
+		{
+			rbp_internal_wake_pair(pipeline, pipeline->joint[j].body_1, pipeline->joint[j].body_2);
+		}
+	}
+}
+
+/* 
+ * Push the field batches of the step onto mem and sum the angular drag of every packed body into angular_drag.
+ * Buoyancy uses the world boxes at the start of the step and takes the y axis as up.
+ */
+static void rbp_internal_push_field_batches(struct arena *mem, const struct rbp *pipeline, struct rbp_linear_state *state, f32 *angular_drag)
+{
+	state->batch = (pipeline->field_count) ? arena_push(mem, NULL, pipeline->field_count * sizeof(struct rbp_field_batch)) : NULL;
+	state->batch_count = 0;
+	for (i32 k = 0; k < state->count; ++k)
+	{
+		angular_drag[k] = 0.0f;
+	}
+
+	mat3 rot;
+	struct AABB world_box;
+	for (u32 f = 0; f < pipeline->field_count; ++f)
+	{
+		const struct rbp_field *field = pipeline->field + f;
+		struct rbp_field_batch *b = state->batch + state->batch_count;
+		b->field = field;
+		b->body = NULL;
+		b->count = state->count;
+
+		if (field->type == RBP_FIELD_SPRING)
+		{
+			const i32 i_1 = field->value.spring.body_1;
+			const i32 i_2 = field->value.spring.body_2;
+			if (pipeline->awake_index[i_1] == -1 && (i_2 == -1 || pipeline->awake_index[i_2] == -1))
+			{
+				continue;
+			}
+
+			b->body = arena_push(mem, NULL, 2 * sizeof(i32));
+			b->body[0] = pipeline->awake_index[i_1];
+			b->body[1] = (i_2 != -1) ? pipeline->awake_index[i_2] : -1;
+			b->count = 2;
+			vec3_copy(b->anchor, (i_2 == -1) ? field->value.spring.anchor : pipeline->position[i_2]);
+			if (b->body[0] == -1)
+			{
+				/* keep the moving end first */
+				b->body[0] = b->body[1];
+				b->body[1] = -1;
+				vec3_copy(b->anchor, pipeline->position[i_1]);
+			}
+		}
+		else if (field->bounded || field->type == RBP_FIELD_BUOYANCY)
+		{
+			/* slots of the proxies in the box, compacted in place into packed indices of awake bodies */
+			b->body = (i32 *) mem->stack_ptr;
+			const i32 overlap_count = dbvt_push_box_overlaps(mem, &pipeline->dynamic_tree, &field->box);
+			b->count = 0;
+			for (i32 j = 0; j < overlap_count; ++j)
+			{
+				const i32 k = pipeline->awake_index[b->body[j]];
+				if (k != -1)
+				{
+					b->body[b->count++] = k;
+				}
+			}
+
+			if (b->count == 0)
+			{
+				continue;
+			}
+		}
+
+		if (field->type == RBP_FIELD_BUOYANCY)
+		{
+			b->volume = arena_push(mem, NULL, b->count * sizeof(f32));
+			b->offset = arena_push(mem, NULL, b->count * sizeof(f32));
+			b->extent = arena_push(mem, NULL, b->count * sizeof(f32));
+			for (i32 n = 0; n < b->count; ++n)
+			{
+				const i32 i = pipeline->awake[b->body[n]];
+				quat_to_mat3(rot, pipeline->rotation[i]);
+				AABB_transform(&world_box, pipeline->local_box + i, rot, pipeline->position[i]);
+				b->volume[n] = pipeline->bodies[i].volume;
+				b->offset[n] = world_box.center[1] - pipeline->position[i][1];
+				b->extent[n] = world_box.hw[1];
+			}
+		}
+		else if (field->type == RBP_FIELD_DRAG)
+		{
+			for (i32 n = 0; n < b->count; ++n)
+			{
+				angular_drag[(b->body) ? b->body[n] : n] += field->value.drag.angular;
+			}
+		}
+
+		state->batch_count += 1;
+	}
+}
+
+/* force on every packed body in the state (x, p): gravity, the accumulated force and one pass per field batch */
+static void rbp_internal_forces(f32 *force, const struct rbp *pipeline, const struct rbp_linear_state *state, const f32 *x, const f32 *p)
+{
+	for (i32 k = 0; k < state->count; ++k)
+	{
+		const f32 m = 1.0f / state->inv_mass[k];
+		force[3*k + 0] = pipeline->gravity[0] * m + state->force[3*k + 0];
+		force[3*k + 1] = pipeline->gravity[1] * m + state->force[3*k + 1];
+		force[3*k + 2] = pipeline->gravity[2] * m + state->force[3*k + 2];
+	}
+
+	vec3 d, v, f;
+	for (u32 j = 0; j < state->batch_count; ++j)
+	{
+		const struct rbp_field_batch *b = state->batch + j;
+		const union rbp_field_value *value = &b->field->value;
+		switch (b->field->type)
+		{
+			case RBP_FIELD_UNIFORM:
+			{
+				for (i32 n = 0; n < b->count; ++n)
+				{
+					const i32 k = (b->body) ? b->body[n] : n;
+					vec3_translate_scaled(force + 3*k, value->uniform.acceleration, 1.0f / state->inv_mass[k]);
+				}
+			} break;
+
+			case RBP_FIELD_ATTRACTOR:
+			{
+				for (i32 n = 0; n < b->count; ++n)
+				{
+					const i32 k = (b->body) ? b->body[n] : n;
+					vec3_sub(d, value->attractor.point, x + 3*k);
+					const f32 dist = vec3_length(d);
+					if (dist > 0.0f)
+					{
+						const f32 r = fmaxf(dist, value->attractor.min_distance);
+						vec3_translate_scaled(force + 3*k, d, value->attractor.strength / (r * r * dist * state->inv_mass[k]));
+					}
+				}
+			} break;
+
+			case RBP_FIELD_DRAG:
+			{
+				for (i32 n = 0; n < b->count; ++n)
+				{
+					const i32 k = (b->body) ? b->body[n] : n;
+					vec3_scale(v, p + 3*k, state->inv_mass[k]);
+					const f32 c = value->drag.linear + value->drag.quadratic * vec3_length(v);
+					vec3_translate_scaled(force + 3*k, v, -c);
+				}
+			} break;
+
+			case RBP_FIELD_BUOYANCY:
+			{
+				const f32 surface = b->field->box.center[1] + b->field->box.hw[1];
+				for (i32 n = 0; n < b->count; ++n)
+				{
+					const i32 k = b->body[n];
+					const f32 bottom = x[3*k + 1] + b->offset[n] - b->extent[n];
+					const f32 depth = fminf(fmaxf(surface - bottom, 0.0f), 2.0f * b->extent[n]);
+					const f32 fraction = (b->extent[n] > 0.0f) ? depth / (2.0f * b->extent[n]) : 0.0f;
+					vec3_translate_scaled(force + 3*k, pipeline->gravity, -value->buoyancy.density * b->volume[n] * fraction);
+					vec3_scale(v, p + 3*k, state->inv_mass[k]);
+					vec3_translate_scaled(force + 3*k, v, -value->buoyancy.drag * fraction);
+				}
+			} break;
+
+			case RBP_FIELD_SPRING:
+			{
+				/* f on the first end, -f on the second */
+				const i32 k_1 = b->body[0];
+				const i32 k_2 = b->body[1];
+				vec3_scale(v, p + 3*k_1, state->inv_mass[k_1]);
+				if (k_2 != -1)
+				{
+					vec3_sub(d, x + 3*k_1, x + 3*k_2);
+					vec3_translate_scaled(v, p + 3*k_2, -state->inv_mass[k_2]);
+				}
+				else
+				{
+					vec3_sub(d, x + 3*k_1, b->anchor);
+				}
+
+				const f32 length = vec3_length(d);
+				if (length > 0.0f)
+				{
+					vec3_mul_constant(d, 1.0f / length);
+					const f32 magnitude = value->spring.stiffness * (length - value->spring.rest_length) + value->spring.damping * vec3_dot(v, d);
+					vec3_scale(f, d, -magnitude);
+					vec3_translate(force + 3*k_1, f);
+					if (k_2 != -1)
+					{
+						vec3_translate_scaled(force + 3*k_2, f, -1.0f);
+					}
+				}
+			} break;
+		}
+	}
+}
+
+/* x_new = x + (p / m) * h, p_new = p + F(x, p) * h */
+static void rbp_internal_integrate_euler(struct arena *mem, const struct rbp *pipeline, struct rbp_linear_state *state)
+{
+	f32 *force = arena_push(mem, NULL, 3 * state->count * sizeof(f32));
+	rbp_internal_forces(force, pipeline, state, state->x, state->p);
+	for (i32 j = 0; j < 3*state->count; ++j)
+	{
+		const i32 k = j / 3;
+		state->x[j] += state->p[j] * state->inv_mass[k] * state->h[k];
+		state->p[j] += force[j] * state->h[k];
+	}
+}
+
+/* p_new = p + F(x, p) * h, x_new = x + (p_new / m) * h */
+static void rbp_internal_integrate_symplectic_euler(struct arena *mem, const struct rbp *pipeline, struct rbp_linear_state *state)
+{
+	f32 *force = arena_push(mem, NULL, 3 * state->count * sizeof(f32));
+	rbp_internal_forces(force, pipeline, state, state->x, state->p);
+	for (i32 j = 0; j < 3*state->count; ++j)
+	{
+		const i32 k = j / 3;
+		state->p[j] += force[j] * state->h[k];
+		state->x[j] += state->p[j] * state->inv_mass[k] * state->h[k];
+	}
+}
+
+/* p_half = p + F(x, p) * h/2, x_new = x + (p_half / m) * h, p_new = p_half + F(x_new, p_half) * h/2 */
+static void rbp_internal_integrate_verlet(struct arena *mem, const struct rbp *pipeline, struct rbp_linear_state *state)
+{
+	f32 *force = arena_push(mem, NULL, 3 * state->count * sizeof(f32));
+	rbp_internal_forces(force, pipeline, state, state->x, state->p);
+	for (i32 j = 0; j < 3*state->count; ++j)
+	{
+		const i32 k = j / 3;
+		state->p[j] += force[j] * 0.5f * state->h[k];
+		state->x[j] += state->p[j] * state->inv_mass[k] * state->h[k];
+	}
+
+	rbp_internal_forces(force, pipeline, state, state->x, state->p);
+	for (i32 j = 0; j < 3*state->count; ++j)
+	{
+		state->p[j] += force[j] * 0.5f * state->h[j / 3];
+	}
+}
+
+/* 
+ * classic Runge-Kutta on y = (x, p), y' = (p / m, F(x, p)): the stages k_s are evaluated at y + c_s * h * k_(s-1)
+ * with c = (0, 1/2, 1/2, 1) and summed with weights (1, 2, 2, 1) / 6
+ */
+static void rbp_internal_integrate_rk4(struct arena *mem, const struct rbp *pipeline, struct rbp_linear_state *state)
+{
+	const u64 size = 3 * state->count * sizeof(f32);
+	f32 *x_stage = arena_push(mem, NULL, size);
+	f32 *p_stage = arena_push(mem, NULL, size);
+	f32 *dx = arena_push(mem, NULL, size);
+	f32 *dp = arena_push(mem, NULL, size);
+	f32 *dx_sum = arena_push(mem, NULL, size);
+	f32 *dp_sum = arena_push(mem, NULL, size);
+	memcpy(x_stage, state->x, size);
+	memcpy(p_stage, state->p, size);
+	memset(dx_sum, 0, size);
+	memset(dp_sum, 0, size);
+
+	const f32 c[4] = { 0.5f, 0.5f, 1.0f, 0.0f };	/* offset of the next stage */
+	const f32 weight[4] = { 1.0f / 6.0f, 2.0f / 6.0f, 2.0f / 6.0f, 1.0f / 6.0f };
+	for (u32 s = 0; s < 4; ++s)
+	{
+		rbp_internal_forces(dp, pipeline, state, x_stage, p_stage);
+		for (i32 j = 0; j < 3*state->count; ++j)
+		{
+			const i32 k = j / 3;
+			dx[j] = p_stage[j] * state->inv_mass[k];
+			dx_sum[j] += weight[s] * dx[j];
+			dp_sum[j] += weight[s] * dp[j];
+			x_stage[j] = state->x[j] + c[s] * state->h[k] * dx[j];
+			p_stage[j] = state->p[j] + c[s] * state->h[k] * dp[j];
+		}
+	}
+
+	for (i32 j = 0; j < 3*state->count; ++j)
+	{
+		const i32 k = j / 3;
+		state->x[j] += dx_sum[j] * state->h[k];
+		state->p[j] += dp_sum[j] * state->h[k];
+	}
+}
+
+/*
+ * Each pass walks the awake list and streams only the arrays it needs; static and sleeping bodies do not move, so
+ * they are never touched. The linear state of the awake bodies is packed, integrated with pipeline->integrator 
+ * over the time each body may move, and scattered back. Bodies stopped short by the CCD step still receive the 
+ * momentum of the full step.
+ */
+static void rbp_internal_integrate(struct arena *mem_frame, struct rbp *pipeline, const f32 delta, const f32 *step)
+{
+	struct arena record = *mem_frame;
+
+	rbp_internal_wake_connected(pipeline);
+	struct rbp_linear_state state = { .count = pipeline->awake_count };
+	f32 *angular_drag = NULL;
+	if (state.count)
+	{
+		state.x = arena_push(mem_frame, NULL, 3 * state.count * sizeof(f32));
+		state.p = arena_push(mem_frame, NULL, 3 * state.count * sizeof(f32));
+		state.force = arena_push(mem_frame, NULL, 3 * state.count * sizeof(f32));
+		state.inv_mass = arena_push(mem_frame, NULL, state.count * sizeof(f32));
+		state.h = arena_push(mem_frame, NULL, state.count * sizeof(f32));
+		angular_drag = arena_push(mem_frame, NULL, state.count * sizeof(f32));
+		rbp_internal_push_field_batches(mem_frame, pipeline, &state, angular_drag);
+	}
+
+	u32 stopped = 0;
+	for (i32 k = 0; k < state.count; ++k)
+	{
+		const i32 i = pipeline->awake[k];
+		vec3_copy(state.x + 3*k, pipeline->position[i]);
+		vec3_copy(state.p + 3*k, pipeline->linear_momentum[i]);
+		vec3_copy(state.force + 3*k, pipeline->force[i]);
+		vec3_set(pipeline->force[i], 0.0f, 0.0f, 0.0f);
+		state.inv_mass[k] = pipeline->inv_mass[i];
+		state.h[k] = step[i];
+		stopped |= (step[i] < delta);
+	}
+
+	if (state.count)
+	{
+		switch (pipeline->integrator)
+		{
+			case RBP_INTEGRATOR_EULER: { rbp_internal_integrate_euler(mem_frame, pipeline, &state); } break;
+			case RBP_INTEGRATOR_SYMPLECTIC_EULER: { rbp_internal_integrate_symplectic_euler(mem_frame, pipeline, &state); } break;
+			case RBP_INTEGRATOR_VERLET: { rbp_internal_integrate_verlet(mem_frame, pipeline, &state); } break;
+			case RBP_INTEGRATOR_RK4: { rbp_internal_integrate_rk4(mem_frame, pipeline, &state); } break;
+			default: { assert(0 && "unknown integrator"); } break;
+		}
+	}
+
+	if (stopped)
+	{
+		f32 *force = arena_push(mem_frame, NULL, 3 * state.count * sizeof(f32));
+		rbp_internal_forces(force, pipeline, &state, state.x, state.p);
+		for (i32 j = 0; j < 3*state.count; ++j)
+		{
+			state.p[j] += force[j] * (delta - state.h[j / 3]);
+		}
+	}
+
+	for (i32 k = 0; k < state.count; ++k)
+	{
+		const i32 i = pipeline->awake[k];
+		vec3_copy(pipeline->position[i], state.x + 3*k);
+		vec3_copy(pipeline->linear_momentum[i], state.p + 3*k);
+	}
+
+	/* 
+	 * L += (torque - angular drag * w) * delta, w = I^-1 L, q_new = normalize(q_old + 0.5 * step * (w, 0) q_old),
+	 * after which the world frame inverse inertia follows the new rotation.
+	 */
+	mat3 rot;
+	vec3 w;
+	quat w_q, dq;
+	for (i32 k = 0; k < pipeline->awake_count; ++k)
+	{
+		const i32 i = pipeline->awake[k];
+		mat3_vec_mul(w, pipeline->inv_inertia[i], pipeline->angular_momentum[i]);
+		vec3_translate_scaled(pipeline->torque[i], w, -angular_drag[k]);
+		vec3_translate_scaled(pipeline->angular_momentum[i], pipeline->torque[i], delta);
+		vec3_set(pipeline->torque[i], 0.0f, 0.0f, 0.0f);
+		mat3_vec_mul(w, pipeline->inv_inertia[i], pipeline->angular_momentum[i]);
+		quat_set(w_q, w[0], w[1], w[2], 0.0f);
+		quat_mult(dq, w_q, pipeline->rotation[i]);
+		quat_scale(dq, 0.5f * step[i]);
+		quat_add(pipeline->rotation[i], pipeline->rotation[i], dq);
+		quat_normalize(pipeline->rotation[i]);
+		quat_to_mat3(rot, pipeline->rotation[i]);
+		rbp_internal_world_tensor(pipeline->inv_inertia[i], rot, pipeline->inv_inertia_body[i]);
+	}
+
+	rbp_internal_update_proxies(pipeline, pipeline->awake, pipeline->awake_count);
+
+	*mem_frame = record;
+}
+
+static u32 rbp_internal_contact_match(const struct rbp_contact_point *a, const struct rbp_contact_point *b)
+{
+	return a->body_1 == b->body_1 && a->body_2 == b->body_2 && a->child_1 == b->child_1 
+		&& a->child_2 == b->child_2 && a->feature == b->feature;
+}
+
+/* body slot i was asleep when the contact step started, awake_start being the awake count at that time */
+static u32 rbp_internal_slept_through(const struct rbp *pipeline, const i32 i, const i32 awake_start)
+{
+	return pipeline->awake_index[i] == -1 || pipeline->awake_index[i] >= awake_start;
+}
+
+/* 
+ * replace the contact cache with this step's points, points beyond the cache size are not warm started. Cached
+ * points of pairs skipped this step because both bodies were asleep are carried over, so a stack woken later
+ * starts from its resting impulses.
+ */
+static void rbp_internal_cache_contacts(struct arena *mem, struct rbp *pipeline, const struct rbp_contact_point *point, const u32 count, const i32 awake_start)
+{
+	struct arena record = *mem;
+
+	u32 kept = 0;
+	struct rbp_contact_point *keep = (pipeline->contact_count) 
+		? arena_push(mem, NULL, pipeline->contact_count * sizeof(struct rbp_contact_point)) 
+		: NULL;
+	for (u32 i = 0; i < pipeline->contact_count; ++i)
+	{
+		const struct rbp_contact_point *c = pipeline->contact_cache + i;
+		if (rbp_internal_slept_through(pipeline, c->body_1, awake_start) && rbp_internal_slept_through(pipeline, c->body_2, awake_start))
+		{
+			keep[kept++] = *c;
+		}
+	}
+
+	hash_clear(pipeline->contact_hash);
+	pipeline->contact_count = (count < pipeline->contact_size) ? count : pipeline->contact_size;
+	for (u32 i = 0; i < pipeline->contact_count; ++i)
+	{
+		pipeline->contact_cache[i] = point[i];
+		hash_add(pipeline->contact_hash, rbp_internal_contact_key(point + i), (i32) i);
+	}
+
+	/* a pair woken during the step may have fresh points already */
+	for (u32 k = 0; k < kept && pipeline->contact_count < pipeline->contact_size; ++k)
+	{
+		const i32 key = rbp_internal_contact_key(keep + k);
+		u32 fresh = 0;
+		for (i32 h = hash_first(pipeline->contact_hash, key); h != -1 && !fresh; h = hash_next(pipeline->contact_hash, h))
+		{
+			fresh = rbp_internal_contact_match(pipeline->contact_cache + h, keep + k);
+		}
+
+		if (!fresh)
+		{
+			pipeline->contact_cache[pipeline->contact_count] = keep[k];
+			hash_add(pipeline->contact_hash, key, (i32) pipeline->contact_count);
+			pipeline->contact_count += 1;
+		}
+	}
+
+	*mem = record;
+}
+
+/* union-find over active body indices, with path halving; the smaller index becomes the root */
+static i32 rbp_internal_island_find(i32 *parent, i32 k)
+{
+	while (parent[k] != k)
+	{
+		parent[k] = parent[parent[k]];
+		k = parent[k];
+	}
+
+	return k;
+}
+
+static void rbp_internal_island_union(i32 *parent, const i32 a, const i32 b)
+{
+	const i32 r_a = rbp_internal_island_find(parent, a);
+	const i32 r_b = rbp_internal_island_find(parent, b);
+	if (r_a < r_b)
+	{
+		parent[r_b] = r_a;
+	}
+	else
+	{
+		parent[r_a] = r_b;
+	}
+}
+
+/* active index k is a dynamic body, pipeline->count stands for the world */
+static u32 rbp_internal_island_dynamic(const struct rbp *pipeline, const i32 k)
+{
+	return k < pipeline->count && pipeline->inv_mass[pipeline->active[k]] > 0.0f;
+}
+
+/* island of the constraint between active indices k_1 and k_2, created on first use, see rbp_internal_solve_islands */
+static u32 rbp_internal_island_of(const struct rbp *pipeline, struct rbp_island *island, u32 *island_count, i32 *parent, i32 *island_of, i32 *local, const i32 k_1, const i32 k_2)
+{
+	const i32 k[2] = { k_1, k_2 };
+	const i32 root = rbp_internal_island_find(parent, (rbp_internal_island_dynamic(pipeline, k[0])) ? k[0] : k[1]);
+	if (island_of[root] == -1)
+	{
+		island_of[root] = (i32) *island_count;
+		memset(island + *island_count, 0, sizeof(struct rbp_island));
+		*island_count += 1;
 	}
 
-	for (i32 i = 0; i < size; ++i)
+	struct rbp_island *is = island + island_of[root];
+	for (u32 j = 0; j < 2; ++j)
 	{
-		pipeline.bodies[i].active = 0;			
+		if (rbp_internal_island_dynamic(pipeline, k[j]) && local[k[j]] == -1)
+		{
+			local[k[j]] = (i32) is->body_count++;
+		}
 	}
 
-	return pipeline;
+	return (u32) island_of[root];
 }
 
-void rbp_add(struct rbp *pipeline, const i32 index, struct rigid_body *body, u32 dynamic)
+/*
+ * Split the contacts and joints (body indices = active indices, pipeline->count for the world) into islands with
+ * union-find and solve every island on its own, as jobs for the island workers and the calling thread; islands of at
+ * least RBP_COLOR_CONTACTS contacts are instead solved one at a time by all threads, color by color. Islands,
+ * their bodies, contacts and joints are numbered in contact order, then joint order, so the result does not depend on
+ * the thread count. Solved velocities are written back as momentum, the solved impulses back into contact and joint, and 
+ * island_id[slot] is set to the island of each dynamic body in contact or jointed.
+ */
+static void rbp_internal_solve_islands(struct arena *mem_frame, struct rbp *pipeline, i32 *island_id, struct solver_contact *contact, const u32 count, struct solver_joint *joint, const u32 joint_count, const f32 delta)
 {
-	assert(index >= 0 && index < pipeline->size);
-	assert(pipeline->bodies[index].active == 0);
+	struct arena record = *mem_frame;
 
-	memcpy(pipeline->bodies + index, body, sizeof(struct rigid_body));
-	pipeline->bodies[index].active = 1;
-	pipeline->bodies[index].dynamic = dynamic;
-	pipeline->count += 1;
+	const i32 world = pipeline->count;
+	i32 *parent = arena_push(mem_frame, NULL, (world + 1) * sizeof(i32));
+	i32 *island_of = arena_push(mem_frame, NULL, (world + 1) * sizeof(i32));
+	i32 *local = arena_push(mem_frame, NULL, (world + 1) * sizeof(i32));
+	u32 *contact_island = arena_push(mem_frame, NULL, (count + joint_count) * sizeof(u32));
+	u32 *joint_island = contact_island + count;
+	struct rbp_island *island = arena_push(mem_frame, NULL, (count + joint_count) * sizeof(struct rbp_island));
+	for (i32 k = 0; k <= world; ++k)
+	{
+		parent[k] = k;
+		island_of[k] = -1;
+		local[k] = -1;
+	}
 
-	struct AABB proxy;
-	rigid_body_proxy(&proxy, &pipeline->bodies[index]);
-	pipeline->bodies[index].proxy = dbvt_insert(&pipeline->dynamic_tree, index, &proxy);
-}
+	/* static bodies have zero inverse mass */
+	const f32 *inv_mass = pipeline->inv_mass;
+	const i32 *active = pipeline->active;
+	for (u32 n = 0; n < count; ++n)
+	{
+		const i32 k_1 = (i32) contact[n].body_1;
+		const i32 k_2 = (i32) contact[n].body_2;
+		if (rbp_internal_island_dynamic(pipeline, k_1) && rbp_internal_island_dynamic(pipeline, k_2))
+		{
+			rbp_internal_island_union(parent, k_1, k_2);
+		}
+	}
 
-void rbp_remove(struct rbp *pipeline, const i32 index)
-{
-	assert(index >= 0 && index < pipeline->size);
-	assert(pipeline->bodies[index].active == 1);
+	for (u32 n = 0; n < joint_count; ++n)
+	{
+		const i32 k_1 = (i32) joint[n].body_1;
+		const i32 k_2 = (i32) joint[n].body_2;
+		if (rbp_internal_island_dynamic(pipeline, k_1) && rbp_internal_island_dynamic(pipeline, k_2))
+		{
+			rbp_internal_island_union(parent, k_1, k_2);
+		}
+	}
 
-	pipeline->bodies[index].active = 0;
-	pipeline->count -= 1;
-}
+	u32 island_count = 0;
+	for (u32 n = 0; n < count; ++n)
+	{
+		contact_island[n] = rbp_internal_island_of(pipeline, island, &island_count, parent, island_of, local, (i32) contact[n].body_1, (i32) contact[n].body_2);
+		island[contact_island[n]].contact_count += 1;
+	}
 
-void rbp_push_dbvt(struct drawbuffer *buf, struct rbp *pipeline, const vec4 color)
-{
-	dbvt_push_lines(buf, &pipeline->dynamic_tree, color);
-}
+	for (u32 n = 0; n < joint_count; ++n)
+	{
+		joint_island[n] = rbp_internal_island_of(pipeline, island, &island_count, parent, island_of, local, (i32) joint[n].body_1, (i32) joint[n].body_2);
+		island[joint_island[n]].joint_count += 1;
+	}
 
-void rbp_push_proxies(struct drawbuffer *buf, const struct rbp *pipeline, const vec4 color)
-{
-	for (i32 i = 0; i < pipeline->size; ++i)
+	u32 contact_first = 0;
+	u32 joint_first = 0;
+	u32 body_first = 0;
+	for (u32 i = 0; i < island_count; ++i)
+	{
+		island[i].contact_first = contact_first;
+		island[i].joint_first = joint_first;
+		island[i].body_first = body_first;
+		contact_first += island[i].contact_count;
+		joint_first += island[i].joint_count;
+		body_first += island[i].body_count + 1;
+	}
+
+	struct solver_bodies bodies = { .count = body_first };
+	bodies.linear_velocity = arena_push(mem_frame, NULL, bodies.count * sizeof(vec3));
+	bodies.angular_velocity = arena_push(mem_frame, NULL, bodies.count * sizeof(vec3));
+	bodies.inv_mass = arena_push(mem_frame, NULL, bodies.count * sizeof(f32));
+	bodies.inv_inertia = arena_push(mem_frame, NULL, bodies.count * sizeof(mat3));
+	for (u32 i = 0; i < island_count; ++i)
+	{
+		const u32 b = island[i].body_first + island[i].body_count;
+		vec3_set(bodies.linear_velocity[b], 0.0f, 0.0f, 0.0f);
+		vec3_set(bodies.angular_velocity[b], 0.0f, 0.0f, 0.0f);
+		bodies.inv_mass[b] = 0.0f;
+		memset(bodies.inv_inertia[b], 0, sizeof(mat3));
+	}
+
+	for (i32 k = 0; k < pipeline->count; ++k)
 	{
-		if (pipeline->bodies[i].active)
+		if (local[k] != -1)
 		{
-			AABB_push_lines(buf, &pipeline->dynamic_tree.nodes[pipeline->bodies[i].proxy].box, color);
+			const u32 b = island[island_of[rbp_internal_island_find(parent, k)]].body_first + (u32) local[k];
+			rbp_internal_body_velocity(bodies.linear_velocity[b], pipeline, active[k]);
+			mat3_vec_mul(bodies.angular_velocity[b], pipeline->inv_inertia[active[k]], pipeline->angular_momentum[active[k]]);
+			bodies.inv_mass[b] = inv_mass[active[k]];
+			memcpy(bodies.inv_inertia[b], pipeline->inv_inertia[active[k]], sizeof(mat3));
 		}
 	}
-}
 
-void rbp_push_convex_hulls(const struct rbp *pipeline, struct drawbuffer *buf, const vec4 color, struct arena *mem_1, struct arena *mem_2, struct arena *mem_3, struct arena *mem_4, struct arena *mem_5, i32 i_count[], i32 i_offset[])
-{
-	const i32 len = (pipeline->size % UNIFORM_SIZE) ? pipeline->size / UNIFORM_SIZE + 1 : pipeline->size / UNIFORM_SIZE;
-	for (i32 i = 0; i < len; ++i)
+	/* contacts and joints grouped by island in input order, with island local body indices */
+	struct solver_contact *sorted = (count) ? arena_push(mem_frame, NULL, count * sizeof(struct solver_contact)) : NULL;
+	struct solver_joint *sorted_joint = (joint_count) ? arena_push(mem_frame, NULL, joint_count * sizeof(struct solver_joint)) : NULL;
+	u32 *order = arena_push(mem_frame, NULL, (count + joint_count) * sizeof(u32));
+	u32 *joint_order = order + count;
+	u32 max_contacts = 0;
+	u32 max_joints = 0;
+	u32 max_bodies = 0;
+	for (u32 i = 0; i < island_count; ++i)
 	{
-		i_count[i] = 0;
-		i_offset[i] = 0;
+		max_contacts = (island[i].contact_count > max_contacts) ? island[i].contact_count : max_contacts;
+		max_joints = (island[i].joint_count > max_joints) ? island[i].joint_count : max_joints;
+		max_bodies = (island[i].body_count + 1 > max_bodies) ? island[i].body_count + 1 : max_bodies;
+		island[i].contact_count = 0;
+		island[i].joint_count = 0;
 	}
 
-	const void *first = buf->i_buf.stack_ptr;
+	for (u32 n = 0; n < count; ++n)
+	{
+		struct rbp_island *is = island + contact_island[n];
+		const u32 j = is->contact_first + is->contact_count++;
+		sorted[j] = contact[n];
+		sorted[j].body_1 = (local[contact[n].body_1] != -1) ? (u32) local[contact[n].body_1] : is->body_count;
+		sorted[j].body_2 = (local[contact[n].body_2] != -1) ? (u32) local[contact[n].body_2] : is->body_count;
+		order[j] = n;
+	}
 
-	for (i32 i = 0; i < pipeline->size; ++i)
+	for (u32 n = 0; n < joint_count; ++n)
 	{
-		const void *before = buf->i_buf.stack_ptr;
-		if (pipeline->bodies[i].active)
+		struct rbp_island *is = island + joint_island[n];
+		const u32 j = is->joint_first + is->joint_count++;
+		sorted_joint[j] = joint[n];
+		sorted_joint[j].body_1 = (local[joint[n].body_1] != -1) ? (u32) local[joint[n].body_1] : is->body_count;
+		sorted_joint[j].body_2 = (local[joint[n].body_2] != -1) ? (u32) local[joint[n].body_2] : is->body_count;
+		joint_order[j] = n;
+	}
+
+	/* 
+	 * islands of at least RBP_COLOR_CONTACTS contacts first, solved one by one on every thread, then the rest largest
+	 * first, so no thread is left with a big island at the end
+	 */
+	u64 *keys = arena_push(mem_frame, NULL, island_count * sizeof(u64));
+	u32 colored_count = 0;
+	for (u32 i = 0; i < island_count; ++i)
+	{
+		const u64 colored = (island[i].contact_count >= RBP_COLOR_CONTACTS) ? 0 : 1;
+		keys[i] = (colored << 63) | ((u64) (0x7fffffff - island[i].contact_count - island[i].joint_count) << 32) | (u64) i;
+		colored_count += 1 - (u32) colored;
+	}
+	mergesort(mem_frame, keys, island_count, sizeof(u64), &internal_pair_cost_compare);
+
+	struct rbp_island_jobs jobs =
+	{
+		.island = island,
+		.order = keys,
+		.count = island_count,
+		.next = 0,
+		.bodies = bodies,
+		.contact = sorted,
+		.joint = sorted_joint,
+		.scratch_size = solver_scratch_size(max_contacts, max_joints, max_bodies),
+		.delta = delta,
+	};
+
+	struct rbp_workers *workers = pipeline->workers;
+	jobs.lock = &workers->lock;
+	jobs.barrier = &workers->barrier;
+	jobs.thread_count = workers->count + 1;
+	for (u32 i = 0; i < colored_count; ++i)
+	{
+		const struct rbp_island *is = island + (u32) keys[i];
+		struct solver_bodies island_bodies = rbp_internal_island_bodies(&jobs, (u32) keys[i]);
+		struct solver_colored colored;
+		solver_color_setup(&colored, mem_frame, &island_bodies, sorted + is->contact_first, is->contact_count, sorted_joint + is->joint_first, is->joint_count, delta);
+		jobs.colored = &colored;
+		jobs.next = 0;
+		if (workers->count == 0)
 		{
-			convex_hull_cs_step_draw(mem_1, mem_2, mem_3, mem_4, mem_5, pipeline->bodies[i].mesh.v, pipeline->bodies[i].mesh.v_count, 0.0001f, pipeline->bodies[i].mesh.v_count, 7583458, buf, color, 0);
+			rbp_internal_color_work(&jobs, 0);
 		}
-		const void *after = buf->i_buf.stack_ptr;
-		i_count[i / UNIFORM_SIZE] += ((u64) after - (u64) before) / sizeof(i32);
-		if (i % UNIFORM_SIZE == 0)
+		else
 		{
-			i_offset[i / UNIFORM_SIZE] = ((u64) before - (u64) first);
+			rbp_internal_dispatch(workers, &jobs, mem_frame);
 		}
+		solver_color_finish(&colored, mem_frame);
 	}
-}
 
-void rbp_push_positions(void *buf, const struct rbp *pipeline)
-{
+	jobs.colored = NULL;
+	jobs.next = colored_count;
+	if (workers->count == 0 || island_count - colored_count <= 1)
+	{
+		for (u32 i = colored_count; i < island_count; ++i)
+		{
+			rbp_internal_solve_island(mem_frame, &jobs, (u32) keys[i]);
+		}
+	}
+	else
+	{
+		/* the calling thread works on the islands as well */
+		rbp_internal_dispatch(workers, &jobs, mem_frame);
+	}
+
+	/* L = v / inv_mass, angular L = R I_body R^T w */
+	mat3 rot, inertia;
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		if (local[k] != -1)
+		{
+			const i32 i = island_of[rbp_internal_island_find(parent, k)];
+			const u32 b = island[i].body_first + (u32) local[k];
+			vec3_scale(pipeline->linear_momentum[active[k]], bodies.linear_velocity[b], 1.0f / inv_mass[active[k]]);
+			quat_to_mat3(rot, pipeline->rotation[active[k]]);
+			rbp_internal_world_tensor(inertia, rot, pipeline->bodies[active[k]].inertia_tensor);
+			mat3_vec_mul(pipeline->angular_momentum[active[k]], inertia, bodies.angular_velocity[b]);
+			island_id[active[k]] = i;
+		}
+	}
+
+	for (u32 j = 0; j < count; ++j)
+	{
+		contact[order[j]].normal_impulse = sorted[j].normal_impulse;
+		vec3_copy(contact[order[j]].friction_impulse, sorted[j].friction_impulse);
+	}
+
+	for (u32 j = 0; j < joint_count; ++j)
+	{
+		vec3_copy(joint[joint_order[j]].linear_impulse, sorted_joint[j].linear_impulse);
+		vec3_copy(joint[joint_order[j]].angular_impulse, sorted_joint[j].angular_impulse);
+	}
 
+	*mem_frame = record;
 }
 
-static void internal_update_bodies(struct rbp *pipeline, const f32 delta)
+/*
+ * Solver rows of the joints with an awake body, with active body indices and pipeline->count for the world; index[j]
+ * is the pipeline joint of solver joint j. A sleeping body joined to an awake one is woken. Linear rows hold the
+ * anchors together along the world axes (ball, hinge, fixed), across the axis (prismatic) or along the anchor
+ * separation (distance). Angular rows keep the hinge axes aligned, or hold the relative rotation q_1^-1 q_2 of the
+ * joint with the rotation error 2 vec(q_2 (q_1 relative)^-1).
+ */
+static struct solver_joint *rbp_internal_push_joints(struct arena *mem_frame, struct rbp *pipeline, u32 **index, u32 *count)
 {
-	vec3 translation;
-	struct AABB world_AABB;
-	for (i32 i = 0; i < pipeline->size; ++i)
+	*count = 0;
+	if (pipeline->joint_count == 0)
+	{
+		return NULL;
+	}
+
+	struct solver_joint *joint = arena_push(mem_frame, NULL, pipeline->joint_count * sizeof(struct solver_joint));
+	*index = arena_push(mem_frame, NULL, pipeline->joint_count * sizeof(u32));
+
+	mat3 rot_1, rot_2;
+	vec3 p_1, p_2, d, a_1, a_2, c;
+	quat q_1, q_2, q_target, q_conj, q_error;
+	for (u32 j = 0; j < pipeline->joint_count; ++j)
 	{
-		if (pipeline->bodies[i].active)
+		const struct rbp_joint *rj = pipeline->joint + j;
+		const i32 i_1 = rj->body_1;
+		const i32 i_2 = rj->body_2;
+		if (pipeline->awake_index[i_1] == -1 && (i_2 == -1 || pipeline->awake_index[i_2] == -1))
 		{
-			vec3_scale(translation, pipeline->bodies[i].velocity, delta);
-			vec3_translate(pipeline->bodies[i].position, translation);
-			vec3_add(world_AABB.center, pipeline->bodies[i].local_box.center, pipeline->bodies[i].position);
-			vec3_copy(world_AABB.hw, pipeline->bodies[i].local_box.hw);
-			const struct AABB *proxy = &pipeline->dynamic_tree.nodes[pipeline->bodies[i].proxy].box;
-			if (!AABB_contains(proxy, &world_AABB))
+			continue;
+		}
+		rbp_internal_wake_pair(pipeline, i_1, i_2);
+
+		struct solver_joint *sj = joint + *count;
+		(*index)[*count] = j;
+		*count += 1;
+
+		rbp_internal_joint_frame(p_1, q_1, pipeline, i_1);
+		rbp_internal_joint_frame(p_2, q_2, pipeline, i_2);
+		quat_to_mat3(rot_1, q_1);
+		quat_to_mat3(rot_2, q_2);
+		mat3_vec_mul(sj->r_1, rot_1, rj->anchor_1);
+		mat3_vec_mul(sj->r_2, rot_2, rj->anchor_2);
+		vec3_sub(d, p_2, p_1);
+		vec3_translate(d, sj->r_2);
+		vec3_translate_scaled(d, sj->r_1, -1.0f);
+
+		sj->body_1 = (u32) pipeline->active_index[i_1];
+		sj->body_2 = (i_2 == -1) ? (u32) pipeline->count : (u32) pipeline->active_index[i_2];
+		sj->linear_count = 0;
+		sj->angular_count = 0;
+		vec3_copy(sj->linear_impulse, rj->linear_impulse);
+		vec3_copy(sj->angular_impulse, rj->angular_impulse);
+
+		switch (rj->type)
+		{
+			case RBP_JOINT_BALL:
+			case RBP_JOINT_HINGE:
+			case RBP_JOINT_FIXED:
+			{
+				sj->linear_count = 3;
+				for (u32 r = 0; r < 3; ++r)
+				{
+					vec3_set(sj->linear[r], (r == 0) ? 1.0f : 0.0f, (r == 1) ? 1.0f : 0.0f, (r == 2) ? 1.0f : 0.0f);
+					sj->linear_error[r] = d[r];
+				}
+			} break;
+
+			case RBP_JOINT_PRISMATIC:
+			{
+				/* body 1 is held at the anchor of body 2, which slides along the axis */
+				mat3_vec_mul(a_1, rot_1, rj->axis_1);
+				vec3_create_basis(sj->linear[0], sj->linear[1], a_1);
+				vec3_translate(sj->r_1, d);
+				sj->linear_count = 2;
+				sj->linear_error[0] = vec3_dot(sj->linear[0], d);
+				sj->linear_error[1] = vec3_dot(sj->linear[1], d);
+			} break;
+
+			case RBP_JOINT_DISTANCE:
+			{
+				const f32 length = vec3_length(d);
+				if (length > 1e-6f)
+				{
+					vec3_scale(sj->linear[0], d, 1.0f / length);
+				}
+				else
+				{
+					vec3_set(sj->linear[0], 0.0f, 1.0f, 0.0f);
+				}
+				sj->linear_count = 1;
+				sj->linear_error[0] = length - rj->length;
+			} break;
+
+			default: { assert(0 && "unknown joint type"); } break;
+		}
+
+		if (rj->type == RBP_JOINT_HINGE)
+		{
+			/* a_1 x a_2 = theta t for a small rotation theta of body 2 about t, perpendicular to the axis */
+			mat3_vec_mul(a_1, rot_1, rj->axis_1);
+			mat3_vec_mul(a_2, rot_2, rj->axis_2);
+			vec3_cross(c, a_1, a_2);
+			vec3_create_basis(sj->angular[0], sj->angular[1], a_1);
+			sj->angular_count = 2;
+			sj->angular_error[0] = vec3_dot(sj->angular[0], c);
+			sj->angular_error[1] = vec3_dot(sj->angular[1], c);
+		}
+		else if (rj->type == RBP_JOINT_PRISMATIC || rj->type == RBP_JOINT_FIXED)
+		{
+			quat_mult(q_target, q_1, rj->relative);
+			quat_conj(q_conj, q_target);
+			quat_mult(q_error, q_2, q_conj);
+			const f32 sign = (q_error[3] < 0.0f) ? -2.0f : 2.0f;
+			sj->angular_count = 3;
+			for (u32 r = 0; r < 3; ++r)
 			{
-				world_AABB.hw[0] += pipeline->bodies[i].margin;
-				world_AABB.hw[1] += pipeline->bodies[i].margin;
-				world_AABB.hw[2] += pipeline->bodies[i].margin;
-				dbvt_remove(&pipeline->dynamic_tree, pipeline->bodies[i].proxy);
-				pipeline->bodies[i].proxy = dbvt_insert(&pipeline->dynamic_tree, i, &world_AABB);
+				vec3_set(sj->angular[r], (r == 0) ? 1.0f : 0.0f, (r == 1) ? 1.0f : 0.0f, (r == 2) ? 1.0f : 0.0f);
+				sj->angular_error[r] = sign * q_error[r];
 			}
 		}
 	}
 
+	return joint;
 }
 
-static i32 internal_push_proxy_overlaps(struct arena *mem_frame, struct rbp *pipeline)
+/* key of the unordered slot pair i_1, i_2 */
+static u64 rbp_internal_pair_key(const i32 i_1, const i32 i_2)
 {
-	return dbvt_push_overlap_pairs(mem_frame, &pipeline->dynamic_tree);
+	return (i_1 < i_2) 
+		? ((u64) i_1 << 32) | (u64) i_2
+		: ((u64) i_2 << 32) | (u64) i_1;
 }
 
-static i32 *internal_push_collisions(struct arena *mem_frame, struct rbp *pipeline, i32 *overlaps, const i32 overlap_count)
+/* binary search of the sorted pair keys */
+static u32 rbp_internal_pair_joined(const u64 *joined, const u32 count, const i32 i_1, const i32 i_2)
 {
-	i32 *collisions = arena_push_packed(mem_frame, NULL, sizeof(i32)*pipeline->size);
-	for (i32 i = 0; i < pipeline->size; ++i) { collisions[i] = 0; }
-	i32 num_collisions = 0;
+	const u64 key = rbp_internal_pair_key(i_1, i_2);
+	u32 low = 0;
+	u32 high = count;
+	while (low < high)
+	{
+		const u32 mid = low + (high - low) / 2;
+		if (joined[mid] < key)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
 
+	return low < count && joined[low] == key;
+}
+
+/*
+ * Contact step: every child pair of overlapping bodies, one of them dynamic, within RBP_CONTACT_MARGIN gets a contact
+ * patch; its points are warm started from the contact cache and solved island by island together with the joints,
+ * after which the cache is replaced. Pairs without an awake body or joined by a joint are skipped, and a sleeping
+ * body touched by an awake one is woken.
+ */
+static void rbp_internal_solve_contacts(struct arena *mem_frame, struct rbp *pipeline, i32 *island, const i32 *overlaps, const i32 overlap_count, const f32 delta)
+{
 	struct arena record = *mem_frame;
+	const i32 awake_start = pipeline->awake_count;
 
-	struct rigid_body *b1, *b2;
-	for (i32 i = 0; i < overlap_count; ++i)
-	{
-		b1 = pipeline->bodies + overlaps[2*i];
-		b2 = pipeline->bodies + overlaps[2*i+1];
+	u32 *joint_index = NULL;
+	u32 joint_count = 0;
+	struct solver_joint *joint = rbp_internal_push_joints(mem_frame, pipeline, &joint_index, &joint_count);
 
-		struct contact_manifold c_m;
-		//if (GJK_test(b1->position, b1->v, b1->v_count, b2->position, b2->v, b2->v_count, 0.0, 100.0f*FLT_EPSILON))
-		if (GJK_EPA(mem_frame, &c_m, b1->position, b1->mesh.v, b1->mesh.v_count, b2->position, b2->mesh.v, b2->mesh.v_count, 0.001f, 100.0f*FLT_EPSILON))
+	u32 joined_count = 0;
+	u64 *joined = (pipeline->joint_count) ? arena_push(mem_frame, NULL, pipeline->joint_count * sizeof(u64)) : NULL;
+	for (u32 j = 0; j < pipeline->joint_count; ++j)
+	{
+		if (pipeline->joint[j].body_2 != -1)
 		{
-			num_collisions += 1;
-			collisions[overlaps[2*i]] = 1;
-			collisions[overlaps[2*i+1]] = 1;
+			joined[joined_count++] = rbp_internal_pair_key(pipeline->joint[j].body_1, pipeline->joint[j].body_2);
 		}
 	}
+	if (joined_count)
+	{
+		mergesort(mem_frame, joined, joined_count, sizeof(u64), &internal_pair_cost_compare);
+	}
 
-	*mem_frame = record;
-	return collisions;
-}
+	mat3 *rot = internal_push_rotations(mem_frame, pipeline);
 
-vec3ptr rbp_push_closest_points_between_bodies(struct arena *mem_frame, struct rbp *pipeline, u32 *pair_count)
-{
-	*pair_count = 0;
-	struct rigid_body *b1, *b2;
-	vec3ptr point_pairs = arena_push(mem_frame, NULL, 2*sizeof(vec3)*pipeline->size*(pipeline->size-1)/2);
+	/* child pairs that can touch this step, first[o] is the first child pair of overlap o */
+	u32 *first = arena_push(mem_frame, NULL, sizeof(u32)*(overlap_count + 1));
+	const i32 *child = (i32 *) mem_frame->stack_ptr;
+	struct sphere s_1, s_2;
+	i32 pair_count = 0;
+	for (i32 o = 0; o < overlap_count; ++o)
+	{
+		first[o] = pair_count;
+		const i32 i_1 = overlaps[2*o];
+		const i32 i_2 = overlaps[2*o+1];
+		if ((pipeline->awake_index[i_1] == -1 && pipeline->awake_index[i_2] == -1) 
+				|| rbp_internal_pair_joined(joined, joined_count, i_1, i_2))
+		{
+			continue;
+		}
 
-	for (i32 i = 0; i < pipeline->size; ++i)
+		rigid_body_world_sphere(&s_1, pipeline->bodies + i_1, pipeline->position[i_1], rot[i_1]);
+		rigid_body_world_sphere(&s_2, pipeline->bodies + i_2, pipeline->position[i_2], rot[i_2]);
+		if (sphere_distance(&s_1, &s_2) <= RBP_CONTACT_MARGIN)
+		{
+			pair_count += rbp_internal_push_child_pairs(mem_frame, pipeline, i_1, rot[i_1], i_2, rot[i_2], RBP_CONTACT_MARGIN);
+		}
+	}
+	first[overlap_count] = pair_count;
+
+	u32 point_count = 0;
+	struct contact_patch *patch = NULL;
+	if (pair_count)
 	{
-		b1 = pipeline->bodies + i;
-		for (i32 j = i+1; j < pipeline->size; ++j)
+		patch = arena_push(mem_frame, NULL, pair_count * sizeof(struct contact_patch));
+		for (i32 o = 0; o < overlap_count; ++o)
 		{
-			b2 = pipeline->bodies + j;
-			struct contact_manifold c_m;
-			if (GJK_EPA(mem_frame, &c_m, b1->position, b1->mesh.v, b1->mesh.v_count, b2->position, b2->mesh.v, b2->mesh.v_count, 0.001f, 100.0f*FLT_EPSILON))
-			//if (GJK_distance(point_pairs[2*(*pair_count)], point_pairs[2*(*pair_count) + 1],
-			//			b1->position, b1->v, b1->v_count, b2->position, b2->v, b2->v_count, 0.001f, 100.0f*FLT_EPSILON) > 0.0f)
+			const i32 i_1 = overlaps[2*o];
+			const i32 i_2 = overlaps[2*o+1];
+			u32 pair_points = 0;
+			for (u32 p = first[o]; p < first[o+1]; ++p)
 			{
-				printf("PENETRATION_DEPTH: %f\n", c_m.penetration_depth);
-				vec3 pen_dir;
-				vec3_sub(pen_dir, c_m.p_1, c_m.p_2);
-				vec3_translate(b2->position, pen_dir);
-				vec3_copy(point_pairs[2*(*pair_count)], c_m.p_1);
-				vec3_copy(point_pairs[2*(*pair_count) + 1], c_m.p_2);
-				*pair_count += 1;
+				const struct tri_mesh *h_1 = rbp_internal_child_hull(pipeline->bodies + i_1, child[2*p]);
+				const struct tri_mesh *h_2 = rbp_internal_child_hull(pipeline->bodies + i_2, child[2*p+1]);
+				pair_points += convex_hull_contact(mem_frame, patch + p, pipeline->position[i_1], rot[i_1], h_1, pipeline->position[i_2], rot[i_2], h_2, RBP_CONTACT_MARGIN);
+			}
+
+			/* an awake body touching a sleeping one wakes it */
+			if (pair_points)
+			{
+				if (pipeline->flags[i_1] & RBP_BODY_SLEEPING) { rbp_wake(pipeline, i_1); }
+				if (pipeline->flags[i_2] & RBP_BODY_SLEEPING) { rbp_wake(pipeline, i_2); }
 			}
+			point_count += pair_points;
 		}
 	}
 
-	return point_pairs;
-}
+	if (point_count + joint_count == 0)
+	{
+		rbp_internal_cache_contacts(mem_frame, pipeline, NULL, 0, awake_start);
+		*mem_frame = record;
+		return;
+	}
 
-i32 *rbp_simulate(struct arena *mem_frame, struct rbp *pipeline, const f32 delta)
-{
-	internal_update_bodies(pipeline, delta);
+	struct solver_contact *contact = (point_count) ? arena_push(mem_frame, NULL, point_count * sizeof(struct solver_contact)) : NULL;
+	struct rbp_contact_point *point = (point_count) ? arena_push(mem_frame, NULL, point_count * sizeof(struct rbp_contact_point)) : NULL;
+	u32 n = 0;
+	for (i32 o = 0; o < overlap_count; ++o)
+	{
+		const i32 i_1 = overlaps[2*o];
+		const i32 i_2 = overlaps[2*o+1];
+		const struct rigid_body *b1 = pipeline->bodies + i_1;
+		const struct rigid_body *b2 = pipeline->bodies + i_2;
+		for (u32 p = first[o]; p < first[o+1]; ++p)
+		{
+			for (u32 j = 0; j < patch[p].count; ++j, ++n)
+			{
+				struct solver_contact *c = contact + n;
+				c->body_1 = (u32) pipeline->active_index[i_1];
+				c->body_2 = (u32) pipeline->active_index[i_2];
+				vec3_copy(c->normal, patch[p].normal);
+				vec3_sub(c->r_1, patch[p].point[j], pipeline->position[i_1]);
+				vec3_sub(c->r_2, patch[p].point[j], pipeline->position[i_2]);
+				c->depth = patch[p].depth[j];
+				c->friction = sqrtf(b1->friction * b2->friction);
+				c->restitution = fmaxf(b1->restitution, b2->restitution);
+				c->normal_impulse = 0.0f;
+				vec3_set(c->friction_impulse, 0.0f, 0.0f, 0.0f);
 
-	i32 *overlaps = (i32 *) mem_frame->stack_ptr;
-	i32 overlap_pairs_count = internal_push_proxy_overlaps(mem_frame, pipeline);
-	i32 *collisions = internal_push_collisions(mem_frame, pipeline, overlaps, overlap_pairs_count);
+				point[n].body_1 = i_1;
+				point[n].body_2 = i_2;
+				point[n].child_1 = child[2*p];
+				point[n].child_2 = child[2*p+1];
+				point[n].feature = patch[p].feature[j];
+				const i32 key = rbp_internal_contact_key(point + n);
+				for (i32 h = hash_first(pipeline->contact_hash, key); h != -1; h = hash_next(pipeline->contact_hash, h))
+				{
+					if (rbp_internal_contact_match(pipeline->contact_cache + h, point + n))
+					{
+						c->normal_impulse = pipeline->contact_cache[h].normal_impulse;
+						vec3_copy(c->friction_impulse, pipeline->contact_cache[h].friction_impulse);
+						break;
+					}
+				}
+			}
+		}
+	}
 
-	return collisions;
-}
+	rbp_internal_solve_islands(mem_frame, pipeline, island, contact, point_count, joint, joint_count, delta);
 
-void rbp_construct_random(struct arena *mem, struct rbp *pipeline, const u64 index, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena_collection *mem_tmp, const vec3 pos)
-{
-	assert(mem_tmp->arena_count >= 5);
+	for (u32 j = 0; j < joint_count; ++j)
+	{
+		vec3_copy(pipeline->joint[joint_index[j]].linear_impulse, joint[j].linear_impulse);
+		vec3_copy(pipeline->joint[joint_index[j]].angular_impulse, joint[j].angular_impulse);
+	}
 
-	struct rigid_body body;
-	const f32 radius = gen_continuous_uniform_f(min_radius, max_radius);
-	const f32 t1 = gen_rand_f();
-	const f32 t2 = gen_rand_f();
+	for (u32 i = 0; i < point_count; ++i)
+	{
+		point[i].normal_impulse = contact[i].normal_impulse;
+		vec3_copy(point[i].friction_impulse, contact[i].friction_impulse);
+	}
+	rbp_internal_cache_contacts(mem_frame, pipeline, point, point_count, awake_start);
 
-	struct arena record = mem_tmp->arenas[4];
-	u32 v_count = (u32) gen_continuous_uniform_f(min_v_count, (f32) max_v_count + 0.99f); 
-	vec3ptr v = arena_push_packed(&mem_tmp->arenas[4], NULL, v_count * sizeof(vec3));
+	*mem_frame = record;
+}
 
-	vec3_set(body.velocity, 0.0f, 0.0f, 0.0f);
-	//vec3_set(body.velocity, 
-	//	gen_continuous_uniform_f(-1.0f, 1.0f),
-	//	gen_continuous_uniform_f(-1.0f, 1.0f),
-	//	gen_continuous_uniform_f(-1.0f, 1.0f));
-	//vec3_mul_constant(body.velocity, 1.0f / vec3_length(body.velocity));
-	vec3_set(body.position, 0.0f, 0.0f, 0.0f);
-	for (u32 j = 0; j < v_count; ++j)
+/* wake the sleeping bodies around bodies removed since the last step */
+static void rbp_internal_wake_removed(struct arena *mem_frame, struct rbp *pipeline)
+{
+	if (pipeline->wake_count > RBP_WAKE_BOX_MAX)
 	{
-		const f32 u1 = gen_continuous_uniform_f(0.0f, 1.0f);
-		const f32 u2 = gen_continuous_uniform_f(0.0f, 1.0f);
-		const f32 phi = acosf(2*u1 - 1.0f) - MM_PI_F / 2.0f;
-		const f32 lambda = 2*MM_PI_F*u2;
-		vec3_set(v[j]
-				,pos[0] + radius*cosf(phi)*cosf(lambda)
-				,pos[1] + radius*cosf(phi)*sinf(lambda)
-				,pos[2] + radius*sinf(phi));
+		for (i32 k = 0; k < pipeline->count; ++k)
+		{
+			if (pipeline->flags[pipeline->active[k]] & RBP_BODY_SLEEPING)
+			{
+				rbp_wake(pipeline, pipeline->active[k]);
+			}
+		}
 	}
-
-	/* TODO:
-	 * (O) generate hull
-	 * (O) generate statics
-	 * () generate dynamics 
-	 */
+	else
 	{
-		const f32 density = 1.0;
-		struct tri_mesh mesh = convex_hull_construct(mem, mem_tmp->arenas + 0, mem_tmp->arenas + 1, mem_tmp->arenas + 2, mem_tmp->arenas + 3, mem_tmp->arenas + 4, v, v_count, 100.0f * FLT_EPSILON);
-		statics_setup(&body, mem, &mesh, density);
+		for (u32 b = 0; b < pipeline->wake_count; ++b)
+		{
+			struct arena record = *mem_frame;
+			const i32 *candidates = (i32 *) mem_frame->stack_ptr;
+			const i32 candidate_count = dbvt_push_box_overlaps(mem_frame, &pipeline->dynamic_tree, pipeline->wake_box + b);
+			for (i32 j = 0; j < candidate_count; ++j)
+			{
+				if (pipeline->flags[candidates[j]] & RBP_BODY_SLEEPING)
+				{
+					rbp_wake(pipeline, candidates[j]);
+				}
+			}
+			*mem_frame = record;
+		}
 	}
 
-	mem_tmp->arenas[4] = record;
-
-	body.margin = 1.00f;
-	rbp_add(pipeline, index, &body, 1);
+	pipeline->wake_count = 0;
 }
 
-static void rbp_internal_integrate(struct arena *mem_frame, struct rbp *pipeline, const f32 delta)
+/*
+ * Put islands to sleep once all of their bodies have rested for RBP_SLEEP_FRAMES steps; island[slot] is the contact
+ * island of an awake body, or -1 if it touches no other dynamic body and so forms an island of its own.
+ */
+static void rbp_internal_update_sleep(struct arena *mem_frame, struct rbp *pipeline, const i32 *island)
 {
-	vec3 velocity, acceleration, force, torque, tmp;
-	struct AABB world_AABB;
-
-	for (i32 i = 0; i < pipeline->count; ++i)
+	if (pipeline->awake_count == 0)
 	{
-		struct rigid_body *b = pipeline->bodies + i;
-		if (b->active && b->dynamic)
-		{
-			assert(b->mass > 0.0f);
+		return;
+	}
 
-			vec3_scale(velocity, b->linear_momentum, 1.0f/b->mass);
-			vec3_translate_scaled(b->position, velocity, delta);
+	struct arena record = *mem_frame;
+	u32 *island_rest = arena_push(mem_frame, NULL, pipeline->awake_count * sizeof(u32));
+	for (i32 k = 0; k < pipeline->awake_count; ++k)
+	{
+		island_rest[k] = 0xffffffff;
+	}
 
-			vec3_add(world_AABB.center, b->local_box.center, pipeline->bodies[i].position);
-			vec3_copy(world_AABB.hw, b->local_box.hw);
-			const struct AABB *proxy = &pipeline->dynamic_tree.nodes[b->proxy].box;
-			if (!AABB_contains(proxy, &world_AABB))
-			{
-				world_AABB.hw[0] += pipeline->bodies[i].margin;
-				world_AABB.hw[1] += pipeline->bodies[i].margin;
-				world_AABB.hw[2] += pipeline->bodies[i].margin;
-				dbvt_remove(&pipeline->dynamic_tree, pipeline->bodies[i].proxy);
-				pipeline->bodies[i].proxy = dbvt_insert(&pipeline->dynamic_tree, i, &world_AABB);
-			}
+	vec3 velocity, w;
+	for (i32 k = 0; k < pipeline->awake_count; ++k)
+	{
+		const i32 i = pipeline->awake[k];
+		rbp_internal_body_velocity(velocity, pipeline, i);
+		mat3_vec_mul(w, pipeline->inv_inertia[i], pipeline->angular_momentum[i]);
+		pipeline->rest_frames[i] = (vec3_dot(velocity, velocity) < RBP_SLEEP_VELOCITY*RBP_SLEEP_VELOCITY
+				&& vec3_dot(w, w) < RBP_SLEEP_ANGULAR_VELOCITY*RBP_SLEEP_ANGULAR_VELOCITY) 
+			? pipeline->rest_frames[i] + 1 
+			: 0;
+		if (island[i] != -1 && pipeline->rest_frames[i] < island_rest[island[i]])
+		{
+			island_rest[island[i]] = pipeline->rest_frames[i];
+		}
+	}
 
-			/*L_new = L_old + Force*delta */
-			vec3_scale(force, pipeline->gravity, b->mass);
-			vec3_translate_scaled(b->linear_momentum, force, delta);
+	/* backwards, since a body put to sleep is replaced by the last awake body */
+	for (i32 k = pipeline->awake_count - 1; k >= 0; --k)
+	{
+		const i32 i = pipeline->awake[k];
+		const u32 rest = (island[i] == -1) ? pipeline->rest_frames[i] : island_rest[island[i]];
+		if (rest >= RBP_SLEEP_FRAMES)
+		{
+			rbp_internal_sleep(pipeline, i);
 		}
 	}
+
+	*mem_frame = record;
 }
 
 struct physics_output physics_output_cleared(void)
@@ -302,17 +2537,30 @@ struct physics_output rbp_simulate_frame(struct arena *mem_frame, struct rbp *pi
 	 * (2) get derivatives
 	 * (3) integrate
 	 * (4) collision step
-	 * (5) constraint step
+	 * (5) contact step, solving the velocities the next step integrates with
+	 * (6) put resting islands to sleep
 	 */
 	struct physics_output phy_out = { 0 };
 	
-	/* Apply forces, get derivatives and integrate */
-	/* super simpled euler integration */
-	rbp_internal_integrate(mem_frame, pipeline, delta);
+	rbp_internal_wake_removed(mem_frame, pipeline);
+
+	/* Sweep fast bodies, so they stop at their first time of impact instead of tunneling */
+	const f32 *step = rbp_internal_continuous_collision(mem_frame, pipeline, delta);
+
+	/* Apply forces, get derivatives and integrate, see pipeline->integrator */
+	rbp_internal_integrate(mem_frame, pipeline, delta, step);
 
 	i32 *overlaps = (i32 *) mem_frame->stack_ptr;
 	i32 overlap_pairs_count = internal_push_proxy_overlaps(mem_frame, pipeline);
 	phy_out.collisions = internal_push_collisions(mem_frame, pipeline, overlaps, overlap_pairs_count);
 
+	i32 *island = arena_push(mem_frame, NULL, pipeline->size * sizeof(i32));
+	for (i32 k = 0; k < pipeline->count; ++k)
+	{
+		island[pipeline->active[k]] = -1;
+	}
+	rbp_internal_solve_contacts(mem_frame, pipeline, island, overlaps, overlap_pairs_count, delta);
+	rbp_internal_update_sleep(mem_frame, pipeline, island);
+
 	return phy_out;
 }
@@ -5,6 +5,112 @@
 #include "mg_mempool.h"
 #include "dbvt.h"
 #include "rigid_body.h"
+#include "shape.h"
+#include "solver.h"
+#include "hash_index.h"
+
+/* collision hull budget of randomly constructed bodies */
+#define RBP_COLLISION_MAX_V_COUNT 32
+#define RBP_COLLISION_VOLUME_TOLERANCE 0.01f
+
+/* contact step */
+#define RBP_SOLVER_ITERATIONS		10
+#define RBP_CONTACT_MARGIN		0.05f	/* bodies closer than this get speculative contacts */
+#define RBP_CONTACT_CACHE_PER_BODY	8	/* contact points kept for warm starting, per body slot */
+#define RBP_MAX_THREADS			64
+#define RBP_COLOR_CONTACTS		256	/* islands with this many contacts are solved color by color on every thread */
+
+/* 
+ * an island of bodies sleeps once all of them have moved slower than RBP_SLEEP_VELOCITY and turned slower than
+ * RBP_SLEEP_ANGULAR_VELOCITY (radians per second) for RBP_SLEEP_FRAMES steps
+ */
+#define RBP_SLEEP_VELOCITY		0.05f
+#define RBP_SLEEP_ANGULAR_VELOCITY	0.05f
+#define RBP_SLEEP_FRAMES		30
+#define RBP_WAKE_BOX_MAX		64	/* removals per step that wake only their neighbourhood */
+
+/* 
+ * linear motion integrators, all of them step position and momentum over the same packed state. Contacts are solved
+ * on the velocity level after integration, so every integrator moves bodies with the solved momentum of the
+ * previous step.
+ */
+enum rbp_integrator
+{
+	RBP_INTEGRATOR_EULER,			/* explicit Euler, first order, the default */
+	RBP_INTEGRATOR_SYMPLECTIC_EULER,	/* momentum first, then position with the new momentum; first order */
+	RBP_INTEGRATOR_VERLET,			/* velocity Verlet, second order, two force evaluations */
+	RBP_INTEGRATOR_RK4,			/* classic Runge-Kutta, fourth order, four force evaluations */
+	RBP_INTEGRATOR_COUNT,
+};
+
+/*
+ * force fields - evaluated every step before integration as one pass per field over the awake bodies it acts on,
+ * bounded fields only act on the bodies whose proxies overlap their box (found through the dynamic tree). Gravity is
+ * the pipeline wide uniform field pipeline->gravity.
+ */
+#define RBP_FIELD_PER_BODY	2	/* field slots per body slot, springs being the fields that grow with the body count */
+
+enum rbp_field_type
+{
+	RBP_FIELD_UNIFORM,	/* F = m * acceleration */
+	RBP_FIELD_ATTRACTOR,	/* F = m * strength / r^2 towards point, r clamped to at least min_distance */
+	RBP_FIELD_DRAG,		/* F = -(linear + quadratic * |v|) * v, torque = -angular * w */
+	RBP_FIELD_BUOYANCY,	/* fluid filling box: F = -density * submerged volume * gravity - drag * submerged fraction * v */
+	RBP_FIELD_SPRING,	/* damped spring between the centers of mass of two bodies, or a body and an anchor */
+	RBP_FIELD_COUNT,
+};
+
+union rbp_field_value
+{
+	struct { vec3 acceleration; } uniform;
+	struct { vec3 point; f32 strength; f32 min_distance; } attractor;
+	struct { f32 linear; f32 quadratic; f32 angular; } drag;
+	struct { f32 density; f32 drag; } buoyancy;
+	/* body_2 = -1 anchors body_1 to anchor */
+	struct { i32 body_1; i32 body_2; vec3 anchor; f32 rest_length; f32 stiffness; f32 damping; } spring;
+};
+
+struct rbp_field
+{
+	enum rbp_field_type type;
+	u32 bounded;		/* act only within box; buoyancy fields are always bounded, springs never */
+	struct AABB box;
+	union rbp_field_value value;
+};
+
+/*
+ * joints - bilateral constraints between a dynamic body and a second body or the world, solved in the contact step
+ * together with the contacts of their island, so jointed bodies form one island and sleep together. Anchors and
+ * axes are kept in the body frames and brought to world frame every step; contacts between jointed bodies are
+ * skipped.
+ */
+#define RBP_JOINT_PER_BODY	2	/* joint slots per body slot */
+
+enum rbp_joint_type
+{
+	RBP_JOINT_BALL,		/* anchors coincide, free rotation */
+	RBP_JOINT_HINGE,	/* anchors coincide, rotation about axis only */
+	RBP_JOINT_PRISMATIC,	/* translation along axis only, no relative rotation */
+	RBP_JOINT_FIXED,	/* anchors coincide, no relative rotation */
+	RBP_JOINT_DISTANCE,	/* anchors keep their initial distance, free rotation */
+	RBP_JOINT_COUNT,
+};
+
+struct rbp_joint
+{
+	enum rbp_joint_type type;
+	i32 body_1;		/* dynamic */
+	i32 body_2;		/* -1 joins body_1 to the world, whose frame is the world frame */
+	vec3 anchor_1;		/* body 1 frame, relative to the center of mass */
+	vec3 anchor_2;		/* body 2 frame */
+	vec3 axis_1;		/* hinge and prismatic: unit axis, body 1 frame */
+	vec3 axis_2;		/* hinge: unit axis, body 2 frame */
+	quat relative;		/* q_1^-1 q_2 at creation, held by prismatic and fixed joints */
+	f32 length;		/* distance joint: anchor distance */
+	/* accumulated impulses on body 2 of the previous step, world frame, warm starting the solver */
+	vec3 linear_impulse;
+	vec3 angular_impulse;
+};
 
 struct physics_output
 {
@@ -12,29 +118,174 @@ struct physics_output
 	vec3ptr closest_point_pairs;
 	u32 point_pairs_count;
 };
+#define RBP_BODY_ACTIVE		(1u << 0)
+#define RBP_BODY_DYNAMIC	(1u << 1)
+#define RBP_BODY_FAST		(1u << 2)	/* swept against other bodies (CCD), see struct rigid_body */
+#define RBP_BODY_SLEEPING	(1u << 3)	/* dynamic body at rest, skipped until woken */
+
+/* 
+ * contact point of the previous step, identified by the body slots, the children (-1 for single hulls) and the
+ * generating hull vertex (see struct contact_patch), holding the accumulated impulses that warm start the solver
+ */
+struct rbp_contact_point
+{
+	i32 body_1;
+	i32 body_2;
+	i32 child_1;
+	i32 child_2;
+	u32 feature;
+	f32 normal_impulse;
+	vec3 friction_impulse;
+};
+
+/* 
+ * external reference to a body, field or joint slot; resolves to -1 once what it refers to has been removed (see
+ * rbp_handle_index, rbp_field_index and rbp_joint_index)
+ */
+struct rbp_handle
+{
+	i32 index;
+	u32 generation;
+};
+
 /*
- * Rigid Body Pipeline
+ * Rigid Body Pipeline - body state is split by access pattern. The hot state read and written every step (position,
+ * momentum, inverse mass, proxy, ...) is kept in one array per field, so the integrator and the proxy update stream
+ * only the bytes they use. The cold state (hulls, mass properties) stays in rigid_body records, where only the static
+ * state is valid after rbp_add.
  */
+struct rbp_workers;
+
 struct rbp
 {
 	i32 size;
 	i32 count;
+
+	/* active[0, count) packs the slots in use, active_index[slot] is the position of the slot in it, -1 if free */
+	i32 *active;
+	i32 *active_index;
+	u32 *slot_generation;		/* bumped when a slot is freed, see struct rbp_handle */
+
+	/* awake[0, awake_count) packs the dynamic bodies that are not sleeping, awake_index[slot] is -1 otherwise */
+	i32 *awake;
+	i32 *awake_index;
+	i32 awake_count;
+	u32 *rest_frames;		/* consecutive steps below RBP_SLEEP_VELOCITY */
+
+	/* 
+	 * proxies of bodies removed and boxes of fields changed since the last step; the bodies overlapping them are
+	 * woken at the start of the next step, all bodies are if more than RBP_WAKE_BOX_MAX boxes were queued
+	 */
+	struct AABB wake_box[RBP_WAKE_BOX_MAX];
+	u32 wake_count;
+
+	/* hot state, indexed by body slot */
+	vec3ptr position;		/* center of mass world frame position */
+	vec3ptr linear_momentum;	/* L = mv */
+	vec3ptr angular_momentum;	/* world frame, L = Iw */
+	vec3ptr force;			/* force accumulator, applied over the next step and then cleared */
+	vec3ptr torque;			/* world frame torque accumulator, as force */
+	vec3ptr velocity;		/* kinematic velocity, used by rbp_simulate */
+	quat *rotation;			/* body frame -> world frame */
+	f32 *inv_mass;			/* 1/mass of dynamic bodies, 0 for static bodies */
+	mat3 *inv_inertia_body;		/* body frame I^-1 of dynamic bodies, 0 for static bodies */
+	mat3 *inv_inertia;		/* world frame I^-1 = R I_body^-1 R^T, updated together with rotation */
+	f32 *margin;			/* proxy enlargement */
+	struct AABB *local_box;		/* body frame bounding box */
+	i32 *proxy;			/* dynamic tree leaf */
+	u32 *flags;			/* RBP_BODY_* */
+
+	/* cold state */
 	struct rigid_body *bodies;
 	struct dbvt dynamic_tree;
+	struct shape_registry shapes;	/* hulls shared between bodies, a body holds one reference to its shape */
+	u32 generation;	/* bumped on every add/remove, lets cached render data detect body set changes */
+
+	/* contact points of the previous step, replaced every step; rbp_remove evicts the points of the removed body, so a reused slot never inherits impulses */
+	struct hash_index *contact_hash;
+	struct rbp_contact_point *contact_cache;
+	u32 contact_count;
+	u32 contact_size;
+
+	u32 thread_count;	/* threads solving contact islands, the calling thread included, see rbp_new */
+	struct rbp_workers *workers;	/* island worker threads, persistent until rbp_free */
+	enum rbp_integrator integrator;	/* linear motion integrator, RBP_INTEGRATOR_EULER by default */
 
 	vec3 gravity;	/* gravity constant */
+
+	/* 
+	 * field[0, field_count) packs the fields, field_slot[i] is the slot of field i and field_index[slot] the
+	 * position of a slot in field, -1 if free; field_slot[field_count, field_size) holds the free slots
+	 */
+	struct rbp_field *field;
+	i32 *field_slot;
+	i32 *field_index;
+	u32 *field_generation;		/* bumped when a slot is freed, see struct rbp_handle */
+	u32 field_count;
+	u32 field_size;
+
+	/* joint[0, joint_count) packs the joints, with slots kept as for fields */
+	struct rbp_joint *joint;
+	i32 *joint_slot;
+	i32 *joint_index;
+	u32 *joint_generation;
+	u32 joint_count;
+	u32 joint_size;
 };
 
-struct 	rbp rbp_new(struct arena *mem, const i32 size);
-void rbp_add(struct rbp *pipeline, const i32 index, struct rigid_body *body, u32 dynamic);
+/* 
+ * pipeline of size body slots solving contact islands on thread_count threads (clamped to [1, RBP_MAX_THREADS]), the
+ * calling thread included; the thread_count - 1 worker threads are started here and run until rbp_free
+ */
+struct 	rbp rbp_new(struct arena *mem, const i32 size, const u32 thread_count);
+/* stop the worker threads; the pipeline memory is released together with mem */
+void	rbp_free(struct rbp *pipeline);
+/* add body into the free slot index in O(1), returns a handle to it */
+struct	rbp_handle rbp_add(struct rbp *pipeline, const i32 index, struct rigid_body *body, u32 dynamic);
+/* remove body index in O(1) by moving the last active slot into its place in the active list */
 void 	rbp_remove(struct rbp *pipeline, const i32 index);
+/* slot of a handle, -1 if the body it refers to has been removed */
+i32	rbp_handle_index(const struct rbp *pipeline, const struct rbp_handle handle);
+/* wake a sleeping body, see RBP_BODY_SLEEPING */
+void	rbp_wake(struct rbp *pipeline, const i32 index);
+/* L += impulse, waking the body */
+void	rbp_apply_linear_impulse(struct rbp *pipeline, const i32 index, const vec3 impulse);
+/* angular L += impulse (world frame), waking the body */
+void	rbp_apply_angular_impulse(struct rbp *pipeline, const i32 index, const vec3 impulse);
+/* accumulate a force at the center of mass over the next step, waking the body */
+void	rbp_apply_force(struct rbp *pipeline, const i32 index, const vec3 force);
+/* accumulate a force at the world point over the next step, together with its torque about the center of mass */
+void	rbp_apply_force_at(struct rbp *pipeline, const i32 index, const vec3 force, const vec3 point);
+/* accumulate a world frame torque over the next step, waking the body */
+void	rbp_apply_torque(struct rbp *pipeline, const i32 index, const vec3 torque);
+/* add a force field, waking the bodies it reaches; returns a handle to it, with index -1 if field_size fields exist */
+struct	rbp_handle rbp_field_add(struct rbp *pipeline, const struct rbp_field *field);
+/* remove a field in O(1) by moving the last field into its place; stale handles are ignored */
+void	rbp_field_remove(struct rbp *pipeline, const struct rbp_handle handle);
+/* position of a field in pipeline->field, -1 if it has been removed (springs are removed with their bodies) */
+i32	rbp_field_index(const struct rbp *pipeline, const struct rbp_handle handle);
+/* 
+ * join body_1 (dynamic) to body_2 (-1 for the world) at their current poses, anchor_1/anchor_2 and axis in world
+ * frame; the anchors coincide for every type but the distance joint. Returns a handle to the joint, with index -1 if
+ * joint_size joints exist. Joints of a removed body are removed with it.
+ */
+struct	rbp_handle rbp_joint_add(struct rbp *pipeline, const enum rbp_joint_type type, const i32 body_1, const i32 body_2, const vec3 anchor_1, const vec3 anchor_2, const vec3 axis);
+/* remove a joint in O(1) by moving the last joint into its place; stale handles are ignored */
+void	rbp_joint_remove(struct rbp *pipeline, const struct rbp_handle handle);
+/* position of a joint in pipeline->joint, -1 if it has been removed */
+i32	rbp_joint_index(const struct rbp *pipeline, const struct rbp_handle handle);
 void 	rbp_construct_random(struct arena *mem, struct rbp *pipeline, const u64 index, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena_collection *mem_tmp, const vec3 pos);
+/* construct count random bodies at pos[i] into index[i]; hulls are built on thread_count threads, point sets are pushed onto mem_tmp */
+void 	rbp_construct_random_batch(struct arena *mem, struct rbp *pipeline, const u64 *index, const vec3ptr pos, const u32 count, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena *mem_tmp, const u32 thread_count);
 
 void	rbp_push_dbvt(struct drawbuffer *buf, struct rbp *pipeline, const vec4 color);
 void	rbp_push_proxies(struct drawbuffer *buf, const struct rbp *pipeline, const vec4 color);
-void 	rbp_push_convex_hulls(const struct rbp *pipeline, struct drawbuffer *buf, const vec4 color, struct arena *mem_1, struct arena *mem_2, struct arena *mem_3, struct arena *mem_4, struct arena *mem_5, i32 i_count[], i32 i_offset[]);
+/* push local space meshes of active bodies tagged with their body index; only needs to be redone when pipeline->generation changes */
+void 	rbp_push_convex_hulls(const struct rbp *pipeline, struct drawbuffer *buf, const vec4 color, i32 i_count[], i32 i_offset[]);
 void	rbp_push_positions(void *buf, const struct rbp *pipeline);
 vec3ptr rbp_push_closest_points_between_bodies(struct arena *mem_frame, struct rbp *pipeline, u32 *pair_count);
+/* push indices of bodies within max_dist of body index onto mem->stack_ptr; returns number of bodies pushed */
+i32	rbp_push_bodies_within(struct arena *mem, struct rbp *pipeline, const i32 index, const f32 max_dist);
 
 i32 *	rbp_simulate(struct arena *mem_frame, struct rbp *pipeline, const f32 delta);
 
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "shape.h"
+#include "rigid_body.h"
+
+struct shape_registry shape_registry_new(struct arena *mem, const u32 size, const u32 collision_max_v_count, const f32 collision_volume_tolerance)
+{
+	struct shape_registry reg =
+	{
+		.hash = hash_new(mem, power_of_two_ceil(size), size),
+		.size = size,
+		.count = 0,
+		.max_used = 0,
+		.free = -1,
+		.free_block = NULL,
+		.free_size = 0,
+		.collision_max_v_count = collision_max_v_count,
+		.collision_volume_tolerance = collision_volume_tolerance,
+	};
+
+	if (mem)
+	{
+		reg.shapes = arena_push(mem, NULL, size * sizeof(struct shape));
+	}
+	else
+	{
+		reg.shapes = malloc(size * sizeof(struct shape));
+	}
+
+	return reg;
+}
+
+/* FNV-1a over the vertex and triangle data */
+static i32 shape_internal_key(const struct tri_mesh *mesh)
+{
+	u32 key = 2166136261u;
+	const u8 *data = (const u8 *) mesh->v;
+	for (u64 i = 0; i < mesh->v_count * sizeof(vec3); ++i)
+	{
+		key = (key ^ data[i]) * 16777619u;
+	}
+
+	data = (const u8 *) mesh->tri;
+	for (u64 i = 0; i < mesh->tri_count * sizeof(vec3u32); ++i)
+	{
+		key = (key ^ data[i]) * 16777619u;
+	}
+
+	return (i32) key;
+}
+
+/* shape vertices are the source vertices translated by -center_of_mass, so redo the translation and compare exactly */
+static u32 shape_internal_match(const struct shape *s, const struct tri_mesh *mesh)
+{
+	if (s->mesh.v_count != mesh->v_count || s->mesh.tri_count != mesh->tri_count
+			|| memcmp(s->mesh.tri, mesh->tri, mesh->tri_count * sizeof(vec3u32)) != 0)
+	{
+		return 0;
+	}
+
+	vec3 translation, p;
+	vec3_copy(translation, s->center_of_mass);
+	vec3_negative(translation);
+	for (u32 i = 0; i < mesh->v_count; ++i)
+	{
+		vec3_add(p, mesh->v[i], translation);
+		if (p[0] != s->mesh.v[i][0] || p[1] != s->mesh.v[i][1] || p[2] != s->mesh.v[i][2])
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* smallest released block of at least size bytes, or a new block pushed onto mem */
+static void *shape_internal_block_get(struct shape_registry *reg, struct arena *mem, const u64 size, u64 *block_size)
+{
+	for (struct shape_block **b = &reg->free_block; *b; b = &(*b)->next)
+	{
+		if ((*b)->size >= size)
+		{
+			struct shape_block *block = *b;
+			*b = block->next;
+			*block_size = block->size;
+			reg->free_size -= block->size;
+			return block;
+		}
+	}
+
+	*block_size = size;
+	return arena_push(mem, NULL, size);
+}
+
+static void shape_internal_block_put(struct shape_registry *reg, void *data, const u64 size)
+{
+	assert(size >= sizeof(struct shape_block));
+	struct shape_block *block = data;
+	block->size = size;
+	struct shape_block **b = &reg->free_block;
+	while (*b && (*b)->size < size)
+	{
+		b = &(*b)->next;
+	}
+	block->next = *b;
+	*b = block;
+	reg->free_size += size;
+}
+
+/* array sizes rounded up to keep every array of a block 16 byte aligned */
+static u64 shape_internal_align(const u64 size)
+{
+	return (size + 15) & ~((u64) 15);
+}
+
+/* move the hull arrays of body into one block owned by s */
+static void shape_internal_store(struct shape_registry *reg, struct arena *mem, struct shape *s, struct rigid_body *body)
+{
+	const u32 simplified = (body->collision.v != body->mesh.v);
+	const u64 size[4] =
+	{
+		shape_internal_align(body->mesh.v_count * sizeof(vec3)),
+		shape_internal_align(body->mesh.tri_count * sizeof(vec3u32)),
+		(simplified) ? shape_internal_align(body->collision.v_count * sizeof(vec3)) : 0,
+		(simplified) ? shape_internal_align(body->collision.tri_count * sizeof(vec3u32)) : 0,
+	};
+
+	u8 *block = shape_internal_block_get(reg, mem, size[0] + size[1] + size[2] + size[3], &s->block_size);
+	s->block = block;
+	s->mesh = body->mesh;
+	s->mesh.v = memcpy(block, body->mesh.v, body->mesh.v_count * sizeof(vec3));
+	s->mesh.tri = memcpy(block + size[0], body->mesh.tri, body->mesh.tri_count * sizeof(vec3u32));
+	s->collision = s->mesh;
+	if (simplified)
+	{
+		s->collision = body->collision;
+		s->collision.v = memcpy(block + size[0] + size[1], body->collision.v, body->collision.v_count * sizeof(vec3));
+		s->collision.tri = memcpy(block + size[0] + size[1] + size[2], body->collision.tri, body->collision.tri_count * sizeof(vec3u32));
+	}
+}
+
+i32 shape_registry_add(struct shape_registry *reg, struct arena *mem, struct arena *scratch, const struct tri_mesh *mesh)
+{
+	const i32 key = shape_internal_key(mesh);
+	for (i32 i = hash_first(reg->hash, key); i != -1; i = hash_next(reg->hash, i))
+	{
+		if (reg->shapes[i].key == key && shape_internal_match(reg->shapes + i, mesh))
+		{
+			reg->shapes[i].ref_count += 1;
+			return i;
+		}
+	}
+
+	i32 id;
+	if (reg->free != -1)
+	{
+		id = reg->free;
+		reg->free = reg->shapes[id].next_free;
+	}
+	else if (reg->max_used < reg->size)
+	{
+		id = (i32) reg->max_used++;
+	}
+	else
+	{
+		return -1;
+	}
+
+	/* 
+	 * statics_setup moves the vertices into the center of mass frame, so it runs on our own copy; the hulls are built
+	 * on scratch and then moved into the block of the shape
+	 */
+	struct arena record = *scratch;
+	struct tri_mesh copy =
+	{
+		.v = arena_push(scratch, mesh->v, mesh->v_count * sizeof(vec3)),
+		.tri = arena_push(scratch, mesh->tri, mesh->tri_count * sizeof(vec3u32)),
+		.v_count = mesh->v_count,
+		.tri_count = mesh->tri_count,
+	};
+
+	struct rigid_body body;
+	statics_setup(&body, scratch, &copy, 1.0f);
+	if (reg->collision_max_v_count)
+	{
+		struct arena mem_record = *mem;
+		rigid_body_simplify_collision(&body, mem, scratch, reg->collision_max_v_count, reg->collision_volume_tolerance);
+		if (body.collision.v != body.mesh.v)
+		{
+			body.collision.v = arena_push(scratch, body.collision.v, body.collision.v_count * sizeof(vec3));
+			body.collision.tri = arena_push(scratch, body.collision.tri, body.collision.tri_count * sizeof(vec3u32));
+		}
+		*mem = mem_record;
+	}
+	rigid_body_update_local_box(&body);
+
+	struct shape *s = reg->shapes + id;
+	shape_internal_store(reg, mem, s, &body);
+	*scratch = record;
+	s->local_box = body.local_box;
+	s->bounding_sphere = body.bounding_sphere;
+	memcpy(s->inertia_tensor, body.inertia_tensor, sizeof(mat3));
+	vec3_copy(s->center_of_mass, body.position);
+	s->volume = body.mass;
+	s->key = key;
+	s->ref_count = 1;
+	s->next_free = -1;
+
+	hash_add(reg->hash, key, id);
+	reg->count += 1;
+
+	return id;
+}
+
+void shape_registry_acquire(struct shape_registry *reg, const i32 id)
+{
+	assert(id >= 0 && (u32) id < reg->max_used && reg->shapes[id].ref_count > 0);
+	reg->shapes[id].ref_count += 1;
+}
+
+void shape_registry_release(struct shape_registry *reg, const i32 id)
+{
+	assert(id >= 0 && (u32) id < reg->max_used && reg->shapes[id].ref_count > 0);
+
+	struct shape *s = reg->shapes + id;
+	s->ref_count -= 1;
+	if (s->ref_count == 0)
+	{
+		hash_remove(reg->hash, s->key, id);
+		shape_internal_block_put(reg, s->block, s->block_size);
+		s->block = NULL;
+		s->next_free = reg->free;
+		reg->free = id;
+		reg->count -= 1;
+	}
+}
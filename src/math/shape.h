@@ -0,0 +1,66 @@
+#ifndef __SHAPE_H__
+#define __SHAPE_H__
+
+#include "mg_common.h"
+#include "mg_mempool.h"
+#include "hash_index.h"
+#include "geometry.h"
+
+/*
+ * Shape - a hull and its unit density mass properties, shared by every body spawned from identical hull data.
+ */
+struct shape
+{
+	struct tri_mesh mesh;		/* hull in shape frame, center of mass at the origin */
+	struct tri_mesh collision;	/* narrowphase hull, mesh unless simplified */
+	struct AABB local_box;		/* bounding AABB of the collision hull in shape frame */
+	struct sphere bounding_sphere;	/* shape frame bounding sphere of the collision hull */
+	mat3 inertia_tensor;		/* inertia tensor at unit density */
+	vec3 center_of_mass;		/* center of mass in the frame of the source hull */
+	f32 volume;			/* mass at unit density */
+	i32 key;			/* hash of the source hull */
+	i32 ref_count;			/* 0 if the slot is free */
+	i32 next_free;
+	void *block;			/* memory holding the hull arrays of mesh and collision */
+	u64 block_size;
+};
+
+/* released hull memory, the header is kept in the block itself */
+struct shape_block
+{
+	struct shape_block *next;
+	u64 size;
+};
+
+/*
+ * Shape registry - maps hull data to shape ids, so that memory and statics setup are O(unique shapes). Shapes are
+ * looked up by a hash of the source vertices and triangles and compared exactly. Released shapes free their slot
+ * for reuse and put their hull memory on a free list ordered by size, from which new shapes take the smallest block
+ * that fits before pushing onto the arena.
+ */
+struct shape_registry
+{
+	struct hash_index *hash;
+	struct shape *shapes;
+	u32 size;
+	u32 count;			/* shapes with references */
+	u32 max_used;			/* slots [0, max_used) have been handed out at least once */
+	i32 free;			/* first free slot, -1 if none */
+	struct shape_block *free_block;	/* released hull memory, smallest block first */
+	u64 free_size;			/* bytes in released blocks */
+	u32 collision_max_v_count;	/* collision hull budget of new shapes, 0 keeps the full hull */
+	f32 collision_volume_tolerance;
+};
+
+struct shape_registry shape_registry_new(struct arena *mem, const u32 size, const u32 collision_max_v_count, const f32 collision_volume_tolerance);
+/**
+ * Return the shape id of mesh (in any frame), taking a reference. New shapes copy the hull onto mem, run statics
+ * setup at unit density and build the collision hull using scratch; the caller's mesh is left untouched. Returns
+ * -1 if the registry is full.
+ */
+i32 shape_registry_add(struct shape_registry *reg, struct arena *mem, struct arena *scratch, const struct tri_mesh *mesh);
+void shape_registry_acquire(struct shape_registry *reg, const i32 id);
+/* drop a reference, the slot and the hull memory are freed when the last reference is dropped */
+void shape_registry_release(struct shape_registry *reg, const i32 id);
+
+#endif
@@ -0,0 +1,616 @@
+#include <float.h>
+#include <string.h>
+
+#include "solver.h"
+
+/* one constraint row of every lane in a batch */
+struct solver_row
+{
+	f32 dir[3][SOLVER_LANES];
+	f32 ang_1[3][SOLVER_LANES];	/* r_1 x dir */
+	f32 ang_2[3][SOLVER_LANES];	/* r_2 x dir */
+	f32 inv_ang_1[3][SOLVER_LANES];	/* I_1^-1 (r_1 x dir) */
+	f32 inv_ang_2[3][SOLVER_LANES];	/* I_2^-1 (r_2 x dir) */
+	f32 mass[SOLVER_LANES];		/* effective mass 1 / (J M^-1 J^T) */
+	f32 impulse[SOLVER_LANES];	/* accumulated impulse */
+};
+
+struct solver_batch
+{
+	struct solver_row row[3];	/* normal, tangent 1, tangent 2 */
+	f32 bias[SOLVER_LANES];		/* normal row target velocity */
+	f32 friction[SOLVER_LANES];
+	f32 inv_mass_1[SOLVER_LANES];
+	f32 inv_mass_2[SOLVER_LANES];
+	u32 body_1[SOLVER_LANES];
+	u32 body_2[SOLVER_LANES];
+	i32 contact[SOLVER_LANES];	/* -1 for padding lanes, which have zero rows and are never scattered */
+	u32 lane_count;
+};
+
+/* one block of joint rows, see struct solver_joint; unused rows are zero */
+struct solver_block
+{
+	vec3 dir[3];		/* linear part of the rows, zero for angular rows */
+	vec3 ang_1[3];
+	vec3 ang_2[3];
+	vec3 inv_ang_1[3];	/* I_1^-1 ang_1 */
+	vec3 inv_ang_2[3];	/* I_2^-1 ang_2 */
+	mat3 mass;		/* K^-1 = (J M^-1 J^T)^-1, identity padded for unused rows */
+	vec3 bias;
+	vec3 impulse;		/* accumulated */
+	u32 count;
+};
+
+struct solver_joint_block
+{
+	struct solver_block block[2];	/* linear, angular */
+	u32 body_1;
+	u32 body_2;
+	f32 inv_mass_1;
+	f32 inv_mass_2;
+};
+
+static void solver_internal_gather(__m128 out[3], const vec3ptr v, const u32 index[SOLVER_LANES])
+{
+	for (u32 j = 0; j < 3; ++j)
+	{
+		out[j] = _mm_set_ps(v[index[3]][j], v[index[2]][j], v[index[1]][j], v[index[0]][j]);
+	}
+}
+
+/* static bodies are never written, so islands sharing them can be solved concurrently */
+static void solver_internal_scatter(vec3ptr v, const u32 index[SOLVER_LANES], const i32 contact[SOLVER_LANES], const f32 inv_mass[SOLVER_LANES], const __m128 in[3])
+{
+	f32 lane[3][SOLVER_LANES];
+	for (u32 j = 0; j < 3; ++j)
+	{
+		_mm_storeu_ps(lane[j], in[j]);
+	}
+
+	for (u32 l = 0; l < SOLVER_LANES; ++l)
+	{
+		if (contact[l] != -1 && inv_mass[l] > 0.0f)
+		{
+			vec3_set(v[index[l]], lane[0][l], lane[1][l], lane[2][l]);
+		}
+	}
+}
+
+static inline void solver_internal_load(__m128 out[3], f32 in[3][SOLVER_LANES])
+{
+	out[0] = _mm_loadu_ps(in[0]);
+	out[1] = _mm_loadu_ps(in[1]);
+	out[2] = _mm_loadu_ps(in[2]);
+}
+
+static inline __m128 solver_internal_dot(const __m128 a[3], const __m128 b[3])
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+}
+
+/* apply the impulse lambda*dir on body 2 and its opposite on body 1 */
+static void solver_internal_apply_row(struct solver_row *row, __m128 v_1[3], __m128 w_1[3], __m128 v_2[3], __m128 w_2[3], const __m128 im_1, const __m128 im_2, const __m128 lambda)
+{
+	__m128 dir[3], inv_ang_1[3], inv_ang_2[3];
+	solver_internal_load(dir, row->dir);
+	solver_internal_load(inv_ang_1, row->inv_ang_1);
+	solver_internal_load(inv_ang_2, row->inv_ang_2);
+	const __m128 l_1 = _mm_mul_ps(lambda, im_1);
+	const __m128 l_2 = _mm_mul_ps(lambda, im_2);
+	for (u32 j = 0; j < 3; ++j)
+	{
+		v_1[j] = _mm_sub_ps(v_1[j], _mm_mul_ps(dir[j], l_1));
+		w_1[j] = _mm_sub_ps(w_1[j], _mm_mul_ps(inv_ang_1[j], lambda));
+		v_2[j] = _mm_add_ps(v_2[j], _mm_mul_ps(dir[j], l_2));
+		w_2[j] = _mm_add_ps(w_2[j], _mm_mul_ps(inv_ang_2[j], lambda));
+	}
+}
+
+/* drive the relative velocity along the row towards bias, keeping the accumulated impulse within [lo, hi] */
+static void solver_internal_solve_row(struct solver_row *row, __m128 v_1[3], __m128 w_1[3], __m128 v_2[3], __m128 w_2[3], const __m128 im_1, const __m128 im_2, const __m128 bias, const __m128 lo, const __m128 hi)
+{
+	__m128 dir[3], ang_1[3], ang_2[3], dv[3];
+	solver_internal_load(dir, row->dir);
+	solver_internal_load(ang_1, row->ang_1);
+	solver_internal_load(ang_2, row->ang_2);
+	for (u32 j = 0; j < 3; ++j)
+	{
+		dv[j] = _mm_sub_ps(v_2[j], v_1[j]);
+	}
+
+	const __m128 vn = _mm_sub_ps(_mm_add_ps(solver_internal_dot(dir, dv), solver_internal_dot(ang_2, w_2)), solver_internal_dot(ang_1, w_1));
+	const __m128 old = _mm_loadu_ps(row->impulse);
+	const __m128 impulse = _mm_min_ps(_mm_max_ps(_mm_add_ps(old, _mm_mul_ps(_mm_loadu_ps(row->mass), _mm_sub_ps(bias, vn))), lo), hi);
+	_mm_storeu_ps(row->impulse, impulse);
+	solver_internal_apply_row(row, v_1, w_1, v_2, w_2, im_1, im_2, _mm_sub_ps(impulse, old));
+}
+
+static void solver_internal_setup_lane(struct solver_batch *batch, const struct solver_bodies *bodies, const struct solver_contact *c, const i32 index, const f32 delta)
+{
+	const u32 l = batch->lane_count++;
+	const f32 im_1 = bodies->inv_mass[c->body_1];
+	const f32 im_2 = bodies->inv_mass[c->body_2];
+	batch->contact[l] = index;
+	batch->body_1[l] = c->body_1;
+	batch->body_2[l] = c->body_2;
+	batch->inv_mass_1[l] = im_1;
+	batch->inv_mass_2[l] = im_2;
+	batch->friction[l] = c->friction;
+
+	vec3 dir[3];
+	vec3_copy(dir[0], c->normal);
+	vec3_create_basis(dir[1], dir[2], c->normal);
+	const f32 impulse[3] = { c->normal_impulse, vec3_dot(c->friction_impulse, dir[1]), vec3_dot(c->friction_impulse, dir[2]) };
+
+	vec3 ang_1, ang_2, inv_ang_1, inv_ang_2;
+	for (u32 r = 0; r < 3; ++r)
+	{
+		struct solver_row *row = batch->row + r;
+		vec3_cross(ang_1, c->r_1, dir[r]);
+		vec3_cross(ang_2, c->r_2, dir[r]);
+		mat3_vec_mul(inv_ang_1, bodies->inv_inertia[c->body_1], ang_1);
+		mat3_vec_mul(inv_ang_2, bodies->inv_inertia[c->body_2], ang_2);
+		for (u32 j = 0; j < 3; ++j)
+		{
+			row->dir[j][l] = dir[r][j];
+			row->ang_1[j][l] = ang_1[j];
+			row->ang_2[j][l] = ang_2[j];
+			row->inv_ang_1[j][l] = inv_ang_1[j];
+			row->inv_ang_2[j][l] = inv_ang_2[j];
+		}
+
+		const f32 k = im_1 + im_2 + vec3_dot(ang_1, inv_ang_1) + vec3_dot(ang_2, inv_ang_2);
+		row->mass[l] = (k > 0.0f) ? 1.0f / k : 0.0f;
+		row->impulse[l] = impulse[r];
+	}
+
+	/* approach velocity before warm starting, v_rel = (v_2 + w_2 x r_2) - (v_1 + w_1 x r_1) */
+	vec3 v_1, v_2;
+	vec3_cross(v_1, bodies->angular_velocity[c->body_1], c->r_1);
+	vec3_cross(v_2, bodies->angular_velocity[c->body_2], c->r_2);
+	vec3_translate(v_1, bodies->linear_velocity[c->body_1]);
+	vec3_translate(v_2, bodies->linear_velocity[c->body_2]);
+	const f32 vn = vec3_dot(c->normal, v_2) - vec3_dot(c->normal, v_1);
+
+	/*
+	 * penetration beyond the slop is pushed out over a few steps; a speculative contact lets the bodies close the
+	 * gap within this step but no further
+	 */
+	f32 bias = 0.0f;
+	if (c->depth > SOLVER_PENETRATION_SLOP)
+	{
+		bias = SOLVER_BAUMGARTE * (c->depth - SOLVER_PENETRATION_SLOP) / delta;
+	}
+	else if (c->depth < 0.0f)
+	{
+		bias = c->depth / delta;
+	}
+
+	if (vn < -SOLVER_RESTITUTION_THRESHOLD)
+	{
+		bias = fmaxf(bias, -c->restitution * vn);
+	}
+	batch->bias[l] = bias;
+}
+
+/* padding lanes copy the bodies of lane 0 and have zero rows, so they neither change nor write any velocity */
+static void solver_internal_pad(struct solver_batch *batch)
+{
+	for (u32 l = batch->lane_count; l < SOLVER_LANES; ++l)
+	{
+		batch->contact[l] = -1;
+		batch->body_1[l] = batch->body_1[0];
+		batch->body_2[l] = batch->body_2[0];
+	}
+}
+
+/* rows with dir = 0 are angular rows, ang_1 = ang_2 = axis */
+static void solver_internal_setup_block(struct solver_block *block, const struct solver_joint_block *j, const struct solver_bodies *bodies, const vec3 *dir, const vec3 *ang_1, const vec3 *ang_2, const f32 *error, const vec3 impulse, const u32 count, const f32 delta)
+{
+	memset(block, 0, sizeof(struct solver_block));
+	block->count = count;
+	for (u32 r = 0; r < count; ++r)
+	{
+		vec3_copy(block->dir[r], dir[r]);
+		vec3_copy(block->ang_1[r], ang_1[r]);
+		vec3_copy(block->ang_2[r], ang_2[r]);
+		mat3_vec_mul(block->inv_ang_1[r], bodies->inv_inertia[j->body_1], ang_1[r]);
+		mat3_vec_mul(block->inv_ang_2[r], bodies->inv_inertia[j->body_2], ang_2[r]);
+		block->bias[r] = SOLVER_BAUMGARTE * error[r] / delta;
+		/* rows are orthonormal, so projecting the world impulse recovers the row impulses */
+		block->impulse[r] = vec3_dot(impulse, (vec3_dot(dir[r], dir[r]) > 0.0f) ? dir[r] : ang_1[r]);
+	}
+
+	mat3 k;
+	mat3_identity(k);
+	const f32 im = j->inv_mass_1 + j->inv_mass_2;
+	for (u32 r = 0; r < count; ++r)
+	{
+		for (u32 c = 0; c < count; ++c)
+		{
+			k[c][r] = im * vec3_dot(dir[r], dir[c]) + vec3_dot(ang_1[r], block->inv_ang_1[c]) + vec3_dot(ang_2[r], block->inv_ang_2[c]);
+		}
+	}
+
+	/* both bodies static or the rows dependent, nothing to solve */
+	if (mat3_inverse(block->mass, k) <= 0.0f)
+	{
+		memset(block->mass, 0, sizeof(mat3));
+	}
+}
+
+/* apply the row impulses lambda on body 2 and their opposite on body 1 */
+static void solver_internal_apply_block(const struct solver_block *block, const struct solver_joint_block *j, struct solver_bodies *bodies, const vec3 lambda)
+{
+	vec3ptr v_1 = bodies->linear_velocity + j->body_1;
+	vec3ptr w_1 = bodies->angular_velocity + j->body_1;
+	vec3ptr v_2 = bodies->linear_velocity + j->body_2;
+	vec3ptr w_2 = bodies->angular_velocity + j->body_2;
+	for (u32 r = 0; r < block->count; ++r)
+	{
+		vec3_translate_scaled(*v_1, block->dir[r], -lambda[r] * j->inv_mass_1);
+		vec3_translate_scaled(*w_1, block->inv_ang_1[r], -lambda[r]);
+		vec3_translate_scaled(*v_2, block->dir[r], lambda[r] * j->inv_mass_2);
+		vec3_translate_scaled(*w_2, block->inv_ang_2[r], lambda[r]);
+	}
+}
+
+/* drive the relative velocity of all rows of the block to -bias at once, lambda = -K^-1 (J v + bias) */
+static void solver_internal_solve_block(struct solver_block *block, const struct solver_joint_block *j, struct solver_bodies *bodies)
+{
+	const vec3ptr v_1 = bodies->linear_velocity + j->body_1;
+	const vec3ptr w_1 = bodies->angular_velocity + j->body_1;
+	const vec3ptr v_2 = bodies->linear_velocity + j->body_2;
+	const vec3ptr w_2 = bodies->angular_velocity + j->body_2;
+
+	vec3 dv, rhs, lambda;
+	vec3_sub(dv, *v_2, *v_1);
+	vec3_set(rhs, 0.0f, 0.0f, 0.0f);
+	for (u32 r = 0; r < block->count; ++r)
+	{
+		const f32 jv = vec3_dot(block->dir[r], dv) + vec3_dot(block->ang_2[r], *w_2) - vec3_dot(block->ang_1[r], *w_1);
+		rhs[r] = -(jv + block->bias[r]);
+	}
+
+	mat3_vec_mul(lambda, block->mass, rhs);
+	vec3_translate(block->impulse, lambda);
+	solver_internal_apply_block(block, j, bodies, lambda);
+}
+
+static void solver_internal_setup_joint(struct solver_joint_block *j, const struct solver_bodies *bodies, const struct solver_joint *joint, const f32 delta)
+{
+	j->body_1 = joint->body_1;
+	j->body_2 = joint->body_2;
+	j->inv_mass_1 = bodies->inv_mass[joint->body_1];
+	j->inv_mass_2 = bodies->inv_mass[joint->body_2];
+
+	vec3 ang_1[3], ang_2[3];
+	for (u32 r = 0; r < joint->linear_count; ++r)
+	{
+		vec3_cross(ang_1[r], joint->r_1, joint->linear[r]);
+		vec3_cross(ang_2[r], joint->r_2, joint->linear[r]);
+	}
+	solver_internal_setup_block(j->block + 0, j, bodies, joint->linear, ang_1, ang_2, joint->linear_error, joint->linear_impulse, joint->linear_count, delta);
+
+	const vec3 zero[3] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+	solver_internal_setup_block(j->block + 1, j, bodies, zero, joint->angular, joint->angular, joint->angular_error, joint->angular_impulse, joint->angular_count, delta);
+}
+
+u64 solver_scratch_size(const u32 contact_count, const u32 joint_count, const u32 body_count)
+{
+	return contact_count * sizeof(struct solver_batch) + joint_count * sizeof(struct solver_joint_block) + body_count * sizeof(i32) + 3 * MEMORY_ALIGNMENT;
+}
+
+/* set up the joint blocks and apply their accumulated impulses of the previous step */
+static struct solver_joint_block *solver_internal_setup_joints(struct arena *mem, struct solver_bodies *bodies, const struct solver_joint *joint, const u32 joint_count, const f32 delta)
+{
+	struct solver_joint_block *joint_block = NULL;
+	if (joint_count)
+	{
+		joint_block = arena_push(mem, NULL, joint_count * sizeof(struct solver_joint_block));
+		for (u32 i = 0; i < joint_count; ++i)
+		{
+			solver_internal_setup_joint(joint_block + i, bodies, joint + i, delta);
+			solver_internal_apply_block(joint_block[i].block + 0, joint_block + i, bodies, joint_block[i].block[0].impulse);
+			solver_internal_apply_block(joint_block[i].block + 1, joint_block + i, bodies, joint_block[i].block[1].impulse);
+		}
+	}
+
+	return joint_block;
+}
+
+/*
+ * Greedy batching of the contacts index[0, count) (contact i if index == NULL) into batch[first, ...): a contact goes 
+ * into the first batch with a free lane after the last batch holding either of its dynamic bodies. first_open skips 
+ * the prefix of full batches. last[body] must be below first or -1 for every body. Returns the end of the batches.
+ */
+static u32 solver_internal_batch(struct solver_batch *batch, i32 *last, const struct solver_bodies *bodies, const struct solver_contact *contact, const u32 *index, const u32 count, const u32 first, const f32 delta)
+{
+	u32 batch_count = first;
+	u32 first_open = first;
+	for (u32 n = 0; n < count; ++n)
+	{
+		const u32 i = (index) ? index[n] : n;
+		const struct solver_contact *c = contact + i;
+		const u32 dynamic_1 = bodies->inv_mass[c->body_1] > 0.0f;
+		const u32 dynamic_2 = bodies->inv_mass[c->body_2] > 0.0f;
+		i32 b = (i32) first_open;
+		b = (dynamic_1 && last[c->body_1] >= b) ? last[c->body_1] + 1 : b;
+		b = (dynamic_2 && last[c->body_2] >= b) ? last[c->body_2] + 1 : b;
+		while ((u32) b < batch_count && batch[b].lane_count == SOLVER_LANES)
+		{
+			b += 1;
+		}
+		batch_count = ((u32) b + 1 > batch_count) ? (u32) b + 1 : batch_count;
+
+		solver_internal_setup_lane(batch + b, bodies, c, (i32) i, delta);
+		last[c->body_1] = (dynamic_1) ? b : last[c->body_1];
+		last[c->body_2] = (dynamic_2) ? b : last[c->body_2];
+		while (first_open < batch_count && batch[first_open].lane_count == SOLVER_LANES)
+		{
+			first_open += 1;
+		}
+	}
+
+	for (u32 b = first; b < batch_count; ++b)
+	{
+		solver_internal_pad(batch + b);
+	}
+
+	return batch_count;
+}
+
+/* apply the accumulated impulses of the previous step of batch[first, end) */
+static void solver_internal_warm_start(struct solver_bodies *bodies, struct solver_batch *batch, const u32 first, const u32 end)
+{
+	__m128 v_1[3], w_1[3], v_2[3], w_2[3];
+	for (u32 b = first; b < end; ++b)
+	{
+		struct solver_batch *s = batch + b;
+		const __m128 im_1 = _mm_loadu_ps(s->inv_mass_1);
+		const __m128 im_2 = _mm_loadu_ps(s->inv_mass_2);
+		solver_internal_gather(v_1, bodies->linear_velocity, s->body_1);
+		solver_internal_gather(w_1, bodies->angular_velocity, s->body_1);
+		solver_internal_gather(v_2, bodies->linear_velocity, s->body_2);
+		solver_internal_gather(w_2, bodies->angular_velocity, s->body_2);
+		for (u32 r = 0; r < 3; ++r)
+		{
+			solver_internal_apply_row(s->row + r, v_1, w_1, v_2, w_2, im_1, im_2, _mm_loadu_ps(s->row[r].impulse));
+		}
+		solver_internal_scatter(bodies->linear_velocity, s->body_1, s->contact, s->inv_mass_1, v_1);
+		solver_internal_scatter(bodies->angular_velocity, s->body_1, s->contact, s->inv_mass_1, w_1);
+		solver_internal_scatter(bodies->linear_velocity, s->body_2, s->contact, s->inv_mass_2, v_2);
+		solver_internal_scatter(bodies->angular_velocity, s->body_2, s->contact, s->inv_mass_2, w_2);
+	}
+}
+
+/* one sweep over every stride'th batch of batch[first, end); friction first, so the non-penetration rows have the final say */
+static void solver_internal_sweep(struct solver_bodies *bodies, struct solver_batch *batch, const u32 first, const u32 end, const u32 stride)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 inf = _mm_set1_ps(FLT_MAX);
+	__m128 v_1[3], w_1[3], v_2[3], w_2[3];
+	for (u32 b = first; b < end; b += stride)
+	{
+		struct solver_batch *s = batch + b;
+		const __m128 im_1 = _mm_loadu_ps(s->inv_mass_1);
+		const __m128 im_2 = _mm_loadu_ps(s->inv_mass_2);
+		solver_internal_gather(v_1, bodies->linear_velocity, s->body_1);
+		solver_internal_gather(w_1, bodies->angular_velocity, s->body_1);
+		solver_internal_gather(v_2, bodies->linear_velocity, s->body_2);
+		solver_internal_gather(w_2, bodies->angular_velocity, s->body_2);
+
+		const __m128 max_friction = _mm_mul_ps(_mm_loadu_ps(s->friction), _mm_loadu_ps(s->row[0].impulse));
+		const __m128 min_friction = _mm_sub_ps(zero, max_friction);
+		solver_internal_solve_row(s->row + 1, v_1, w_1, v_2, w_2, im_1, im_2, zero, min_friction, max_friction);
+		solver_internal_solve_row(s->row + 2, v_1, w_1, v_2, w_2, im_1, im_2, zero, min_friction, max_friction);
+		solver_internal_solve_row(s->row + 0, v_1, w_1, v_2, w_2, im_1, im_2, _mm_loadu_ps(s->bias), zero, inf);
+
+		solver_internal_scatter(bodies->linear_velocity, s->body_1, s->contact, s->inv_mass_1, v_1);
+		solver_internal_scatter(bodies->angular_velocity, s->body_1, s->contact, s->inv_mass_1, w_1);
+		solver_internal_scatter(bodies->linear_velocity, s->body_2, s->contact, s->inv_mass_2, v_2);
+		solver_internal_scatter(bodies->angular_velocity, s->body_2, s->contact, s->inv_mass_2, w_2);
+	}
+}
+
+static void solver_internal_sweep_joints(struct solver_bodies *bodies, struct solver_joint_block *joint_block, const u32 joint_count)
+{
+	for (u32 i = 0; i < joint_count; ++i)
+	{
+		solver_internal_solve_block(joint_block[i].block + 0, joint_block + i, bodies);
+		solver_internal_solve_block(joint_block[i].block + 1, joint_block + i, bodies);
+	}
+}
+
+/* hand the accumulated impulses back for warm starting the next step */
+static void solver_internal_store(struct solver_contact *contact, const struct solver_batch *batch, const u32 batch_count, struct solver_joint *joint, const struct solver_joint_block *joint_block, const u32 joint_count)
+{
+	for (u32 b = 0; b < batch_count; ++b)
+	{
+		const struct solver_batch *s = batch + b;
+		for (u32 l = 0; l < s->lane_count; ++l)
+		{
+			struct solver_contact *c = contact + s->contact[l];
+			c->normal_impulse = s->row[0].impulse[l];
+			for (u32 j = 0; j < 3; ++j)
+			{
+				c->friction_impulse[j] = s->row[1].impulse[l] * s->row[1].dir[j][l] + s->row[2].impulse[l] * s->row[2].dir[j][l];
+			}
+		}
+	}
+
+	for (u32 i = 0; i < joint_count; ++i)
+	{
+		const struct solver_block *linear = joint_block[i].block + 0;
+		const struct solver_block *angular = joint_block[i].block + 1;
+		vec3_set(joint[i].linear_impulse, 0.0f, 0.0f, 0.0f);
+		vec3_set(joint[i].angular_impulse, 0.0f, 0.0f, 0.0f);
+		for (u32 r = 0; r < linear->count; ++r)
+		{
+			vec3_translate_scaled(joint[i].linear_impulse, linear->dir[r], linear->impulse[r]);
+		}
+		for (u32 r = 0; r < angular->count; ++r)
+		{
+			vec3_translate_scaled(joint[i].angular_impulse, angular->ang_2[r], angular->impulse[r]);
+		}
+	}
+}
+
+void solver_solve(struct arena *mem, struct solver_bodies *bodies, struct solver_contact *contact, const u32 contact_count, struct solver_joint *joint, const u32 joint_count, const f32 delta, const u32 iterations)
+{
+	if (contact_count + joint_count == 0)
+	{
+		return;
+	}
+
+	struct arena record = *mem;
+
+	struct solver_joint_block *joint_block = solver_internal_setup_joints(mem, bodies, joint, joint_count, delta);
+
+	const u32 count = contact_count;
+	struct solver_batch *batch = (count) ? arena_push(mem, NULL, count * sizeof(struct solver_batch)) : NULL;
+	i32 *last = (count) ? arena_push(mem, NULL, bodies->count * sizeof(i32)) : NULL;
+	for (u32 i = 0; count && i < bodies->count; ++i)
+	{
+		last[i] = -1;
+	}
+	if (count)
+	{
+		memset(batch, 0, count * sizeof(struct solver_batch));
+	}
+
+	const u32 batch_count = solver_internal_batch(batch, last, bodies, contact, NULL, count, 0, delta);
+
+	/* warm start with the accumulated impulses of the previous step */
+	solver_internal_warm_start(bodies, batch, 0, batch_count);
+
+	for (u32 it = 0; it < iterations; ++it)
+	{
+		solver_internal_sweep_joints(bodies, joint_block, joint_count);
+		solver_internal_sweep(bodies, batch, 0, batch_count, 1);
+	}
+
+	solver_internal_store(contact, batch, batch_count, joint, joint_block, joint_count);
+
+	*mem = record;
+}
+
+u64 solver_color_scratch_size(const u32 contact_count, const u32 joint_count, const u32 body_count)
+{
+	return solver_scratch_size(contact_count, joint_count, body_count) + 2 * contact_count * sizeof(u32) + body_count * sizeof(u64) + 3 * MEMORY_ALIGNMENT;
+}
+
+void solver_color_setup(struct solver_colored *colored, struct arena *mem, struct solver_bodies *bodies, struct solver_contact *contact, const u32 contact_count, struct solver_joint *joint, const u32 joint_count, const f32 delta)
+{
+	colored->record = *mem;
+	colored->bodies = bodies;
+	colored->contact = contact;
+	colored->joint = joint;
+	colored->joint_count = joint_count;
+	colored->joint_block = solver_internal_setup_joints(mem, bodies, joint, joint_count, delta);
+	colored->batch = NULL;
+	colored->batch_count = 0;
+	colored->color_count = 0;
+	colored->serial = 0;
+	if (contact_count == 0)
+	{
+		return;
+	}
+
+	/* 
+	 * greedy coloring: a contact takes the lowest color none of its dynamic bodies has yet; contacts of bodies out
+	 * of colors go into the serial color SOLVER_MAX_COLORS
+	 */
+	const u32 count = contact_count;
+	u64 *used = arena_push(mem, NULL, bodies->count * sizeof(u64));
+	u32 *color = arena_push(mem, NULL, count * sizeof(u32));
+	u32 color_size[SOLVER_MAX_COLORS + 1] = { 0 };
+	memset(used, 0, bodies->count * sizeof(u64));
+	for (u32 i = 0; i < count; ++i)
+	{
+		const struct solver_contact *c = contact + i;
+		const u64 mask_1 = (bodies->inv_mass[c->body_1] > 0.0f) ? used[c->body_1] : 0;
+		const u64 mask_2 = (bodies->inv_mass[c->body_2] > 0.0f) ? used[c->body_2] : 0;
+		const u64 free = ~(mask_1 | mask_2);
+		color[i] = (free) ? (u32) __builtin_ctzll(free) : SOLVER_MAX_COLORS;
+		if (color[i] < SOLVER_MAX_COLORS)
+		{
+			used[c->body_1] |= (bodies->inv_mass[c->body_1] > 0.0f) ? ((u64) 1 << color[i]) : 0;
+			used[c->body_2] |= (bodies->inv_mass[c->body_2] > 0.0f) ? ((u64) 1 << color[i]) : 0;
+		}
+		color_size[color[i]] += 1;
+	}
+
+	/* contacts ordered by color, in contact order within a color */
+	u32 color_offset[SOLVER_MAX_COLORS + 1];
+	u32 offset = 0;
+	for (u32 k = 0; k <= SOLVER_MAX_COLORS; ++k)
+	{
+		color_offset[k] = offset;
+		offset += color_size[k];
+	}
+	u32 *index = arena_push(mem, NULL, count * sizeof(u32));
+	for (u32 i = 0; i < count; ++i)
+	{
+		index[color_offset[color[i]]++] = i;
+	}
+
+	/* 
+	 * batch every color on its own; contacts of a color share no dynamic body and fill their batches in order, the
+	 * serial color is batched greedily. last[] only holds batches of earlier colors, which batching ignores.
+	 */
+	struct solver_batch *batch = arena_push(mem, NULL, count * sizeof(struct solver_batch));
+	i32 *last = arena_push(mem, NULL, bodies->count * sizeof(i32));
+	memset(batch, 0, count * sizeof(struct solver_batch));
+	for (u32 i = 0; i < bodies->count; ++i)
+	{
+		last[i] = -1;
+	}
+
+	u32 first = 0;
+	u32 batch_count = 0;
+	for (u32 k = 0; k <= SOLVER_MAX_COLORS; ++k)
+	{
+		if (color_size[k] == 0) { continue; }
+
+		colored->color_first[colored->color_count++] = batch_count;
+		batch_count = solver_internal_batch(batch, last, bodies, contact, index + first, color_size[k], batch_count, delta);
+		first += color_size[k];
+		colored->serial = (k == SOLVER_MAX_COLORS);
+	}
+	colored->color_first[colored->color_count] = batch_count;
+	colored->batch = batch;
+	colored->batch_count = batch_count;
+
+	/* warm start with the accumulated impulses of the previous step */
+	solver_internal_warm_start(bodies, batch, 0, batch_count);
+}
+
+void solver_color_sweep_joints(struct solver_colored *colored)
+{
+	solver_internal_sweep_joints(colored->bodies, colored->joint_block, colored->joint_count);
+}
+
+void solver_color_sweep(struct solver_colored *colored, const u32 color, const u32 thread, const u32 thread_count)
+{
+	const u32 first = colored->color_first[color];
+	const u32 end = colored->color_first[color + 1];
+	if (colored->serial && color + 1 == colored->color_count)
+	{
+		if (thread == 0)
+		{
+			solver_internal_sweep(colored->bodies, colored->batch, first, end, 1);
+		}
+	}
+	else
+	{
+		solver_internal_sweep(colored->bodies, colored->batch, first + thread, end, thread_count);
+	}
+}
+
+void solver_color_finish(struct solver_colored *colored, struct arena *mem)
+{
+	solver_internal_store(colored->contact, colored->batch, colored->batch_count, colored->joint, colored->joint_block, colored->joint_count);
+	*mem = colored->record;
+}
@@ -0,0 +1,117 @@
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include "mg_common.h"
+#include "mg_mempool.h"
+#include "mmath.h"
+
+/*
+ * Sequential impulse contact solver - projected Gauss-Seidel on the velocity level. Every contact point gives three
+ * rows (normal and two friction tangents) whose accumulated impulses are clamped, the normal impulse to be
+ * non-negative and the friction impulses to the box |lambda_t| <= friction * lambda_n. Penetration is fed back as a
+ * Baumgarte velocity bias, and restitution as a bias on the pre-solve approach velocity.
+ *
+ * Contacts are packed into batches of SOLVER_LANES contacts sharing no dynamic body, stored lane-wise, so a whole
+ * batch is solved with one pass of SSE arithmetic without any two lanes writing the same body. Batch order follows
+ * contact order, so the Gauss-Seidel sweep stays deterministic.
+ *
+ * Joints are solved in the same sweeps, ahead of the contacts. A joint is made of a linear block of up to three rows
+ * J = [-n, -(r_1 x n), n, r_2 x n], holding the anchors together along the directions n, and an angular block of up
+ * to three rows J = [0, -a, 0, a], stopping relative rotation about the axes a. Each block is solved at once with its
+ * effective mass K^-1, inverted once per step and stored with the rest of the joint's rows in one contiguous record.
+ */
+#define SOLVER_LANES			4
+#define SOLVER_BAUMGARTE		0.2f	/* fraction of the penetration removed per step */
+#define SOLVER_PENETRATION_SLOP		0.01f	/* penetration left uncorrected, keeps resting contacts touching */
+#define SOLVER_RESTITUTION_THRESHOLD	1.0f	/* approach speeds below this do not bounce */
+
+/* solver bodies, velocities are solved in place; static bodies have zero inverse mass and inertia */
+struct solver_bodies
+{
+	vec3ptr linear_velocity;
+	vec3ptr angular_velocity;
+	f32 *inv_mass;
+	mat3 *inv_inertia;	/* world frame */
+	u32 count;
+};
+
+struct solver_contact
+{
+	u32 body_1;		/* solver body indices */
+	u32 body_2;
+	vec3 normal;		/* unit, body 1 -> body 2 */
+	vec3 r_1;		/* contact point relative to the centers of mass */
+	vec3 r_2;
+	f32 depth;		/* penetration, negative for speculative contacts */
+	f32 friction;
+	f32 restitution;
+	/* accumulated impulses on body 2, the warm start on input and the solution on output */
+	f32 normal_impulse;
+	vec3 friction_impulse;	/* world frame, so it carries over between tangent bases */
+};
+
+struct solver_joint
+{
+	u32 body_1;		/* solver body indices */
+	u32 body_2;
+	vec3 r_1;		/* anchors relative to the centers of mass */
+	vec3 r_2;
+	vec3 linear[3];		/* unit directions of the linear rows */
+	vec3 angular[3];	/* unit axes of the angular rows */
+	u32 linear_count;
+	u32 angular_count;
+	f32 linear_error[3];	/* position error along each row, fed back as a Baumgarte bias */
+	f32 angular_error[3];
+	/* accumulated impulses on body 2, world frame, the warm start on input and the solution on output */
+	vec3 linear_impulse;
+	vec3 angular_impulse;
+};
+
+/* scratch memory required by solver_solve */
+u64 solver_scratch_size(const u32 contact_count, const u32 joint_count, const u32 body_count);
+/*
+ * warm start with the given impulses and run iterations sweeps over the joints and contacts; batches and joint blocks
+ * are pushed onto mem temporarily
+ */
+void solver_solve(struct arena *mem, struct solver_bodies *bodies, struct solver_contact *contact, const u32 contact_count, struct solver_joint *joint, const u32 joint_count, const f32 delta, const u32 iterations);
+
+/*
+ * Colored solve of one large island on several threads. Contacts are greedily colored so that no two contacts of a
+ * color share a dynamic body, and every color is batched on its own, so the batches of a color can be swept
+ * concurrently. A sweep is solver_color_sweep_joints on one thread followed by solver_color_sweep of every color on
+ * every thread, with a barrier after the joints and after each color. Contacts whose bodies ran out of colors go
+ * into a last, serial color swept by thread 0 alone. The coloring only depends on the contacts, so the result does
+ * not depend on the thread count.
+ */
+#define SOLVER_MAX_COLORS		64
+
+struct solver_batch;
+struct solver_joint_block;
+
+struct solver_colored
+{
+	struct solver_bodies *bodies;
+	struct solver_contact *contact;
+	struct solver_joint *joint;
+	struct solver_joint_block *joint_block;
+	struct solver_batch *batch;
+	u32 joint_count;
+	u32 batch_count;
+	u32 color_first[SOLVER_MAX_COLORS + 2];	/* batches of color k are [color_first[k], color_first[k+1]) */
+	u32 color_count;
+	u32 serial;		/* the last color shares bodies and is swept by thread 0 alone */
+	struct arena record;	/* mem before solver_color_setup */
+};
+
+/* scratch memory required by solver_color_setup */
+u64 solver_color_scratch_size(const u32 contact_count, const u32 joint_count, const u32 body_count);
+/* color and batch the contacts and warm start; batches and joint blocks are pushed onto mem until solver_color_finish */
+void solver_color_setup(struct solver_colored *colored, struct arena *mem, struct solver_bodies *bodies, struct solver_contact *contact, const u32 contact_count, struct solver_joint *joint, const u32 joint_count, const f32 delta);
+/* sweep the joints once, on one thread */
+void solver_color_sweep_joints(struct solver_colored *colored);
+/* sweep every thread_count'th batch of color, starting at batch thread */
+void solver_color_sweep(struct solver_colored *colored, const u32 color, const u32 thread, const u32 thread_count);
+/* hand the solved impulses back into the contacts and joints and release mem */
+void solver_color_finish(struct solver_colored *colored, struct arena *mem);
+
+#endif
@@ -570,6 +570,22 @@ void vec3_recenter_cross(vec3 dst, const vec3 center, const vec3 a, const vec3 b
 	vec3_sub(b_c, b, center);
 	vec3_cross(dst, a_c, b_c);
 }
+
+void vec3_create_basis(vec3 t_1, vec3 t_2, const vec3 n)
+{
+	/* cross n with the axis it is least aligned with */
+	if (fabs(n[0]) >= 0.57735f)
+	{
+		vec3_set(t_1, n[1], -n[0], 0.0f);
+	}
+	else
+	{
+		vec3_set(t_1, 0.0f, n[2], -n[1]);
+	}
+	vec3_normalize(t_1, t_1);
+	vec3_cross(t_2, n, t_1);
+}
+
 /* CCW */
 void vec3_rotate_y(vec3 dst, const vec3 a, const vec_type angle)
 {
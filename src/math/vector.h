@@ -119,6 +119,8 @@ void vec3_triple_product(vec3 dst, const vec3 a, const vec3 b, const vec3 c);
 
 /* (a-center) x (b-center) */
 void vec3_recenter_cross(vec3 dst, const vec3 center, const vec3 a, const vec3 b);
+/* t_1, t_2 such that (n, t_1, t_2) is an orthonormal right-handed basis, n unit */
+void vec3_create_basis(vec3 t_1, vec3 t_2, const vec3 n);
 
 void vec4_set(vec4 dst, const vec_type x, const vec_type y, const vec_type z, const vec_type w);
 void vec4_copy(vec4 dst, const vec4 src);
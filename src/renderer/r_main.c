@@ -39,15 +39,19 @@ void update_uniforms(struct render_state *re, const struct simulation *sim, stru
 	mglUniform3f(light_position_addr, re->cam.position[0], re->cam.position[1], re->cam.position[2]);
 
 	vec3ptr transforms = (vec3ptr) arena_push_packed(mem, NULL, sizeof(vec3)*sim->entity_count);
+	quat *rotations = (quat *) arena_push_packed(mem, NULL, sizeof(quat)*sim->entity_count);
 	for (u64 i = 0; i < sim->entity_count; ++i)
 	{
 		if (sim->entities[i].active)
 		{
-			vec3_copy(transforms[i], sim->pipeline.bodies[i].position);
+			sim_render_transform(transforms[i], rotations[i], sim, (i32) i);
 		}
 	}
 	i32 loc = mglGetUniformLocation(re->lightning_prg, "transform");
 	mglUniform3fv(loc, sim->entity_count, (f32 *) transforms);
+	loc = mglGetUniformLocation(re->lightning_prg, "rotation");
+	mglUniform4fv(loc, sim->entity_count, (f32 *) rotations);
+	arena_pop_packed(mem, sizeof(quat)*sim->entity_count);
 	arena_pop_packed(mem, sizeof(vec3)*sim->entity_count);
 
 	loc = mglGetUniformLocation(re->lightning_prg, "collision");
@@ -95,17 +99,29 @@ void r_main(struct render_state *re, struct graphics_context *gtx, struct simula
 	vec4 dbvt_color = { 1.0f, 0.0f, 0.0f, 0.7f };
 	dbvt_push_lines(&re->color_buf, &sim->pipeline.dynamic_tree, dbvt_color);
 
-	/* (2) fill drawbuffers */
-	for (u64 i = 0; i < sim->entity_count; ++i)
+	/* (2) fill drawbuffers; entity meshes are static in local space and only rebuilt when bodies come and go */
+	const u32 rebuild_entities = !re->entity_buf_valid || re->entity_buf_generation != sim->pipeline.generation;
+	if (rebuild_entities)
+	{
+		drawbuffer_clear(&re->entity_buf);
+	}
+
+	for (i32 k = 0; k < sim->pipeline.count; ++k)
 	{
-		if (sim->pipeline.bodies[i].active)
+		const i32 i = sim->pipeline.active[k];
+		if (rebuild_entities)
 		{
 			entity_push_convex_hull(&re->entity_buf, sim, i);	
-
-			struct AABB world_box = sim->pipeline.bodies[i].local_box;
-			vec3_translate(world_box.center, sim->pipeline.bodies[i].position);
-			AABB_push_lines(&re->color_buf, &world_box, dbvt_color); 
 		}
+
+		struct AABB world_box;
+		mat3 rot;
+		vec3 position;
+		quat rotation;
+		sim_render_transform(position, rotation, sim, i);
+		quat_to_mat3(rot, rotation);
+		AABB_transform(&world_box, sim->pipeline.local_box + i, rot, position);
+		AABB_push_lines(&re->color_buf, &world_box, dbvt_color); 
 	}
 
 	for (u32 i = 0; i < sim->phy_out.point_pairs_count; ++i)
@@ -114,12 +130,16 @@ void r_main(struct render_state *re, struct graphics_context *gtx, struct simula
 	}
 
 	/* (3) send data to gpu */
-	drawbuffer_buffer_data(&re->gl, &re->entity_buf);
+	if (rebuild_entities)
+	{
+		drawbuffer_buffer_data(&re->gl, &re->entity_buf);
+		re->entity_buf_generation = sim->pipeline.generation;
+		re->entity_buf_valid = 1;
+	}
 	drawbuffer_buffer_data(&re->gl, &re->color_buf);
 
 	/* (4) draw */
 	r_draw(re, &gtx->win);
 
-	drawbuffer_clear(&re->entity_buf);
 	drawbuffer_clear(&re->color_buf);
 }
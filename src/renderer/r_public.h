@@ -46,6 +46,8 @@ struct render_state
 	struct camera cam;
 
 	struct drawbuffer entity_buf;
+	u32 entity_buf_generation;	/* pipeline generation entity_buf was built for, meshes are static */
+	u32 entity_buf_valid;
 	struct drawbuffer color_buf;
 	struct drawbuffer widget_buf;
 
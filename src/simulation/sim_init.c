@@ -36,6 +36,12 @@ struct simulation *sim_init(struct arena *mem, void (*simulation_method)(struct
 		.entity_count = 0,
 		.running = 1,
 		.speed_scale = 1.0f,
+		.step = SIM_STEP_DEFAULT,
+		.accumulator = 0.0,
+		.max_substeps = SIM_MAX_SUBSTEPS_DEFAULT,
+		.interpolation = 1.0f,
+		.previous_position = NULL,
+		.previous_rotation = NULL,
 		.time = 0.0,
 		.seed = seed,
 		.simulation_method = simulation_method,
@@ -60,5 +66,9 @@ struct simulation *sim_init(struct arena *mem, void (*simulation_method)(struct
 
 void sim_cleanup(struct simulation *sim)
 {
-
+	/* the pipeline is set up on the first simulation step */
+	if (sim->mem_persistent)
+	{
+		rbp_free(&sim->pipeline);
+	}
 }
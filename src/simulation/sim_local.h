@@ -16,5 +16,6 @@ struct visual *visuals_init_default(struct arena *mem, const u64 count);
 
 void entity_construct_random_at_origin(struct arena *mem, struct simulation *sim, const u64 index, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena_collection *mem_tmp);
 void entity_construct_random(struct arena *mem, struct simulation *sim, const u64 index, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena_collection *mem_tmp, const vec3 position);
+void entity_construct_random_batch(struct arena *mem, struct simulation *sim, const u64 *index, const vec3ptr pos, const u32 count, const f32 min_radius, const f32 max_radius, const u32 min_v_count, const u32 max_v_count, struct arena *mem_tmp, const u32 thread_count);
 
 #endif
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "sim_public.h"
 #include "sim_local.h"
 #include "mmath.h"
@@ -8,10 +10,67 @@ static void sim_clear_frame(struct simulation *sim)
 	arena_flush(sim->mem_frame);
 }
 
+static void sim_save_previous_state(struct simulation *sim)
+{
+	const struct rbp *pipeline = &sim->pipeline;
+	memcpy(sim->previous_position, pipeline->position, pipeline->size * sizeof(vec3));
+	memcpy(sim->previous_rotation, pipeline->rotation, pipeline->size * sizeof(quat));
+}
+
+/*
+ * Fixed step scheduler: the simulation only ever advances by sim->step, so it behaves the same whatever the frame
+ * rate. Frame time left over is carried in the accumulator to the next frame; time beyond max_substeps steps is
+ * dropped, so a slow frame can not pile up ever more steps (spiral of death), the simulation runs slower instead.
+ */
 void sim_main(struct simulation *sim, const f64 delta)
 {
-	sim_clear_frame(sim);
-	sim->simulation_method(sim, sim->speed_scale * delta);
+	sim->accumulator += sim->speed_scale * delta;
+	const f64 max_time = sim->max_substeps * sim->step;
+	if (sim->accumulator > max_time)
+	{
+		sim->accumulator = max_time;
+	}
+
+	while (sim->accumulator >= sim->step)
+	{
+		const u32 generation = sim->pipeline.generation;
+		if (sim->previous_position)
+		{
+			sim_save_previous_state(sim);
+		}
+
+		sim_clear_frame(sim);
+		sim->simulation_method(sim, sim->step);
+		sim->accumulator -= sim->step;
+
+		/* the body set is set up in the first step, and bodies added since have no previous state to blend */
+		if (!sim->previous_position)
+		{
+			sim->previous_position = arena_push(sim->mem_persistent, NULL, sim->pipeline.size * sizeof(vec3));
+			sim->previous_rotation = arena_push(sim->mem_persistent, NULL, sim->pipeline.size * sizeof(quat));
+			sim_save_previous_state(sim);
+		}
+		else if (generation != sim->pipeline.generation)
+		{
+			sim_save_previous_state(sim);
+		}
+	}
+
+	sim->interpolation = (f32) (sim->accumulator / sim->step);
+}
+
+void sim_render_transform(vec3 position, quat rotation, const struct simulation *sim, const i32 index)
+{
+	if (sim->previous_position)
+	{
+		vec3_interpolate(position, sim->pipeline.position[index], sim->previous_position[index], sim->interpolation);
+		quat_interpolate(rotation, sim->pipeline.rotation[index], sim->previous_rotation[index], sim->interpolation);
+	}
+	else
+	{
+		vec3_copy(position, sim->pipeline.position[index]);
+		quat_copy(rotation, sim->pipeline.rotation[index]);
+	}
 }
 
 static void convex_volume_intersection_simulation_setup(struct simulation *sim, struct arena *mem_persistent)
@@ -32,7 +91,7 @@ static void convex_volume_intersection_simulation_setup(struct simulation *sim,
 
 	/* (2) Setup rigid bodies */
 	/* TODO: rewrite pipeline to use non-contiguous shit...? */
-	sim->pipeline = rbp_new(mem_persistent, CVI_BODIES);
+	sim->pipeline = rbp_new(mem_persistent, CVI_BODIES, 1);
 	sim->entities = entities_init_default(mem_persistent, CVI_BODIES);
 	sim->visuals = visuals_init_default(mem_persistent, CVI_BODIES);
 
@@ -213,9 +272,9 @@ void convex_volume_intersection_simulation(struct simulation *sim, const f64 del
 	f32 interpolation; /* relative small body positions between start and end points */
 	convex_volume_intersection_determine_positions(&interpolation, s1, s2, s3, e1, e2, e3, sim->time, test_time);
 
-	vec3_interpolate(sim->pipeline.bodies[CVI_SMALL1_INDEX].position, s1, e1, interpolation);
-	vec3_interpolate(sim->pipeline.bodies[CVI_SMALL2_INDEX].position, s2, e2, interpolation);
-	vec3_interpolate(sim->pipeline.bodies[CVI_SMALL3_INDEX].position, s3, e3, interpolation);
+	vec3_interpolate(sim->pipeline.position[CVI_SMALL1_INDEX], s1, e1, interpolation);
+	vec3_interpolate(sim->pipeline.position[CVI_SMALL2_INDEX], s2, e2, interpolation);
+	vec3_interpolate(sim->pipeline.position[CVI_SMALL3_INDEX], s3, e3, interpolation);
 
 	sim->phy_out.collisions = rbp_simulate(sim->mem_frame, &sim->pipeline, delta);
 	//TODO: need to set out aswell
@@ -240,21 +299,23 @@ static void gravity_simulation_setup(struct simulation *sim, struct arena *mem_p
 
 	/* (2) Setup rigid bodies */
 	/* TODO: rewrite pipeline to use non-contiguous shit...? */
-	sim->pipeline = rbp_new(sim->mem_persistent, G_BODIES);
+	sim->pipeline = rbp_new(sim->mem_persistent, G_BODIES, G_SOLVER_THREADS);
 	sim->entities = entities_init_default(sim->mem_persistent, G_BODIES);
 	sim->visuals = visuals_init_default(sim->mem_persistent, G_BODIES);
 
-	vec3 pos_1, pos_2, pos_3, pos_4;
+	vec3 pos_1;
 	vec3_set(pos_1, 0.0f, 0.0f, 0.0f);
-	vec3_set(pos_2, 1.0f, 3.0f, 1.0f);
-	vec3_set(pos_3, 0.0f, 3.0f, 0.0f);
-	vec3_set(pos_4, -1.0f, 3.0f, -1.0f);
+	vec3 pos_small[3] = 
+	{
+		{  1.0f, 3.0f,  1.0f },
+		{  0.0f, 3.0f,  0.0f },
+		{ -1.0f, 3.0f, -1.0f },
+	};
+	const u64 small_index[3] = { G_SMALL1_INDEX, G_SMALL2_INDEX, G_SMALL3_INDEX };
 
 	/* (3) Setup entity, rigid_body and visuals  */
 	entity_construct_random(sim->mem_persistent, sim, G_LARGE_INDEX,  1.5f, 1.5f, 70, 70, &sim->mem_tmp, pos_1);
-	entity_construct_random(sim->mem_persistent, sim, G_SMALL1_INDEX, 0.5f, 0.5f, 70, 70, &sim->mem_tmp, pos_2);
-	entity_construct_random(sim->mem_persistent, sim, G_SMALL2_INDEX, 0.5f, 0.5f, 70, 70, &sim->mem_tmp, pos_3);
-	entity_construct_random(sim->mem_persistent, sim, G_SMALL3_INDEX, 0.5f, 0.5f, 70, 70, &sim->mem_tmp, pos_4);
+	entity_construct_random_batch(sim->mem_persistent, sim, small_index, pos_small, 3, 0.5f, 0.5f, 70, 70, sim->mem_tmp.arenas + 4, G_HULL_THREADS);
 
 	vec3 box[8] =
 	{
@@ -269,20 +330,20 @@ static void gravity_simulation_setup(struct simulation *sim, struct arena *mem_p
 	};
 
 	struct rigid_body floor;
+	struct arena record = sim->mem_tmp.arenas[1];
 	struct tri_mesh mesh = convex_hull_construct(
-			sim->mem_persistent,
+			sim->mem_tmp.arenas + 1,
 		        sim->mem_tmp.arenas + 0,
-		       	sim->mem_tmp.arenas + 1,
-		       	sim->mem_tmp.arenas + 2, 
-			sim->mem_tmp.arenas + 3, 
-			sim->mem_tmp.arenas + 4,
 		       	box,
 		       	8,
 		       	100.0f * FLT_EPSILON);
 
 	const f32 density = 1.0f;
-	statics_setup(&floor, sim->mem_persistent, &mesh, density);
+	const i32 shape = shape_registry_add(&sim->pipeline.shapes, sim->mem_persistent, sim->mem_tmp.arenas + 0, &mesh);
+	rigid_body_set_shape(&floor, &sim->pipeline.shapes, shape, density);
+	sim->mem_tmp.arenas[1] = record;
 	floor.margin = 1.0f;
+	floor.fast = 0;
 	rbp_add(&sim->pipeline, G_FLOOR_INDEX, &floor, 0);
 
 	++sim->entity_count;
@@ -60,6 +60,18 @@ struct simulation
 
 	f32 speed_scale;
 
+	/*
+	 * fixed step scheduling, see sim_main: scaled frame time is accumulated and consumed in steps of step seconds,
+	 * at most max_substeps per frame. Rendering blends the body state before the last step (previous_*) with the
+	 * current one by interpolation = accumulator / step.
+	 */
+	f64 step;
+	f64 accumulator;
+	u32 max_substeps;
+	f32 interpolation;
+	vec3ptr previous_position;	/* indexed by body slot, NULL until the first step */
+	quat *previous_rotation;
+
 	struct arena *mem_persistent;	/* full simulation lifetime */
 	struct arena *mem_frame;	/* frame lifetime */
 	struct arena_collection mem_tmp;
@@ -84,7 +96,12 @@ void sim_cleanup(struct simulation *sim);
 /****************************** sim_main ******************************/
 
 void sim_system_events(struct simulation *sim, struct ui_state *ui, struct graphics_context *gtx);
+#define SIM_STEP_DEFAULT		(1.0 / 60.0)
+#define SIM_MAX_SUBSTEPS_DEFAULT	4
+/* advance the simulation by delta seconds of wall-clock time (times speed_scale) in fixed steps */
 void sim_main(struct simulation *sim, const f64 delta);
+/* interpolated world transform of body index for rendering, see struct simulation */
+void sim_render_transform(vec3 position, quat rotation, const struct simulation *sim, const i32 index);
 
 #define CVI_BODIES 4
 #define CVI_LARGE_INDEX 0
@@ -99,6 +116,8 @@ void convex_volume_intersection_simulation(struct simulation *sim, const f64 del
 #define G_SMALL2_INDEX 2
 #define G_SMALL3_INDEX 3
 #define G_FLOOR_INDEX 4
+#define G_HULL_THREADS 4
+#define G_SOLVER_THREADS 4
 void gravity_simulation(struct simulation *sim, const f64 delta);
 
 /****************************** sim_event ******************************/
@@ -110,6 +129,7 @@ void sim_process_system_events(struct simulation *sim, struct ui_state *ui, stru
 
 /****************************** sim_entity ******************************/
 
+/* push the local space mesh of entity index, drawn with transform[index] */
 void entity_push_convex_hull(struct drawbuffer *buf, struct simulation *sim, const u64 index);
 
 
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include <fenv.h>
@@ -8,6 +9,7 @@
 #include "math_debug_local.h"
 #include "geometry.h"
 #include "rigid_body.h"
+#include "rigid_body_pipeline.h"
 
 static struct test_output ieee32_754_assert_type(struct test_environment *env)
 {
@@ -773,6 +775,46 @@ void gen_box(vec3 box[8], const vec3 center, const vec3 hw)
 	vec3_set(box[7], center[0] + hw[0],  center[1] + hw[1], center[2] + hw[2]);
 }
 
+static struct test_output quat_interpolate_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	quat p, q, q_neg, dst, half;
+	const vec3 axis = { 0.0f, 0.0f, 1.0f };
+	quat_set(p, 0.0f, 0.0f, 0.0f, 1.0f);
+	axis_angle_to_quaternion(q, axis, MM_PI_F / 2.0f);
+	axis_angle_to_quaternion(half, axis, MM_PI_F / 4.0f);
+
+	/* alpha weighs p, the midpoint of a symmetric blend is the half rotation */
+	quat_interpolate(dst, p, q, 1.0f);
+	TEST_TRUE(fabsf(dst[0] - p[0]) + fabsf(dst[1] - p[1]) + fabsf(dst[2] - p[2]) + fabsf(dst[3] - p[3]) < 0.0001f);
+	quat_interpolate(dst, p, q, 0.0f);
+	TEST_TRUE(fabsf(dst[0] - q[0]) + fabsf(dst[1] - q[1]) + fabsf(dst[2] - q[2]) + fabsf(dst[3] - q[3]) < 0.0001f);
+	quat_interpolate(dst, p, q, 0.5f);
+	TEST_TRUE(fabsf(dst[0] - half[0]) + fabsf(dst[1] - half[1]) + fabsf(dst[2] - half[2]) + fabsf(dst[3] - half[3]) < 0.0001f);
+
+	/* 
+	 * -q is the same rotation with a negative dot product against p; it is flipped, so the blend takes the 90 degree
+	 * arc instead of the 270 degree one and never turns further from p than q does
+	 */
+	quat_copy(q_neg, q);
+	quat_scale(q_neg, -1.0f);
+	quat_interpolate(dst, p, q_neg, 0.5f);
+	TEST_TRUE(fabsf(dst[0] - half[0]) + fabsf(dst[1] - half[1]) + fabsf(dst[2] - half[2]) + fabsf(dst[3] - half[3]) < 0.0001f);
+	for (u32 i = 0; i <= 10; ++i)
+	{
+		const f32 alpha = (f32) i / 10.0f;
+		quat_interpolate(dst, p, q_neg, alpha);
+		TEST_TRUE(fabsf(quat_norm(dst) - 1.0f) < 0.0001f);
+		TEST_TRUE(dst[3] > q[3] - 0.0001f);
+		TEST_TRUE(fabsf(dst[0]) < 0.0001f && fabsf(dst[1]) < 0.0001f && dst[2] > -0.0001f);
+	}
+	quat_interpolate(dst, p, q_neg, 0.0f);
+	TEST_TRUE(fabsf(fabsf(dst[0]*q[0] + dst[1]*q[1] + dst[2]*q[2] + dst[3]*q[3]) - 1.0f) < 0.0001f);
+
+	return output;
+}
+
 static struct test_output rigid_statics_assert(struct test_environment *env)
 {
 	struct test_output output = { .success = 1, .id = __func__ };
@@ -800,11 +842,1374 @@ static struct test_output rigid_statics_assert(struct test_environment *env)
 	for (u64 i = 0; i < 9; ++i)
 	{
 		gen_box(box, centers[i], hw);
-		struct tri_mesh mesh = convex_hull_construct(env->mem_1, env->mem_2, env->mem_3, env->mem_4, env->mem_5, env->mem_6, box, 8, 0.0001f);
+		struct tri_mesh mesh = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
 		struct rigid_body body;
 		statics_setup(&body, env->mem_1, &mesh, density);
 		statics_print(stderr, &body);
+		/* unit cube: mass 1, I = m(1 + 1)/12 on the diagonal */
+		TEST_TRUE(fabsf(body.mass - 1.0f) < 0.0001f);
+		TEST_TRUE(vec3_distance(body.position, centers[i]) < 0.0001f);
+		for (u32 j = 0; j < 3; ++j)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const f32 expected = (j == k) ? 1.0f / 6.0f : 0.0f;
+				TEST_TRUE(fabsf(body.inertia_tensor[j][k] - expected) < 0.0001f);
+			}
+		}
+		TEST_TRUE(vec3_length(body.bounding_sphere.center) < 0.0001f);
+		TEST_TRUE(fabsf(body.bounding_sphere.radius - sqrtf(3.0f)*hw[0]) < 0.0001f);
+	}
+
+	return output;
+}
+
+static struct test_output convex_hull_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	mersenne_twister_init(env->seed);
+
+	const u32 v_count = 2000;
+	vec3ptr v = arena_push(env->mem_3, NULL, v_count * sizeof(vec3));
+	for (u32 i = 0; i < v_count; ++i)
+	{
+		/* every other point is interior */
+		const f32 radius = (i % 2) ? 0.5f : 1.0f;
+		const f32 phi = acosf(2*gen_rand_f() - 1.0f) - MM_PI_F / 2.0f;
+		const f32 lambda = 2*MM_PI_F*gen_rand_f();
+		vec3_set(v[i], radius*cosf(phi)*cosf(lambda), radius*cosf(phi)*sinf(lambda), radius*sinf(phi));
+	}
+
+	struct tri_mesh (*construct[2])(struct arena *, struct arena *, const vec3ptr, const u32, const f32) = 
+	{
+		convex_hull_construct,
+		convex_hull_quickhull,
+	};
+
+	for (u32 c = 0; c < 2; ++c)
+	{
+		const u64 scratch_left = env->mem_2->mem_left;
+		TEST_TRUE(convex_hull_scratch_size(v_count) <= scratch_left);
+		struct tri_mesh mesh = construct[c](env->mem_1, env->mem_2, v, v_count, 0.000001f);
+		TEST_EQUAL(env->mem_2->mem_left, scratch_left);
+
+		/* closed triangulated hull of vertices in convex position */
+		TEST_TRUE(0 < mesh.v_count && mesh.v_count <= v_count / 2);
+		TEST_EQUAL(mesh.tri_count, 2*mesh.v_count - 4);
+		for (u32 i = 0; i < mesh.v_count; ++i)
+		{
+			TEST_TRUE(vec3_length(mesh.v[i]) > 0.99f);
+		}
+
+		vec3 a, b, n;
+		for (u32 t = 0; t < mesh.tri_count; ++t)
+		{
+			vec3_sub(a, mesh.v[mesh.tri[t][1]], mesh.v[mesh.tri[t][0]]);
+			vec3_sub(b, mesh.v[mesh.tri[t][2]], mesh.v[mesh.tri[t][0]]);
+			vec3_cross(n, a, b);
+			vec3_mul_constant(n, 1.0f / vec3_length(n));
+			for (u32 i = 0; i < v_count; ++i)
+			{
+				vec3_sub(a, v[i], mesh.v[mesh.tri[t][0]]);
+				TEST_TRUE(vec3_dot(n, a) <= 0.001f);
+			}
+		}
+	}
+
+	/* 
+	 * a lattice is full of coplanar points and collinear rows, and still has a hull; the leading row runs far from
+	 * the first point, so it must not be taken for a triangle
+	 */
+	const u32 side = 6;
+	const u32 row = 40;
+	const u32 lattice_count = row + side * side * side;
+	vec3ptr lattice = arena_push(env->mem_3, NULL, lattice_count * sizeof(vec3));
+	for (u32 i = 0; i < row; ++i)
+	{
+		vec3_set(lattice[i], 0.1f * (f32) i, 0.2f * (f32) i, 0.3f * (f32) i);
+	}
+	for (u32 i = 0; i < side * side * side; ++i)
+	{
+		vec3_set(lattice[row + i], (f32) (i % side), (f32) ((i / side) % side), (f32) (i / (side * side)));
+	}
+	for (u32 c = 0; c < 2; ++c)
+	{
+		const struct tri_mesh mesh = construct[c](env->mem_1, env->mem_2, lattice, lattice_count, 100.0f * FLT_EPSILON);
+		TEST_TRUE(mesh.v_count >= 8);
+		TEST_EQUAL(mesh.tri_count, 2*mesh.v_count - 4);
+		TEST_TRUE(tri_mesh_volume(&mesh) > 125.0f);
+	}
+
+	/* 
+	 * jittered within a few EPSILON, the lattice faces are nearly coplanar and the horizons of their points come out
+	 * pinched; the hull must still be closed and contain every point
+	 */
+	for (u32 i = 0; i < side * side * side; ++i)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			lattice[row + i][k] += gen_continuous_uniform_f(-0.0001f, 0.0001f);
+		}
 	}
+	for (u32 c = 0; c < 2; ++c)
+	{
+		const struct tri_mesh mesh = construct[c](env->mem_1, env->mem_2, lattice + row, side * side * side, 0.0001f);
+		TEST_TRUE(mesh.v_count >= 8);
+		TEST_EQUAL(mesh.tri_count, 2*mesh.v_count - 4);
+
+		vec3 a, b, n;
+		for (u32 t = 0; t < mesh.tri_count; ++t)
+		{
+			vec3_sub(a, mesh.v[mesh.tri[t][1]], mesh.v[mesh.tri[t][0]]);
+			vec3_sub(b, mesh.v[mesh.tri[t][2]], mesh.v[mesh.tri[t][0]]);
+			vec3_cross(n, a, b);
+			TEST_TRUE(vec3_length(n) > 0.0f);
+			vec3_mul_constant(n, 1.0f / vec3_length(n));
+			for (u32 i = 0; i < side * side * side; ++i)
+			{
+				vec3_sub(a, lattice[row + i], mesh.v[mesh.tri[t][0]]);
+				TEST_TRUE(vec3_dot(n, a) <= 0.01f);
+			}
+		}
+	}
+
+	return output;
+}
+
+static struct test_output convex_hull_batch_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	mersenne_twister_init(env->seed);
+
+	const u32 count = 16;
+	vec3ptr v[16];
+	u32 v_count[16];
+	struct tri_mesh meshes[16];
+	for (u32 i = 0; i < count; ++i)
+	{
+		v_count[i] = 4 + (u32) gen_continuous_uniform_f(0.0f, 200.0f);
+		v[i] = arena_push(env->mem_3, NULL, v_count[i] * sizeof(vec3));
+		for (u32 j = 0; j < v_count[i]; ++j)
+		{
+			vec3_set(v[i][j], gen_continuous_uniform_f(-1.0f, 1.0f), gen_continuous_uniform_f(-1.0f, 1.0f), gen_continuous_uniform_f(-1.0f, 1.0f));
+		}
+	}
+
+	convex_hull_construct_batch(env->mem_1, meshes, v, v_count, count, 100.0f * FLT_EPSILON, 4);
+
+	/* hull construction is deterministic, so every hull matches its sequential construction */
+	for (u32 i = 0; i < count; ++i)
+	{
+		struct tri_mesh mesh = convex_hull_construct(env->mem_4, env->mem_5, v[i], v_count[i], 100.0f * FLT_EPSILON);
+		TEST_EQUAL(meshes[i].v_count, mesh.v_count);
+		TEST_EQUAL(meshes[i].tri_count, mesh.tri_count);
+		TEST_TRUE(memcmp(meshes[i].v, mesh.v, mesh.v_count * sizeof(vec3)) == 0);
+		TEST_TRUE(memcmp(meshes[i].tri, mesh.tri, mesh.tri_count * sizeof(vec3u32)) == 0);
+	}
+
+	return output;
+}
+
+static struct test_output convex_hull_simplify_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	mersenne_twister_init(env->seed);
+
+	/* box corners followed by points on the box faces, coplanar face vertices are merged away */
+	const u32 v_count = 8 + 64;
+	vec3ptr v = arena_push(env->mem_3, NULL, v_count * sizeof(vec3));
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 1.0f, 2.0f, 3.0f };
+	gen_box(v, center, hw);
+	for (u32 i = 8; i < v_count; ++i)
+	{
+		const u32 axis = i % 3;
+		vec3_set(v[i], gen_continuous_uniform_f(-hw[0], hw[0]), gen_continuous_uniform_f(-hw[1], hw[1]), gen_continuous_uniform_f(-hw[2], hw[2]));
+		v[i][axis] = (i % 2) ? hw[axis] : -hw[axis];
+	}
+
+	struct tri_mesh hull = convex_hull_construct(env->mem_1, env->mem_2, v, v_count, 100.0f * FLT_EPSILON);
+	TEST_TRUE(hull.v_count > 8);
+	struct tri_mesh simplified = convex_hull_simplify(env->mem_1, env->mem_2, &hull, v_count, 0.0f, 0.0001f);
+	TEST_EQUAL(simplified.v_count, 8);
+	TEST_EQUAL(simplified.tri_count, 12);
+	TEST_TRUE(fabsf(tri_mesh_volume(&simplified) - 48.0f) < 0.001f);
+
+	/* vertex cap and volume bound on a sphere */
+	const u32 sphere_count = 500;
+	vec3ptr sphere = arena_push(env->mem_3, NULL, sphere_count * sizeof(vec3));
+	for (u32 i = 0; i < sphere_count; ++i)
+	{
+		const f32 phi = acosf(2*gen_rand_f() - 1.0f) - MM_PI_F / 2.0f;
+		const f32 lambda = 2*MM_PI_F*gen_rand_f();
+		vec3_set(sphere[i], cosf(phi)*cosf(lambda), cosf(phi)*sinf(lambda), sinf(phi));
+	}
+
+	hull = convex_hull_construct(env->mem_1, env->mem_2, sphere, sphere_count, 100.0f * FLT_EPSILON);
+	const f32 volume = tri_mesh_volume(&hull);
+
+	/* the simplified hulls contain every vertex of the original */
+	vec3 n, r;
+	simplified = convex_hull_simplify(env->mem_1, env->mem_2, &hull, 32, 0.0f, 100.0f * FLT_EPSILON);
+	TEST_TRUE(4 <= simplified.v_count && simplified.v_count <= 32);
+	TEST_EQUAL(simplified.tri_count, 2*simplified.v_count - 4);
+	TEST_TRUE(tri_mesh_volume(&simplified) >= volume);
+	for (u32 t = 0; t < simplified.tri_count; ++t)
+	{
+		vec3_recenter_cross(n, simplified.v[simplified.tri[t][0]], simplified.v[simplified.tri[t][1]], simplified.v[simplified.tri[t][2]]);
+		vec3_normalize(n, n);
+		for (u32 i = 0; i < hull.v_count; ++i)
+		{
+			vec3_sub(r, hull.v[i], simplified.v[simplified.tri[t][0]]);
+			TEST_TRUE(vec3_dot(n, r) < 0.0001f);
+		}
+	}
+
+	simplified = convex_hull_simplify(env->mem_1, env->mem_2, &hull, hull.v_count, 0.05f, 100.0f * FLT_EPSILON);
+	TEST_TRUE(simplified.v_count < hull.v_count);
+	TEST_TRUE(tri_mesh_volume(&simplified) >= volume);
+	TEST_TRUE(tri_mesh_volume(&simplified) <= 1.05f * volume);
+
+	/* the body proxy and bounding sphere bound the simplified collision hull */
+	struct rigid_body body;
+	statics_setup(&body, env->mem_2, &hull, 1.0f);
+	rigid_body_simplify_collision(&body, env->mem_1, env->mem_2, 16, 0.0f);
+	TEST_TRUE(body.collision.v != body.mesh.v);
+	for (u32 i = 0; i < body.collision.v_count; ++i)
+	{
+		for (u32 k = 0; k < 3; ++k)
+		{
+			TEST_TRUE(fabsf(body.collision.v[i][k] - body.local_box.center[k]) <= body.local_box.hw[k] + 0.0001f);
+		}
+		TEST_TRUE(vec3_distance(body.collision.v[i], body.bounding_sphere.center) <= body.bounding_sphere.radius + 0.0001f);
+	}
+
+	return output;
+}
+
+static struct test_output convex_decomposition_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	/* L shaped soup of two overlapping closed boxes, the inner faces are swallowed by the voxel fill */
+	vec3 box[8];
+	const vec3 c_1 = { 1.0f, 0.5f, 0.5f };
+	const vec3 hw_1 = { 1.0f, 0.5f, 0.5f };
+	const vec3 c_2 = { 0.5f, 1.0f, 0.5f };
+	const vec3 hw_2 = { 0.5f, 1.0f, 0.5f };
+	gen_box(box, c_1, hw_1);
+	const struct tri_mesh b_1 = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	gen_box(box, c_2, hw_2);
+	const struct tri_mesh b_2 = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+
+	struct tri_mesh soup =
+	{
+		.v = arena_push(env->mem_1, NULL, (b_1.v_count + b_2.v_count) * sizeof(vec3)),
+		.tri = arena_push(env->mem_1, NULL, (b_1.tri_count + b_2.tri_count) * sizeof(vec3u32)),
+		.v_count = b_1.v_count + b_2.v_count,
+		.tri_count = b_1.tri_count + b_2.tri_count,
+	};
+	memcpy(soup.v, b_1.v, b_1.v_count * sizeof(vec3));
+	memcpy(soup.v + b_1.v_count, b_2.v, b_2.v_count * sizeof(vec3));
+	memcpy(soup.tri, b_1.tri, b_1.tri_count * sizeof(vec3u32));
+	for (u32 i = 0; i < b_2.tri_count; ++i)
+	{
+		vec3u32_set(soup.tri[b_1.tri_count + i], b_2.tri[i][0] + b_1.v_count, b_2.tri[i][1] + b_1.v_count, b_2.tri[i][2] + b_1.v_count);
+	}
+
+	/* one hull of the L is a seventh empty, a cut into two boxes covers it within the voxel width */
+	struct tri_mesh parts[8];
+	const u32 resolution = 16;
+	const u32 count = convex_decomposition(env->mem_3, parts, 8, &soup, resolution, 0.01f, 4);
+	TEST_TRUE(2 <= count && count <= 8);
+
+	const f32 h = 2.0f / resolution;
+	f32 volume = 0.0f;
+	for (u32 i = 0; i < count; ++i)
+	{
+		TEST_TRUE(parts[i].tri_count > 0);
+		volume += tri_mesh_volume(parts + i);
+		for (u32 j = 0; j < parts[i].v_count; ++j)
+		{
+			TEST_TRUE(-h <= parts[i].v[j][0] && parts[i].v[j][0] <= 2.0f + h);
+			TEST_TRUE(-h <= parts[i].v[j][1] && parts[i].v[j][1] <= 2.0f + h);
+			TEST_TRUE(-h <= parts[i].v[j][2] && parts[i].v[j][2] <= 1.0f + h);
+		}
+	}
+	TEST_TRUE(fabsf(volume - 3.0f) < 0.3f);
+
+	return output;
+}
+
+static struct test_output shape_registry_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	struct shape_registry reg = shape_registry_new(env->mem_1, 2, 0, 0.0f);
+
+	vec3 box[8];
+	const vec3 center = { 1.0f, 2.0f, 3.0f };
+	const vec3 hw = { 0.5f, 1.0f, 1.5f };
+	gen_box(box, center, hw);
+	const struct tri_mesh mesh = convex_hull_construct(env->mem_2, env->mem_3, box, 8, 0.0001f);
+	const vec3 first_v = { mesh.v[0][0], mesh.v[0][1], mesh.v[0][2] };
+
+	/* identical hull data shares one shape, and the caller's mesh is left in its frame */
+	const i32 id = shape_registry_add(&reg, env->mem_1, env->mem_3, &mesh);
+	TEST_TRUE(id != -1);
+	TEST_EQUAL(shape_registry_add(&reg, env->mem_1, env->mem_3, &mesh), id);
+	TEST_EQUAL(reg.shapes[id].ref_count, 2);
+	TEST_EQUAL(reg.count, 1);
+	TEST_TRUE(vec3_distance(mesh.v[0], first_v) == 0.0f);
+	TEST_TRUE(vec3_distance(reg.shapes[id].center_of_mass, center) < 0.0001f);
+	TEST_TRUE(fabsf(reg.shapes[id].volume - 6.0f) < 0.0001f);
+
+	struct rigid_body body;
+	rigid_body_set_shape(&body, &reg, id, 2.0f);
+	TEST_EQUAL(body.shape, id);
+	TEST_TRUE(body.mesh.v == reg.shapes[id].mesh.v);
+	TEST_TRUE(fabsf(body.mass - 12.0f) < 0.0001f);
+	TEST_TRUE(fabsf(body.inertia_tensor[0][0] - 2.0f * reg.shapes[id].inertia_tensor[0][0]) < 0.0001f);
+	TEST_TRUE(vec3_distance(body.position, center) < 0.0001f);
+
+	/* other hull data gets another slot, a released slot is reused */
+	const vec3 other_center = { -1.0f, 0.0f, 0.0f };
+	gen_box(box, other_center, hw);
+	const struct tri_mesh other = convex_hull_construct(env->mem_2, env->mem_3, box, 8, 0.0001f);
+	const i32 other_id = shape_registry_add(&reg, env->mem_1, env->mem_3, &other);
+	TEST_TRUE(other_id != -1 && other_id != id);
+
+	/* full registry */
+	const vec3 third_center = { 0.0f, -4.0f, 0.0f };
+	gen_box(box, third_center, hw);
+	const struct tri_mesh third = convex_hull_construct(env->mem_2, env->mem_3, box, 8, 0.0001f);
+	TEST_EQUAL(shape_registry_add(&reg, env->mem_1, env->mem_3, &third), -1);
+
+	shape_registry_release(&reg, id);
+	TEST_EQUAL(reg.count, 2);
+	shape_registry_release(&reg, id);
+	TEST_EQUAL(reg.count, 1);
+	TEST_TRUE(reg.free_size >= 8 * sizeof(vec3) + 12 * sizeof(vec3u32));
+
+	/* the hull memory of the released shape is reused instead of pushing onto the arena */
+	const u8 *stack_ptr = env->mem_1->stack_ptr;
+	TEST_EQUAL(shape_registry_add(&reg, env->mem_1, env->mem_3, &mesh), id);
+	TEST_EQUAL(reg.shapes[id].ref_count, 1);
+	TEST_TRUE(env->mem_1->stack_ptr == stack_ptr);
+	TEST_EQUAL(reg.free_size, 0);
+	TEST_TRUE(vec3_distance(reg.shapes[id].center_of_mass, center) < 0.0001f);
+	TEST_TRUE(fabsf(tri_mesh_volume(&reg.shapes[id].mesh) - 6.0f) < 0.0001f);
+
+	return output;
+}
+
+static struct test_output compound_body_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	/* 4x3x2 grid of unit cubes as children */
+	vec3 box[8];
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const u32 child_count = 24;
+	struct tri_mesh *child = arena_push(env->mem_1, NULL, child_count * sizeof(struct tri_mesh));
+	for (u32 i = 0; i < child_count; ++i)
+	{
+		const vec3 center = { (f32) (i % 4), (f32) ((i / 4) % 3), (f32) (i / 12) };
+		gen_box(box, center, hw);
+		child[i] = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	}
+
+	struct rigid_body body;
+	statics_setup_compound(&body, env->mem_1, env->mem_2, child, child_count, 1.0f);
+	const vec3 com = { 1.5f, 1.0f, 0.5f };
+	TEST_TRUE(fabsf(body.mass - 24.0f) < 0.0001f);
+	TEST_TRUE(vec3_distance(body.position, com) < 0.0001f);
+	TEST_EQUAL(body.mesh.v_count, 8);
+
+	/* bulk built tree: every child in exactly one leaf, every node box bounds its children */
+	const struct dbvt *tree = &body.compound->tree;
+	TEST_EQUAL(tree->len, 2*child_count - 1);
+	TEST_EQUAL(tree->nodes[tree->root].parent, DBVT_NO_NODE);
+	u32 leaf_mask = 0;
+	for (i32 i = 0; i < tree->len; ++i)
+	{
+		const struct dbvt_node *node = tree->nodes + i;
+		if (node->left == DBVT_NO_NODE)
+		{
+			TEST_TRUE(0 <= node->id && node->id < (i32) child_count);
+			leaf_mask |= 1u << node->id;
+		}
+		else
+		{
+			TEST_EQUAL(node->left, i + 1);
+			TEST_EQUAL(tree->nodes[node->left].parent, i);
+			TEST_EQUAL(tree->nodes[node->right].parent, i);
+			TEST_TRUE(AABB_contains(&node->box, &tree->nodes[node->left].box));
+			TEST_TRUE(AABB_contains(&node->box, &tree->nodes[node->right].box));
+		}
+	}
+	TEST_EQUAL(leaf_mask, (1u << child_count) - 1);
+
+	/* a thin rod along x rotated onto the y axis overlaps the column of children at x = 0, z = 0 */
+	struct dbvt_node rod_node = { .box = { .center = { 1.0f, 0.0f, 0.0f }, .hw = { 1.4f, 0.1f, 0.1f } }, .id = 7, .parent = DBVT_NO_NODE, .left = DBVT_NO_NODE, .right = DBVT_NO_NODE };
+	struct dbvt rod = { .nodes = &rod_node, .root = 0, .proxy_count = 1 };
+	mat3 rot;
+	mat3_set(rot, 0.0f, 1.0f, 0.0f,
+		     -1.0f, 0.0f, 0.0f,
+		      0.0f, 0.0f, 1.0f);
+	const vec3 pos = { -1.5f, -1.0f, -0.5f };
+	i32 *pair = (i32 *) env->mem_2->stack_ptr;
+	const i32 pair_count = dbvt_push_transformed_overlap_pairs(env->mem_2, tree, &rod, rot, pos, 0.0f);
+	TEST_EQUAL(pair_count, 3);
+	for (i32 i = 0; i < pair_count; ++i)
+	{
+		TEST_TRUE(pair[2*i] == 0 || pair[2*i] == 4 || pair[2*i] == 8);
+		TEST_EQUAL(pair[2*i+1], 7);
+	}
+
+	/* L shaped compound: a box in the notch is inside the hull of the L but touches no child */
+	struct tri_mesh *l = arena_push(env->mem_1, NULL, 2 * sizeof(struct tri_mesh));
+	const vec3 c_1 = { 1.0f, 0.5f, 0.5f };
+	const vec3 hw_1 = { 1.0f, 0.5f, 0.5f };
+	const vec3 c_2 = { 0.5f, 1.5f, 0.5f };
+	gen_box(box, c_1, hw_1);
+	l[0] = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	gen_box(box, c_2, hw);
+	l[1] = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+
+	struct rbp pipeline = rbp_new(env->mem_3, 3, 1);
+	vec3_set(pipeline.gravity, 0.0f, 0.0f, 0.0f);
+	struct rigid_body bodies[3];
+	statics_setup_compound(bodies + 0, env->mem_1, env->mem_2, l, 2, 1.0f);
+
+	const vec3 notch_center = { 1.3f, 1.3f, 0.5f };
+	const vec3 notch_hw = { 0.2f, 0.2f, 0.2f };
+	gen_box(box, notch_center, notch_hw);
+	struct tri_mesh notch = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	statics_setup(bodies + 1, env->mem_2, &notch, 1.0f);
+
+	const vec3 arm_center = { 0.5f, 1.9f, 0.5f };
+	gen_box(box, arm_center, notch_hw);
+	struct tri_mesh arm = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	statics_setup(bodies + 2, env->mem_2, &arm, 1.0f);
+
+	for (i32 i = 0; i < 3; ++i)
+	{
+		bodies[i].margin = 0.0f;
+		vec3_set(bodies[i].velocity, 0.0f, 0.0f, 0.0f);
+		vec3_set(bodies[i].linear_momentum, 0.0f, 0.0f, 0.0f);
+		rigid_body_update_local_box(bodies + i);
+		rbp_add(&pipeline, i, bodies + i, 0);
+	}
+
+	const i32 *collisions = rbp_simulate(env->mem_2, &pipeline, 0.0f);
+	TEST_EQUAL(collisions[0], 1);
+	TEST_EQUAL(collisions[1], 0);
+	TEST_EQUAL(collisions[2], 1);
+
+	i32 *within = (i32 *) env->mem_2->stack_ptr;
+	TEST_EQUAL(rbp_push_bodies_within(env->mem_2, &pipeline, 1, 0.05f), 0);
+	TEST_EQUAL(rbp_push_bodies_within(env->mem_2, &pipeline, 1, 0.15f), 1);
+	TEST_EQUAL(within[0], 0);
+
+	return output;
+}
+
+/* box body at rest with its center of mass at center, margin 0.1 and no continuous collision */
+static void box_body_setup(struct rigid_body *body, struct test_environment *env, const vec3 center, const vec3 hw, const f32 density)
+{
+	vec3 box[8];
+	gen_box(box, center, hw);
+	struct tri_mesh mesh = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+	statics_setup(body, env->mem_2, &mesh, density);
+	body->margin = 0.1f;
+	body->fast = 0;
+	vec3_set(body->velocity, 0.0f, 0.0f, 0.0f);
+	vec3_set(body->linear_momentum, 0.0f, 0.0f, 0.0f);
+}
+
+static struct test_output rbp_integrate_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const vec3 center[2] = { { 0.0f, 10.0f, 0.0f }, { 0.0f, -10.0f, 0.0f } };
+	struct rbp pipeline = rbp_new(env->mem_1, 3, 1);
+	for (i32 i = 0; i < 2; ++i)
+	{
+		struct rigid_body body;
+		box_body_setup(&body, env, center[i], hw, 2.0f);
+		rbp_add(&pipeline, i, &body, (i == 0));
+	}
+
+	/* the first step only picks up momentum, the second moves the dynamic body by g*dt^2 */
+	const f32 dt = 0.1f;
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	TEST_TRUE(fabsf(pipeline.inv_mass[0] - 0.5f) < 0.0001f);
+	TEST_TRUE(fabsf(pipeline.linear_momentum[0][1] - 2.0f * 2.0f * dt * pipeline.gravity[1]) < 0.0001f);
+	TEST_TRUE(fabsf(pipeline.position[0][1] - (10.0f + dt * dt * pipeline.gravity[1])) < 0.0001f);
+	TEST_TRUE(vec3_distance(pipeline.position[1], center[1]) == 0.0f);
+
+	/* the moved proxy still bounds the body */
+	struct AABB world_box = pipeline.local_box[0];
+	vec3_translate(world_box.center, pipeline.position[0]);
+	TEST_TRUE(AABB_contains(&pipeline.dynamic_tree.nodes[pipeline.proxy[0]].box, &world_box));
+
+	return output;
+}
+
+static struct test_output rbp_contact_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 20.0f, 1.0f, 20.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const vec3 center[2] = { { 0.0f, 0.6f, 0.0f }, { 10.0f, 3.0f, 0.0f } };
+	struct rbp pipeline = rbp_new(env->mem_1, 3, 1);
+
+	struct rigid_body body;
+	box_body_setup(&body, env, floor_center, floor_hw, 1.0f);
+	rbp_add(&pipeline, 0, &body, 0);
+
+	/* a box sliding along the floor and a bouncing box dropped from above it */
+	for (i32 i = 0; i < 2; ++i)
+	{
+		box_body_setup(&body, env, center[i], hw, 1.0f);
+		body.restitution = (f32) i;
+		vec3_set(body.linear_momentum, 2.0f * body.mass * (f32) (1 - i), 0.0f, 0.0f);
+		rbp_add(&pipeline, i + 1, &body, 1);
+	}
+
+	/* the dropped box hits the floor at about 6.3 m/s and leaves it upwards with about the same speed */
+	const f32 dt = 1.0f / 60.0f;
+	f32 max_rise = 0.0f;
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		max_rise = fmaxf(max_rise, pipeline.linear_momentum[2][1] * pipeline.inv_mass[2]);
+	}
+	TEST_TRUE(max_rise > 5.0f);
+
+	/* friction has stopped the sliding box, which rests on the floor within the penetration slop */
+	TEST_TRUE(fabsf(pipeline.linear_momentum[1][0]) < 0.0001f);
+	TEST_TRUE(pipeline.position[1][0] > 0.2f && pipeline.position[1][0] < 0.6f);
+	TEST_TRUE(fabsf(pipeline.position[1][1] - 0.5f) < SOLVER_PENETRATION_SLOP + 0.005f);
+
+	/* 
+	 * the four corners of the resting face are cached for warm starting and together carry the weight of the box,
+	 * also once it has fallen asleep
+	 */
+	u32 resting = 0;
+	f32 impulse = 0.0f;
+	for (u32 i = 0; i < pipeline.contact_count; ++i)
+	{
+		const struct rbp_contact_point *c = pipeline.contact_cache + i;
+		if (c->body_1 == 1 || c->body_2 == 1)
+		{
+			resting += 1;
+			impulse += c->normal_impulse;
+		}
+	}
+	TEST_TRUE(pipeline.flags[1] & RBP_BODY_SLEEPING);
+	TEST_EQUAL(resting, 4);
+	TEST_TRUE(fabsf(impulse + pipeline.gravity[1] * dt / pipeline.inv_mass[1]) < 0.001f);
+
+	/* removing a body only evicts its own points, the resting box keeps warm starting */
+	rbp_remove(&pipeline, 2);
+	resting = 0;
+	for (u32 i = 0; i < pipeline.contact_count; ++i)
+	{
+		const struct rbp_contact_point *c = pipeline.contact_cache + i;
+		TEST_TRUE(c->body_1 != 2 && c->body_2 != 2);
+		resting += (c->body_1 == 1 || c->body_2 == 1) ? 1 : 0;
+	}
+	TEST_EQUAL(resting, 4);
+
+	rbp_remove(&pipeline, 1);
+	TEST_EQUAL(pipeline.contact_count, 0);
+
+	return output;
+}
+
+static struct test_output rbp_fast_slide_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 40.0f, 1.0f, 40.0f };
+	const vec3 center = { -20.0f, 0.5f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const f32 dt = 1.0f / 60.0f;
+	struct rbp pipeline = rbp_new(env->mem_1, 2, 1);
+
+	struct rigid_body body;
+	box_body_setup(&body, env, floor_center, floor_hw, 1.0f);
+	rbp_add(&pipeline, 0, &body, 0);
+
+	/* a fast box sliding on the floor moves further than its half width every step, and must not stop at the floor */
+	box_body_setup(&body, env, center, hw, 1.0f);
+	body.fast = 1;
+	body.friction = 0.0f;
+	vec3_set(body.linear_momentum, 60.0f * body.mass, 0.0f, 0.0f);
+	rbp_add(&pipeline, 1, &body, 1);
+	for (u32 step = 0; step < 30; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	TEST_TRUE(pipeline.position[1][0] > -20.0f + 0.9f * 30.0f);
+	TEST_TRUE(fabsf(pipeline.position[1][1] - 0.5f) < 0.05f);
+
+	/* nor when leaving the floor */
+	const vec3 up = { -60.0f * body.mass, 60.0f * body.mass, 0.0f };
+	rbp_apply_linear_impulse(&pipeline, 1, up);
+	const f32 y = pipeline.position[1][1];
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	TEST_TRUE(pipeline.position[1][1] - y > 0.9f);
+
+	return output;
+}
+
+static struct test_output rbp_island_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	/* separate piles on a shared floor: islands only meet through the static floor */
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 20.0f, 1.0f, 20.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const u32 pile_count = 6;
+	struct rbp pipeline[2] = { rbp_new(env->mem_1, 2*pile_count + 1, 1), rbp_new(env->mem_1, 2*pile_count + 1, 4) };
+	for (u32 p = 0; p < 2; ++p)
+	{
+		struct rigid_body body;
+		box_body_setup(&body, env, floor_center, floor_hw, 1.0f);
+		rbp_add(pipeline + p, 0, &body, 0);
+
+		for (u32 i = 0; i < 2*pile_count; ++i)
+		{
+			const vec3 center = { 3.0f * (f32) (i / 2), 0.55f + 1.05f * (f32) (i % 2), 0.0f };
+			box_body_setup(&body, env, center, hw, 1.0f);
+			rbp_add(pipeline + p, (i32) i + 1, &body, 1);
+		}
+	}
+
+	const f32 dt = 1.0f / 60.0f;
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, pipeline + 0, dt);
+		rbp_simulate_frame(env->mem_2, pipeline + 1, dt);
+	}
+
+	/* the stacks settle, and solving the islands on several threads gives the single threaded result */
+	for (u32 i = 0; i < 2*pile_count; ++i)
+	{
+		const f32 rest = 0.5f + (f32) (i % 2);
+		TEST_TRUE(fabsf(pipeline[0].position[i + 1][1] - rest) < 2.0f * SOLVER_PENETRATION_SLOP);
+		TEST_TRUE(memcmp(pipeline[0].position[i + 1], pipeline[1].position[i + 1], sizeof(vec3)) == 0);
+		TEST_TRUE(memcmp(pipeline[0].linear_momentum[i + 1], pipeline[1].linear_momentum[i + 1], sizeof(vec3)) == 0);
+	}
+	rbp_free(pipeline + 1);
+
+	return output;
+}
+
+static struct test_output rbp_color_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	/* a layer of boxes side by side on the floor is one island, large enough to be solved color by color */
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 20.0f, 1.0f, 20.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const u32 side = 6;
+	struct rbp pipeline[2] = { rbp_new(env->mem_1, side*side + 1, 1), rbp_new(env->mem_1, side*side + 1, 4) };
+	for (u32 p = 0; p < 2; ++p)
+	{
+		struct rigid_body body;
+		box_body_setup(&body, env, floor_center, floor_hw, 1.0f);
+		rbp_add(pipeline + p, 0, &body, 0);
+
+		for (u32 i = 0; i < side*side; ++i)
+		{
+			const vec3 center = { 1.02f * (f32) (i % side), 0.55f, 1.02f * (f32) (i / side) };
+			box_body_setup(&body, env, center, hw, 1.0f);
+			rbp_add(pipeline + p, (i32) i + 1, &body, 1);
+		}
+	}
+
+	const f32 dt = 1.0f / 60.0f;
+	for (u32 step = 0; step < 30; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, pipeline + 0, dt);
+		rbp_simulate_frame(env->mem_2, pipeline + 1, dt);
+	}
+	TEST_TRUE(pipeline[0].contact_count >= RBP_COLOR_CONTACTS);
+
+	/* the boxes rest, and the colored solve on several threads gives the single threaded result */
+	for (u32 i = 0; i < side*side; ++i)
+	{
+		TEST_TRUE(fabsf(pipeline[0].position[i + 1][1] - 0.5f) < 2.0f * SOLVER_PENETRATION_SLOP);
+		TEST_TRUE(memcmp(pipeline[0].position[i + 1], pipeline[1].position[i + 1], sizeof(vec3)) == 0);
+		TEST_TRUE(memcmp(pipeline[0].linear_momentum[i + 1], pipeline[1].linear_momentum[i + 1], sizeof(vec3)) == 0);
+		TEST_TRUE(memcmp(pipeline[0].angular_momentum[i + 1], pipeline[1].angular_momentum[i + 1], sizeof(vec3)) == 0);
+	}
+	rbp_free(pipeline + 1);
+
+	return output;
+}
+
+static struct test_output rbp_sleep_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 20.0f, 1.0f, 20.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const vec3 center[3] = { { 0.0f, 0.55f, 0.0f }, { 3.0f, 0.55f, 0.0f }, { 0.0f, 1.8f, 0.0f } };
+	struct rbp pipeline = rbp_new(env->mem_1, 4, 1);
+
+	struct rigid_body body;
+	box_body_setup(&body, env, floor_center, floor_hw, 1.0f);
+	rbp_add(&pipeline, 0, &body, 0);
+
+	struct rigid_body boxes[3];
+	for (u32 i = 0; i < 3; ++i)
+	{
+		box_body_setup(boxes + i, env, center[i], hw, 1.0f);
+	}
+	rbp_add(&pipeline, 1, boxes + 0, 1);
+	rbp_add(&pipeline, 2, boxes + 1, 1);
+
+	/* resting boxes fall asleep and stay put */
+	const f32 dt = 1.0f / 60.0f;
+	for (u32 step = 0; step < 90; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	TEST_EQUAL(pipeline.awake_count, 0);
+	TEST_TRUE(pipeline.flags[1] & RBP_BODY_SLEEPING);
+	vec3 rest;
+	vec3_copy(rest, pipeline.position[1]);
+	for (u32 step = 0; step < 10; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	TEST_TRUE(memcmp(rest, pipeline.position[1], sizeof(vec3)) == 0);
+
+	/* a box dropped onto a sleeping one wakes it, the other stays asleep until pushed */
+	rbp_add(&pipeline, 3, boxes + 2, 1);
+	for (u32 step = 0; step < 20; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	TEST_TRUE(!(pipeline.flags[1] & RBP_BODY_SLEEPING));
+	TEST_TRUE(pipeline.flags[2] & RBP_BODY_SLEEPING);
+
+	const vec3 impulse = { 0.0f, 2.0f, 0.0f };
+	const f32 height = pipeline.position[2][1];
+	rbp_apply_linear_impulse(&pipeline, 2, impulse);
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	TEST_TRUE(pipeline.position[2][1] > height + 0.01f);
+
+	/* removing the floor wakes everything resting on it */
+	for (u32 step = 0; step < 120; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	TEST_EQUAL(pipeline.awake_count, 0);
+	f32 heights[4];
+	for (i32 i = 1; i < 4; ++i)
+	{
+		heights[i] = pipeline.position[i][1];
+	}
+	rbp_remove(&pipeline, 0);
+	for (u32 step = 0; step < 30; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	for (i32 i = 1; i < 4; ++i)
+	{
+		TEST_TRUE(pipeline.position[i][1] < heights[i] - 1.0f);
+	}
+
+	return output;
+}
+
+static struct test_output rbp_active_list_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	struct rigid_body body;
+	box_body_setup(&body, env, center, hw, 1.0f);
+
+	/* sparse slots */
+	struct rbp pipeline = rbp_new(env->mem_1, 8, 1);
+	const struct rbp_handle h_5 = rbp_add(&pipeline, 5, &body, 1);
+	const struct rbp_handle h_2 = rbp_add(&pipeline, 2, &body, 1);
+	const struct rbp_handle h_7 = rbp_add(&pipeline, 7, &body, 0);
+	TEST_EQUAL(pipeline.count, 3);
+	TEST_EQUAL(rbp_handle_index(&pipeline, h_2), 2);
+
+	/* swap remove keeps the active list packed and the back pointers in sync */
+	rbp_remove(&pipeline, 5);
+	TEST_EQUAL(pipeline.count, 2);
+	TEST_EQUAL(rbp_handle_index(&pipeline, h_5), -1);
+	TEST_EQUAL(rbp_handle_index(&pipeline, h_7), 7);
+	for (i32 k = 0; k < pipeline.count; ++k)
+	{
+		TEST_EQUAL(pipeline.active_index[pipeline.active[k]], k);
+	}
+	TEST_EQUAL(pipeline.active_index[5], -1);
+
+	/* a reused slot does not revive old handles, and sparse dynamic bodies are all integrated */
+	const struct rbp_handle h_5_new = rbp_add(&pipeline, 5, &body, 1);
+	TEST_EQUAL(rbp_handle_index(&pipeline, h_5), -1);
+	TEST_EQUAL(rbp_handle_index(&pipeline, h_5_new), 5);
+
+	rbp_simulate_frame(env->mem_2, &pipeline, 0.1f);
+	TEST_TRUE(pipeline.linear_momentum[2][1] < 0.0f);
+	TEST_TRUE(pipeline.linear_momentum[5][1] < 0.0f);
+	TEST_TRUE(pipeline.linear_momentum[7][1] == 0.0f);
+
+	return output;
+}
+
+static struct test_output rbp_rotation_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 floor_center = { 0.0f, -1.0f, 0.0f };
+	const vec3 floor_hw = { 20.0f, 1.0f, 20.0f };
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	const f32 dt = 1.0f / 60.0f;
+
+	struct rigid_body body;
+	box_body_setup(&body, env, center, hw, 1.0f);
+
+	/* a free cube spun about y turns at w = L / I and stays normalized */
+	struct rbp pipeline = rbp_new(env->mem_1, 2, 1);
+	vec3_set(pipeline.gravity, 0.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	const f32 w = 2.0f;
+	const vec3 spin = { 0.0f, w * body.inertia_tensor[1][1], 0.0f };
+	rbp_apply_angular_impulse(&pipeline, 0, spin);
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+	const f32 *q = pipeline.rotation[0];
+	TEST_TRUE(fabsf(quat_norm(pipeline.rotation[0]) - 1.0f) < 0.0001f);
+	TEST_TRUE(fabsf(q[0]) < 0.0001f && fabsf(q[2]) < 0.0001f);
+	TEST_TRUE(fabsf(2.0f * atan2f(q[1], q[3]) - w * 60.0f * dt) < 0.01f);
+
+	/* the proxy bounds the rotated box */
+	mat3 rot;
+	struct AABB world_box;
+	quat_to_mat3(rot, pipeline.rotation[0]);
+	AABB_transform(&world_box, pipeline.local_box + 0, rot, pipeline.position[0]);
+	TEST_TRUE(AABB_contains(&pipeline.dynamic_tree.nodes[pipeline.proxy[0]].box, &world_box));
+	TEST_TRUE(world_box.hw[0] > 0.6f);
+
+	/* a tilted cube dropped onto the floor tips over and settles flat on a face */
+	pipeline = rbp_new(env->mem_1, 2, 1);
+	struct rigid_body floor;
+	box_body_setup(&floor, env, floor_center, floor_hw, 1.0f);
+	rbp_add(&pipeline, 0, &floor, 0);
+
+	const vec3 axis = { 0.0f, 0.0f, 1.0f };
+	axis_angle_to_quaternion(body.rotation, axis, 0.5f);
+	vec3_set(body.position, 0.0f, 1.5f, 0.0f);
+	rbp_add(&pipeline, 1, &body, 1);
+	for (u32 step = 0; step < 240; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	}
+
+	quat_to_mat3(rot, pipeline.rotation[1]);
+	const f32 up = fmaxf(fabsf(rot[0][1]), fmaxf(fabsf(rot[1][1]), fabsf(rot[2][1])));
+	TEST_TRUE(up > 0.999f);
+	TEST_TRUE(fabsf(pipeline.position[1][1] - 0.5f) < 0.05f);
+
+	return output;
+}
+
+static struct test_output rbp_integrator_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	struct rigid_body body;
+	box_body_setup(&body, env, center, hw, 1.0f);
+
+	/* 
+	 * thrown up under gravity: the second and fourth order integrators are exact for constant forces, explicit
+	 * Euler lags behind the parabola and symplectic Euler runs ahead of it by n*h^2*g/2
+	 */
+	const f32 dt = 1.0f / 30.0f;
+	const u32 steps = 30;
+	const f32 v_0 = 5.0f;
+	const f32 g = 10.0f;
+	const f32 t = dt * steps;
+	const f32 exact = v_0 * t - 0.5f * g * t * t;
+	const f32 drift = 0.5f * g * dt * dt * steps;
+	f32 height[RBP_INTEGRATOR_COUNT];
+	for (u32 integrator = 0; integrator < RBP_INTEGRATOR_COUNT; ++integrator)
+	{
+		struct rbp pipeline = rbp_new(env->mem_1, 1, 1);
+		pipeline.integrator = integrator;
+		vec3_set(pipeline.gravity, 0.0f, -g, 0.0f);
+		vec3_set(body.linear_momentum, 0.0f, v_0 * body.mass, 0.0f);
+		rbp_add(&pipeline, 0, &body, 1);
+		for (u32 step = 0; step < steps; ++step)
+		{
+			rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		}
+		height[integrator] = pipeline.position[0][1];
+		TEST_TRUE(fabsf(pipeline.linear_momentum[0][1] / body.mass - (v_0 - g * t)) < 0.001f);
+	}
+
+	TEST_TRUE(fabsf(height[RBP_INTEGRATOR_EULER] - (exact + drift)) < 0.001f);
+	TEST_TRUE(fabsf(height[RBP_INTEGRATOR_SYMPLECTIC_EULER] - (exact - drift)) < 0.001f);
+	TEST_TRUE(fabsf(height[RBP_INTEGRATOR_VERLET] - exact) < 0.001f);
+	TEST_TRUE(fabsf(height[RBP_INTEGRATOR_RK4] - exact) < 0.001f);
+
+	return output;
+}
+
+static struct test_output rbp_field_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	struct rigid_body body;
+	box_body_setup(&body, env, center, hw, 1.0f);
+	TEST_TRUE(fabsf(body.volume - 1.0f) < 0.0001f);
+
+	const f32 dt = 1.0f / 60.0f;
+	struct arena record = *env->mem_2;
+
+	/* accumulated forces act over one step */
+	struct rbp pipeline = rbp_new(env->mem_1, 4, 1);
+	vec3_set(pipeline.gravity, 0.0f, 0.0f, 0.0f);
+	vec3_set(body.position, 0.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	const vec3 push = { 6.0f, 0.0f, 0.0f };
+	rbp_apply_force(&pipeline, 0, push);
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	rbp_simulate_frame(env->mem_2, &pipeline, dt);
+	*env->mem_2 = record;
+	TEST_TRUE(fabsf(pipeline.linear_momentum[0][0] - 6.0f * dt) < 0.0001f);
+
+	/* a damped spring to an anchor comes to rest at its rest length, a body outside a bounded drag field is not slowed */
+	struct rbp_field field = { .type = RBP_FIELD_SPRING, .bounded = 0 };
+	field.value.spring.body_1 = 0;
+	field.value.spring.body_2 = -1;
+	vec3_set(field.value.spring.anchor, -2.0f, 0.0f, 0.0f);
+	field.value.spring.rest_length = 1.0f;
+	field.value.spring.stiffness = 20.0f;
+	field.value.spring.damping = 4.0f;
+	const struct rbp_handle spring = rbp_field_add(&pipeline, &field);
+	TEST_EQUAL(rbp_field_index(&pipeline, spring), 0);
+
+	vec3_set(body.position, 10.0f, 0.0f, 0.0f);
+	vec3_set(body.linear_momentum, 1.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 1, &body, 1);
+	struct rbp_field drag = { .type = RBP_FIELD_DRAG, .bounded = 1 };
+	vec3_set(drag.box.center, 0.0f, 0.0f, 0.0f);
+	vec3_set(drag.box.hw, 5.0f, 5.0f, 5.0f);
+	drag.value.drag.linear = 1.0f;
+	drag.value.drag.quadratic = 0.0f;
+	drag.value.drag.angular = 0.0f;
+	const struct rbp_handle slow = rbp_field_add(&pipeline, &drag);
+	TEST_EQUAL(rbp_field_index(&pipeline, slow), 1);
+	for (u32 step = 0; step < 600; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+	}
+	TEST_TRUE(fabsf(pipeline.position[0][0] + 1.0f) < 0.01f);
+	TEST_TRUE(fabsf(pipeline.linear_momentum[1][0] - 1.0f) < 0.0001f);
+
+	/* removing the body removes its spring, the handle of the moved field still resolves and a reused slot does not */
+	rbp_remove(&pipeline, 0);
+	TEST_EQUAL(pipeline.field_count, 1);
+	TEST_EQUAL(rbp_field_index(&pipeline, spring), -1);
+	TEST_EQUAL(rbp_field_index(&pipeline, slow), 0);
+	TEST_EQUAL(pipeline.field[rbp_field_index(&pipeline, slow)].type, RBP_FIELD_DRAG);
+	const struct rbp_handle again = rbp_field_add(&pipeline, &drag);
+	TEST_EQUAL(again.index, spring.index);
+	TEST_EQUAL(rbp_field_index(&pipeline, spring), -1);
+	rbp_field_remove(&pipeline, spring);
+	TEST_EQUAL(pipeline.field_count, 2);
+	rbp_field_remove(&pipeline, slow);
+	TEST_EQUAL(pipeline.field_count, 1);
+	TEST_EQUAL(rbp_field_index(&pipeline, again), 0);
+
+	/* a body half as dense as the fluid floats half submerged, one beside the fluid falls */
+	pipeline = rbp_new(env->mem_1, 4, 1);
+	vec3_set(body.linear_momentum, 0.0f, 0.0f, 0.0f);
+	vec3_set(body.position, 0.0f, 1.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	vec3_set(body.position, 20.0f, 1.0f, 0.0f);
+	rbp_add(&pipeline, 1, &body, 1);
+	struct rbp_field fluid = { .type = RBP_FIELD_BUOYANCY, .bounded = 1 };
+	vec3_set(fluid.box.center, 0.0f, -5.0f, 0.0f);
+	vec3_set(fluid.box.hw, 5.0f, 5.0f, 5.0f);
+	fluid.value.buoyancy.density = 2.0f;
+	fluid.value.buoyancy.drag = 4.0f;
+	rbp_field_add(&pipeline, &fluid);
+	for (u32 step = 0; step < 600; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+	}
+	TEST_TRUE(fabsf(pipeline.position[0][1]) < 0.02f);
+	TEST_TRUE(pipeline.position[1][1] < -100.0f);
+
+	return output;
+}
+
+static struct test_output rbp_joint_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	struct rigid_body body;
+	box_body_setup(&body, env, center, hw, 1.0f);
+
+	const f32 dt = 1.0f / 60.0f;
+	struct arena record = *env->mem_2;
+	const vec3 origin = { 0.0f, 0.0f, 0.0f };
+	const vec3 x_axis = { 1.0f, 0.0f, 0.0f };
+	const vec3 z_axis = { 0.0f, 0.0f, 1.0f };
+
+	/* a pendulum on a ball joint swings down and keeps its length */
+	struct rbp pipeline = rbp_new(env->mem_1, 2, 1);
+	vec3_set(body.position, 2.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	const struct rbp_handle ball = rbp_joint_add(&pipeline, RBP_JOINT_BALL, 0, -1, origin, origin, x_axis);
+	TEST_EQUAL(rbp_joint_index(&pipeline, ball), 0);
+	for (u32 step = 0; step < 30; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+		TEST_TRUE(fabsf(vec3_length(pipeline.position[0]) - 2.0f) < 0.05f);
+	}
+	TEST_TRUE(pipeline.position[0][1] < -1.0f);
+
+	/* a hinge keeps its axis when kicked about another one */
+	pipeline = rbp_new(env->mem_1, 2, 1);
+	vec3_set(body.position, 0.0f, -1.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	rbp_joint_add(&pipeline, RBP_JOINT_HINGE, 0, -1, origin, origin, z_axis);
+	const vec3 kick = { 1.0f, 0.5f, 0.2f };
+	rbp_apply_angular_impulse(&pipeline, 0, kick);
+	mat3 rot;
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+	}
+	quat_to_mat3(rot, pipeline.rotation[0]);
+	TEST_TRUE(rot[2][2] > 0.99f);
+	TEST_TRUE(fabsf(vec3_length(pipeline.position[0]) - 1.0f) < 0.05f);
+	TEST_TRUE(fabsf(pipeline.position[0][2]) < 0.05f);
+
+	/* a prismatic joint lets the body slide along its axis only */
+	pipeline = rbp_new(env->mem_1, 2, 1);
+	vec3_set(body.position, 0.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	rbp_joint_add(&pipeline, RBP_JOINT_PRISMATIC, 0, -1, origin, origin, x_axis);
+	const vec3 shove = { 2.0f, 1.0f, 0.0f };
+	rbp_apply_linear_impulse(&pipeline, 0, shove);
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+	}
+	TEST_TRUE(pipeline.position[0][0] > 1.5f);
+	TEST_TRUE(fabsf(pipeline.position[0][1]) < 0.05f);
+	TEST_TRUE(fabsf(pipeline.rotation[0][3]) > 0.999f);
+
+	/* two bodies joined by a fixed joint spin and fall as one, a distance joint keeps its length */
+	pipeline = rbp_new(env->mem_1, 3, 1);
+	vec3_set(body.position, 0.0f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 0, &body, 1);
+	vec3_set(body.position, 1.5f, 0.0f, 0.0f);
+	rbp_add(&pipeline, 1, &body, 1);
+	vec3_set(body.position, 0.0f, 0.0f, 5.0f);
+	rbp_add(&pipeline, 2, &body, 1);
+	const vec3 weld = { 0.75f, 0.0f, 0.0f };
+	const vec3 hook = { 0.0f, 3.0f, 5.0f };
+	const struct rbp_handle fixed = rbp_joint_add(&pipeline, RBP_JOINT_FIXED, 0, 1, weld, weld, x_axis);
+	const struct rbp_handle rope = rbp_joint_add(&pipeline, RBP_JOINT_DISTANCE, 2, -1, pipeline.position[2], hook, x_axis);
+	const vec3 spin = { 0.0f, 0.5f, 0.5f };
+	rbp_apply_angular_impulse(&pipeline, 0, spin);
+	vec3 d;
+	for (u32 step = 0; step < 60; ++step)
+	{
+		rbp_simulate_frame(env->mem_2, &pipeline, dt);
+		*env->mem_2 = record;
+	}
+	TEST_TRUE(pipeline.position[0][1] < -1.0f);
+	TEST_TRUE(fabsf(vec3_distance(pipeline.position[0], pipeline.position[1]) - 1.5f) < 0.05f);
+	TEST_TRUE(fabsf(vec3_dot(pipeline.rotation[0], pipeline.rotation[1]) + pipeline.rotation[0][3] * pipeline.rotation[1][3]) > 0.999f);
+	vec3_sub(d, pipeline.position[2], hook);
+	TEST_TRUE(fabsf(vec3_length(d) - 3.0f) < 0.05f);
+
+	/* removing a body removes its joints, the handle of the moved joint still resolves */
+	rbp_remove(&pipeline, 1);
+	TEST_EQUAL(pipeline.joint_count, 1);
+	TEST_EQUAL(rbp_joint_index(&pipeline, fixed), -1);
+	TEST_EQUAL(rbp_joint_index(&pipeline, rope), 0);
+	TEST_EQUAL(pipeline.joint[rbp_joint_index(&pipeline, rope)].type, RBP_JOINT_DISTANCE);
+	rbp_joint_remove(&pipeline, fixed);
+	TEST_EQUAL(pipeline.joint_count, 1);
+	rbp_joint_remove(&pipeline, rope);
+	TEST_EQUAL(pipeline.joint_count, 0);
+	TEST_EQUAL(rbp_joint_index(&pipeline, rope), -1);
+
+	return output;
+}
+
+static struct test_output GJK_batch_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	mersenne_twister_init(env->seed);
+
+	const u32 set_count = 12;
+	const u32 max_v_count = 64;
+	vec3 pos[12];
+	mat3 rot[12];
+	vec3 vs[12][64];
+	u32 n[12];
+
+	for (u32 i = 0; i < set_count; ++i)
+	{
+		n[i] = 4 + (u32) gen_continuous_uniform_f(0.0f, (f32) (max_v_count - 4));
+		vec3_set(pos[i], gen_continuous_uniform_f(-2.0f, 2.0f), gen_continuous_uniform_f(-2.0f, 2.0f), gen_continuous_uniform_f(-2.0f, 2.0f));
+		quat q;
+		const vec3 axis = { gen_continuous_uniform_f(-1.0f, 1.0f), gen_continuous_uniform_f(-1.0f, 1.0f), 1.0f };
+		axis_angle_to_quaternion(q, axis, gen_continuous_uniform_f(0.0f, 2.0f*MM_PI_F));
+		quat_to_mat3(rot[i], q);
+		for (u32 j = 0; j < n[i]; ++j)
+		{
+			vec3_set(vs[i][j], gen_continuous_uniform_f(-1.0f, 1.0f), gen_continuous_uniform_f(-1.0f, 1.0f), gen_continuous_uniform_f(-1.0f, 1.0f));
+		}
+	}
+
+	const f32 tol = 100.0f * FLT_EPSILON;
+	struct gjk_pair pairs[12*11/2];
+	u32 result[12*11/2];
+	u32 count = 0;
+	for (u32 i = 0; i < set_count; ++i)
+	{
+		for (u32 j = i+1; j < set_count; ++j)
+		{
+			pairs[count].pos_1 = pos[i];
+			pairs[count].pos_2 = pos[j];
+			pairs[count].rot_1 = rot[i];
+			pairs[count].rot_2 = rot[j];
+			pairs[count].vs_1 = vs[i];
+			pairs[count].vs_2 = vs[j];
+			pairs[count].n_1 = n[i];
+			pairs[count].n_2 = n[j];
+
+			/* the vertices lie within sqrt(3) of the positions; every lane has its own tolerance */
+			struct sphere s_1 = { .radius = sqrtf(3.0f) };
+			struct sphere s_2 = { .radius = sqrtf(3.0f) };
+			vec3_copy(s_1.center, pos[i]);
+			vec3_copy(s_2.center, pos[j]);
+			pairs[count].abs_tol = GJK_tolerance(&s_1, &s_2, tol);
+			count += 1;
+		}
+	}
+
+	GJK_test_batch(result, pairs, count);
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		const u32 expected = GJK_test(pairs[i].pos_1, pairs[i].rot_1, pairs[i].vs_1, pairs[i].n_1, pairs[i].pos_2, pairs[i].rot_2, pairs[i].vs_2, pairs[i].n_2, pairs[i].abs_tol, 0.0f);
+		TEST_EQUAL(result[i], expected);
+	}
+
+	return output;
+}
+
+static struct test_output GJK_time_of_impact_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	vec3 box[8];
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	gen_box(box, center, hw);
+
+	const vec3 pos_1 = { 0.0f, 0.0f, 0.0f };
+	const vec3 pos_2 = { 5.0f, 0.25f, 0.0f };
+	const vec3 vel_1 = { 10.0f, 0.0f, 0.0f };
+	const vec3 vel_away = { -10.0f, 0.0f, 0.0f };
+	const vec3 vel_2 = { 0.0f, 0.0f, 0.0f };
+	const f32 tol = 0.001f;
+	mat3 rot;
+	mat3_identity(rot);
+
+	/* gap of 4.0 closed at speed 10.0 */
+	const f32 toi = GJK_time_of_impact(pos_1, rot, vel_1, box, 8, pos_2, rot, vel_2, box, 8, 1.0f, tol);
+	TEST_TRUE(toi <= 0.4f && toi >= 0.4f - tol);
+
+	/* impact happens after t_max */
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_1, box, 8, pos_2, rot, vel_2, box, 8, 0.3f, tol), FLT_MAX);
+
+	/* separating bodies */
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_away, box, 8, pos_2, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+
+	/* bodies touching or overlapping at the start are left to the contact solver, whichever way they move */
+	const vec3 touching = { 1.0f + 0.5f*tol, 0.0f, 0.0f };
+	const vec3 overlapping = { 0.9f, 0.0f, 0.0f };
+	const vec3 vel_slide = { 0.0f, 10.0f, 0.0f };
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_1, box, 8, touching, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_slide, box, 8, touching, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_away, box, 8, touching, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_1, box, 8, overlapping, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+
+	/* passing beside a body never impacts */
+	const vec3 beside = { 5.0f, 2.0f, 0.0f };
+	TEST_EQUAL(GJK_time_of_impact(pos_1, rot, vel_1, box, 8, beside, rot, vel_2, box, 8, 1.0f, tol), FLT_MAX);
+
+	return output;
+}
+
+static struct test_output GJK_rotation_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	/* 
+	 * a rod turned 30 degrees around z and its mirror image turned -30 degrees are told apart only if the rotation, 
+	 * and not its transpose, is applied; the rod is long along x so a box on one side of the x axis touches one of them
+	 */
+	vec3 rod[8], box[8];
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 rod_hw = { 1.0f, 0.05f, 0.05f };
+	const vec3 box_hw = { 0.1f, 0.1f, 0.1f };
+	gen_box(rod, center, rod_hw);
+	gen_box(box, center, box_hw);
+
+	quat q;
+	mat3 identity, rot;
+	const vec3 axis = { 0.0f, 0.0f, 1.0f };
+	axis_angle_to_quaternion(q, axis, MM_PI_F / 6.0f);
+	quat_to_mat3(rot, q);
+	mat3_identity(identity);
+
+	/* the rod reaches (0.78, 0.45) at 0.9 along its axis, and never comes near (0.78, -0.45) */
+	const vec3 pos_1 = { 0.0f, 0.0f, 0.0f };
+	const vec3 above = { 0.78f, 0.45f, 0.0f };
+	const vec3 below = { 0.78f, -0.45f, 0.0f };
+	TEST_EQUAL(GJK_test(pos_1, rot, rod, 8, above, identity, box, 8, 0.0f, 100.0f*FLT_EPSILON), 1);
+	TEST_EQUAL(GJK_test(pos_1, rot, rod, 8, below, identity, box, 8, 0.0f, 100.0f*FLT_EPSILON), 0);
+	TEST_EQUAL(GJK_test(above, identity, box, 8, pos_1, rot, rod, 8, 0.0f, 100.0f*FLT_EPSILON), 1);
+	TEST_EQUAL(GJK_test(below, identity, box, 8, pos_1, rot, rod, 8, 0.0f, 100.0f*FLT_EPSILON), 0);
+
+	/* the closest point of the rod to a box straight above the origin lies on its upper right half */
+	vec3 c_1, c_2;
+	const vec3 pos_3 = { 0.0f, 1.0f, 0.0f };
+	const f32 dist = GJK_distance(c_1, c_2, pos_1, rot, rod, 8, pos_3, identity, box, 8, 0.0001f, 100.0f*FLT_EPSILON);
+	TEST_TRUE(dist > 0.0f && dist < 0.9f);
+	TEST_TRUE(c_1[0] > 0.3f && c_1[1] > 0.2f);
+	TEST_TRUE(fabsf(vec3_distance(c_1, c_2) - dist) < 0.001f);
+
+	return output;
+}
+
+static struct test_output GJK_distance_within_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	mersenne_twister_init(env->seed);
+
+	vec3 box[8];
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	gen_box(box, center, hw);
+
+	mat3 identity;
+	mat3_identity(identity);
+	vec3 c_1, c_2;
+	const vec3 pos_1 = { 0.0f, 0.0f, 0.0f };
+	for (u32 i = 0; i < 64; ++i)
+	{
+		const vec3 pos_2 = 
+		{
+			gen_continuous_uniform_f(-3.0f, 3.0f),
+			gen_continuous_uniform_f(-3.0f, 3.0f),
+			gen_continuous_uniform_f(-3.0f, 3.0f),
+		};
+		const f32 max_dist = gen_continuous_uniform_f(0.0f, 2.0f);
+		const f32 dist = GJK_distance(c_1, c_2, pos_1, identity, box, 8, pos_2, identity, box, 8, 0.0001f, 100.0f*FLT_EPSILON);
+		const u32 within = GJK_distance_within(pos_1, identity, box, 8, pos_2, identity, box, 8, max_dist, 0.0001f, 100.0f*FLT_EPSILON);
+		if (fabsf(dist - max_dist) > 0.001f)
+		{
+			TEST_EQUAL(within, (u32) (dist <= max_dist));
+		}
+	}
+
+	return output;
+}
+
+static struct test_output convex_hull_contact_assert(struct test_environment *env)
+{
+	struct test_output output = { .success = 1, .id = __func__ };
+
+	vec3 box[8];
+	const vec3 center = { 0.0f, 0.0f, 0.0f };
+	const vec3 hw = { 0.5f, 0.5f, 0.5f };
+	gen_box(box, center, hw);
+	const struct tri_mesh mesh = convex_hull_construct(env->mem_1, env->mem_2, box, 8, 0.0001f);
+
+	/* a box resting on a face of another one touches at the four corners */
+	struct contact_patch patch;
+	mat3 rot_1, rot_2;
+	mat3_identity(rot_1);
+	mat3_identity(rot_2);
+	const vec3 pos_1 = { 0.0f, 0.0f, 0.0f };
+	vec3 pos_2 = { 0.0f, 0.99f, 0.0f };
+	TEST_EQUAL(convex_hull_contact(env->mem_2, &patch, pos_1, rot_1, &mesh, pos_2, rot_2, &mesh, 0.05f), 4);
+	TEST_TRUE(patch.normal[1] > 0.999f);
+
+	/* 
+	 * boxes crossed edge on edge overlap along every face normal, only the cross product of the edges separates
+	 * them; once the edges dig in there is one edge contact along that axis
+	 */
+	quat q;
+	const vec3 x_axis = { 1.0f, 0.0f, 0.0f };
+	const vec3 z_axis = { 0.0f, 0.0f, 1.0f };
+	axis_angle_to_quaternion(q, z_axis, MM_PI_F / 4.0f);
+	quat_to_mat3(rot_1, q);
+	axis_angle_to_quaternion(q, x_axis, MM_PI_F / 4.0f);
+	quat_to_mat3(rot_2, q);
+	const f32 reach = sqrtf(2.0f);
+	vec3_set(pos_2, 0.0f, reach + 0.3f, 0.0f);
+	TEST_EQUAL(convex_hull_contact(env->mem_2, &patch, pos_1, rot_1, &mesh, pos_2, rot_2, &mesh, 0.05f), 0);
+
+	vec3_set(pos_2, 0.0f, reach - 0.02f, 0.0f);
+	TEST_EQUAL(convex_hull_contact(env->mem_2, &patch, pos_1, rot_1, &mesh, pos_2, rot_2, &mesh, 0.05f), 1);
+	TEST_TRUE(patch.normal[1] > 0.999f);
+	TEST_TRUE(fabsf(patch.depth[0] - 0.02f) < 0.001f);
+	TEST_TRUE(fabsf(patch.point[0][1] - (0.5f * reach - 0.01f)) < 0.001f);
+	TEST_TRUE(patch.feature[0] & CONTACT_PATCH_EDGE_FEATURE);
 
 	return output;
 }
@@ -823,7 +2228,30 @@ static struct test_output (*math_tests[])(struct test_environment *) =
 	fINF_assert_rounding,
 	fINF_assert_trap_interrupt,
 	fINF_assert_arithmetic,
+	quat_interpolate_assert,
 	rigid_statics_assert,
+	convex_hull_assert,
+	convex_hull_batch_assert,
+	convex_hull_simplify_assert,
+	shape_registry_assert,
+	compound_body_assert,
+	rbp_integrate_assert,
+	rbp_active_list_assert,
+	rbp_contact_assert,
+	rbp_fast_slide_assert,
+	rbp_island_assert,
+	rbp_color_assert,
+	rbp_sleep_assert,
+	rbp_rotation_assert,
+	rbp_integrator_assert,
+	rbp_field_assert,
+	rbp_joint_assert,
+	convex_decomposition_assert,
+	GJK_batch_assert,
+	GJK_time_of_impact_assert,
+	GJK_rotation_assert,
+	GJK_distance_within_assert,
+	convex_hull_contact_assert,
 };
 
 struct suite m_math_suite =